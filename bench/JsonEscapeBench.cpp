@@ -0,0 +1,307 @@
+// Throughput of the JsonEscape kernels against a per-byte loop and
+// nlohmann's string handling, on generated corpora and on the lines of any
+// files given on the command line:
+//
+//   JsonEscapeBench [file...]
+//
+// Every string is first checked against the per-byte loop and round-tripped
+// through Escape and Unescape; the program exits with 1 on a mismatch.
+#include "JsonEscape.h"
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Corpus {
+  std::string name;
+  std::vector<std::string> strings;
+  size_t bytes = 0;
+  // Unescape input writes non-ASCII as \uXXXX instead of raw UTF-8
+  bool asciiEscapes = false;
+};
+
+static volatile size_t g_sink;
+
+static uint32_t NextRandom(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static void Add(Corpus &corpus, std::string s) {
+  corpus.bytes += s.size();
+  corpus.strings.push_back(std::move(s));
+}
+
+// Keys and values of a typical settings file: short, plain ASCII.
+static Corpus ConfigCorpus() {
+  static const char *kWords[] = {"name",    "enabled", "server", "port",
+                                 "timeout", "retries", "path",   "level",
+                                 "include", "version", "id",     "target"};
+  Corpus corpus;
+  corpus.name = "config";
+  uint32_t state = 1;
+  for (int i = 0; i < 200000; i++) {
+    std::string s = kWords[NextRandom(state) % 12];
+    if (NextRandom(state) % 2) {
+      s += '.';
+      s += kWords[NextRandom(state) % 12];
+    }
+    Add(corpus, std::move(s));
+  }
+  return corpus;
+}
+
+// Log messages: long ASCII runs with the odd quote, Windows path and tab.
+static Corpus LogCorpus() {
+  Corpus corpus;
+  corpus.name = "log";
+  uint32_t state = 2;
+  for (int i = 0; i < 20000; i++) {
+    std::string s = "2024-05-01T12:00:00Z worker-" + std::to_string(i % 64) +
+                    " request completed in " +
+                    std::to_string(NextRandom(state) % 1000) + " ms";
+    switch (NextRandom(state) % 4) {
+    case 0:
+      s += " while loading \"C:\\Users\\build\\project\\settings.json\"";
+      break;
+    case 1:
+      s += "\tuser agent=\"Mozilla/5.0 (Windows NT 10.0; Win64; x64)\"";
+      break;
+    default:
+      s += " status=ok bytes=" + std::to_string(NextRandom(state));
+      break;
+    }
+    Add(corpus, std::move(s));
+  }
+  return corpus;
+}
+
+// UTF-8 prose: escaping passes it through, and its \uXXXX form (surrogate
+// pairs included) is what other tools write.
+static Corpus UnicodeCorpus() {
+  static const char *kWords[] = {"caf\xC3\xA9",   "na\xC3\xAFve",
+                                 "\xE6\x97\xA5\xE6\x9C\xAC",
+                                 "\xF0\x9F\x98\x80", "plain", "text"};
+  Corpus corpus;
+  corpus.name = "unicode";
+  corpus.asciiEscapes = true;
+  uint32_t state = 3;
+  for (int i = 0; i < 50000; i++) {
+    std::string s;
+    for (int w = 0; w < 6; w++) {
+      if (w)
+        s += ' ';
+      s += kWords[NextRandom(state) % 6];
+    }
+    Add(corpus, std::move(s));
+  }
+  return corpus;
+}
+
+// Escape-dense strings: every few bytes is a quote, newline or control.
+static Corpus DenseCorpus() {
+  static const char kSpecial[] = {'"', '\\', '\n', '\r', '\t', '\x01'};
+  Corpus corpus;
+  corpus.name = "dense";
+  uint32_t state = 4;
+  for (int i = 0; i < 20000; i++) {
+    std::string s;
+    for (int c = 0; c < 64; c++)
+      s += NextRandom(state) % 4 ? (char)('a' + c % 26)
+                                 : kSpecial[NextRandom(state) % 6];
+    Add(corpus, std::move(s));
+  }
+  return corpus;
+}
+
+static bool FileCorpus(const char *path, Corpus &corpus) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  corpus.name = path;
+  std::string line;
+  while (std::getline(in, line)) {
+    try {
+      nlohmann::json(line).dump(); // nlohmann only takes valid UTF-8
+    } catch (const std::exception &) {
+      continue;
+    }
+    Add(corpus, std::move(line));
+  }
+  return true;
+}
+
+// The per-byte loop Escape replaces; same output.
+static void EscapeScalar(std::string &out, const std::string &s) {
+  static const char kHex[] = "0123456789abcdef";
+  for (char ch : s) {
+    unsigned char c = (unsigned char)ch;
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        out += "\\u00";
+        out += kHex[c >> 4];
+        out += kHex[c & 15];
+      } else {
+        out += ch;
+      }
+    }
+  }
+}
+
+// Rewrites each UTF-8 sequence of escaped as \uXXXX, with a surrogate
+// pair above U+FFFF. The input must be valid UTF-8.
+static std::string AsciiEscapes(const std::string &escaped) {
+  std::string out;
+  char hex[16];
+  for (size_t i = 0; i < escaped.size();) {
+    unsigned char c = (unsigned char)escaped[i];
+    if (c < 0x80) {
+      out += (char)c;
+      i++;
+      continue;
+    }
+    int length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+    uint32_t cp = c & (0x7F >> length);
+    for (int k = 1; k < length; k++)
+      cp = (cp << 6) | ((unsigned char)escaped[i + k] & 0x3F);
+    i += length;
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      std::snprintf(hex, sizeof(hex), "\\u%04x\\u%04x", 0xD800 + (cp >> 10),
+                    0xDC00 + (cp & 0x3FF));
+    } else {
+      std::snprintf(hex, sizeof(hex), "\\u%04x", cp);
+    }
+    out += hex;
+  }
+  return out;
+}
+
+// Runs work until at least 200 ms have passed and returns
+// the throughput in MB/s of input.
+static double Measure(size_t bytes,
+                      const std::function<void()> &work) {
+  using Clock = std::chrono::steady_clock;
+  int rounds = 0;
+  Clock::time_point start = Clock::now();
+  double seconds = 0;
+  do {
+    work();
+    rounds++;
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  } while (seconds < 0.2);
+  return (double)bytes * rounds / seconds / (1024 * 1024);
+}
+
+static bool Run(const Corpus &corpus) {
+  std::vector<std::string> escaped;
+  size_t escapedBytes = 0;
+  for (const std::string &s : corpus.strings) {
+    std::string e;
+    JsonEscape::Escape(e, s.data(), s.size());
+    std::string reference;
+    EscapeScalar(reference, s);
+    if (reference != e) {
+      std::printf("%s: Escape differs from the per-byte loop\n",
+                  corpus.name.c_str());
+      return false;
+    }
+    if (corpus.asciiEscapes)
+      e = AsciiEscapes(e);
+    std::string back;
+    if (!JsonEscape::Unescape(back, e.data(), e.size()) || back != s) {
+      std::printf("%s: round trip failed\n", corpus.name.c_str());
+      return false;
+    }
+    escapedBytes += e.size();
+    escaped.push_back(std::move(e));
+  }
+
+  std::string out;
+  size_t sink = 0;
+  double escape = Measure(corpus.bytes, [&] {
+    for (const std::string &s : corpus.strings) {
+      out.clear();
+      JsonEscape::Escape(out, s.data(), s.size());
+      sink += out.size();
+    }
+  });
+  double scalar = Measure(corpus.bytes, [&] {
+    for (const std::string &s : corpus.strings) {
+      out.clear();
+      EscapeScalar(out, s);
+      sink += out.size();
+    }
+  });
+  double dump = Measure(corpus.bytes, [&] {
+    for (const std::string &s : corpus.strings)
+      sink += nlohmann::json(s).dump().size();
+  });
+  double unescape = Measure(escapedBytes, [&] {
+    for (const std::string &e : escaped) {
+      out.clear();
+      JsonEscape::Unescape(out, e.data(), e.size());
+      sink += out.size();
+    }
+  });
+  std::string quoted;
+  double parse = Measure(escapedBytes, [&] {
+    for (const std::string &e : escaped) {
+      quoted = '"' + e + '"';
+      sink += nlohmann::json::parse(quoted).get_ref<std::string &>().size();
+    }
+  });
+
+  g_sink = sink;
+  std::printf("%-16s %8.1f %8.1f %8.1f %10.1f %8.1f\n", corpus.name.c_str(),
+              escape, scalar, dump, unescape, parse);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::vector<Corpus> corpora = {ConfigCorpus(), LogCorpus(), UnicodeCorpus(),
+                                 DenseCorpus()};
+  for (int i = 1; i < argc; i++) {
+    Corpus corpus;
+    if (!FileCorpus(argv[i], corpus)) {
+      std::printf("Cannot read %s\n", argv[i]);
+      return 1;
+    }
+    corpora.push_back(std::move(corpus));
+  }
+
+  std::printf("MB/s             escape   scalar     dump   unescape    parse\n");
+  for (const Corpus &corpus : corpora)
+    if (!Run(corpus))
+      return 1;
+  return 0;
+}
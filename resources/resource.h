@@ -7,6 +7,11 @@
 #define IDM_FILE_EXIT 1005
 #define IDM_FORMAT_JSON 1010
 #define IDM_FORMAT_YAML 1011
+#define IDM_FORMAT_MINIFY_JSON 1012
+#define IDM_FORMAT_SELECTION 1013
+#define IDM_FORMAT_NODE 1014
+#define IDM_FORMAT_SCHEMA 1015
+#define IDM_FORMAT_LINT 1016
 #define IDM_EOL_CRLF 1020
 #define IDM_EOL_LF 1021
 #define IDM_EOL_CR 1022
@@ -14,5 +19,45 @@
 #define IDC_MAIN_EDIT 2001
 #define IDM_VIEW_REFRESH_TREE 1030
 #define IDC_TREE_VIEW 2002
+#define IDC_QUERY_EDIT 2003
+#define IDC_FILTER_BOX 2004
+#define IDM_VIEW_SHARE_SUBTREES 1031
+#define IDM_VIEW_FILTER_TREE 1032
+#define IDM_VIEW_CLEAR_FILTER 1033
+#define IDM_VIEW_GOTO_MATCH 1034
 #define IDM_LANG_EN 1040
 #define IDM_LANG_JP 1041
+#define IDM_EDIT_UNDO_TREE 1050
+#define IDM_EDIT_EXPAND_ALIASES 1051
+#define IDM_EDIT_MATCH_BRACKET 1052
+#define IDM_EDIT_SELECT_BLOCK 1053
+#define IDM_CONVERT_YAML_TO_JSON 1060
+#define IDM_CONVERT_YAML_TO_JSONL 1061
+#define IDM_CONVERT_JSON_TO_YAML 1062
+#define IDM_CONVERT_JSONL_TO_YAML 1063
+#define IDM_CONVERT_METADATA 1064
+#define IDM_SEARCH_FIND 1070
+#define IDM_SEARCH_FIND_NEXT 1071
+#define IDM_SEARCH_REPLACE 1072
+#define IDM_SEARCH_REPLACE_ALL 1073
+#define IDM_SEARCH_FIND_ALL 1074
+#define IDM_SEARCH_GOTO_RESULT 1075
+#define IDM_SEARCH_FIND_IN_TABS 1076
+#define IDM_SEARCH_FIND_IN_FILES 1077
+#define IDM_SEARCH_QUERY 1078
+#define IDM_SEARCH_RUN_QUERY 1079
+#define IDM_SEARCH_CANCEL_QUERY 1080
+#define IDM_SEARCH_GOTO_DEFINITION 1081
+#define IDM_SEARCH_FIND_REFERENCES 1082
+#define IDM_SEARCH_FIND_DANGLING 1083
+#define IDM_SEARCH_INDEX_PROJECT 1084
+#define IDM_SEARCH_FIND_ASSET_REFS 1085
+#define IDC_FIND_TEXT 2010
+#define IDC_REPLACE_TEXT 2011
+#define IDC_FIND_CASE 2012
+#define IDC_FIND_WORD 2013
+#define IDC_FIND_REGEX 2014
+#define IDC_FIND_RESULTS 2015
+#define IDC_FIND_FOLDER 2016
+#define IDC_FIND_FILTER 2017
+#define IDC_FIND_BROWSE 2018
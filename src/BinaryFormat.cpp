@@ -0,0 +1,250 @@
+#include "BinaryFormat.h"
+#include <algorithm>
+#include <cwctype>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using ordered_json = nlohmann::ordered_json;
+
+BinaryFormat::Format BinaryFormat::FromPath(const std::wstring &path) {
+  size_t dot = path.find_last_of(L".\\/");
+  if (dot == std::wstring::npos || path[dot] != L'.')
+    return NONE;
+  std::wstring ext = path.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return (wchar_t)towlower(c); });
+  if (ext == L"msgpack" || ext == L"mpk")
+    return MSGPACK;
+  if (ext == L"cbor")
+    return CBOR;
+  if (ext == L"bson")
+    return BSON;
+  if (ext == L"ubj" || ext == L"ubjson")
+    return UBJSON;
+  return NONE;
+}
+
+const wchar_t *BinaryFormat::Name(Format format) {
+  switch (format) {
+  case MSGPACK:
+    return L"MessagePack";
+  case CBOR:
+    return L"CBOR";
+  case BSON:
+    return L"BSON";
+  case UBJSON:
+    return L"UBJSON";
+  default:
+    return L"JSON";
+  }
+}
+
+// Builds the model from SAX events. Arrays of one numeric or boolean kind
+// are packed the way Model::FromJson packs them.
+class ModelSaxBuilder : public nlohmann::json_sax<json> {
+public:
+  ModelPtr Root() const { return m_root ? m_root : Model::Null(); }
+
+  bool null() override { return Add(Model::Null()); }
+  bool boolean(bool value) override { return Add(Model::Boolean(value)); }
+  bool number_integer(number_integer_t value) override {
+    return Add(Model::Integer(value));
+  }
+  bool number_unsigned(number_unsigned_t value) override {
+    return Add(Model::Unsigned(value));
+  }
+  bool number_float(number_float_t value, const string_t &) override {
+    return Add(Model::Real(value));
+  }
+  bool string(string_t &value) override {
+    return Add(Model::String(std::move(value)));
+  }
+
+  bool binary(binary_t &value) override {
+    std::vector<int64_t> bytes(value.begin(), value.end());
+    ModelPtr byteArray;
+    if (bytes.size() >= Model::kMinPackedSize) {
+      byteArray = Model::PackedInts(ModelNode::INTEGER, std::move(bytes));
+    } else {
+      std::vector<ModelPtr> items;
+      for (int64_t b : bytes)
+        items.push_back(Model::Integer(b));
+      byteArray = Model::Array(std::move(items));
+    }
+    ModelPtr subtype = value.has_subtype()
+                           ? Model::Integer((int64_t)value.subtype())
+                           : Model::Null();
+    return Add(Model::Object({"bytes", "subtype"}, {byteArray, subtype}));
+  }
+
+  bool start_object(std::size_t) override {
+    m_stack.push_back(Frame());
+    m_stack.back().isMap = true;
+    return true;
+  }
+  bool key(string_t &key) override {
+    m_stack.back().keys.push_back(std::move(key));
+    return true;
+  }
+  bool end_object() override {
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+    return Add(Model::Object(std::move(frame.keys), std::move(frame.items)));
+  }
+
+  bool start_array(std::size_t size) override {
+    m_stack.push_back(Frame());
+    if (size != (std::size_t)-1)
+      m_stack.back().items.reserve(size);
+    return true;
+  }
+  bool end_array() override {
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+    ModelPtr packed = TryPack(frame.items);
+    return Add(packed ? packed : Model::Array(std::move(frame.items)));
+  }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &e) override {
+    m_error = e.what();
+    return false;
+  }
+
+  const std::string &Error() const { return m_error; }
+
+private:
+  struct Frame {
+    bool isMap = false;
+    std::vector<std::string> keys;
+    std::vector<ModelPtr> items;
+  };
+
+  bool Add(ModelPtr node) {
+    if (m_stack.empty())
+      m_root = std::move(node);
+    else
+      m_stack.back().items.push_back(std::move(node));
+    return true;
+  }
+
+  static ModelPtr TryPack(const std::vector<ModelPtr> &items) {
+    if (items.size() < Model::kMinPackedSize)
+      return nullptr;
+    ModelNode::Kind kind = items[0]->kind;
+    if (kind != ModelNode::BOOLEAN && kind != ModelNode::INTEGER &&
+        kind != ModelNode::REAL)
+      return nullptr;
+    for (const ModelPtr &item : items)
+      if (item->kind != kind || item->isUnsigned)
+        return nullptr;
+    if (kind == ModelNode::REAL) {
+      std::vector<double> reals;
+      reals.reserve(items.size());
+      for (const ModelPtr &item : items)
+        reals.push_back(item->real);
+      return Model::PackedReals(std::move(reals));
+    }
+    std::vector<int64_t> ints;
+    ints.reserve(items.size());
+    for (const ModelPtr &item : items)
+      ints.push_back(kind == ModelNode::BOOLEAN ? (item->boolean ? 1 : 0)
+                                                : item->integer);
+    return Model::PackedInts(kind, std::move(ints));
+  }
+
+  std::vector<Frame> m_stack;
+  ModelPtr m_root;
+  std::string m_error;
+};
+
+ModelPtr BinaryFormat::Read(const uint8_t *data, size_t size, Format format) {
+  json::input_format_t input;
+  switch (format) {
+  case MSGPACK:
+    input = json::input_format_t::msgpack;
+    break;
+  case CBOR:
+    input = json::input_format_t::cbor;
+    break;
+  case BSON:
+    input = json::input_format_t::bson;
+    break;
+  case UBJSON:
+    input = json::input_format_t::ubjson;
+    break;
+  default:
+    throw std::runtime_error("Not a binary format");
+  }
+  // The reader is used directly because json::sax_parse rejects CBOR tags;
+  // with "store" a tag on a byte string becomes its subtype.
+  ModelSaxBuilder builder;
+  auto adapter = nlohmann::detail::input_adapter(data, data + size);
+  nlohmann::detail::binary_reader<json, decltype(adapter), ModelSaxBuilder>
+      reader(std::move(adapter), input);
+  if (!reader.sax_parse(input, &builder, true,
+                        nlohmann::detail::cbor_tag_handler_t::store))
+    throw std::runtime_error(builder.Error());
+  return builder.Root();
+}
+
+std::vector<uint8_t> BinaryFormat::Write(const ordered_json &j,
+                                         Format format) {
+  switch (format) {
+  case MSGPACK:
+    return ordered_json::to_msgpack(j);
+  case CBOR:
+    return ordered_json::to_cbor(j);
+  case BSON:
+    return ordered_json::to_bson(j);
+  case UBJSON:
+    return ordered_json::to_ubjson(j);
+  default: {
+    std::string text = j.dump();
+    return std::vector<uint8_t>(text.begin(), text.end());
+  }
+  }
+}
+
+// {"bytes": [0..255, ...], "subtype": n or null} back to a binary value.
+static void RestoreBinary(ordered_json &j) {
+  if (j.is_array()) {
+    for (auto &item : j)
+      RestoreBinary(item);
+    return;
+  }
+  if (!j.is_object())
+    return;
+  auto bytes = j.find("bytes");
+  auto subtype = j.find("subtype");
+  if (j.size() == 2 && bytes != j.end() && subtype != j.end() &&
+      bytes->is_array() && (subtype->is_null() || subtype->is_number_integer())) {
+    std::vector<uint8_t> data;
+    data.reserve(bytes->size());
+    bool ok = true;
+    for (const auto &b : *bytes) {
+      if (!b.is_number_integer() || b.get<int64_t>() < 0 ||
+          b.get<int64_t>() > 255) {
+        ok = false;
+        break;
+      }
+      data.push_back((uint8_t)b.get<int64_t>());
+    }
+    if (ok) {
+      j = subtype->is_null()
+              ? ordered_json::binary(std::move(data))
+              : ordered_json::binary(
+                    std::move(data),
+                    subtype->get<ordered_json::binary_t::subtype_type>());
+      return;
+    }
+  }
+  for (auto &item : j.items())
+    RestoreBinary(item.value());
+}
+
+ordered_json BinaryFormat::ToJson(const std::string &text) {
+  ordered_json j = ordered_json::parse(text);
+  RestoreBinary(j);
+  return j;
+}
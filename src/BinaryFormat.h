@@ -0,0 +1,33 @@
+#pragma once
+#include "Model.h"
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Binary JSON encodings (MessagePack, CBOR, BSON, UBJSON) read with
+// nlohmann's SAX parsers straight into the model, without building a
+// nlohmann::json DOM first.
+//
+// Binary values (MessagePack bin, CBOR byte strings, BSON binary) become
+// {"bytes": [...], "subtype": n or null}, the same shape nlohmann uses for
+// them in JSON, and ToJson turns that shape back into a binary value.
+class BinaryFormat {
+public:
+  enum Format { NONE, MSGPACK, CBOR, BSON, UBJSON };
+
+  // Format implied by the file extension (.msgpack/.mpk, .cbor, .bson,
+  // .ubj/.ubjson), or NONE.
+  static Format FromPath(const std::wstring &path);
+  static const wchar_t *Name(Format format);
+
+  // Throws std::runtime_error on malformed input.
+  static ModelPtr Read(const uint8_t *data, size_t size, Format format);
+  // Encodes j; throws nlohmann::json::exception if the format cannot hold
+  // it (BSON needs an object at the top).
+  static std::vector<uint8_t> Write(const nlohmann::ordered_json &j,
+                                    Format format);
+  // Parses JSON text back into a value, restoring binary values. Members
+  // keep their order in the text, so a save does not sort the keys.
+  static nlohmann::ordered_json ToJson(const std::string &text);
+};
@@ -1,15 +1,34 @@
 #include "EditorWindow.h"
 #include "../resources/resource.h"
+#include "FileSearch.h"
 #include "FileUtils.h"
+#include "GuidIndex.h"
+#include "JsonFormatter.h"
+#include "JsonLines.h"
+#include "JsonPath.h"
+#include "YamlEmitter.h"
+#include "YamlLint.h"
+#include "YamlFormatter.h"
+#include "Model.h"
+#include "ModelIndex.h"
+#include "OutputSink.h"
+#include "SearchEngine.h"
+#include "StreamConverter.h"
+#include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
 #include <commctrl.h>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <map>
 #include <nlohmann/json.hpp>
 #include <shlwapi.h>
 #include <shobjidl.h>
 #include <sstream>
+#include <thread>
 #include <windowsx.h>
 
 #pragma comment(lib, "comctl32.lib")
@@ -44,114 +63,466 @@ static std::string WideToString(const std::wstring &wstr) {
   return std::string(buf.data());
 }
 
+// Text of an edit control as UTF-8.
+static std::string GetEditTextUtf8(HWND hEdit) {
+  int len = GetWindowTextLength(hEdit);
+  if (len == 0)
+    return "";
+  std::vector<wchar_t> buffer(len + 1);
+  GetWindowText(hEdit, buffer.data(), len + 1);
+  int utf8Len =
+      WideCharToMultiByte(CP_UTF8, 0, buffer.data(), len, NULL, 0, NULL, NULL);
+  std::string utf8(utf8Len, '\0');
+  WideCharToMultiByte(CP_UTF8, 0, buffer.data(), len, &utf8[0], utf8Len, NULL,
+                      NULL);
+  return utf8;
+}
+
+// Replaces the text of an edit control; text must already use CRLF.
+static void SetEditTextUtf8(HWND hEdit, const std::string &text) {
+  int wLen = MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(),
+                                 NULL, 0);
+  std::wstring wText(wLen, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(), &wText[0],
+                      wLen);
+  SetWindowText(hEdit, wText.c_str());
+}
+
+// UTF-8 byte offset of UTF-16 position pos in text.
+static size_t Utf8Offset(const wchar_t *text, size_t pos) {
+  return pos == 0 ? 0
+                  : (size_t)WideCharToMultiByte(CP_UTF8, 0, text, (int)pos,
+                                                NULL, 0, NULL, NULL);
+}
+
+// UTF-16 position of UTF-8 byte offset pos in text.
+static size_t WideOffset(const char *text, size_t pos) {
+  return pos == 0 ? 0
+                  : (size_t)MultiByteToWideChar(CP_UTF8, 0, text, (int)pos,
+                                                NULL, 0);
+}
+
 struct TreeItemData {
   std::string path;    // JSON Pointer path
   bool isArrayElement; // true if it's an array element like [0]
+  // JSON Lines: records [first, last) added when the item is expanded; a
+  // record item keeps its index in first
+  size_t first = 0, last = 0;
+  bool isRecord = false;
+  // Packed arrays: elements [first, last) of packed, added when the item is
+  // expanded; element 0 has the source line at lineIndex, if any
+  ModelPtr packed;
+  size_t lineIndex = SIZE_MAX;
+  bool isRange = false; // "[lo - hi]" items are not values
+  // Query results list nodes of the model; selecting one selects its line
+  bool isQueryResult = false;
+  enum Kind { QUERY, SCHEMA, LINT };
+  Kind resultKind = QUERY; // Each kind replaces only its own results
+  int sourceLine = -1;
+};
+
+// Posted by the JSON Lines validation thread; lParam is a
+// JsonLinesValidation to delete.
+static const UINT WM_JSONL_VALIDATED = WM_APP + 1;
+
+struct JsonLinesValidation {
+  const JsonLinesIndex *index;
+  std::vector<JsonLinesError> errors;
+};
+
+// Posted by the Find All thread; lParam is a FindResults to delete.
+static const UINT WM_FIND_RESULTS = WM_APP + 2;
+
+struct FindResults {
+  unsigned searchId;
+  std::vector<FileHits> hits;
+  size_t searched; // Texts searched, once done
+  bool done;
+};
+
+// Find All counts every match but lists only this many.
+static const size_t kMaxListedResults = 10000;
+
+// Posted by the query thread; lParam is a QueryResults to delete.
+static const UINT WM_QUERY_RESULTS = WM_APP + 3;
+
+struct EditorWindow::QueryResults {
+  unsigned queryId;
+  HWND hEdit; // The tab queried
+  std::wstring expression;
+  std::vector<QueryResult> results;
+  std::vector<int> lines; // Source line of each result, or -1
+  bool complete = true;   // false if cut short by the limit or cancelled
+  bool cancelled = false;
+  ULONGLONG ms = 0;
+};
+
+// Posted by the GUID index thread; lParam is a GuidIndexResult to delete.
+static const UINT WM_GUID_INDEXED = WM_APP + 4;
+
+struct EditorWindow::GuidIndexResult {
+  unsigned indexId;
+  bool announce; // Requested from the menu rather than refreshed at startup
+  std::unique_ptr<GuidIndex> index;
+  ULONGLONG ms = 0;
+};
+
+// The GUID index of the last indexed project, kept beside settings.json.
+static const wchar_t kGuidIndexFile[] = L"guidindex.bin";
+
+// A query lists at most this many nodes.
+static const size_t kMaxQueryResults = 10000;
+
+// Posted by the schema validation thread; lParam is a SchemaResults to
+// delete.
+static const UINT WM_SCHEMA_VALIDATED = WM_APP + 5;
+
+struct EditorWindow::SchemaResults {
+  unsigned schemaId;
+  HWND hEdit; // The tab validated
+  std::vector<SchemaError> errors;
+  std::vector<int> lines; // Source line of each error's value, or -1
+  bool complete = true;   // false if cut short by the limit or cancelled
+  bool cancelled = false;
+  ULONGLONG ms = 0;
+};
+
+// Schema validation lists at most this many errors.
+static const size_t kMaxSchemaErrors = 10000;
+
+// Posted by the lint thread; lParam is a LintResults to delete.
+static const UINT WM_LINT_RESULTS = WM_APP + 6;
+
+struct EditorWindow::LintResults {
+  unsigned lintId;
+  HWND hEdit; // The tab linted
+  std::vector<LintDiagnostic> diagnostics;
+  bool complete = true; // false if cut short by the limit or cancelled
+  bool cancelled = false;
+  ULONGLONG ms = 0;
+};
+
+// Lint lists at most this many findings.
+static const size_t kMaxLintResults = 10000;
+
+// Height of the query and filter bars above the tree.
+static const int kBarHeight = 24;
+
+// The tree is filtered once typing pauses this long (ms).
+static const UINT_PTR kFilterTimer = 1;
+static const UINT kFilterDelay = 150;
+// A filtered tree shows at most this many matches, and the filter box
+// lists this many completions.
+static const size_t kMaxFilterMatches = 2000;
+static const size_t kMaxCompletions = 50;
+
+// Which nodes a filtered tree shows, by node number: each match with its
+// subtree, and the path down to it.
+struct TreeFilter {
+  enum : uint8_t { HIDE, PATH, MATCH };
+  std::vector<uint8_t> show;
+  const ModelIndex *index;
+  HTREEITEM firstMatch = NULL;
+
+  uint8_t Show(size_t node) const {
+    return node < show.size() ? show[node] : MATCH;
+  }
 };
 
-static HTREEITEM AddYamlToTree(HWND hTree, HTREEITEM hParent,
-                               const std::string &key, const YAML::Node &node,
-                               const std::string &path,
-                               bool isArrayElem = false) {
+static bool PostFindResults(HWND hwnd, FindResults *result) {
+  if (PostMessage(hwnd, WM_FIND_RESULTS, 0, (LPARAM)result))
+    return true;
+  delete result; // The window is gone
+  return false;
+}
+
+// Records or packed array elements listed under one tree item; larger
+// ranges are split into nested ranges so no item ever has more children than
+// this.
+static const size_t kItemsPerRange = 1000;
+
+// Inserts an item that shows an expand button before it has children.
+static HTREEITEM InsertLazyItem(HWND hTree, HTREEITEM hParent,
+                                const std::wstring &text, TreeItemData *data) {
+  TVINSERTSTRUCTW tvis = {0};
+  tvis.hParent = hParent;
+  tvis.hInsertAfter = TVI_LAST;
+  tvis.item.mask = TVIF_TEXT | TVIF_PARAM | TVIF_CHILDREN;
+  tvis.item.pszText = (LPWSTR)text.c_str();
+  tvis.item.cChildren = 1;
+  tvis.item.lParam = (LPARAM)data;
+  return (HTREEITEM)SendMessage(hTree, TVM_INSERTITEMW, 0, (LPARAM)&tvis);
+}
+
+// Adds items [first, last) under hParent through addItem, or nested ranges of
+// them that copy range's data.
+static void AddItemRange(HWND hTree, HTREEITEM hParent, size_t first,
+                         size_t last, const TreeItemData &range,
+                         const std::function<void(size_t)> &addItem) {
+  size_t span = last - first;
+  if (span <= kItemsPerRange) {
+    for (size_t i = first; i < last; i++)
+      addItem(i);
+    return;
+  }
+  size_t step = kItemsPerRange;
+  while (span / step > kItemsPerRange)
+    step *= kItemsPerRange;
+  for (size_t lo = first; lo < last; lo += step) {
+    size_t hi = (last - lo < step) ? last : lo + step;
+    std::wstring label =
+        L"[" + std::to_wstring(lo) + L" - " + std::to_wstring(hi - 1) + L"]";
+    TreeItemData *data = new TreeItemData(range);
+    data->first = lo;
+    data->last = hi;
+    data->isRange = true;
+    InsertLazyItem(hTree, hParent, label, data);
+  }
+}
+
+// Label suffix for a sequence; packed numeric arrays also show a preview.
+static std::wstring SequenceLabel(const ModelPtr &model) {
+  ModelSummary summary;
+  if (!Model::Summarize(model, summary))
+    return L" (Sequence)";
+
+  const wchar_t *type = model->packedKind == ModelNode::REAL      ? L"real"
+                        : model->packedKind == ModelNode::BOOLEAN ? L"bool"
+                                                                  : L"int";
+  std::wostringstream label;
+  label << L" (Sequence: " << summary.count << L" x " << type << L", min "
+        << summary.min << L", max " << summary.max << L", sum " << summary.sum
+        << L")";
+  return label.str();
+}
+
+// Adds model (and its children) to the tree. lines holds the source line of
+// every value node in pre-order, as produced by Model::ParseYaml; cursor
+// walks it in step with the traversal. Aliases are shown as references and
+// not expanded.
+static HTREEITEM AddModelToTree(HWND hTree, HTREEITEM hParent,
+                                const std::string &key, const ModelPtr &model,
+                                const std::vector<int> &lines, size_t &cursor,
+                                const std::string &path,
+                                bool isArrayElem = false,
+                                TreeFilter *filter = nullptr) {
+  size_t number = cursor;
+  uint8_t show = filter ? filter->Show(number) : TreeFilter::MATCH;
+  if (show == TreeFilter::HIDE) {
+    cursor = filter->index->End(number);
+    return NULL;
+  }
   std::wstring wKey = StringToWide(key);
 
-  int line = (int)node.Mark().line;
+  int line = (cursor < lines.size()) ? lines[cursor] : 0;
+  cursor++;
 
   std::wstring lineStr =
-      (key == "ROOT") ? L"" : (L" (Ln " + std::to_wstring(line) + L")");
+      (key.compare(0, 4, "ROOT") == 0 || lines.empty())
+          ? L""
+          : (L" (Ln " + std::to_wstring(line) + L")");
 
   std::wstring text = wKey + lineStr;
 
-  if (node.IsScalar()) {
-    text += L": " + StringToWide(node.as<std::string>());
-  } else if (node.IsSequence()) {
-    text += L" (Sequence)";
-  } else if (node.IsMap()) {
+  if (model->kind == ModelNode::ARRAY) {
+    text += SequenceLabel(model);
+  } else if (model->kind == ModelNode::OBJECT) {
     text += L" (Map)";
+  } else if (model->kind == ModelNode::ALIAS) {
+    text += L": " + StringToWide(Model::ScalarText(model)) +
+            (model->items.empty() ? L" (Recursive Alias)" : L" (Alias)");
+  } else {
+    text += L": " + StringToWide(Model::ScalarText(model));
+  }
+
+  // Below a match everything is shown
+  TreeFilter *childFilter = show == TreeFilter::PATH ? filter : nullptr;
+  TreeItemData *data = new TreeItemData{path, isArrayElem};
+  // A packed array's elements are added when it is expanded, unless the
+  // filter picks among them
+  bool lazy = model->IsPacked() && model->Size() > 0 && !childFilter;
+  if (lazy) {
+    data->packed = model;
+    data->last = model->Size();
+    data->lineIndex = lines.empty() ? SIZE_MAX : cursor;
   }
 
   TVINSERTSTRUCTW tvis = {0};
   tvis.hParent = hParent;
   tvis.hInsertAfter = TVI_LAST;
-  tvis.item.mask = TVIF_TEXT | TVIF_PARAM;
+  tvis.item.mask = TVIF_TEXT | TVIF_PARAM | (lazy ? TVIF_CHILDREN : 0);
   tvis.item.pszText = (LPWSTR)text.c_str();
-  tvis.item.lParam = (LPARAM) new TreeItemData{path, isArrayElem};
+  tvis.item.cChildren = lazy ? 1 : 0;
+  tvis.item.lParam = (LPARAM)data;
   HTREEITEM hItem =
       (HTREEITEM)SendMessage(hTree, TVM_INSERTITEMW, 0, (LPARAM)&tvis);
+  if (filter && show == TreeFilter::MATCH && !filter->firstMatch)
+    filter->firstMatch = hItem;
+  if (lazy) {
+    cursor += model->Size();
+    return hItem;
+  }
 
-  if (node.IsMap()) {
-    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
-      std::string k;
-      try {
-        k = it->first.as<std::string>();
-      } catch (...) {
-        k = "???";
-      }
-      // Escape JSON pointer key
-      std::string escapedKey = k;
-      // Simple escape: replace ~ with ~0 and / with ~1
-      size_t pos = 0;
-      while ((pos = escapedKey.find("~", pos)) != std::string::npos) {
-        escapedKey.replace(pos, 1, "~0");
-        pos += 2;
-      }
-      pos = 0;
-      while ((pos = escapedKey.find("/", pos)) != std::string::npos) {
-        escapedKey.replace(pos, 1, "~1");
-        pos += 2;
-      }
-      std::string subPath = (path == "/" ? "" : path) + "/" + escapedKey;
-      AddYamlToTree(hTree, hItem, k, it->second, subPath, false);
+  std::string prefix = (path == "/" ? "" : path) + "/";
+  if (model->kind == ModelNode::OBJECT) {
+    for (size_t i = 0; i < model->items.size(); i++) {
+      AddModelToTree(hTree, hItem, model->Keys()[i], model->items[i], lines,
+                     cursor, prefix + Model::EscapePointerToken(model->Keys()[i]),
+                     false, childFilter);
     }
-  } else if (node.IsSequence()) {
-    for (size_t i = 0; i < node.size(); i++) {
-      std::string subPath = (path == "/" ? "" : path) + "/" + std::to_string(i);
-      AddYamlToTree(hTree, hItem, "[" + std::to_string(i) + "]", node[i],
-                    subPath, true);
+  } else if (model->kind == ModelNode::ARRAY) {
+    for (size_t i = 0; i < model->Size(); i++) {
+      AddModelToTree(hTree, hItem, "[" + std::to_string(i) + "]",
+                     Model::Item(model, i), lines, cursor,
+                     prefix + std::to_string(i), true, childFilter);
     }
   }
+  if (childFilter)
+    TreeView_Expand(hTree, hItem, TVE_EXPAND);
   return hItem;
 }
 
-// Convert YAML::Node to json
-static json YamlToJson(const YAML::Node &node) {
-  if (node.IsScalar()) {
-    std::string s = node.as<std::string>();
-    if (s == "true")
-      return true;
-    if (s == "false")
-      return false;
-    if (s == "null" || s == "~")
-      return nullptr;
-    try {
-      if (s.find('.') != std::string::npos ||
-          s.find('e') != std::string::npos || s.find('E') != std::string::npos)
-        return std::stod(s);
-      return std::stoll(s);
-    } catch (...) {
-    }
-    return s;
-  }
-  if (node.IsSequence()) {
-    json j = json::array();
-    for (size_t i = 0; i < node.size(); i++)
-      j.push_back(YamlToJson(node[i]));
-    return j;
-  }
-  if (node.IsMap()) {
-    json j = json::object();
-    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
-      std::string key;
-      try {
-        key = it->first.as<std::string>();
-      } catch (...) {
-        key = "???";
-      }
-      j[key] = YamlToJson(it->second);
+// Marks the nodes a filter shows. The filter is "key", "key=value" or
+// "=value": values under keys containing key (case-insensitively), whose
+// text is exactly value. Returns the number of matches.
+static size_t BuildTreeFilter(const ModelIndex &index, const std::string &text,
+                              TreeFilter &filter) {
+  auto trim = [](const std::string &s) {
+    size_t first = s.find_first_not_of(" \t");
+    size_t last = s.find_last_not_of(" \t");
+    return first == std::string::npos ? std::string()
+                                      : s.substr(first, last - first + 1);
+  };
+  size_t equals = text.find('=');
+  std::string key = trim(text.substr(0, equals));
+  std::vector<size_t> found;
+  if (equals == std::string::npos) {
+    found = index.FindKey(key);
+  } else {
+    found = index.FindValue(trim(text.substr(equals + 1)));
+    if (!key.empty()) {
+      std::vector<size_t> keyed = index.FindKey(key), both;
+      std::set_intersection(found.begin(), found.end(), keyed.begin(),
+                            keyed.end(), std::back_inserter(both));
+      found.swap(both);
     }
-    return j;
   }
-  return nullptr;
+
+  filter.index = &index;
+  filter.show.assign(index.Size(), TreeFilter::HIDE);
+  for (size_t i = 0; i < found.size() && i < kMaxFilterMatches; i++) {
+    filter.show[found[i]] = TreeFilter::MATCH;
+    for (size_t node = index.Parent(found[i]);
+         node != ModelIndex::kNone && filter.show[node] == TreeFilter::HIDE;
+         node = index.Parent(node))
+      filter.show[node] = TreeFilter::PATH;
+  }
+  return found.size();
+}
+
+// "path (Ln N): value", in the style of AddModelToTree.
+static std::wstring QueryResultLabel(const QueryResult &result, int line) {
+  std::wstring text = StringToWide(result.path.empty() ? "/" : result.path);
+  if (line >= 0)
+    text += L" (Ln " + std::to_wstring(line) + L")";
+  const ModelPtr &node = result.node;
+  if (node->kind == ModelNode::ARRAY)
+    text += SequenceLabel(node);
+  else if (node->kind == ModelNode::OBJECT)
+    text += L" (Map)";
+  else
+    text += L": " + StringToWide(Model::ScalarText(node));
+  return text;
+}
+
+static HTREEITEM
+InsertQueryItem(HWND hTree, HTREEITEM hParent, HTREEITEM hInsertAfter,
+                const std::wstring &text, int line,
+                TreeItemData::Kind kind = TreeItemData::QUERY) {
+  TreeItemData *data = new TreeItemData{"", false};
+  data->isQueryResult = true;
+  data->resultKind = kind;
+  data->sourceLine = line;
+  TVINSERTSTRUCTW tvis = {0};
+  tvis.hParent = hParent;
+  tvis.hInsertAfter = hInsertAfter;
+  tvis.item.mask = TVIF_TEXT | TVIF_PARAM;
+  tvis.item.pszText = (LPWSTR)text.c_str();
+  tvis.item.lParam = (LPARAM)data;
+  return (HTREEITEM)SendMessage(hTree, TVM_INSERTITEMW, 0, (LPARAM)&tvis);
+}
+
+// Points the item at path to, and the items below it at the paths under
+// to, after a key rename.
+static void RenameTreePaths(HWND hTree, HTREEITEM hItem,
+                            const std::string &from, const std::string &to) {
+  TVITEMW item = {0};
+  item.hItem = hItem;
+  item.mask = TVIF_PARAM;
+  if (SendMessage(hTree, TVM_GETITEMW, 0, (LPARAM)&item) && item.lParam) {
+    std::string &path = ((TreeItemData *)item.lParam)->path;
+    if (path.compare(0, from.size(), from) == 0)
+      path = to + path.substr(from.size());
+  }
+  for (HTREEITEM hChild = TreeView_GetChild(hTree, hItem); hChild;
+       hChild = TreeView_GetNextSibling(hTree, hChild))
+    RenameTreePaths(hTree, hChild, from, to);
+}
+
+// Removes the earlier results of one kind: queries, schema validation or
+// lint; they are top-level items.
+static void DeleteQueryItems(HWND hTree,
+                             TreeItemData::Kind kind = TreeItemData::QUERY) {
+  HTREEITEM hItem = TreeView_GetRoot(hTree);
+  while (hItem) {
+    HTREEITEM hNext = TreeView_GetNextSibling(hTree, hItem);
+    TVITEMW item = {0};
+    item.hItem = hItem;
+    item.mask = TVIF_PARAM;
+    if (SendMessage(hTree, TVM_GETITEMW, 0, (LPARAM)&item) && item.lParam &&
+        ((TreeItemData *)item.lParam)->isQueryResult &&
+        ((TreeItemData *)item.lParam)->resultKind == kind)
+      TreeView_DeleteItem(hTree, hItem);
+    hItem = hNext;
+  }
+}
+
+// Subclass procedure for the query bar: Enter runs the query, Esc cancels
+// it or clears the results.
+LRESULT CALLBACK QueryEditSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam,
+                                       LPARAM lParam, UINT_PTR uIdSubclass,
+                                       DWORD_PTR dwRefData) {
+  if (uMsg == WM_KEYDOWN && (wParam == VK_RETURN || wParam == VK_ESCAPE)) {
+    SendMessage(GetParent(hWnd), WM_COMMAND,
+                wParam == VK_RETURN ? IDM_SEARCH_RUN_QUERY
+                                    : IDM_SEARCH_CANCEL_QUERY,
+                0);
+    return 0;
+  }
+  if (uMsg == WM_CHAR && (wParam == L'\r' || wParam == 0x1b))
+    return 0; // No beep
+  return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+// Subclass procedure for the edit control of the filter box: Enter goes to
+// the first match, Esc clears the filter. With the list dropped down they
+// keep their usual meaning.
+LRESULT CALLBACK FilterEditSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam,
+                                        LPARAM lParam, UINT_PTR uIdSubclass,
+                                        DWORD_PTR dwRefData) {
+  HWND hCombo = GetParent(hWnd);
+  bool dropped = SendMessage(hCombo, CB_GETDROPPEDSTATE, 0, 0) != 0;
+  if (uMsg == WM_KEYDOWN && !dropped &&
+      (wParam == VK_RETURN || wParam == VK_ESCAPE)) {
+    SendMessage(GetParent(hCombo), WM_COMMAND,
+                wParam == VK_RETURN ? IDM_VIEW_GOTO_MATCH
+                                    : IDM_VIEW_CLEAR_FILTER,
+                0);
+    return 0;
+  }
+  if (uMsg == WM_CHAR && !dropped && (wParam == L'\r' || wParam == 0x1b))
+    return 0; // No beep
+  return DefSubclassProc(hWnd, uMsg, wParam, lParam);
 }
 
 // Subclass procedure for the Edit control
@@ -159,26 +530,97 @@ LRESULT CALLBACK EditSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam,
                                   LPARAM lParam, UINT_PTR uIdSubclass,
                                   DWORD_PTR dwRefData) {
   EditorWindow *pThis = (EditorWindow *)dwRefData;
+  if (uMsg == WM_KEYDOWN &&
+      (wParam == VK_F3 || (wParam == 'F' && GetKeyState(VK_CONTROL) < 0))) {
+    SendMessage(GetParent(hWnd), WM_COMMAND,
+                wParam == VK_F3 ? IDM_SEARCH_FIND_NEXT : IDM_SEARCH_FIND, 0);
+    return 0;
+  }
+  if (uMsg == WM_KEYDOWN && wParam == VK_F12) {
+    SendMessage(GetParent(hWnd), WM_COMMAND,
+                GetKeyState(VK_SHIFT) < 0 ? IDM_SEARCH_FIND_REFERENCES
+                                          : IDM_SEARCH_GOTO_DEFINITION,
+                0);
+    return 0;
+  }
+  if (uMsg == WM_KEYDOWN && wParam == VK_OEM_6 &&
+      GetKeyState(VK_CONTROL) < 0) {
+    SendMessage(GetParent(hWnd), WM_COMMAND,
+                GetKeyState(VK_SHIFT) < 0 ? IDM_EDIT_SELECT_BLOCK
+                                          : IDM_EDIT_MATCH_BRACKET,
+                0);
+    return 0;
+  }
+  // Ctrl+F and Ctrl+]; keep them out of the text
+  if (uMsg == WM_CHAR && (wParam == 0x06 || wParam == 0x1D))
+    return 0;
   switch (uMsg) {
+  case WM_CHAR:
+  case WM_KEYDOWN:
+  case WM_PASTE:
+  case WM_CUT:
+  case WM_CLEAR:
+  case EM_REPLACESEL:
+  case WM_UNDO:
+  case EM_UNDO:
+  case WM_SETTEXT: {
+    // Undo changes text anywhere, so the highlighter starts over
+    EditorWindow::TextEdit edit = pThis->BeginTextEdit(hWnd);
+    LRESULT lRes = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+    bool whole = uMsg == WM_UNDO || uMsg == EM_UNDO || uMsg == WM_SETTEXT ||
+                 (uMsg == WM_CHAR && wParam == 0x1A); // Ctrl+Z
+    if (uMsg == WM_SETTEXT && lRes)
+      pThis->TextReplaced(hWnd);
+    pThis->EndTextEdit(hWnd, edit, whole);
+    if (uMsg == WM_KEYDOWN)
+      pThis->UpdateLineNumbers(hWnd);
+    pThis->PaintHighlights(hWnd);
+    return lRes;
+  }
+  case WM_PAINT:
+  case WM_HSCROLL:
+  case WM_LBUTTONUP:
+  case WM_LBUTTONDBLCLK:
+  case WM_MOUSEMOVE: {
+    // The control redraws a changing selection without WM_PAINT
+    LRESULT lRes = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+    if (uMsg != WM_MOUSEMOVE || (wParam & MK_LBUTTON))
+      pThis->PaintHighlights(hWnd);
+    return lRes;
+  }
   case WM_VSCROLL:
   case WM_MOUSEWHEEL:
-  case WM_KEYDOWN:
-  case WM_KEYUP:
+  case WM_KEYUP: {
     LRESULT lRes = DefSubclassProc(hWnd, uMsg, wParam, lParam);
     pThis->UpdateLineNumbers(hWnd);
     return lRes;
   }
+  }
   return DefSubclassProc(hWnd, uMsg, wParam, lParam);
 }
 
 EditorWindow::EditorWindow()
     : m_hwnd(NULL), m_hTabCtrl(NULL), m_hTreeView(NULL), m_activePageIndex(-1),
-      m_currentLang("en") {}
+      m_currentLang("en"), m_shareSubtrees(false),
+      m_aliasBudget(1000000) {
+  m_fileSearchOptions.include =
+      L"*.yaml;*.yml;*.json;*.jsonl;*.ndjson;*.unity;*.prefab;*.asset;"
+      L"*.meta;*.mat;*.anim;*.controller";
+  m_fileSearchOptions.excludeFolders =
+      L".git;.svn;.hg;.vs;node_modules;Library;Temp;Logs;obj";
+}
 
 void EditorWindow::SetLanguage(const std::string &lang) {
   m_currentLang = lang;
   UpdateMenus();
   UpdateTitle();
+  m_findDialog.Localize(
+      [this](const std::string &key) { return GetLocalizedString(key); });
+}
+
+bool EditorWindow::PreTranslateMessage(MSG *msg) {
+  HWND hFind = m_findDialog.Window();
+  return hFind && IsWindowVisible(hFind) && IsDialogMessage(hFind, msg);
 }
 
 std::wstring EditorWindow::GetLocalizedString(const std::string &key) {
@@ -190,12 +632,68 @@ std::wstring EditorWindow::GetLocalizedString(const std::string &key) {
                         {"Save", L"&Save"},
                         {"SaveAs", L"Save &As..."},
                         {"CloseTab", L"&Close Tab"},
+                        {"Convert", L"Con&vert"},
+                        {"YamlToJson", L"YAML to &JSON..."},
+                        {"YamlToJsonLines", L"YAML to JSON &Lines..."},
+                        {"JsonToYaml", L"JSON to &YAML..."},
+                        {"JsonLinesToYaml", L"JSON Li&nes to YAML..."},
+                        {"KeepTagsAnchors", L"&Keep Tags and Anchors"},
                         {"Exit", L"E&xit"},
+                        {"Edit", L"&Edit"},
+                        {"UndoTreeEdit", L"&Undo Tree Edit"},
+                        {"ExpandAliases", L"E&xpand Aliases"},
+                        {"MatchBracket", L"Go to &Matching Bracket\tCtrl+]"},
+                        {"SelectBlock", L"Select &Block\tCtrl+Shift+]"},
+                        {"Search", L"&Search"},
+                        {"FindReplace", L"&Find / Replace...\tCtrl+F"},
+                        {"FindNext", L"Find &Next\tF3"},
+                        {"FindReplaceTitle", L"Find / Replace"},
+                        {"FindWhat", L"Find:"},
+                        {"ReplaceWith", L"Replace:"},
+                        {"MatchCase", L"Match &case"},
+                        {"WholeWord", L"&Whole word"},
+                        {"RegularExpression", L"Regular e&xpression"},
+                        {"FindNextButton", L"Find &Next"},
+                        {"Replace", L"&Replace"},
+                        {"ReplaceAll", L"Replace &All"},
+                        {"FindAll", L"Fin&d All"},
+                        {"Searching", L"Searching..."},
+                        {"NoMatches", L"No matches"},
+                        {"Matches", L" matches"},
+                        {"ListLimited", L" (first 10000 listed)"},
+                        {"Replaced", L" replaced"},
+                        {"LookIn", L"Folder:"},
+                        {"FileTypes", L"Files:"},
+                        {"FindInTabs", L"In Open &Tabs"},
+                        {"FindInFiles", L"In F&older"},
+                        {"ChooseFolder", L"Choose a folder to search"},
+                        {"FilesSearched", L" files searched"},
+                        {"Query", L"JSONPath &Query"},
+                        {"QueryHint", L"JSONPath, e.g. $..m_Name"},
+                        {"GoToDefinition", L"Go to &Definition\tF12"},
+                        {"FindReferences", L"Find &References\tShift+F12"},
+                        {"FindDangling", L"Find Dan&gling References"},
+                        {"IndexProject", L"Index &Unity Project..."},
+                        {"FindAssetReferences", L"Find &Asset References"},
+                        {"NoGuidIndex",
+                         L"Index a Unity project first (Search > Index "
+                         L"Unity Project)"},
+                        {"Indexing", L"Indexing project..."},
+                        {"FilesIndexed", L" files indexed"},
+                        {"Rescanned", L" rescanned"},
                         {"Format", L"F&ormat"},
                         {"FormatJSON", L"Format &JSON"},
                         {"FormatYAML", L"Format &YAML"},
+                        {"MinifyJSON", L"&Minify JSON"},
+                        {"FormatSelection", L"Format &Selection"},
+                        {"FormatNode", L"Format &Node at Caret"},
+                        {"ValidateSchema", L"&Validate Against Schema..."},
+                        {"Lint", L"&Lint"},
                         {"View", L"&View"},
                         {"RefreshTree", L"Refresh &Tree"},
+                        {"ShareSubtrees", L"&Share Identical Subtrees"},
+                        {"FilterTree", L"&Filter Tree"},
+                        {"FilterHint", L"Filter: key, key=value or =value"},
                         {"LineEndings", L"&Line Endings"},
                         {"Language", L"&Language"},
                         {"English", L"&English"},
@@ -208,12 +706,68 @@ std::wstring EditorWindow::GetLocalizedString(const std::string &key) {
                         {"Save", L"保存(&S)"},
                         {"SaveAs", L"名前を付けて保存(&A)..."},
                         {"CloseTab", L"タブを閉じる(&C)"},
+                        {"Convert", L"変換(&V)"},
+                        {"YamlToJson", L"YAMLからJSONへ(&J)..."},
+                        {"YamlToJsonLines", L"YAMLからJSON Linesへ(&L)..."},
+                        {"JsonToYaml", L"JSONからYAMLへ(&Y)..."},
+                        {"JsonLinesToYaml", L"JSON LinesからYAMLへ(&N)..."},
+                        {"KeepTagsAnchors", L"タグとアンカーを保持(&K)"},
                         {"Exit", L"終了(&X)"},
+                        {"Edit", L"編集(&E)"},
+                        {"UndoTreeEdit", L"ツリー編集を元に戻す(&U)"},
+                        {"ExpandAliases", L"エイリアスを展開(&X)"},
+                        {"MatchBracket", L"対応する括弧へ移動(&M)\tCtrl+]"},
+                        {"SelectBlock", L"ブロックを選択(&B)\tCtrl+Shift+]"},
+                        {"Search", L"検索(&S)"},
+                        {"FindReplace", L"検索と置換(&F)...\tCtrl+F"},
+                        {"FindNext", L"次を検索(&N)\tF3"},
+                        {"FindReplaceTitle", L"検索と置換"},
+                        {"FindWhat", L"検索:"},
+                        {"ReplaceWith", L"置換後:"},
+                        {"MatchCase", L"大文字と小文字を区別(&C)"},
+                        {"WholeWord", L"単語単位(&W)"},
+                        {"RegularExpression", L"正規表現(&X)"},
+                        {"FindNextButton", L"次を検索(&N)"},
+                        {"Replace", L"置換(&R)"},
+                        {"ReplaceAll", L"すべて置換(&A)"},
+                        {"FindAll", L"すべて検索(&D)"},
+                        {"Searching", L"検索中..."},
+                        {"NoMatches", L"見つかりません"},
+                        {"Matches", L" 件"},
+                        {"ListLimited", L" (先頭 10000 件を表示)"},
+                        {"Replaced", L" 件置換しました"},
+                        {"LookIn", L"フォルダー:"},
+                        {"FileTypes", L"ファイル:"},
+                        {"FindInTabs", L"開いているタブ(&T)"},
+                        {"FindInFiles", L"フォルダー内(&O)"},
+                        {"ChooseFolder", L"検索するフォルダーを選んでください"},
+                        {"FilesSearched", L" ファイルを検索"},
+                        {"Query", L"JSONPath クエリ(&Q)"},
+                        {"QueryHint", L"JSONPath (例: $..m_Name)"},
+                        {"GoToDefinition", L"定義へ移動(&D)\tF12"},
+                        {"FindReferences", L"参照を検索(&R)\tShift+F12"},
+                        {"FindDangling", L"壊れた参照を検索(&G)"},
+                        {"IndexProject", L"Unity プロジェクトを索引化(&U)..."},
+                        {"FindAssetReferences", L"アセットの参照を検索(&A)"},
+                        {"NoGuidIndex",
+                         L"先に Unity プロジェクトを索引化してください "
+                         L"(検索 > Unity プロジェクトを索引化)"},
+                        {"Indexing", L"プロジェクトを索引化中..."},
+                        {"FilesIndexed", L" ファイルを索引化"},
+                        {"Rescanned", L" 件を再走査"},
                         {"Format", L"整形(&F)"},
                         {"FormatJSON", L"JSON整形(&J)"},
                         {"FormatYAML", L"YAML整形(&Y)"},
+                        {"MinifyJSON", L"JSON圧縮(&M)"},
+                        {"FormatSelection", L"選択範囲を整形(&S)"},
+                        {"FormatNode", L"カーソル位置のノードを整形(&N)"},
+                        {"ValidateSchema", L"スキーマで検証(&V)..."},
+                        {"Lint", L"構文チェック(&L)"},
                         {"View", L"表示(&V)"},
                         {"RefreshTree", L"ツリー更新(&R)"},
+                        {"ShareSubtrees", L"同一サブツリーを共有(&S)"},
+                        {"FilterTree", L"ツリーを絞り込み(&F)"},
+                        {"FilterHint", L"絞り込み: キー、キー=値、=値"},
                         {"LineEndings", L"改行コード(&L)"},
                         {"Language", L"言語(&L)"},
                         {"English", L"英語(&E)"},
@@ -247,17 +801,83 @@ void EditorWindow::UpdateMenus() {
   AppendMenu(hFileMenu, MF_STRING, IDM_FILE_CLOSE_TAB,
              GetLocalizedString("CloseTab").c_str());
   AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
+  HMENU hConvertMenu = CreatePopupMenu();
+  AppendMenu(hConvertMenu, MF_STRING, IDM_CONVERT_YAML_TO_JSON,
+             GetLocalizedString("YamlToJson").c_str());
+  AppendMenu(hConvertMenu, MF_STRING, IDM_CONVERT_YAML_TO_JSONL,
+             GetLocalizedString("YamlToJsonLines").c_str());
+  AppendMenu(hConvertMenu, MF_STRING, IDM_CONVERT_JSON_TO_YAML,
+             GetLocalizedString("JsonToYaml").c_str());
+  AppendMenu(hConvertMenu, MF_STRING, IDM_CONVERT_JSONL_TO_YAML,
+             GetLocalizedString("JsonLinesToYaml").c_str());
+  AppendMenu(hConvertMenu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(hConvertMenu, MF_STRING, IDM_CONVERT_METADATA,
+             GetLocalizedString("KeepTagsAnchors").c_str());
+  CheckMenuItem(hConvertMenu, IDM_CONVERT_METADATA,
+                m_convertOptions.metadata ? MF_CHECKED : MF_UNCHECKED);
+  AppendMenu(hFileMenu, MF_POPUP, (UINT_PTR)hConvertMenu,
+             GetLocalizedString("Convert").c_str());
+  AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
   AppendMenu(hFileMenu, MF_STRING, IDM_FILE_EXIT,
              GetLocalizedString("Exit").c_str());
   AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hFileMenu,
              GetLocalizedString("File").c_str());
 
+  // Edit Menu
+  HMENU hEditMenu = CreatePopupMenu();
+  AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_UNDO_TREE,
+             GetLocalizedString("UndoTreeEdit").c_str());
+  AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_EXPAND_ALIASES,
+             GetLocalizedString("ExpandAliases").c_str());
+  AppendMenu(hEditMenu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_MATCH_BRACKET,
+             GetLocalizedString("MatchBracket").c_str());
+  AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_SELECT_BLOCK,
+             GetLocalizedString("SelectBlock").c_str());
+  AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hEditMenu,
+             GetLocalizedString("Edit").c_str());
+
+  // Search Menu
+  HMENU hSearchMenu = CreatePopupMenu();
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_FIND,
+             GetLocalizedString("FindReplace").c_str());
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_FIND_NEXT,
+             GetLocalizedString("FindNext").c_str());
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_QUERY,
+             GetLocalizedString("Query").c_str());
+  AppendMenu(hSearchMenu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_GOTO_DEFINITION,
+             GetLocalizedString("GoToDefinition").c_str());
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_FIND_REFERENCES,
+             GetLocalizedString("FindReferences").c_str());
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_FIND_DANGLING,
+             GetLocalizedString("FindDangling").c_str());
+  AppendMenu(hSearchMenu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_INDEX_PROJECT,
+             GetLocalizedString("IndexProject").c_str());
+  AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_FIND_ASSET_REFS,
+             GetLocalizedString("FindAssetReferences").c_str());
+  AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hSearchMenu,
+             GetLocalizedString("Search").c_str());
+
   // Format Menu
   HMENU hFormatMenu = CreatePopupMenu();
   AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_JSON,
              GetLocalizedString("FormatJSON").c_str());
   AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_YAML,
              GetLocalizedString("FormatYAML").c_str());
+  AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_MINIFY_JSON,
+             GetLocalizedString("MinifyJSON").c_str());
+  AppendMenu(hFormatMenu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_SELECTION,
+             GetLocalizedString("FormatSelection").c_str());
+  AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_NODE,
+             GetLocalizedString("FormatNode").c_str());
+  AppendMenu(hFormatMenu, MF_SEPARATOR, 0, NULL);
+  AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_SCHEMA,
+             GetLocalizedString("ValidateSchema").c_str());
+  AppendMenu(hFormatMenu, MF_STRING, IDM_FORMAT_LINT,
+             GetLocalizedString("Lint").c_str());
   AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hFormatMenu,
              GetLocalizedString("Format").c_str());
 
@@ -265,6 +885,12 @@ void EditorWindow::UpdateMenus() {
   HMENU hViewMenu = CreatePopupMenu();
   AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_REFRESH_TREE,
              GetLocalizedString("RefreshTree").c_str());
+  AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_SHARE_SUBTREES,
+             GetLocalizedString("ShareSubtrees").c_str());
+  AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_FILTER_TREE,
+             GetLocalizedString("FilterTree").c_str());
+  CheckMenuItem(hViewMenu, IDM_VIEW_SHARE_SUBTREES,
+                m_shareSubtrees ? MF_CHECKED : MF_UNCHECKED);
   AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hViewMenu,
              GetLocalizedString("View").c_str());
 
@@ -294,6 +920,13 @@ void EditorWindow::UpdateMenus() {
   SetMenu(m_hwnd, hMenu);
   if (hOldMenu)
     DestroyMenu(hOldMenu);
+
+  if (m_hQueryEdit)
+    SendMessage(m_hQueryEdit, EM_SETCUEBANNER, TRUE,
+                (LPARAM)GetLocalizedString("QueryHint").c_str());
+  if (m_hFilterBox)
+    SendMessage(m_hFilterBox, CB_SETCUEBANNER, 0,
+                (LPARAM)GetLocalizedString("FilterHint").c_str());
 }
 
 EditorWindow::~EditorWindow() { SaveSettings(); }
@@ -352,6 +985,15 @@ LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
     OnSize(LOWORD(lParam), HIWORD(lParam));
     return 0;
   case WM_COMMAND:
+    if (HIWORD(wParam) == EN_CHANGE) {
+      for (auto &doc : m_documents) {
+        if (doc.hEdit == (HWND)lParam) {
+          doc.generation++;
+          break;
+        }
+      }
+      return 0;
+    }
     OnCommand(LOWORD(wParam), HIWORD(wParam));
     return 0;
   case WM_NOTIFY: {
@@ -360,7 +1002,14 @@ LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
       int index = TabCtrl_GetCurSel(m_hTabCtrl);
       SwitchTab(index);
     } else if (pnm->idFrom == IDC_TREE_VIEW) {
-      if (pnm->code == TVN_ENDLABELEDITW || pnm->code == TVN_ENDLABELEDITA) {
+      if (pnm->code == TVN_BEGINLABELEDITW ||
+          pnm->code == TVN_BEGINLABELEDITA) {
+        // Query results, ranges and the filter summary are not model values
+        LPNMTVDISPINFO ptvdi = (LPNMTVDISPINFO)lParam;
+        TreeItemData *pData = (TreeItemData *)ptvdi->item.lParam;
+        return !pData || pData->isQueryResult || pData->isRange;
+      } else if (pnm->code == TVN_ENDLABELEDITW ||
+                 pnm->code == TVN_ENDLABELEDITA) {
         LPNMTVDISPINFO ptvdi = (LPNMTVDISPINFO)lParam;
         if (ptvdi->item.pszText) {
           // Get the path from lParam
@@ -373,64 +1022,56 @@ LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
               std::string newText = WideToString(ptvdi->item.pszText);
               // Basic editing: If label is "key: value", try to update value
               // If it's just "ROOT" or non-primitive, we might ignore for now
+              Document &doc = m_documents[m_activePageIndex];
+              if (doc.jsonLines || pData->isQueryResult)
+                return FALSE; // Records and query results are read-only
+              ModelPtr newRoot;
+              ScalarEdit edit{pData->path};
               size_t colonPos = newText.find(": ");
               if (colonPos != std::string::npos) {
                 std::string newValStr = newText.substr(colonPos + 2);
+                ModelPtr newVal;
                 try {
                   // Attempt to parse new value as JSON
-                  json newVal = json::parse(newValStr);
-                  Document &doc = m_documents[m_activePageIndex];
-                  doc.jsonData[json::json_pointer(pData->path)] = newVal;
-                  UpdateTextFromModel();
+                  newVal = Model::FromJson(json::parse(newValStr));
                 } catch (...) {
                   // Fallback: update as string
-                  Document &doc = m_documents[m_activePageIndex];
-                  doc.jsonData[json::json_pointer(pData->path)] = newValStr;
-                  UpdateTextFromModel();
+                  newVal = Model::String(newValStr);
                 }
+                newRoot = Model::SetAt(doc.model, pData->path, newVal);
+                edit.value = newVal;
               } else if (!pData->isArrayElement && pData->path != "/" &&
                          pData->path != "" && !newText.empty() &&
                          newText != "ROOT") {
-                // Key rename
-                size_t lastSlash = pData->path.find_last_of('/');
-                if (lastSlash != std::string::npos) {
-                  std::string parentPath = pData->path.substr(0, lastSlash);
-                  std::string oldKeyEscaped = pData->path.substr(lastSlash + 1);
-
-                  // Unescape JSON Pointer key (~1 -> /, ~0 -> ~)
-                  std::string oldKey = oldKeyEscaped;
-                  size_t p = 0;
-                  while ((p = oldKey.find("~1", p)) != std::string::npos) {
-                    oldKey.replace(p, 2, "/");
-                    p++;
-                  }
-                  p = 0;
-                  while ((p = oldKey.find("~0", p)) != std::string::npos) {
-                    oldKey.replace(p, 2, "~");
-                    p++;
-                  }
-
-                  Document &doc = m_documents[m_activePageIndex];
-                  try {
-                    json &parent =
-                        (parentPath.empty())
-                            ? doc.jsonData
-                            : doc.jsonData[json::json_pointer(parentPath)];
-                    if (parent.is_object() && parent.contains(oldKey)) {
-                      auto val = parent[oldKey];
-                      parent.erase(oldKey);
-                      parent[newText] = val;
-                      UpdateTextFromModel();
-                    }
-                  } catch (...) {
-                  }
-                }
+                // Key rename: the renamed subtree is shared, not copied
+                newRoot = Model::RenameKey(doc.model, pData->path, newText);
+                edit.key = newText;
+              }
+              if (!newRoot)
+                return FALSE; // Not an edit, or the item's path is stale
+              ApplyTreeEdit(doc, newRoot, &edit);
+              if (colonPos == std::string::npos) {
+                // Later edits below the key must use its new name
+                std::string from = pData->path;
+                RenameTreePaths(m_hTreeView, item.hItem, from,
+                                from.substr(0, from.rfind('/') + 1) +
+                                    Model::EscapePointerToken(newText));
               }
             }
           }
           return TRUE; // Accept the change
         }
         return FALSE;
+      } else if (pnm->code == TVN_ITEMEXPANDINGA ||
+                 pnm->code == TVN_ITEMEXPANDINGW) {
+        LPNMTREEVIEW pnmv = (LPNMTREEVIEW)lParam;
+        if (pnmv->action & TVE_EXPAND)
+          ExpandLazyItem(pnmv->itemNew.hItem);
+      } else if (pnm->code == TVN_SELCHANGEDA ||
+                 pnm->code == TVN_SELCHANGEDW) {
+        LPNMTREEVIEW pnmv = (LPNMTREEVIEW)lParam;
+        ShowJsonLinesRecord(pnmv->itemNew.hItem);
+        ShowQueryResult(pnmv->itemNew.hItem);
       } else if (pnm->code == TVN_DELETEITEMA || pnm->code == TVN_DELETEITEMW) {
         LPNMTREEVIEW pnmv = (LPNMTREEVIEW)lParam;
         if (pnmv->itemOld.lParam) {
@@ -440,6 +1081,50 @@ LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
     }
   }
     return 0;
+  case WM_JSONL_VALIDATED: {
+    auto *result = (JsonLinesValidation *)lParam;
+    OnJsonLinesValidated(result->index, std::move(result->errors));
+    delete result;
+  }
+    return 0;
+  case WM_FIND_RESULTS: {
+    auto *result = (FindResults *)lParam;
+    OnFindResults(result->searchId, std::move(result->hits), result->searched,
+                  result->done);
+    delete result;
+  }
+    return 0;
+  case WM_TIMER:
+    if (wParam == kFilterTimer) {
+      KillTimer(m_hwnd, kFilterTimer);
+      ApplyTreeFilter(m_filterTyped);
+      m_filterTyped = false;
+    }
+    return 0;
+  case WM_QUERY_RESULTS: {
+    auto *result = (QueryResults *)lParam;
+    OnQueryResults(*result);
+    delete result;
+  }
+    return 0;
+  case WM_SCHEMA_VALIDATED: {
+    auto *result = (SchemaResults *)lParam;
+    OnSchemaValidated(*result);
+    delete result;
+  }
+    return 0;
+  case WM_LINT_RESULTS: {
+    auto *result = (LintResults *)lParam;
+    OnLintResults(*result);
+    delete result;
+  }
+    return 0;
+  case WM_GUID_INDEXED: {
+    auto *result = (GuidIndexResult *)lParam;
+    OnGuidIndexed(*result);
+    delete result;
+  }
+    return 0;
   case WM_DESTROY:
     OnDestroy();
     return 0;
@@ -451,13 +1136,6 @@ void EditorWindow::OnCreate() {
   // Check for doc folder
   CreateDirectory(L"doc", NULL);
 
-  // Create Tree View
-  m_hTreeView = CreateWindowEx(
-      0, WC_TREEVIEW, L"",
-      WS_CHILD | WS_VISIBLE | WS_BORDER | TVS_HASLINES | TVS_HASBUTTONS |
-          TVS_LINESATROOT | TVS_EDITLABELS,
-      0, 0, 0, 0, m_hwnd, (HMENU)IDC_TREE_VIEW, GetModuleHandle(NULL), NULL);
-
   // Create Tab Control
   m_hTabCtrl = CreateWindow(
       WC_TABCONTROL, L"", WS_CHILD | WS_CLIPSIBLINGS | WS_VISIBLE, 0, 0, 0, 0,
@@ -466,6 +1144,24 @@ void EditorWindow::OnCreate() {
   SendMessage(m_hTabCtrl, WM_SETFONT, (WPARAM)GetStockObject(DEFAULT_GUI_FONT),
               0);
 
+  // Query bar above the tree
+  m_hQueryEdit = CreateWindowEx(
+      0, L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL, 0,
+      0, 0, 0, m_hwnd, (HMENU)IDC_QUERY_EDIT, GetModuleHandle(NULL), NULL);
+  SendMessage(m_hQueryEdit, WM_SETFONT,
+              (WPARAM)GetStockObject(DEFAULT_GUI_FONT), 0);
+  SetWindowSubclass(m_hQueryEdit, QueryEditSubclassProc, 0, (DWORD_PTR)this);
+
+  // Filter box below it; its list offers keys completing the text
+  m_hFilterBox = CreateWindowEx(
+      0, WC_COMBOBOX, L"",
+      WS_CHILD | WS_VISIBLE | WS_VSCROLL | CBS_DROPDOWN | CBS_AUTOHSCROLL, 0,
+      0, 0, 0, m_hwnd, (HMENU)IDC_FILTER_BOX, GetModuleHandle(NULL), NULL);
+  SendMessage(m_hFilterBox, WM_SETFONT,
+              (WPARAM)GetStockObject(DEFAULT_GUI_FONT), 0);
+  SetWindowSubclass(FindWindowEx(m_hFilterBox, NULL, L"Edit", NULL),
+                    FilterEditSubclassProc, 0, (DWORD_PTR)this);
+
   UpdateMenus();
 
   LoadSettings();
@@ -474,6 +1170,14 @@ void EditorWindow::OnCreate() {
   }
 }
 
+HWND EditorWindow::CreateTreeView() {
+  return CreateWindowEx(0, WC_TREEVIEW, L"",
+                        WS_CHILD | WS_BORDER | TVS_HASLINES | TVS_HASBUTTONS |
+                            TVS_LINESATROOT | TVS_EDITLABELS,
+                        0, 0, 0, 0, m_hwnd, (HMENU)IDC_TREE_VIEW,
+                        GetModuleHandle(NULL), NULL);
+}
+
 void EditorWindow::CreateNewTab(const std::wstring &path,
                                 const std::wstring &content) {
   Document doc;
@@ -482,6 +1186,8 @@ void EditorWindow::CreateNewTab(const std::wstring &path,
   doc.eolMode = 0; // Default CRLF
   doc.isDirty = false;
 
+  doc.hTree = CreateTreeView();
+
   // Create Line Number Control (Static)
   doc.hLineNum =
       CreateWindowEx(0, L"STATIC", L"", WS_CHILD | WS_VISIBLE | SS_RIGHT, 0, 0,
@@ -552,16 +1258,414 @@ void EditorWindow::UpdateLineNumbers(HWND hEdit) {
   int totalLines = (int)SendMessage(hEdit, EM_GETLINECOUNT, 0, 0);
 
   std::wstring numText;
+  numText.reserve((linesVisible + 2) * 8);
+  StringSink<wchar_t> sink(numText);
   for (int i = 0; i <= linesVisible + 1; i++) {
     int lineIdx = firstLine + i;
     if (lineIdx >= totalLines)
       break;
-    numText += std::to_wstring(lineIdx + 1) + L"\r\n";
+    WriteDecimal(sink, (unsigned)lineIdx + 1);
+    WriteLineBreak<FileUtils::CRLF>(sink);
   }
 
   SetWindowText(pDoc->hLineNum, numText.c_str());
 }
 
+EditorWindow::Document *EditorWindow::DocumentOf(HWND hEdit) {
+  for (auto &doc : m_documents)
+    if (doc.hEdit == hEdit)
+      return &doc;
+  return nullptr;
+}
+
+SyntaxHighlighter::Language
+EditorWindow::HighlightLanguage(const Document &doc) const {
+  if (doc.jsonLines || doc.binaryFormat != BinaryFormat::NONE)
+    return SyntaxHighlighter::JSON; // Shown as JSON
+  std::filesystem::path path(doc.filePath);
+  std::wstring ext = path.extension().wstring();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return (wchar_t)towlower(c); });
+  if (ext == L".gz" || ext == L".zst" || ext == L".zstd") {
+    ext = path.stem().extension().wstring();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](wchar_t c) { return (wchar_t)towlower(c); });
+  }
+  if (ext == L".json" || ext == L".geojson")
+    return SyntaxHighlighter::JSON;
+  if (ext == L".yaml" || ext == L".yml" || ext == L".unity" ||
+      ext == L".prefab" || ext == L".asset" || ext == L".meta" ||
+      ext == L".mat" || ext == L".anim" || ext == L".controller")
+    return SyntaxHighlighter::YAML;
+  // Otherwise whatever the text last parsed as
+  if (doc.format == Document::FMT_JSON)
+    return SyntaxHighlighter::JSON;
+  if (doc.format == Document::FMT_YAML)
+    return SyntaxHighlighter::YAML;
+  return SyntaxHighlighter::NONE;
+}
+
+EditorWindow::TextEdit EditorWindow::BeginTextEdit(HWND hEdit) {
+  TextEdit edit;
+  Document *doc = DocumentOf(hEdit);
+  if (!doc || !doc->highlighter)
+    return edit;
+  DWORD selStart, selEnd;
+  SendMessage(hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  edit.lineCount = (size_t)SendMessage(hEdit, EM_GETLINECOUNT, 0, 0);
+  size_t first = (size_t)SendMessage(hEdit, EM_LINEFROMCHAR, selStart, 0);
+  size_t last = (size_t)SendMessage(hEdit, EM_LINEFROMCHAR, selEnd, 0);
+  // Deleting a line break joins the line before or after the selection
+  edit.firstLine = first > 0 ? first - 1 : 0;
+  edit.lastLine = std::min(last + 1, edit.lineCount - 1);
+  edit.generation = doc->generation;
+  return edit;
+}
+
+void EditorWindow::EndTextEdit(HWND hEdit, const TextEdit &before,
+                               bool whole) {
+  Document *doc = DocumentOf(hEdit);
+  if (!doc || !doc->highlighter)
+    return;
+  if (!whole && doc->generation == before.generation)
+    return; // The message did not change the text
+  size_t lines = (size_t)SendMessage(hEdit, EM_GETLINECOUNT, 0, 0);
+  size_t removed = before.lastLine - before.firstLine + 1;
+  if (whole || before.lineCount != doc->highlighter->LineCount() ||
+      removed + lines <= before.lineCount) {
+    doc->highlighter = nullptr; // Recreated on the next paint
+    return;
+  }
+  doc->highlighter->Edit(before.firstLine, removed,
+                         removed + lines - before.lineCount);
+}
+
+void EditorWindow::TextReplaced(HWND hEdit) {
+  if (Document *doc = DocumentOf(hEdit))
+    doc->generation++;
+}
+
+static COLORREF TokenColor(TokenRun::Kind kind) {
+  switch (kind) {
+  case TokenRun::KEY:
+    return RGB(0x04, 0x51, 0xA5);
+  case TokenRun::STRING:
+    return RGB(0xA3, 0x15, 0x15);
+  case TokenRun::NUMBER:
+    return RGB(0x09, 0x86, 0x58);
+  case TokenRun::LITERAL:
+    return RGB(0x00, 0x00, 0xFF);
+  case TokenRun::PUNCTUATION:
+    return RGB(0x70, 0x70, 0x70);
+  case TokenRun::COMMENT:
+    return RGB(0x00, 0x80, 0x00);
+  case TokenRun::ANCHOR:
+    return RGB(0xAF, 0x00, 0xDB);
+  case TokenRun::TAG:
+    return RGB(0x26, 0x7F, 0x99);
+  default:
+    return RGB(0x79, 0x5E, 0x26);
+  }
+}
+
+// The edit control's text, read in place from its buffer, which stays
+// locked while this lives.
+class EditBuffer {
+public:
+  explicit EditBuffer(HWND hEdit)
+      : m_hEdit(hEdit), m_hText((HLOCAL)SendMessage(hEdit, EM_GETHANDLE, 0, 0)),
+        m_text(m_hText ? (const wchar_t *)LocalLock(m_hText) : nullptr) {}
+  ~EditBuffer() {
+    if (m_text)
+      LocalUnlock(m_hText);
+  }
+  EditBuffer(const EditBuffer &) = delete;
+  EditBuffer &operator=(const EditBuffer &) = delete;
+
+  const wchar_t *Text() const { return m_text; }
+  SyntaxHighlighter::LineReader Reader() const {
+    return [this](size_t line) {
+      size_t start = (size_t)SendMessage(m_hEdit, EM_LINEINDEX, line, 0);
+      size_t length = (size_t)SendMessage(m_hEdit, EM_LINELENGTH, start, 0);
+      return std::wstring_view(m_text + start, length);
+    };
+  }
+
+private:
+  HWND m_hEdit;
+  HLOCAL m_hText;
+  const wchar_t *m_text;
+};
+
+SyntaxHighlighter *EditorWindow::Highlighter(Document &doc) {
+  SyntaxHighlighter::Language language = HighlightLanguage(doc);
+  if (language == SyntaxHighlighter::NONE) {
+    doc.highlighter = nullptr;
+    return nullptr;
+  }
+  size_t lineCount = (size_t)SendMessage(doc.hEdit, EM_GETLINECOUNT, 0, 0);
+  if (!doc.highlighter || doc.highlighter->GetLanguage() != language ||
+      doc.highlighter->LineCount() != lineCount)
+    doc.highlighter = std::make_shared<SyntaxHighlighter>(language, lineCount);
+  return doc.highlighter.get();
+}
+
+void EditorWindow::PaintHighlights(HWND hEdit) {
+  Document *doc = DocumentOf(hEdit);
+  SyntaxHighlighter *highlighter = doc ? Highlighter(*doc) : nullptr;
+  if (!highlighter)
+    return;
+  EditBuffer buffer(hEdit);
+  const wchar_t *text = buffer.Text();
+  if (!text)
+    return;
+  SyntaxHighlighter::LineReader read = buffer.Reader();
+
+  HDC hdc = GetDC(hEdit);
+  SelectObject(hdc, (HFONT)SendMessage(hEdit, WM_GETFONT, 0, 0));
+  TEXTMETRIC tm;
+  GetTextMetrics(hdc, &tm);
+  RECT rc;
+  SendMessage(hEdit, EM_GETRECT, 0, (LPARAM)&rc);
+  IntersectClipRect(hdc, rc.left, rc.top, rc.right, rc.bottom);
+  bool readOnly = (GetWindowLong(hEdit, GWL_STYLE) & ES_READONLY) != 0;
+  SetBkColor(hdc, GetSysColor(readOnly ? COLOR_3DFACE : COLOR_WINDOW));
+  SetBkMode(hdc, OPAQUE);
+
+  size_t first = (size_t)SendMessage(hEdit, EM_GETFIRSTVISIBLELINE, 0, 0);
+  size_t last = first + (rc.bottom - rc.top) / tm.tmHeight + 2;
+  DWORD selStart, selEnd;
+  SendMessage(hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  std::vector<TokenRun> runs = highlighter->Runs(first, last, read);
+  size_t runLine = SIZE_MAX, lineStart = 0;
+  for (const TokenRun &run : runs) {
+    if (run.line != runLine) {
+      runLine = run.line;
+      lineStart = (size_t)SendMessage(hEdit, EM_LINEINDEX, run.line, 0);
+    }
+    SetTextColor(hdc, TokenColor(run.kind));
+    // Selected text and tabs are left as the control drew them
+    size_t end = lineStart + run.column + run.length;
+    for (size_t p = lineStart + run.column; p < end;) {
+      if (p >= selStart && p < selEnd) {
+        p = selEnd;
+        continue;
+      }
+      size_t stop = p < selStart ? std::min<size_t>(end, selStart) : end;
+      const wchar_t *tab = wmemchr(text + p, L'\t', stop - p);
+      if (tab)
+        stop = tab - text;
+      if (stop > p) {
+        LRESULT pos = SendMessage(hEdit, EM_POSFROMCHAR, p, 0);
+        ExtTextOut(hdc, (short)LOWORD(pos), (short)HIWORD(pos), 0, NULL,
+                   text + p, (UINT)(stop - p), NULL);
+      }
+      p = tab ? stop + 1 : stop;
+    }
+  }
+
+  // Indentation guides for the blocks on screen, at the column of the line
+  // each starts on; a bracket block's guide stops above its closing line.
+  // The control repaints only the lines it changes, so when the blocks
+  // change in place it is made to repaint all to clear the old guides.
+  std::vector<FoldRange> ranges = highlighter->FoldRanges(first, last, read);
+  bool same = first == doc->guidesFirst &&
+              std::equal(ranges.begin(), ranges.end(), doc->guides.begin(),
+                         doc->guides.end(),
+                         [](const FoldRange &a, const FoldRange &b) {
+                           return a.first == b.first && a.last == b.last;
+                         });
+  bool moved = first != doc->guidesFirst;
+  doc->guides = std::move(ranges);
+  doc->guidesFirst = first;
+  if (!same && !moved) {
+    ReleaseDC(hEdit, hdc);
+    InvalidateRect(hEdit, NULL, FALSE);
+    return;
+  }
+  LRESULT origin = SendMessage(
+      hEdit, EM_POSFROMCHAR, SendMessage(hEdit, EM_LINEINDEX, first, 0), 0);
+  if (origin != -1) {
+    HPEN hPen = CreatePen(PS_DOT, 1, RGB(0xC8, 0xC8, 0xC8));
+    HGDIOBJ hOldPen = SelectObject(hdc, hPen);
+    SetBkMode(hdc, TRANSPARENT);
+    bool brackets = highlighter->GetLanguage() == SyntaxHighlighter::JSON;
+    for (const FoldRange &range : doc->guides) {
+      std::wstring_view header = read(range.first);
+      size_t column = 0;
+      while (column < header.size() && header[column] == L' ')
+        column++;
+      int x = (short)LOWORD(origin) + (int)column * tm.tmAveCharWidth;
+      size_t top = std::max(range.first + 1, first);
+      size_t bottom = brackets ? range.last : range.last + 1;
+      if (bottom <= top)
+        continue;
+      MoveToEx(hdc, x, rc.top + (int)(top - first) * tm.tmHeight, NULL);
+      LineTo(hdc, x, rc.top + (int)(bottom - first) * tm.tmHeight);
+    }
+    SelectObject(hdc, hOldPen);
+    DeleteObject(hPen);
+    SetBkMode(hdc, OPAQUE);
+  }
+
+  // The bracket at or before the caret and its match, when both show
+  size_t marks[2] = {SIZE_MAX, SIZE_MAX};
+  if (selStart == selEnd) {
+    size_t line = (size_t)SendMessage(hEdit, EM_LINEFROMCHAR, selStart, 0);
+    size_t lineStart = (size_t)SendMessage(hEdit, EM_LINEINDEX, line, 0);
+    size_t column = selStart - lineStart, matchLine, matchColumn;
+    bool found = highlighter->MatchBracket(line, column, last, read,
+                                           matchLine, matchColumn);
+    if (!found && column > 0)
+      found = highlighter->MatchBracket(line, --column, last, read, matchLine,
+                                        matchColumn);
+    if (found && matchLine >= first) {
+      marks[0] = lineStart + column;
+      marks[1] =
+          (size_t)SendMessage(hEdit, EM_LINEINDEX, matchLine, 0) + matchColumn;
+    }
+  }
+  for (size_t old : doc->bracketMarks) {
+    LRESULT pos = old == marks[0] || old == marks[1] || old == SIZE_MAX
+                      ? -1
+                      : SendMessage(hEdit, EM_POSFROMCHAR, old, 0);
+    if (pos != -1) {
+      RECT mark = {(short)LOWORD(pos), (short)HIWORD(pos),
+                   (short)LOWORD(pos) + tm.tmAveCharWidth,
+                   (short)HIWORD(pos) + tm.tmHeight};
+      InvalidateRect(hEdit, &mark, FALSE);
+    }
+  }
+  doc->bracketMarks[0] = marks[0];
+  doc->bracketMarks[1] = marks[1];
+  SetBkColor(hdc, RGB(0xD0, 0xE4, 0xFF));
+  SetTextColor(hdc, TokenColor(TokenRun::PUNCTUATION));
+  for (size_t p : marks) {
+    if (p == SIZE_MAX)
+      continue;
+    LRESULT pos = SendMessage(hEdit, EM_POSFROMCHAR, p, 0);
+    ExtTextOut(hdc, (short)LOWORD(pos), (short)HIWORD(pos), 0, NULL,
+               text + p, 1, NULL);
+  }
+  ReleaseDC(hEdit, hdc);
+}
+
+void EditorWindow::GoToMatchingBracket() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  SyntaxHighlighter *highlighter = Highlighter(doc);
+  DWORD selStart, selEnd;
+  SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  size_t line = (size_t)SendMessage(doc.hEdit, EM_LINEFROMCHAR, selEnd, 0);
+  size_t column =
+      selEnd - (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, line, 0);
+  size_t matchLine, matchColumn;
+  bool found = false;
+  if (highlighter) {
+    EditBuffer buffer(doc.hEdit);
+    if (buffer.Text()) {
+      // The bracket after the caret, or else the one before it
+      found = highlighter->MatchBracket(line, column, SIZE_MAX,
+                                        buffer.Reader(), matchLine,
+                                        matchColumn) ||
+              (column > 0 &&
+               highlighter->MatchBracket(line, column - 1, SIZE_MAX,
+                                         buffer.Reader(), matchLine,
+                                         matchColumn));
+    }
+  }
+  if (!found) {
+    MessageBeep(MB_OK); // No bracket at the caret, or it is unmatched
+    return;
+  }
+  size_t start =
+      (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, matchLine, 0) + matchColumn;
+  SelectMatch(doc, {start, 0});
+}
+
+void EditorWindow::SelectBlock() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  SyntaxHighlighter *highlighter = Highlighter(doc);
+  DWORD selStart, selEnd;
+  SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  size_t line = (size_t)SendMessage(doc.hEdit, EM_LINEFROMCHAR, selStart, 0);
+  FoldRange range;
+  bool found = false;
+  if (highlighter) {
+    EditBuffer buffer(doc.hEdit);
+    found = buffer.Text() && highlighter->Block(line, buffer.Reader(), range);
+  }
+  if (!found) {
+    MessageBeep(MB_OK); // Not in a block
+    return;
+  }
+  size_t start = (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, range.first, 0);
+  size_t lastStart =
+      (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, range.last, 0);
+  size_t end =
+      lastStart + (size_t)SendMessage(doc.hEdit, EM_LINELENGTH, lastStart, 0);
+  SelectMatch(doc, {start, end - start});
+}
+
+static bool IsInvalidRecord(const std::vector<JsonLinesError> &errors,
+                            size_t record) {
+  auto it = std::lower_bound(
+      errors.begin(), errors.end(), record,
+      [](const JsonLinesError &e, size_t r) { return e.record < r; });
+  return it != errors.end() && it->record == record;
+}
+
+// "[i] " and the start of record i's text.
+static std::wstring RecordLabel(const JsonLinesIndex &index, size_t i,
+                                const std::vector<JsonLinesError> &errors) {
+  const char *begin;
+  size_t size;
+  index.Record(i, begin, size);
+  std::string preview(begin, size < 80 ? size : 80);
+  if (size > 80)
+    preview += "...";
+  std::wstring label = L"[" + std::to_wstring(i) + L"] " + StringToWide(preview);
+  if (IsInvalidRecord(errors, i))
+    label += L" (Invalid)";
+  return label;
+}
+
+static void AddRecordItem(HWND hTree, HTREEITEM hParent,
+                          const JsonLinesIndex &index, size_t i,
+                          const std::vector<JsonLinesError> &errors) {
+  InsertLazyItem(hTree, hParent, RecordLabel(index, i, errors),
+                 new TreeItemData{"/" + std::to_string(i), true, i, i + 1,
+                                  true});
+}
+
+// Adds records [first, last) under hParent, or nested ranges of them.
+static void AddRecordRange(HWND hTree, HTREEITEM hParent,
+                           const JsonLinesIndex &index, size_t first,
+                           size_t last,
+                           const std::vector<JsonLinesError> &errors) {
+  AddItemRange(hTree, hParent, first, last, TreeItemData{"", false},
+               [&](size_t i) {
+                 AddRecordItem(hTree, hParent, index, i, errors);
+               });
+}
+
+// Adds elements [first, last) of a packed array under hParent, or nested
+// ranges of them; range is the array's item data.
+static void AddPackedRange(HWND hTree, HTREEITEM hParent,
+                           const TreeItemData &range, size_t first,
+                           size_t last, const std::vector<int> &lines) {
+  std::string prefix = (range.path == "/" ? "" : range.path) + "/";
+  AddItemRange(hTree, hParent, first, last, range, [&](size_t i) {
+    size_t cursor = range.lineIndex + i;
+    AddModelToTree(hTree, hParent, "[" + std::to_string(i) + "]",
+                   Model::Item(range.packed, i), lines, cursor,
+                   prefix + std::to_string(i), true);
+  });
+}
+
 void EditorWindow::SwitchTab(int index) {
   if (index < 0 || index >= m_documents.size())
     return;
@@ -569,22 +1673,35 @@ void EditorWindow::SwitchTab(int index) {
   if (m_activePageIndex != -1) {
     ShowWindow(m_documents[m_activePageIndex].hEdit, SW_HIDE);
     ShowWindow(m_documents[m_activePageIndex].hLineNum, SW_HIDE);
+    ShowWindow(m_documents[m_activePageIndex].hTree, SW_HIDE);
   }
 
   m_activePageIndex = index;
+  m_hTreeView = m_documents[index].hTree;
   TabCtrl_SetCurSel(m_hTabCtrl, index);
   ShowWindow(m_documents[index].hEdit, SW_SHOW);
   ShowWindow(m_documents[index].hLineNum, SW_SHOW);
+  ShowWindow(m_hTreeView, SW_SHOW);
   SetFocus(m_documents[index].hEdit);
+  SetWindowText(m_hFilterBox,
+                StringToWide(m_documents[index].treeFilter).c_str());
 
   ResizeTabControl();
   UpdateTitle();
-  UpdateTreeFromText();
+  // The tab keeps its model and tree; only reparse if the text changed
+  if (m_documents[index].treeGeneration != m_documents[index].generation)
+    UpdateTreeFromText();
   UpdateLineNumbers(m_documents[index].hEdit); // Initial update
+  UpdateEolMenu();
+}
+
+void EditorWindow::UpdateEolMenu() {
+  if (m_activePageIndex == -1)
+    return;
 
   // Update Menu State
   HMENU hMenu = GetMenu(m_hwnd);
-  int currentEol = m_documents[index].eolMode;
+  int currentEol = m_documents[m_activePageIndex].eolMode;
   CheckMenuItem(hMenu, IDM_EOL_CRLF,
                 currentEol == 0 ? MF_CHECKED : MF_UNCHECKED);
   CheckMenuItem(hMenu, IDM_EOL_LF, currentEol == 1 ? MF_CHECKED : MF_UNCHECKED);
@@ -596,9 +1713,10 @@ void EditorWindow::OnSize(int width, int height) {
   if (width < treeWidth)
     treeWidth = width / 2;
 
-  if (m_hTreeView) {
-    MoveWindow(m_hTreeView, 0, 0, treeWidth, height, TRUE);
-  }
+  if (m_hQueryEdit)
+    MoveWindow(m_hQueryEdit, 0, 0, treeWidth, kBarHeight, TRUE);
+  if (m_hFilterBox) // The height includes the dropped-down list
+    MoveWindow(m_hFilterBox, 0, kBarHeight, treeWidth, kBarHeight * 12, TRUE);
   if (m_hTabCtrl) {
     MoveWindow(m_hTabCtrl, treeWidth, 0, width - treeWidth, height, TRUE);
     ResizeTabControl();
@@ -629,6 +1747,13 @@ void EditorWindow::ResizeTabControl() {
 
   Document &doc = m_documents[m_activePageIndex];
 
+  // The tree fills the space left of the tab control, below the query and
+  // filter bars
+  RECT rcClient;
+  GetClientRect(m_hwnd, &rcClient);
+  MoveWindow(doc.hTree, 0, 2 * kBarHeight, pt.x,
+             rcClient.bottom - 2 * kBarHeight, TRUE);
+
   if (doc.hLineNum) {
     MoveWindow(doc.hLineNum, x, y, lineNumWidth, h, TRUE);
     // Force repaint of line numbers
@@ -658,42 +1783,158 @@ void EditorWindow::OnCommand(int id, int code) {
   case IDM_FILE_CLOSE_TAB:
     CloseCurrentTab();
     break;
-  case IDM_FORMAT_JSON:
-    FormatJson();
+  case IDM_CONVERT_YAML_TO_JSON:
+  case IDM_CONVERT_YAML_TO_JSONL:
+  case IDM_CONVERT_JSON_TO_YAML:
+  case IDM_CONVERT_JSONL_TO_YAML:
+    ConvertFile(id);
     break;
-  case IDM_FORMAT_YAML:
-    FormatYaml();
+  case IDM_CONVERT_METADATA:
+    m_convertOptions.metadata = !m_convertOptions.metadata;
+    CheckMenuItem(GetMenu(m_hwnd), IDM_CONVERT_METADATA,
+                  m_convertOptions.metadata ? MF_CHECKED : MF_UNCHECKED);
     break;
-  case IDM_VIEW_REFRESH_TREE:
-    UpdateTreeFromText();
+  case IDM_EDIT_UNDO_TREE:
+    UndoTreeEdit();
     break;
-  case IDM_EOL_CRLF:
-    if (m_activePageIndex >= 0)
-      m_documents[m_activePageIndex].eolMode = 0;
-    // Force redraw menu check
-    SwitchTab(m_activePageIndex);
+  case IDM_EDIT_EXPAND_ALIASES:
+    ExpandAliases();
     break;
-  case IDM_EOL_LF:
-    if (m_activePageIndex >= 0)
-      m_documents[m_activePageIndex].eolMode = 1;
-    SwitchTab(m_activePageIndex);
+  case IDM_EDIT_MATCH_BRACKET:
+    GoToMatchingBracket();
     break;
-  case IDM_EOL_CR:
-    if (m_activePageIndex >= 0)
-      m_documents[m_activePageIndex].eolMode = 2;
-    SwitchTab(m_activePageIndex);
+  case IDM_EDIT_SELECT_BLOCK:
+    SelectBlock();
     break;
-  case IDM_LANG_EN:
-    SetLanguage("en");
+  case IDM_SEARCH_FIND:
+    ShowFindDialog();
     break;
-  case IDM_LANG_JP:
-    SetLanguage("jp");
+  case IDM_SEARCH_FIND_NEXT:
+    FindNext();
     break;
-  }
-}
-
-void EditorWindow::OnDestroy() {
-  SaveSettings();
+  case IDM_SEARCH_REPLACE:
+    ReplaceOne();
+    break;
+  case IDM_SEARCH_REPLACE_ALL:
+    ReplaceAll();
+    break;
+  case IDM_SEARCH_FIND_ALL:
+    FindAll();
+    break;
+  case IDM_SEARCH_FIND_IN_TABS:
+    FindInFiles(false);
+    break;
+  case IDM_SEARCH_FIND_IN_FILES:
+    FindInFiles(true);
+    break;
+  case IDM_SEARCH_GOTO_RESULT:
+    GoToFindResult();
+    break;
+  case IDM_SEARCH_QUERY:
+    SetFocus(m_hQueryEdit);
+    SendMessage(m_hQueryEdit, EM_SETSEL, 0, -1);
+    break;
+  case IDM_SEARCH_RUN_QUERY:
+    RunQuery();
+    break;
+  case IDM_SEARCH_CANCEL_QUERY:
+    CancelQuery();
+    break;
+  case IDM_SEARCH_GOTO_DEFINITION:
+    GoToDefinition();
+    break;
+  case IDM_SEARCH_FIND_REFERENCES:
+  case IDM_SEARCH_FIND_DANGLING:
+    FindReferences(id == IDM_SEARCH_FIND_DANGLING);
+    break;
+  case IDM_SEARCH_INDEX_PROJECT:
+    IndexUnityProject(true);
+    break;
+  case IDM_SEARCH_FIND_ASSET_REFS:
+    FindAssetReferences();
+    break;
+  case IDM_FORMAT_JSON:
+    FormatJson();
+    break;
+  case IDM_FORMAT_YAML:
+    FormatYaml();
+    break;
+  case IDM_FORMAT_MINIFY_JSON:
+    FormatJson(true);
+    break;
+  case IDM_FORMAT_SELECTION:
+    FormatRange(true);
+    break;
+  case IDM_FORMAT_NODE:
+    FormatRange(false);
+    break;
+  case IDM_FORMAT_SCHEMA:
+    PickSchema();
+    break;
+  case IDM_FORMAT_LINT:
+    Lint();
+    break;
+  case IDM_VIEW_REFRESH_TREE:
+    UpdateTreeFromText();
+    break;
+  case IDM_VIEW_FILTER_TREE:
+    SetFocus(m_hFilterBox);
+    SendMessage(m_hFilterBox, CB_SETEDITSEL, 0, MAKELPARAM(0, -1));
+    break;
+  case IDC_FILTER_BOX:
+    // Typing waits for a pause; picking a completion filters at once
+    if (code == CBN_EDITCHANGE) {
+      m_filterTyped = true;
+      SetTimer(m_hwnd, kFilterTimer, kFilterDelay, NULL);
+    } else if (code == CBN_SELCHANGE) {
+      SetTimer(m_hwnd, kFilterTimer, kFilterDelay, NULL);
+    } else if (code == CBN_SELENDOK) {
+      SetTimer(m_hwnd, kFilterTimer, 0, NULL); // The text is set after this
+    }
+    break;
+  case IDM_VIEW_CLEAR_FILTER:
+    SetWindowText(m_hFilterBox, L"");
+    ApplyTreeFilter(true);
+    if (m_activePageIndex != -1)
+      SetFocus(m_documents[m_activePageIndex].hEdit);
+    break;
+  case IDM_VIEW_GOTO_MATCH:
+    GoToFirstMatch();
+    break;
+  case IDM_VIEW_SHARE_SUBTREES:
+    m_shareSubtrees = !m_shareSubtrees;
+    CheckMenuItem(GetMenu(m_hwnd), IDM_VIEW_SHARE_SUBTREES,
+                  m_shareSubtrees ? MF_CHECKED : MF_UNCHECKED);
+    for (auto &doc : m_documents)
+      doc.interner.reset();
+    UpdateTreeFromText();
+    break;
+  case IDM_EOL_CRLF:
+    if (m_activePageIndex >= 0)
+      m_documents[m_activePageIndex].eolMode = 0;
+    UpdateEolMenu();
+    break;
+  case IDM_EOL_LF:
+    if (m_activePageIndex >= 0)
+      m_documents[m_activePageIndex].eolMode = 1;
+    UpdateEolMenu();
+    break;
+  case IDM_EOL_CR:
+    if (m_activePageIndex >= 0)
+      m_documents[m_activePageIndex].eolMode = 2;
+    UpdateEolMenu();
+    break;
+  case IDM_LANG_EN:
+    SetLanguage("en");
+    break;
+  case IDM_LANG_JP:
+    SetLanguage("jp");
+    break;
+  }
+}
+
+void EditorWindow::OnDestroy() {
+  SaveSettings();
   PostQuitMessage(0);
 }
 
@@ -702,7 +1943,17 @@ void EditorWindow::CloseCurrentTab() {
     return;
 
   // Check dirty (omitted for brevity, assume user wants to close)
+  Document &closed = m_documents[m_activePageIndex];
+  if (closed.schemaCancel)
+    *closed.schemaCancel = true;
+  if (closed.queryCancel)
+    *closed.queryCancel = true;
+  if (closed.lintCancel)
+    *closed.lintCancel = true;
   DestroyWindow(m_documents[m_activePageIndex].hEdit);
+  DestroyWindow(m_documents[m_activePageIndex].hLineNum);
+  DestroyWindow(m_documents[m_activePageIndex].hTree);
+  m_hTreeView = NULL;
   TabCtrl_DeleteItem(m_hTabCtrl, m_activePageIndex);
   m_documents.erase(m_documents.begin() + m_activePageIndex);
 
@@ -744,8 +1995,7 @@ void EditorWindow::OpenFile() {
             }
           }
 
-          std::wstring content = FileUtils::ReadFileUtf8(wpath);
-          CreateNewTab(wpath, content);
+          OpenPath(wpath);
 
           CoTaskMemFree(pszFilePath);
         }
@@ -756,10 +2006,208 @@ void EditorWindow::OpenFile() {
   }
 }
 
+static bool IsJsonLinesPath(const std::wstring &path) {
+  std::wstring ext = std::filesystem::path(path).extension().wstring();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return (wchar_t)towlower(c); });
+  return ext == L".jsonl" || ext == L".ndjson";
+}
+
+void EditorWindow::OpenPath(const std::wstring &path) {
+  if (IsJsonLinesPath(path)) {
+    OpenJsonLines(path);
+    return;
+  }
+  BinaryFormat::Format format = BinaryFormat::FromPath(path);
+  if (format == BinaryFormat::NONE) {
+    FileUtils::Compression compression;
+    std::wstring content = FileUtils::ReadFileUtf8(path, &compression);
+    CreateNewTab(path, content);
+    m_documents.back().compression = compression;
+    return;
+  }
+
+  // Decoded straight from the mapped file into the model, then shown as
+  // pretty-printed JSON
+  std::string text;
+  try {
+    MappedFile file(path);
+    ModelPtr model = BinaryFormat::Read(file.Data(), file.Size(), format);
+    std::string compact = Model::ToJsonText(model);
+    text = JsonFormatter::Format(compact.data(), compact.size(), 4);
+  } catch (const std::exception &e) {
+    std::wstring msg = std::wstring(L"Could not read the ") +
+                       BinaryFormat::Name(format) + L" file:\n" +
+                       StringToWide(e.what());
+    MessageBox(m_hwnd, msg.c_str(), L"Open Error", MB_OK | MB_ICONERROR);
+    return;
+  }
+  CreateNewTab(path, StringToWide(text));
+  m_documents.back().binaryFormat = format;
+}
+
+void EditorWindow::OpenJsonLines(const std::wstring &path) {
+  auto file = std::make_shared<MappedFile>(path);
+  auto index = std::make_shared<JsonLinesIndex>();
+  index->Build((const char *)file->Data(), file->Size());
+
+  CreateNewTab(path);
+  Document &doc = m_documents.back();
+  doc.mappedFile = file;
+  doc.jsonLines = index;
+  SendMessage(doc.hEdit, EM_SETREADONLY, TRUE, 0);
+
+  TreeView_DeleteAllItems(doc.hTree);
+  std::wstring label = L"Records (" + std::to_wstring(index->Count()) + L")";
+  HTREEITEM hRoot =
+      InsertLazyItem(doc.hTree, TVI_ROOT, label,
+                     new TreeItemData{"/", false, 0, index->Count(), false});
+  TreeView_Expand(doc.hTree, hRoot, TVE_EXPAND);
+
+  // Validate every record in the background; the tab is usable meanwhile
+  HWND hwnd = m_hwnd;
+  std::thread([hwnd, file, index] {
+    auto *result = new JsonLinesValidation{index.get(), index->Validate()};
+    if (!PostMessage(hwnd, WM_JSONL_VALIDATED, 0, (LPARAM)result))
+      delete result;
+  }).detach();
+}
+
+void EditorWindow::OnJsonLinesValidated(const JsonLinesIndex *index,
+                                        std::vector<JsonLinesError> errors) {
+  for (auto &doc : m_documents) {
+    if (doc.jsonLines.get() != index)
+      continue;
+    doc.jsonLinesErrors = std::move(errors);
+    if (doc.jsonLinesErrors.empty())
+      return;
+
+    HTREEITEM hRoot = TreeView_GetRoot(doc.hTree);
+    std::wstring label = L"Records (" + std::to_wstring(index->Count()) +
+                         L", " + std::to_wstring(doc.jsonLinesErrors.size()) +
+                         L" invalid)";
+    TVITEMW item = {0};
+    item.mask = TVIF_TEXT;
+    item.hItem = hRoot;
+    item.pszText = (LPWSTR)label.c_str();
+    SendMessage(doc.hTree, TVM_SETITEMW, 0, (LPARAM)&item);
+
+    // Invalid records get their own list (the first kItemsPerRange)
+    std::wstring errorsLabel =
+        L"Invalid Records (" + std::to_wstring(doc.jsonLinesErrors.size()) +
+        L")";
+    TVINSERTSTRUCTW tvis = {0};
+    tvis.hParent = TVI_ROOT;
+    tvis.hInsertAfter = TVI_LAST;
+    tvis.item.mask = TVIF_TEXT | TVIF_PARAM;
+    tvis.item.pszText = (LPWSTR)errorsLabel.c_str();
+    tvis.item.lParam = (LPARAM) new TreeItemData{"", false};
+    HTREEITEM hErrors =
+        (HTREEITEM)SendMessage(doc.hTree, TVM_INSERTITEMW, 0, (LPARAM)&tvis);
+    for (size_t i = 0;
+         i < doc.jsonLinesErrors.size() && i < kItemsPerRange; i++)
+      AddRecordItem(doc.hTree, hErrors, *index, doc.jsonLinesErrors[i].record,
+                    doc.jsonLinesErrors);
+    return;
+  }
+}
+
+// Fills a packed array, JSON Lines range or record item the first time it
+// is expanded.
+void EditorWindow::ExpandLazyItem(HTREEITEM hItem) {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  TVITEMW item = {0};
+  item.hItem = hItem;
+  item.mask = TVIF_PARAM;
+  if (!SendMessage(doc.hTree, TVM_GETITEMW, 0, (LPARAM)&item) || !item.lParam)
+    return;
+  TreeItemData *pData = (TreeItemData *)item.lParam;
+  if (pData->last <= pData->first)
+    return; // Already filled
+  size_t first = pData->first, last = pData->last;
+  pData->last = pData->first;
+
+  if (pData->packed) {
+    static const std::vector<int> noLines;
+    bool hasLines = pData->lineIndex != SIZE_MAX && doc.sourceLines;
+    AddPackedRange(doc.hTree, hItem, *pData, first, last,
+                   hasLines ? *doc.sourceLines : noLines);
+    return;
+  }
+  if (!doc.jsonLines)
+    return;
+  if (!pData->isRecord) {
+    AddRecordRange(doc.hTree, hItem, *doc.jsonLines, first, last,
+                   doc.jsonLinesErrors);
+    return;
+  }
+
+  ModelPtr record;
+  try {
+    record = doc.jsonLines->Parse(first);
+  } catch (const std::exception &) {
+    // Nothing to show; selecting the record shows the error
+  }
+  std::vector<int> noLines;
+  size_t cursor = 0;
+  std::string prefix = pData->path + "/";
+  if (record && record->kind == ModelNode::OBJECT) {
+    for (size_t i = 0; i < record->items.size(); i++)
+      AddModelToTree(doc.hTree, hItem, record->Keys()[i], record->items[i],
+                     noLines, cursor,
+                     prefix + Model::EscapePointerToken(record->Keys()[i]));
+  } else if (record && record->kind == ModelNode::ARRAY) {
+    for (size_t i = 0; i < record->Size(); i++)
+      AddModelToTree(doc.hTree, hItem, "[" + std::to_string(i) + "]",
+                     Model::Item(record, i), noLines, cursor,
+                     prefix + std::to_string(i), true);
+  } else if (record) {
+    AddModelToTree(doc.hTree, hItem, "value", record, noLines, cursor,
+                   pData->path);
+  }
+
+  if (!TreeView_GetChild(doc.hTree, hItem)) {
+    item.mask = TVIF_CHILDREN;
+    item.cChildren = 0;
+    SendMessage(doc.hTree, TVM_SETITEMW, 0, (LPARAM)&item);
+  }
+}
+
+// Shows the selected JSON Lines record, pretty-printed, in the edit control.
+void EditorWindow::ShowJsonLinesRecord(HTREEITEM hItem) {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  TVITEMW item = {0};
+  item.hItem = hItem;
+  item.mask = TVIF_PARAM;
+  if (!doc.jsonLines ||
+      !SendMessage(doc.hTree, TVM_GETITEMW, 0, (LPARAM)&item) || !item.lParam)
+    return;
+  TreeItemData *pData = (TreeItemData *)item.lParam;
+  if (!pData->isRecord)
+    return;
+
+  const char *begin;
+  size_t size;
+  doc.jsonLines->Record(pData->first, begin, size);
+  std::string text;
+  try {
+    text = JsonFormatter::Format(begin, size, 4);
+  } catch (const std::runtime_error &e) {
+    text = std::string(e.what()) + "\r\n\r\n" + std::string(begin, size);
+  }
+  SetEditTextUtf8(doc.hEdit, text);
+}
+
 void EditorWindow::SaveFile() {
   if (m_activePageIndex == -1)
     return;
   Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return; // Read-only view of the mapped file
 
   if (doc.filePath.empty()) {
     SaveFileAs();
@@ -771,8 +2219,26 @@ void EditorWindow::SaveFile() {
   GetWindowText(doc.hEdit, buffer.data(), len + 1);
 
   std::wstring text = buffer.data();
+  if (doc.binaryFormat != BinaryFormat::NONE) {
+    try {
+      nlohmann::ordered_json j = BinaryFormat::ToJson(WideToString(text));
+      std::vector<uint8_t> bytes = BinaryFormat::Write(j, doc.binaryFormat);
+      if (FileUtils::WriteFileBytes(doc.filePath, bytes.data(),
+                                    bytes.size())) {
+        doc.isDirty = false;
+        UpdateTitle();
+      }
+    } catch (const std::exception &e) {
+      std::wstring msg = std::wstring(L"Could not save as ") +
+                         BinaryFormat::Name(doc.binaryFormat) + L":\n" +
+                         StringToWide(e.what());
+      MessageBox(m_hwnd, msg.c_str(), L"Save Error", MB_OK | MB_ICONERROR);
+    }
+    return;
+  }
   if (FileUtils::WriteFileUtf8(doc.filePath, text,
-                               (FileUtils::EolMode)doc.eolMode)) {
+                               (FileUtils::EolMode)doc.eolMode,
+                               doc.compression)) {
     doc.isDirty = false;
     UpdateTitle();
   }
@@ -782,6 +2248,8 @@ void EditorWindow::SaveFileAs() {
   if (m_activePageIndex == -1)
     return;
   Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return;
 
   IFileSaveDialog *pFileSave;
   HRESULT hr = CoCreateInstance(CLSID_FileSaveDialog, NULL, CLSCTX_ALL,
@@ -810,6 +2278,9 @@ void EditorWindow::SaveFileAs() {
         if (SUCCEEDED(hr)) {
           doc.filePath = pszFilePath;
           doc.fileName = GetFileNameFromPath(doc.filePath);
+          // The extension decides the encoding, so Save As converts
+          doc.binaryFormat = BinaryFormat::FromPath(doc.filePath);
+          doc.compression = FileUtils::CompressionFromPath(doc.filePath);
 
           // Update Tab Text
           TCITEM tie;
@@ -865,6 +2336,23 @@ void EditorWindow::SaveSettings() {
   }
   j["files"] = files;
   j["language"] = m_currentLang;
+  j["shareSubtrees"] = m_shareSubtrees;
+  j["aliasExpansionBudget"] = m_aliasBudget;
+  j["yamlIndent"] = m_yamlOptions.indent;
+  j["yamlFlowThreshold"] = m_yamlOptions.flowThreshold;
+  j["convertMetadata"] = m_convertOptions.metadata;
+  j["searchMatchCase"] = m_searchOptions.matchCase;
+  j["searchWholeWord"] = m_searchOptions.wholeWord;
+  j["searchRegex"] = m_searchOptions.regex;
+  j["lintDuplicateKeys"] = m_lintRules.duplicateKeys;
+  j["lintTypeDrift"] = m_lintRules.typeDrift;
+  j["lintMaxDepth"] = m_lintRules.maxDepth;
+  j["lintMaxScalarBytes"] = m_lintRules.maxScalarBytes;
+  j["findFolder"] = WideToString(m_fileSearchOptions.folder);
+  j["findFilter"] = WideToString(m_fileSearchOptions.include);
+  j["findExcludeFolders"] = WideToString(m_fileSearchOptions.excludeFolders);
+  j["findMaxFileSize"] = m_fileSearchOptions.maxFileSize;
+  j["unityProject"] = WideToString(m_unityProject);
 
   std::ofstream o("settings.json");
   o << j << std::endl;
@@ -882,8 +2370,66 @@ void EditorWindow::LoadSettings() {
     // Load language
     if (j.contains("language")) {
       m_currentLang = j["language"].get<std::string>();
-      UpdateMenus();
     }
+    if (j.contains("shareSubtrees")) {
+      m_shareSubtrees = j["shareSubtrees"].get<bool>();
+    }
+    if (j.contains("aliasExpansionBudget")) {
+      m_aliasBudget = j["aliasExpansionBudget"].get<size_t>();
+    }
+    if (j.contains("yamlIndent")) {
+      m_yamlOptions.indent = j["yamlIndent"].get<int>();
+      if (m_yamlOptions.indent < 1)
+        m_yamlOptions.indent = 2;
+    }
+    if (j.contains("yamlFlowThreshold")) {
+      m_yamlOptions.flowThreshold = j["yamlFlowThreshold"].get<size_t>();
+    }
+    if (j.contains("convertMetadata")) {
+      m_convertOptions.metadata = j["convertMetadata"].get<bool>();
+    }
+    if (j.contains("searchMatchCase")) {
+      m_searchOptions.matchCase = j["searchMatchCase"].get<bool>();
+    }
+    if (j.contains("searchWholeWord")) {
+      m_searchOptions.wholeWord = j["searchWholeWord"].get<bool>();
+    }
+    if (j.contains("searchRegex")) {
+      m_searchOptions.regex = j["searchRegex"].get<bool>();
+    }
+    if (j.contains("lintDuplicateKeys")) {
+      m_lintRules.duplicateKeys = j["lintDuplicateKeys"].get<bool>();
+    }
+    if (j.contains("lintTypeDrift")) {
+      m_lintRules.typeDrift = j["lintTypeDrift"].get<bool>();
+    }
+    if (j.contains("lintMaxDepth")) {
+      m_lintRules.maxDepth = j["lintMaxDepth"].get<size_t>();
+    }
+    if (j.contains("lintMaxScalarBytes")) {
+      m_lintRules.maxScalarBytes = j["lintMaxScalarBytes"].get<size_t>();
+    }
+    if (j.contains("findFolder")) {
+      m_fileSearchOptions.folder =
+          StringToWide(j["findFolder"].get<std::string>());
+    }
+    if (j.contains("findFilter")) {
+      m_fileSearchOptions.include =
+          StringToWide(j["findFilter"].get<std::string>());
+    }
+    if (j.contains("findExcludeFolders")) {
+      m_fileSearchOptions.excludeFolders =
+          StringToWide(j["findExcludeFolders"].get<std::string>());
+    }
+    if (j.contains("findMaxFileSize")) {
+      m_fileSearchOptions.maxFileSize = j["findMaxFileSize"].get<uint64_t>();
+    }
+    if (j.contains("unityProject")) {
+      m_unityProject = StringToWide(j["unityProject"].get<std::string>());
+      if (!m_unityProject.empty())
+        IndexUnityProject(false); // Refreshes the saved index
+    }
+    UpdateMenus();
 
     // Load files
     if (j.contains("files")) {
@@ -895,10 +2441,8 @@ void EditorWindow::LoadSettings() {
           std::vector<wchar_t> wbuf(len);
           MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, wbuf.data(), len);
           std::wstring wpath = wbuf.data();
-          if (std::filesystem::exists(wpath)) {
-            std::wstring content = FileUtils::ReadFileUtf8(wpath);
-            CreateNewTab(wpath, content);
-          }
+          if (std::filesystem::exists(wpath))
+            OpenPath(wpath);
         }
       }
     }
@@ -906,90 +2450,1224 @@ void EditorWindow::LoadSettings() {
   }
 }
 
-void EditorWindow::FormatJson() {
+// Shows a file open or save dialog. Returns false if it was cancelled.
+static bool PickFile(HWND owner, bool save, std::wstring &path) {
+  IFileDialog *pDialog;
+  HRESULT hr = CoCreateInstance(
+      save ? CLSID_FileSaveDialog : CLSID_FileOpenDialog, NULL, CLSCTX_ALL,
+      save ? IID_IFileSaveDialog : IID_IFileOpenDialog,
+      reinterpret_cast<void **>(&pDialog));
+  if (FAILED(hr))
+    return false;
+  bool picked = false;
+  if (SUCCEEDED(pDialog->Show(owner))) {
+    IShellItem *pItem;
+    if (SUCCEEDED(pDialog->GetResult(&pItem))) {
+      PWSTR pszFilePath;
+      if (SUCCEEDED(pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath))) {
+        path = pszFilePath;
+        picked = true;
+        CoTaskMemFree(pszFilePath);
+      }
+      pItem->Release();
+    }
+  }
+  pDialog->Release();
+  return picked;
+}
+
+// Shows a folder picker. Returns false if it was cancelled.
+static bool PickFolder(HWND owner, std::wstring &path) {
+  IFileOpenDialog *pDialog;
+  if (FAILED(CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL,
+                              IID_IFileOpenDialog,
+                              reinterpret_cast<void **>(&pDialog))))
+    return false;
+  DWORD options;
+  if (SUCCEEDED(pDialog->GetOptions(&options)))
+    pDialog->SetOptions(options | FOS_PICKFOLDERS);
+  bool picked = false;
+  if (SUCCEEDED(pDialog->Show(owner))) {
+    IShellItem *pItem;
+    if (SUCCEEDED(pDialog->GetResult(&pItem))) {
+      PWSTR pszPath;
+      if (SUCCEEDED(pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+        path = pszPath;
+        picked = true;
+        CoTaskMemFree(pszPath);
+      }
+      pItem->Release();
+    }
+  }
+  pDialog->Release();
+  return picked;
+}
+
+void EditorWindow::ConvertFile(int command) {
+  std::wstring source, target;
+  if (!PickFile(m_hwnd, false, source) || !PickFile(m_hwnd, true, target))
+    return;
+  if (source == target) {
+    MessageBox(m_hwnd, L"Choose a different file to write to.",
+               L"Convert Error", MB_OK | MB_ICONERROR);
+    return;
+  }
+
+  std::ifstream in(std::filesystem::path(source), std::ios::binary);
+  std::ofstream out(std::filesystem::path(target), std::ios::binary);
+  if (!in || !out) {
+    MessageBox(m_hwnd, L"Could not open the file.", L"Convert Error",
+               MB_OK | MB_ICONERROR);
+    return;
+  }
+
+  m_convertOptions.indent = m_yamlOptions.indent;
+  try {
+    switch (command) {
+    case IDM_CONVERT_YAML_TO_JSON:
+      StreamConverter::YamlToJson(in, out, StreamConverter::JSON,
+                                  m_convertOptions);
+      break;
+    case IDM_CONVERT_YAML_TO_JSONL:
+      StreamConverter::YamlToJson(in, out, StreamConverter::JSON_LINES,
+                                  m_convertOptions);
+      break;
+    case IDM_CONVERT_JSON_TO_YAML:
+      StreamConverter::JsonToYaml(in, out, StreamConverter::JSON,
+                                  m_convertOptions);
+      break;
+    case IDM_CONVERT_JSONL_TO_YAML:
+      StreamConverter::JsonToYaml(in, out, StreamConverter::JSON_LINES,
+                                  m_convertOptions);
+      break;
+    }
+  } catch (const std::exception &e) {
+    MessageBox(m_hwnd, StringToWide(e.what()).c_str(), L"Convert Error",
+               MB_OK | MB_ICONERROR);
+  }
+}
+
+void EditorWindow::ShowFindDialog() {
+  m_findDialog.Show(
+      m_hwnd,
+      [this](const std::string &key) { return GetLocalizedString(key); },
+      m_searchOptions, m_fileSearchOptions);
+  // Start from the selected text, as most editors do
   if (m_activePageIndex == -1)
     return;
   HWND hEdit = m_documents[m_activePageIndex].hEdit;
+  DWORD selStart, selEnd;
+  SendMessage(hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  if (selEnd > selStart && selEnd - selStart < 256) {
+    std::wstring selected = SearchText(m_documents[m_activePageIndex])
+                                ->substr(selStart, selEnd - selStart);
+    if (selected.find_first_of(L"\r\n") == std::wstring::npos)
+      SetDlgItemText(m_findDialog.Window(), IDC_FIND_TEXT, selected.c_str());
+  }
+  SendDlgItemMessage(m_findDialog.Window(), IDC_FIND_TEXT, EM_SETSEL, 0, -1);
+}
 
-  int len = GetWindowTextLength(hEdit);
-  if (len == 0)
+std::shared_ptr<const std::wstring> EditorWindow::SearchText(Document &doc) {
+  // The generation moves with every change the subclass or EN_CHANGE sees;
+  // the length check is a cheap guard against any change they miss, since
+  // ReplaceAll writes matches found in this copy back into the control
+  int len = GetWindowTextLength(doc.hEdit);
+  if (!doc.searchText || doc.searchGeneration != doc.generation ||
+      doc.searchText->size() != (size_t)len) {
+    auto text = std::make_shared<std::wstring>(len + 1, L'\0');
+    GetWindowText(doc.hEdit, &(*text)[0], len + 1);
+    text->resize(len);
+    doc.searchText = text;
+    doc.searchGeneration = doc.generation;
+    doc.unityRefs = nullptr; // Indexes the old text
+  }
+  return doc.searchText;
+}
+
+std::shared_ptr<const UnityRefIndex> EditorWindow::UnityRefs(Document &doc) {
+  std::shared_ptr<const std::wstring> text = SearchText(doc);
+  if (!doc.unityRefs)
+    doc.unityRefs =
+        std::make_shared<const UnityRefIndex>(text->data(), text->size());
+  return doc.unityRefs;
+}
+
+std::unique_ptr<SearchEngine> EditorWindow::CompileSearch() {
+  std::wstring pattern = m_findDialog.Pattern();
+  if (pattern.empty()) {
+    ShowFindDialog();
+    return nullptr;
+  }
+  m_searchOptions = m_findDialog.Options();
+  try {
+    return std::unique_ptr<SearchEngine>(
+        new SearchEngine(pattern, m_searchOptions));
+  } catch (const std::runtime_error &e) {
+    MessageBox(m_findDialog.Window(), StringToWide(e.what()).c_str(),
+               L"Search Error", MB_OK | MB_ICONERROR);
+    return nullptr;
+  }
+}
+
+void EditorWindow::SelectMatch(Document &doc, const SearchMatch &match) {
+  SendMessage(doc.hEdit, EM_SETSEL, match.start, match.start + match.length);
+  SendMessage(doc.hEdit, EM_SCROLLCARET, 0, 0);
+  UpdateLineNumbers(doc.hEdit);
+}
+
+void EditorWindow::FindNext() {
+  if (m_activePageIndex == -1)
+    return;
+  std::unique_ptr<SearchEngine> engine = CompileSearch();
+  if (!engine)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  std::shared_ptr<const std::wstring> text = SearchText(doc);
+
+  DWORD selStart, selEnd;
+  SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  // Wraps around to the top once
+  SearchMatch match;
+  bool found = engine->Find(text->data(), text->size(), selEnd, match);
+  if (found && match.length == 0 && match.start == selStart &&
+      selStart == selEnd)
+    found = engine->Find(text->data(), text->size(), selEnd + 1, match);
+  if (!found && selEnd > 0)
+    found = engine->Find(text->data(), text->size(), 0, match);
+  if (!found) {
+    m_findDialog.SetStatus(GetLocalizedString("NoMatches"));
+    MessageBeep(MB_OK);
+    return;
+  }
+  m_findDialog.SetStatus(L"");
+  SelectMatch(doc, match);
+}
+
+void EditorWindow::ReplaceOne() {
+  if (m_activePageIndex == -1)
+    return;
+  std::unique_ptr<SearchEngine> engine = CompileSearch();
+  if (!engine)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return; // Records are read-only
+  std::shared_ptr<const std::wstring> text = SearchText(doc);
+
+  // Replace the selection if it is a match, then move to the next one
+  DWORD selStart, selEnd;
+  SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  SearchMatch match;
+  if (engine->Find(text->data(), text->size(), selStart, match) &&
+      match.start == selStart && match.start + match.length == selEnd) {
+    std::wstring replacement = m_findDialog.Replacement();
+    SendMessage(doc.hEdit, EM_REPLACESEL, TRUE, (LPARAM)replacement.c_str());
+  }
+  FindNext();
+}
+
+void EditorWindow::ReplaceAll() {
+  if (m_activePageIndex == -1)
+    return;
+  std::unique_ptr<SearchEngine> engine = CompileSearch();
+  if (!engine)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return;
+  std::shared_ptr<const std::wstring> text = SearchText(doc);
+
+  std::vector<SearchMatch> matches;
+  engine->FindAll(text->data(), text->size(),
+                  [&](const std::vector<SearchMatch> &batch) {
+                    matches.insert(matches.end(), batch.begin(), batch.end());
+                    return true;
+                  });
+  if (matches.empty()) {
+    m_findDialog.SetStatus(GetLocalizedString("NoMatches"));
+    MessageBeep(MB_OK);
     return;
+  }
+
+  // One edit from the first match to the end of the last, so it is a
+  // single undo step and the control reflows once
+  size_t begin = matches.front().start;
+  size_t end = matches.back().start + matches.back().length;
+  std::wstring replaced = SearchEngine::Replace(
+      text->data(), begin, end, matches, m_findDialog.Replacement());
+  SendMessage(doc.hEdit, EM_SETSEL, begin, end);
+  SendMessage(doc.hEdit, EM_REPLACESEL, TRUE, (LPARAM)replaced.c_str());
+  SendMessage(doc.hEdit, EM_SETSEL, begin, begin + replaced.size());
+  SendMessage(doc.hEdit, EM_SCROLLCARET, 0, 0);
+  UpdateLineNumbers(doc.hEdit);
+  m_findDialog.SetStatus(std::to_wstring(matches.size()) +
+                         GetLocalizedString("Replaced"));
+}
+
+unsigned EditorWindow::BeginFind(std::vector<FindTarget> targets,
+                                 bool grouped) {
+  // Stop the previous search; its late results are dropped by id
+  if (m_findCancel)
+    *m_findCancel = true;
+  m_findCancel = std::make_shared<std::atomic<bool>>(false);
+  m_findTargets = std::move(targets);
+  m_findRows.clear();
+  m_findCount = 0;
+  m_findGrouped = grouped;
+  m_findDialog.ClearResults();
+  m_findDialog.SetStatus(GetLocalizedString("Searching"));
+  return ++m_findId;
+}
 
+void EditorWindow::FindAll() {
+  if (m_activePageIndex == -1)
+    return;
+  std::shared_ptr<SearchEngine> engine = CompileSearch();
+  if (!engine)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  unsigned searchId =
+      BeginFind({{doc.hEdit, doc.filePath, doc.fileName}}, false);
+
+  // The engine moves to the worker, which streams the matches in batches;
+  // only the listed ones are located
+  std::shared_ptr<const std::wstring> text = SearchText(doc);
+  HWND hwnd = m_hwnd;
+  std::shared_ptr<std::atomic<bool>> cancel = m_findCancel;
+  std::thread([hwnd, searchId, cancel, text, engine]() {
+    MatchLocator locator(text->data(), text->size());
+    size_t listed = 0;
+    engine->FindAll(
+        text->data(), text->size(), [&](const std::vector<SearchMatch> &batch) {
+          if (*cancel)
+            return false;
+          FileHits hits;
+          hits.source = 0;
+          hits.count = batch.size();
+          for (const SearchMatch &match : batch) {
+            if (listed == kMaxListedResults)
+              break;
+            listed++;
+            hits.matches.push_back(locator.Locate(match));
+          }
+          auto *result = new FindResults{searchId, {}, 0, false};
+          result->hits.push_back(std::move(hits));
+          return PostFindResults(hwnd, result);
+        });
+    if (!*cancel)
+      PostFindResults(hwnd, new FindResults{searchId, {}, 1, true});
+  }).detach();
+}
+
+void EditorWindow::FindInFiles(bool inFolder) {
+  if (!CompileSearch())
+    return;
+  m_fileSearchOptions.folder = m_findDialog.Folder();
+  m_fileSearchOptions.include = m_findDialog.Filter();
+  if (m_fileSearchOptions.include.empty())
+    m_fileSearchOptions.include = L"*";
+  if (inFolder && m_fileSearchOptions.folder.empty()) {
+    m_findDialog.SetStatus(GetLocalizedString("ChooseFolder"));
+    MessageBeep(MB_OK);
+    return;
+  }
+
+  // Open documents are searched as edited; the folder walk skips their
+  // files. JSON Lines tabs show one record, so their file is searched.
+  std::vector<FindTarget> targets;
+  std::vector<FileSearch::Source> sources;
+  for (auto &doc : m_documents) {
+    if (doc.jsonLines)
+      continue;
+    targets.push_back({doc.hEdit, doc.filePath,
+                       doc.filePath.empty() ? doc.fileName : doc.filePath});
+    sources.push_back({doc.filePath, SearchText(doc)});
+  }
+  FileSearchOptions fileOptions = m_fileSearchOptions;
+  if (!inFolder)
+    fileOptions.folder.clear();
+  unsigned searchId = BeginFind(std::move(targets), true);
+
+  HWND hwnd = m_hwnd;
+  std::shared_ptr<std::atomic<bool>> cancel = m_findCancel;
+  std::wstring pattern = m_findDialog.Pattern();
+  SearchOptions options = m_searchOptions;
+  std::thread([hwnd, searchId, cancel, sources, pattern, options,
+               fileOptions]() {
+    FileSearch search(pattern, options, fileOptions);
+    // Files with matches are posted in batches, at most every 100 ms
+    std::vector<FileHits> pending;
+    ULONGLONG lastPost = GetTickCount64();
+    size_t searched = search.Run(sources, *cancel, [&](FileHits &&hits) {
+      pending.push_back(std::move(hits));
+      if (GetTickCount64() - lastPost < 100 && pending.size() < 256)
+        return;
+      PostFindResults(hwnd,
+                      new FindResults{searchId, std::move(pending), 0, false});
+      pending.clear();
+      lastPost = GetTickCount64();
+    });
+    if (!*cancel)
+      PostFindResults(
+          hwnd, new FindResults{searchId, std::move(pending), searched, true});
+  }).detach();
+}
+
+void EditorWindow::OnFindResults(unsigned searchId, std::vector<FileHits> hits,
+                                 size_t searched, bool done) {
+  if (searchId != m_findId)
+    return; // From a search that was replaced
+  std::vector<std::wstring> labels;
+  for (const FileHits &file : hits) {
+    size_t target = file.source;
+    if (target == FileHits::kFile) {
+      target = m_findTargets.size();
+      m_findTargets.push_back({NULL, file.path, file.path});
+    }
+    m_findCount += file.count;
+    for (size_t i = 0;
+         i < file.matches.size() && m_findRows.size() < kMaxListedResults;
+         i++) {
+      const FileMatch &match = file.matches[i];
+      FindRow row = {target, match.line, match.column, match.length};
+      if (m_findGrouped && i == 0) {
+        // One heading per file, which goes to its first match
+        labels.push_back(m_findTargets[target].name + L" (" +
+                         std::to_wstring(file.count) + L")");
+        m_findRows.push_back(row);
+      }
+      labels.push_back((m_findGrouped ? L"    Ln " : L"Ln ") +
+                       std::to_wstring(match.line + 1) + L": " + match.text);
+      m_findRows.push_back(row);
+    }
+  }
+  m_findDialog.AddResults(labels);
+
+  std::wstring status;
+  if (m_findCount == 0) {
+    status = GetLocalizedString(done ? "NoMatches" : "Searching");
+  } else {
+    status = std::to_wstring(m_findCount) + GetLocalizedString("Matches");
+    if (m_findRows.size() >= kMaxListedResults)
+      status += GetLocalizedString("ListLimited");
+  }
+  if (done && m_findGrouped)
+    status += L", " + std::to_wstring(searched) +
+              GetLocalizedString("FilesSearched");
+  m_findDialog.SetStatus(status);
+}
+
+void EditorWindow::GoToFindResult() {
+  int index = m_findDialog.SelectedResult();
+  if (index < 0 || (size_t)index >= m_findRows.size())
+    return;
+  const FindRow &row = m_findRows[index];
+  FindTarget &target = m_findTargets[row.target];
+
+  // The tab may have been closed since, or the file not opened yet
+  int page = -1;
+  for (size_t i = 0; i < m_documents.size() && page == -1; i++) {
+    if ((target.hEdit && m_documents[i].hEdit == target.hEdit) ||
+        (!target.path.empty() &&
+         lstrcmpi(m_documents[i].filePath.c_str(), target.path.c_str()) == 0))
+      page = (int)i;
+  }
+  if (page == -1) {
+    if (target.path.empty())
+      return;
+    size_t count = m_documents.size();
+    OpenPath(target.path);
+    if (m_documents.size() == count)
+      return;
+    page = (int)count;
+  }
+  target.hEdit = m_documents[page].hEdit;
+  if (page != m_activePageIndex)
+    SwitchTab(page);
+
+  Document &doc = m_documents[page];
+  if (doc.jsonLines)
+    return; // The edit control holds a single record
+  LRESULT lineStart = SendMessage(doc.hEdit, EM_LINEINDEX, row.line, 0);
+  if (lineStart < 0)
+    return; // The text has lost lines since the search
+  SelectMatch(doc, {(size_t)lineStart + row.column, row.length});
+  SetFocus(doc.hEdit);
+}
+
+// The reference under the caret, or kNone
+static size_t RefAtCaret(HWND hEdit, const UnityRefIndex &refs) {
+  DWORD selStart, selEnd;
+  SendMessage(hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  LRESULT line = SendMessage(hEdit, EM_LINEFROMCHAR, selStart, 0);
+  size_t lineStart = (size_t)SendMessage(hEdit, EM_LINEINDEX, line, 0);
+  size_t lineLength = (size_t)SendMessage(hEdit, EM_LINELENGTH, lineStart, 0);
+  return refs.RefOnLine(lineStart, lineStart + lineLength, selStart);
+}
+
+void EditorWindow::GoToDefinition() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return;
+  std::shared_ptr<const UnityRefIndex> refs = UnityRefs(doc);
+  size_t ref = RefAtCaret(doc.hEdit, *refs);
+  if (ref != UnityRefIndex::kNone && refs->Refs()[ref].external) {
+    GoToAsset(doc, *refs, ref);
+    return;
+  }
+  size_t object = ref == UnityRefIndex::kNone
+                      ? UnityRefIndex::kNone
+                      : refs->Definition(refs->Refs()[ref].fileID);
+  if (object == UnityRefIndex::kNone) {
+    MessageBeep(MB_OK); // No reference here, or it is dangling or external
+    return;
+  }
+  size_t start = refs->Objects()[object].offset;
+  size_t length = (size_t)SendMessage(doc.hEdit, EM_LINELENGTH, start, 0);
+  SelectMatch(doc, {start, length});
+}
+
+void EditorWindow::FindReferences(bool dangling) {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return;
+  std::shared_ptr<const UnityRefIndex> refs = UnityRefs(doc);
+  if (refs->Empty()) {
+    MessageBeep(MB_OK); // Not a Unity file
+    return;
+  }
+
+  // References to the fileID under the caret, else to the object the
+  // caret is in
+  std::vector<size_t> found;
+  if (dangling) {
+    found = refs->Dangling();
+  } else {
+    size_t ref = RefAtCaret(doc.hEdit, *refs);
+    DWORD selStart, selEnd;
+    SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    size_t object = refs->ObjectAt(selStart);
+    if (ref != UnityRefIndex::kNone)
+      found = refs->References(refs->Refs()[ref].fileID);
+    else if (object != UnityRefIndex::kNone)
+      found = refs->References(refs->Objects()[object].fileID);
+    else {
+      MessageBeep(MB_OK);
+      return;
+    }
+  }
+
+  m_findDialog.Show(
+      m_hwnd,
+      [this](const std::string &key) { return GetLocalizedString(key); },
+      m_searchOptions, m_fileSearchOptions);
+  unsigned searchId =
+      BeginFind({{doc.hEdit, doc.filePath, doc.fileName}}, false);
+  std::shared_ptr<const std::wstring> text = SearchText(doc);
+  MatchLocator locator(text->data(), text->size());
+  FileHits hits;
+  hits.source = 0;
+  hits.count = found.size();
+  for (size_t i = 0; i < found.size() && i < kMaxListedResults; i++) {
+    const UnityRef &ref = refs->Refs()[found[i]];
+    hits.matches.push_back(locator.Locate({ref.offset, ref.length}));
+  }
+  OnFindResults(searchId, {std::move(hits)}, 1, true);
+}
+
+// The GUID after the first "guid:" in [from, end of its line).
+static bool GuidOnLine(const std::wstring &text, size_t from, Guid &guid) {
+  size_t lineEnd = text.find_first_of(L"\r\n", from);
+  if (lineEnd == std::wstring::npos)
+    lineEnd = text.size();
+  size_t key = text.find(L"guid:", from);
+  if (key == std::wstring::npos || key >= lineEnd)
+    return false;
+  size_t p = key + 5;
+  while (p < lineEnd && text[p] == L' ')
+    p++;
+  return Guid::Parse(text.data() + p, lineEnd - p, guid) && !guid.Empty();
+}
+
+void EditorWindow::GoToAsset(Document &doc, const UnityRefIndex &refs,
+                             size_t ref) {
+  int64_t fileID = refs.Refs()[ref].fileID;
+  Guid guid;
+  if (!GuidOnLine(*SearchText(doc), refs.Refs()[ref].key, guid)) {
+    MessageBeep(MB_OK);
+    return;
+  }
+  if (!m_guidIndex) {
+    MessageBox(m_hwnd, GetLocalizedString("NoGuidIndex").c_str(),
+               L"JYEditor", MB_OK | MB_ICONINFORMATION);
+    return;
+  }
+  std::wstring path = m_guidIndex->AssetPath(guid);
+  std::error_code ec;
+  if (path.empty() || !std::filesystem::is_regular_file(path, ec)) {
+    MessageBeep(MB_OK); // Unknown GUID, a folder, or a built-in asset
+    return;
+  }
+  {
+    // Textures, models and other binary assets open as their .meta file
+    MappedFile asset(path);
+    if (!asset.Data() ||
+        memchr(asset.Data(), 0, std::min<size_t>(asset.Size(), 8000)))
+      path += L".meta";
+  }
+
+  // doc is not used past here: opening a tab moves the documents
+  int page = -1;
+  for (size_t i = 0; i < m_documents.size() && page == -1; i++)
+    if (lstrcmpi(m_documents[i].filePath.c_str(), path.c_str()) == 0)
+      page = (int)i;
+  if (page == -1) {
+    size_t count = m_documents.size();
+    OpenPath(path);
+    if (m_documents.size() == count)
+      return;
+    page = (int)count;
+  }
+  if (page != m_activePageIndex)
+    SwitchTab(page);
+  Document &asset = m_documents[page];
+  if (asset.jsonLines)
+    return;
+  std::shared_ptr<const UnityRefIndex> assetRefs = UnityRefs(asset);
+  size_t object = assetRefs->Definition(fileID);
+  if (object != UnityRefIndex::kNone) {
+    size_t start = assetRefs->Objects()[object].offset;
+    size_t length = (size_t)SendMessage(asset.hEdit, EM_LINELENGTH, start, 0);
+    SelectMatch(asset, {start, length});
+  }
+  SetFocus(asset.hEdit);
+}
+
+void EditorWindow::IndexUnityProject(bool pick) {
+  if (pick) {
+    std::wstring folder;
+    if (!PickFolder(m_hwnd, folder))
+      return;
+    m_unityProject = folder;
+    m_findDialog.Show(
+        m_hwnd,
+        [this](const std::string &key) { return GetLocalizedString(key); },
+        m_searchOptions, m_fileSearchOptions);
+    m_findDialog.SetStatus(GetLocalizedString("Indexing"));
+  }
+  if (m_guidIndexCancel)
+    *m_guidIndexCancel = true;
+  m_guidIndexCancel = std::make_shared<std::atomic<bool>>(false);
+  unsigned indexId = ++m_guidIndexId;
+
+  // The current index, else the saved one, supplies the files that have
+  // not changed; the index is only used once complete
+  HWND hwnd = m_hwnd;
+  std::wstring root = m_unityProject;
+  std::shared_ptr<const GuidIndex> previous = m_guidIndex;
+  std::shared_ptr<std::atomic<bool>> cancel = m_guidIndexCancel;
+  std::thread([hwnd, indexId, pick, root, previous, cancel]() {
+    ULONGLONG start = GetTickCount64();
+    std::shared_ptr<const GuidIndex> base = previous;
+    if (!base)
+      base = GuidIndex::Load(kGuidIndexFile);
+    auto *result = new GuidIndexResult{indexId, pick};
+    result->index.reset(
+        new GuidIndex(root, GuidIndexOptions(), base.get(), *cancel));
+    if (*cancel) {
+      delete result;
+      return;
+    }
+    result->index->Save(kGuidIndexFile);
+    result->ms = GetTickCount64() - start;
+    if (!PostMessage(hwnd, WM_GUID_INDEXED, 0, (LPARAM)result))
+      delete result;
+  }).detach();
+}
+
+void EditorWindow::OnGuidIndexed(GuidIndexResult &result) {
+  if (result.indexId != m_guidIndexId)
+    return; // From an indexing run that was replaced
+  m_guidIndexCancel = nullptr;
+  m_guidIndex = std::move(result.index);
+  if (result.announce)
+    m_findDialog.SetStatus(
+        std::to_wstring(m_guidIndex->FileCount()) +
+        GetLocalizedString("FilesIndexed") + L", " +
+        std::to_wstring(m_guidIndex->Rescanned()) +
+        GetLocalizedString("Rescanned") + L", " +
+        std::to_wstring(result.ms) + L" ms");
+}
+
+void EditorWindow::FindAssetReferences() {
+  if (m_activePageIndex == -1)
+    return;
+  if (!m_guidIndex) {
+    MessageBox(m_hwnd, GetLocalizedString("NoGuidIndex").c_str(),
+               L"JYEditor", MB_OK | MB_ICONINFORMATION);
+    return;
+  }
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return;
+
+  // The GUID on the caret line, else that of the file itself (or of the
+  // asset, for a .meta file)
+  Guid guid;
+  DWORD selStart, selEnd;
+  SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  LRESULT line = SendMessage(doc.hEdit, EM_LINEFROMCHAR, selStart, 0);
+  size_t lineStart = (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, line, 0);
+  if (!GuidOnLine(*SearchText(doc), lineStart, guid)) {
+    std::wstring path = doc.filePath;
+    if (path.size() > 5 &&
+        lstrcmpi(path.c_str() + path.size() - 5, L".meta") == 0)
+      path.resize(path.size() - 5);
+    guid = m_guidIndex->GuidOf(path);
+  }
+  if (guid.Empty()) {
+    MessageBeep(MB_OK);
+    return;
+  }
+
+  // The referencing files are searched for the GUID to list the lines;
+  // open tabs are searched as edited, as in Find in Files
+  std::vector<FindTarget> targets;
+  std::vector<FileSearch::Source> sources;
+  for (auto &other : m_documents) {
+    if (other.jsonLines)
+      continue;
+    targets.push_back({other.hEdit, other.filePath,
+                       other.filePath.empty() ? other.fileName
+                                              : other.filePath});
+    sources.push_back({other.filePath, SearchText(other)});
+  }
+  FileSearchOptions fileOptions;
+  fileOptions.files = m_guidIndex->Referrers(guid);
+  m_findDialog.Show(
+      m_hwnd,
+      [this](const std::string &key) { return GetLocalizedString(key); },
+      m_searchOptions, m_fileSearchOptions);
+  unsigned searchId = BeginFind(std::move(targets), true);
+
+  HWND hwnd = m_hwnd;
+  std::shared_ptr<std::atomic<bool>> cancel = m_findCancel;
+  std::wstring pattern = guid.ToString();
+  std::thread([hwnd, searchId, cancel, sources, pattern, fileOptions]() {
+    FileSearch search(pattern, SearchOptions(), fileOptions);
+    std::vector<FileHits> found;
+    size_t searched = search.Run(sources, *cancel, [&](FileHits &&hits) {
+      found.push_back(std::move(hits));
+    });
+    if (!*cancel)
+      PostFindResults(
+          hwnd, new FindResults{searchId, std::move(found), searched, true});
+  }).detach();
+}
+
+void EditorWindow::RunQuery() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  int len = GetWindowTextLength(m_hQueryEdit);
   std::vector<wchar_t> buffer(len + 1);
-  GetWindowText(hEdit, buffer.data(), len + 1);
+  GetWindowText(m_hQueryEdit, buffer.data(), len + 1);
+  std::wstring expression = buffer.data();
+  if (expression.empty())
+    return;
 
-  // Convert to UTF-8 for parsing
-  int utf8Len =
-      WideCharToMultiByte(CP_UTF8, 0, buffer.data(), -1, NULL, 0, NULL, NULL);
-  std::vector<char> utf8Buf(utf8Len + 1); // +1 for safety
-  WideCharToMultiByte(CP_UTF8, 0, buffer.data(), -1, utf8Buf.data(), utf8Len,
-                      NULL, NULL);
-  utf8Buf[utf8Len] = 0; // Ensure null terminated
+  if (doc.treeGeneration != doc.generation)
+    UpdateTreeFromText();
+  if (!doc.model || !doc.sourceLines) {
+    MessageBox(m_hwnd, L"This tab has no YAML or JSON document to query.",
+               L"Query Error", MB_OK | MB_ICONERROR);
+    return;
+  }
+  std::shared_ptr<JsonPath> query;
+  try {
+    query = std::make_shared<JsonPath>(WideToString(expression));
+  } catch (const std::exception &e) {
+    MessageBox(m_hwnd, StringToWide(e.what()).c_str(), L"Query Error",
+               MB_OK | MB_ICONERROR);
+    return;
+  }
+
+  if (doc.queryCancel)
+    *doc.queryCancel = true;
+  doc.queryCancel = std::make_shared<std::atomic<bool>>(false);
+  unsigned queryId = doc.queryId = ++m_runId;
+  DeleteQueryItems(doc.hTree);
+  HTREEITEM hRoot = InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST,
+                                    L"Query: " + expression + L" (running...)",
+                                    -1);
+  TreeView_EnsureVisible(doc.hTree, hRoot);
+
+  // The model is immutable, so the worker reads it while the tab is edited
+  HWND hwnd = m_hwnd;
+  HWND hEdit = doc.hEdit;
+  ModelPtr model = doc.model;
+  std::shared_ptr<const std::vector<int>> lines = doc.sourceLines;
+  bool multiDocument = doc.multiDocument;
+  std::shared_ptr<std::atomic<bool>> cancel = doc.queryCancel;
+  std::thread([hwnd, hEdit, queryId, expression, query, model, lines,
+               multiDocument, cancel]() {
+    ULONGLONG start = GetTickCount64();
+    auto *result = new QueryResults{queryId, hEdit, expression};
+    result->results = query->Evaluate(model, cancel.get(), kMaxQueryResults,
+                                      &result->complete);
+    NodeNumbering numbering(model, multiDocument);
+    for (const QueryResult &node : result->results) {
+      size_t number = numbering.Find(node.path);
+      result->lines.push_back(number < lines->size() ? (*lines)[number] : -1);
+    }
+    result->cancelled = *cancel;
+    result->ms = GetTickCount64() - start;
+    if (!PostMessage(hwnd, WM_QUERY_RESULTS, 0, (LPARAM)result))
+      delete result;
+  }).detach();
+}
+
+void EditorWindow::CancelQuery() {
+  if (m_activePageIndex == -1) {
+    SetWindowText(m_hQueryEdit, L"");
+    return;
+  }
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.queryCancel) {
+    *doc.queryCancel = true; // The partial results still arrive
+    return;
+  }
+  SetWindowText(m_hQueryEdit, L"");
+  DeleteQueryItems(doc.hTree);
+  SetFocus(doc.hEdit);
+}
 
+void EditorWindow::OnQueryResults(QueryResults &result) {
+  for (auto &doc : m_documents) {
+    if (doc.hEdit != result.hEdit)
+      continue;
+    if (result.queryId != doc.queryId)
+      return; // From a query that was replaced
+    doc.queryCancel = nullptr;
+    std::wstring label = L"Query: " + result.expression + L" (" +
+                         std::to_wstring(result.results.size()) +
+                         L" results, " + std::to_wstring(result.ms) + L" ms";
+    if (result.cancelled)
+      label += L", cancelled";
+    else if (!result.complete)
+      label += L", first " + std::to_wstring(kMaxQueryResults);
+    label += L")";
+
+    SendMessage(doc.hTree, WM_SETREDRAW, FALSE, 0);
+    DeleteQueryItems(doc.hTree);
+    HTREEITEM hRoot =
+        InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST, label, -1);
+    for (size_t i = 0; i < result.results.size(); i++)
+      InsertQueryItem(doc.hTree, hRoot, TVI_LAST,
+                      QueryResultLabel(result.results[i], result.lines[i]),
+                      result.lines[i]);
+    TreeView_Expand(doc.hTree, hRoot, TVE_EXPAND);
+    SendMessage(doc.hTree, WM_SETREDRAW, TRUE, 0);
+    TreeView_EnsureVisible(doc.hTree, hRoot);
+    return;
+  }
+}
+
+// Selects the source line of the selected query result.
+void EditorWindow::ShowQueryResult(HTREEITEM hItem) {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  TVITEMW item = {0};
+  item.hItem = hItem;
+  item.mask = TVIF_PARAM;
+  if (!SendMessage(doc.hTree, TVM_GETITEMW, 0, (LPARAM)&item) || !item.lParam)
+    return;
+  TreeItemData *pData = (TreeItemData *)item.lParam;
+  if (!pData->isQueryResult || pData->sourceLine < 0)
+    return;
+  LRESULT lineStart =
+      SendMessage(doc.hEdit, EM_LINEINDEX, pData->sourceLine, 0);
+  if (lineStart < 0)
+    return; // The text has lost lines since the query
+  LRESULT length = SendMessage(doc.hEdit, EM_LINELENGTH, lineStart, 0);
+  SelectMatch(doc, {(size_t)lineStart, (size_t)length});
+}
+
+// Reads a JSON or YAML schema file and compiles it. Throws std::exception.
+static std::shared_ptr<const JsonSchema> LoadSchema(const std::wstring &path) {
+  std::istringstream in(WideToString(FileUtils::ReadFileUtf8(path)));
+  std::vector<ModelPtr> roots = Model::ParseYaml(in);
+  if (roots.empty())
+    throw std::runtime_error("The schema file is empty or unreadable.");
+  return std::make_shared<const JsonSchema>(Model::ToJson(roots[0]));
+}
+
+void EditorWindow::PickSchema() {
+  if (m_activePageIndex == -1)
+    return;
+  std::wstring path;
+  if (!PickFile(m_hwnd, false, path))
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  try {
+    doc.schema = LoadSchema(path);
+  } catch (const std::exception &e) {
+    MessageBox(m_hwnd, StringToWide(e.what()).c_str(), L"Schema Error",
+               MB_OK | MB_ICONERROR);
+    return;
+  }
+  doc.schemaPath = path;
+  doc.schemaCache = std::make_shared<JsonSchema::Cache>();
+  UpdateTreeFromText(); // Validates
+}
+
+// Loads the schema named by the root's "$schema" if it is a local path,
+// relative to the document's folder. Web URLs are not fetched.
+void EditorWindow::LoadDeclaredSchema(Document &doc) {
+  ModelPtr root = doc.multiDocument ? Model::Item(doc.model, 0) : doc.model;
+  root = Model::Resolve(root);
+  if (!root || root->kind != ModelNode::OBJECT)
+    return;
+  int key = root->FindKey("$schema");
+  if (key < 0 || root->items[key]->kind != ModelNode::STRING ||
+      root->items[key]->Text().find("://") != std::string::npos)
+    return;
+  std::filesystem::path path(StringToWide(root->items[key]->Text()));
+  if (path.is_relative() && !doc.filePath.empty())
+    path = std::filesystem::path(doc.filePath).parent_path() / path;
+  doc.schemaPath = path.wstring();
   try {
-    auto j = json::parse(utf8Buf.data());
-    std::string formatted = j.dump(4);
+    doc.schema = LoadSchema(doc.schemaPath);
+    doc.schemaCache = std::make_shared<JsonSchema::Cache>();
+  } catch (const std::exception &e) {
+    InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST,
+                    L"Schema: " + GetFileNameFromPath(doc.schemaPath) +
+                        L": " + StringToWide(e.what()),
+                    -1, TreeItemData::SCHEMA);
+  }
+}
+
+void EditorWindow::ValidateSchema(Document &doc) {
+  if (doc.schemaCancel)
+    *doc.schemaCancel = true;
+  doc.schemaCancel = std::make_shared<std::atomic<bool>>(false);
+  unsigned schemaId = doc.schemaId = ++m_runId;
+  DeleteQueryItems(doc.hTree, TreeItemData::SCHEMA);
+  InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST,
+                  L"Schema: " + GetFileNameFromPath(doc.schemaPath) +
+                      L" (validating...)",
+                  -1, TreeItemData::SCHEMA);
+
+  // As for queries, the worker reads the immutable model. Validations of
+  // one schema take turns, so the cache is never used by two at once.
+  HWND hwnd = m_hwnd;
+  HWND hEdit = doc.hEdit;
+  std::shared_ptr<const JsonSchema> schema = doc.schema;
+  std::shared_ptr<JsonSchema::Cache> cache = doc.schemaCache;
+  ModelPtr model = doc.model;
+  std::shared_ptr<const std::vector<int>> lines = doc.sourceLines;
+  bool multiDocument = doc.multiDocument;
+  std::shared_ptr<std::atomic<bool>> cancel = doc.schemaCancel;
+  std::thread([hwnd, hEdit, schemaId, schema, cache, model, lines,
+               multiDocument, cancel]() {
+    ULONGLONG start = GetTickCount64();
+    auto *result = new SchemaResults{schemaId, hEdit};
+    result->errors =
+        schema->Validate(model, multiDocument, cache.get(), cancel.get(),
+                         kMaxSchemaErrors, &result->complete);
+    NodeNumbering numbering(model, multiDocument);
+    for (const SchemaError &error : result->errors) {
+      size_t number = numbering.Find(error.path);
+      result->lines.push_back(number < lines->size() ? (*lines)[number] : -1);
+    }
+    result->cancelled = *cancel;
+    result->ms = GetTickCount64() - start;
+    if (!PostMessage(hwnd, WM_SCHEMA_VALIDATED, 0, (LPARAM)result))
+      delete result;
+  }).detach();
+}
+
+void EditorWindow::OnSchemaValidated(SchemaResults &result) {
+  for (auto &doc : m_documents) {
+    if (doc.hEdit != result.hEdit)
+      continue;
+    if (result.schemaId != doc.schemaId)
+      return; // From a validation that was replaced
+    doc.schemaCancel = nullptr;
+    std::wstring label = L"Schema: " + GetFileNameFromPath(doc.schemaPath) +
+                         L" (" +
+                         (result.errors.empty()
+                              ? std::wstring(L"valid")
+                              : std::to_wstring(result.errors.size()) +
+                                    L" errors") +
+                         L", " + std::to_wstring(result.ms) + L" ms";
+    if (result.cancelled)
+      label += L", cancelled";
+    else if (!result.complete)
+      label += L", first " + std::to_wstring(kMaxSchemaErrors);
+    label += L")";
+
+    SendMessage(doc.hTree, WM_SETREDRAW, FALSE, 0);
+    DeleteQueryItems(doc.hTree, TreeItemData::SCHEMA);
+    HTREEITEM hRoot = InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST, label,
+                                      -1, TreeItemData::SCHEMA);
+    for (size_t i = 0; i < result.errors.size(); i++) {
+      const SchemaError &error = result.errors[i];
+      std::wstring text = StringToWide(error.path.empty() ? "/" : error.path);
+      if (result.lines[i] >= 0)
+        text += L" (Ln " + std::to_wstring(result.lines[i]) + L")";
+      text += L": " + StringToWide(error.message);
+      InsertQueryItem(doc.hTree, hRoot, TVI_LAST, text, result.lines[i],
+                      TreeItemData::SCHEMA);
+    }
+    TreeView_Expand(doc.hTree, hRoot, TVE_EXPAND);
+    SendMessage(doc.hTree, WM_SETREDRAW, TRUE, 0);
+    return;
+  }
+}
+
+void EditorWindow::Lint() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return; // Records are validated as they are indexed
+
+  if (doc.lintCancel)
+    *doc.lintCancel = true;
+  doc.lintCancel = std::make_shared<std::atomic<bool>>(false);
+  unsigned lintId = doc.lintId = ++m_runId;
+  DeleteQueryItems(doc.hTree, TreeItemData::LINT);
+  HTREEITEM hRoot = InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST,
+                                    L"Lint (running...)", -1,
+                                    TreeItemData::LINT);
+  TreeView_EnsureVisible(doc.hTree, hRoot);
+
+  // The parser reads a copy of the text, so the tab can be edited meanwhile
+  HWND hwnd = m_hwnd;
+  HWND hEdit = doc.hEdit;
+  auto text = std::make_shared<std::string>(GetEditTextUtf8(hEdit));
+  LintRules rules = m_lintRules;
+  std::shared_ptr<std::atomic<bool>> cancel = doc.lintCancel;
+  std::thread([hwnd, hEdit, lintId, text, rules, cancel]() {
+    ULONGLONG start = GetTickCount64();
+    auto *result = new LintResults{lintId, hEdit};
+    std::istringstream in(*text);
+    result->diagnostics = YamlLint::Run(in, rules, cancel.get(),
+                                        kMaxLintResults, &result->complete);
+    result->cancelled = *cancel;
+    result->ms = GetTickCount64() - start;
+    if (!PostMessage(hwnd, WM_LINT_RESULTS, 0, (LPARAM)result))
+      delete result;
+  }).detach();
+}
+
+void EditorWindow::OnLintResults(LintResults &result) {
+  for (auto &doc : m_documents) {
+    if (doc.hEdit != result.hEdit)
+      continue;
+    if (result.lintId != doc.lintId)
+      return; // From a lint that was replaced
+    doc.lintCancel = nullptr;
+    std::wstring label =
+        L"Lint (" + std::to_wstring(result.diagnostics.size()) +
+        L" problems, " + std::to_wstring(result.ms) + L" ms";
+    if (result.cancelled)
+      label += L", cancelled";
+    else if (!result.complete)
+      label += L", first " + std::to_wstring(kMaxLintResults);
+    label += L")";
+
+    SendMessage(doc.hTree, WM_SETREDRAW, FALSE, 0);
+    DeleteQueryItems(doc.hTree, TreeItemData::LINT);
+    HTREEITEM hRoot = InsertQueryItem(doc.hTree, TVI_ROOT, TVI_FIRST, label,
+                                      -1, TreeItemData::LINT);
+    for (const LintDiagnostic &diagnostic : result.diagnostics) {
+      std::wstring text =
+          StringToWide(diagnostic.path.empty() ? "/" : diagnostic.path);
+      if (diagnostic.line >= 0)
+        text += L" (Ln " + std::to_wstring(diagnostic.line) + L")";
+      text += L": " + StringToWide(diagnostic.message);
+      InsertQueryItem(doc.hTree, hRoot, TVI_LAST, text, diagnostic.line,
+                      TreeItemData::LINT);
+    }
+    TreeView_Expand(doc.hTree, hRoot, TVE_EXPAND);
+    SendMessage(doc.hTree, WM_SETREDRAW, TRUE, 0);
+    TreeView_EnsureVisible(doc.hTree, hRoot);
+    return;
+  }
+}
+
+void EditorWindow::FormatJson(bool minify) {
+  if (m_activePageIndex == -1)
+    return;
+  HWND hEdit = m_documents[m_activePageIndex].hEdit;
 
-    // Convert back to Wide
-    int wLen = MultiByteToWideChar(CP_UTF8, 0, formatted.c_str(), -1, NULL, 0);
-    std::vector<wchar_t> wOut(wLen + 1);
-    MultiByteToWideChar(CP_UTF8, 0, formatted.c_str(), -1, wOut.data(), wLen);
-    wOut[wLen] = 0;
+  std::string utf8 = GetEditTextUtf8(hEdit);
+  if (utf8.empty())
+    return;
 
-    std::wstring wFormatted = FileUtils::NormalizeToCrlf(wOut.data());
-    SetWindowText(hEdit, wFormatted.c_str());
+  try {
+    // Streams tokens straight to the output: key order and number spelling
+    // are kept, and the output already uses CRLF.
+    std::string formatted =
+        minify ? JsonFormatter::Minify(utf8.data(), utf8.size())
+               : JsonFormatter::Format(utf8.data(), utf8.size(), 4);
+    utf8.clear();
+    utf8.shrink_to_fit();
+
+    SetEditTextUtf8(hEdit, formatted);
     UpdateTreeFromText();
-  } catch (json::parse_error &e) {
+  } catch (std::runtime_error &e) {
     std::string err = e.what();
     std::wstring wErr(err.begin(), err.end());
     MessageBox(m_hwnd, wErr.c_str(), L"JSON Parse Error", MB_OK | MB_ICONERROR);
   }
 }
 
-#include <yaml-cpp/yaml.h>
-
 void EditorWindow::FormatYaml() {
   if (m_activePageIndex == -1)
     return;
   HWND hEdit = m_documents[m_activePageIndex].hEdit;
 
-  int len = GetWindowTextLength(hEdit);
-  if (len == 0)
+  std::string utf8 = GetEditTextUtf8(hEdit);
+  if (utf8.empty())
     return;
 
-  std::vector<wchar_t> buffer(len + 1);
-  GetWindowText(hEdit, buffer.data(), len + 1);
+  // Re-indents the text line by line: comments, tags, anchors and every
+  // document of the stream are kept.
+  std::string formatted = YamlFormatter::Format(utf8.data(), utf8.size(),
+                                                m_yamlOptions.indent);
+  utf8.clear();
+  utf8.shrink_to_fit();
 
-  // Convert to UTF-8
-  int utf8Len =
-      WideCharToMultiByte(CP_UTF8, 0, buffer.data(), -1, NULL, 0, NULL, NULL);
-  std::vector<char> utf8Buf(utf8Len + 1);
-  WideCharToMultiByte(CP_UTF8, 0, buffer.data(), -1, utf8Buf.data(), utf8Len,
-                      NULL, NULL);
-  utf8Buf[utf8Len] = 0;
-
-  try {
-    YAML::Node node = YAML::Load(utf8Buf.data());
-    YAML::Emitter out;
-    out.SetIndent(2);
-    out << node;
+  SetEditTextUtf8(hEdit, formatted);
+  UpdateTreeFromText();
+}
 
-    std::string formatted = out.c_str();
+void EditorWindow::FormatRange(bool selectionOnly) {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
 
-    // Convert back to Wide
-    int wLen = MultiByteToWideChar(CP_UTF8, 0, formatted.c_str(), -1, NULL, 0);
-    std::vector<wchar_t> wOut(wLen + 1);
-    MultiByteToWideChar(CP_UTF8, 0, formatted.c_str(), -1, wOut.data(), wLen);
-    wOut[wLen] = 0;
+  int len = GetWindowTextLength(doc.hEdit);
+  if (len == 0)
+    return;
+  std::vector<wchar_t> wText(len + 1);
+  GetWindowText(doc.hEdit, wText.data(), len + 1);
+  std::string utf8 = WideToString(wText.data());
+
+  DWORD selStart = 0, selEnd = 0;
+  SendMessage(doc.hEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+  size_t begin = Utf8Offset(wText.data(), selStart);
+  size_t end = Utf8Offset(wText.data(), selEnd);
+
+  // Indentation of the line containing pos
+  auto lineIndent = [&](size_t pos) {
+    size_t start = pos;
+    while (start > 0 && utf8[start - 1] != '\n')
+      start--;
+    size_t col = 0;
+    while (start + col < utf8.size() && utf8[start + col] == ' ')
+      col++;
+    return col;
+  };
 
-    std::wstring wFormatted = FileUtils::NormalizeToCrlf(wOut.data());
-    SetWindowText(hEdit, wFormatted.c_str());
-    UpdateTreeFromText();
-  } catch (YAML::Exception &e) {
+  std::string formatted;
+  try {
+    if (doc.format == Document::FMT_JSON) {
+      if (selectionOnly) {
+        while (begin < end && isspace((unsigned char)utf8[begin]))
+          begin++;
+        while (end > begin && isspace((unsigned char)utf8[end - 1]))
+          end--;
+      } else {
+        // The innermost brackets around the caret, found through the
+        // highlighter's structure index; without any, the whole text
+        size_t line =
+            (size_t)SendMessage(doc.hEdit, EM_LINEFROMCHAR, selStart, 0);
+        size_t column =
+            selStart - (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, line, 0);
+        SyntaxHighlighter *highlighter = Highlighter(doc);
+        std::unique_ptr<SyntaxHighlighter> json; // The tab has no language
+        if (!highlighter) {
+          json = std::make_unique<SyntaxHighlighter>(
+              SyntaxHighlighter::JSON,
+              (size_t)SendMessage(doc.hEdit, EM_GETLINECOUNT, 0, 0));
+          highlighter = json.get();
+        }
+        EditBuffer buffer(doc.hEdit);
+        size_t openLine, openColumn, closeLine, closeColumn;
+        if (buffer.Text() &&
+            highlighter->EnclosingBrackets(line, column, buffer.Reader(),
+                                           openLine, openColumn, closeLine,
+                                           closeColumn)) {
+          size_t open =
+              (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, openLine, 0);
+          size_t close =
+              (size_t)SendMessage(doc.hEdit, EM_LINEINDEX, closeLine, 0);
+          begin = Utf8Offset(wText.data(), open + openColumn);
+          end = Utf8Offset(wText.data(), close + closeColumn) + 1;
+        } else {
+          begin = 0;
+          end = utf8.size();
+          while (begin < end && isspace((unsigned char)utf8[begin]))
+            begin++;
+          while (end > begin && isspace((unsigned char)utf8[end - 1]))
+            end--;
+        }
+      }
+      if (begin == end)
+        return;
+      formatted = JsonFormatter::Format(utf8.data() + begin, end - begin, 4,
+                                        "\r\n", lineIndent(begin));
+    } else {
+      size_t column;
+      if (selectionOnly) {
+        // Whole lines of the selection
+        if (end > begin && utf8[end - 1] == '\n')
+          end--;
+        while (begin > 0 && utf8[begin - 1] != '\n')
+          begin--;
+        while (end < utf8.size() && utf8[end] != '\r' && utf8[end] != '\n')
+          end++;
+        size_t first = begin;
+        while (first < end && isspace((unsigned char)utf8[first]))
+          first++;
+        column = lineIndent(first);
+      } else {
+        YamlFormatter::FindEnclosing(utf8.data(), utf8.size(), begin, begin,
+                                     end, column);
+      }
+      if (begin == end)
+        return;
+      formatted = YamlFormatter::Format(utf8.data() + begin, end - begin,
+                                        m_yamlOptions.indent, "\r\n", column);
+    }
+  } catch (std::runtime_error &e) {
     std::string err = e.what();
     std::wstring wErr(err.begin(), err.end());
-    MessageBox(m_hwnd, wErr.c_str(), L"YAML Parse Error", MB_OK | MB_ICONERROR);
+    MessageBox(m_hwnd, wErr.c_str(), L"JSON Parse Error", MB_OK | MB_ICONERROR);
+    return;
   }
+
+  if (utf8.compare(begin, end - begin, formatted) == 0)
+    return;
+
+  // Replace just the span, as one undoable edit
+  size_t wBegin = WideOffset(utf8.data(), begin);
+  size_t wEnd = wBegin + WideOffset(utf8.data() + begin, end - begin);
+  std::wstring wFormatted = StringToWide(formatted);
+  SendMessage(doc.hEdit, EM_SETSEL, wBegin, wEnd);
+  SendMessage(doc.hEdit, EM_REPLACESEL, TRUE, (LPARAM)wFormatted.c_str());
+  SendMessage(doc.hEdit, EM_SETSEL, wBegin, wBegin + wFormatted.size());
+  SendMessage(doc.hEdit, EM_SCROLLCARET, 0, 0);
+  UpdateLineNumbers(doc.hEdit);
 }
 
 void EditorWindow::UpdateTreeFromText() {
@@ -998,12 +3676,16 @@ void EditorWindow::UpdateTreeFromText() {
 
   Document &doc = m_documents[m_activePageIndex];
   HWND hEdit = doc.hEdit;
+  doc.treeGeneration = doc.generation;
+  if (doc.jsonLines)
+    return; // The record tree is built on open; the text is a preview
 
   int len = GetWindowTextLength(hEdit);
   if (len == 0) {
     TreeView_DeleteAllItems(m_hTreeView);
     doc.format = Document::FMT_TEXT;
-    doc.jsonData = json(); // Clear model
+    doc.model = nullptr; // Clear model
+    doc.firstMatch = NULL;
     return;
   }
 
@@ -1020,17 +3702,20 @@ void EditorWindow::UpdateTreeFromText() {
 
   // Unified Parsing using YAML parser (supports JSON and provides line numbers)
   try {
-    std::vector<YAML::Node> nodes = YAML::LoadAll(utf8Buf.data());
-    if (!nodes.empty()) {
-      // Build JSON model from YAML nodes
-      if (nodes.size() == 1) {
-        doc.jsonData = YamlToJson(nodes[0]);
-      } else {
-        doc.jsonData = json::array();
-        for (const auto &n : nodes) {
-          doc.jsonData.push_back(YamlToJson(n));
-        }
-      }
+    // Build model from parser events. The interner outlives each parse, so
+    // subtrees that did not change keep their identity across reparses.
+    ModelInterner *interner = nullptr;
+    if (m_shareSubtrees) {
+      if (!doc.interner)
+        doc.interner = std::make_shared<ModelInterner>();
+      interner = doc.interner.get();
+    }
+    std::istringstream in(utf8Buf.data());
+    std::vector<int> lines;
+    std::vector<ModelPtr> roots = Model::ParseYaml(in, interner, &lines);
+    if (!roots.empty()) {
+      doc.model = (roots.size() == 1) ? roots[0] : Model::Array(roots);
+      doc.multiDocument = roots.size() > 1;
 
       // Detection: Check if it's JSON or YAML
       doc.format = Document::FMT_YAML; // Assume YAML by default if parsed
@@ -1040,27 +3725,21 @@ void EditorWindow::UpdateTreeFromText() {
       if (first_char_idx != std::string::npos) {
         char first_char = s[first_char_idx];
         if (first_char == '{' || first_char == '[') {
-          // Attempt to parse as JSON to confirm
-          try {
-            json::parse(s); // If this succeeds, it's likely JSON
+          // Validate as JSON to confirm; otherwise keep as YAML
+          if (JsonFormatter::IsValid(s.data(), s.size()))
             doc.format = Document::FMT_JSON;
-          } catch (const json::parse_error &) {
-            // It parsed as YAML, but not strict JSON, so keep as YAML
-            doc.format = Document::FMT_YAML;
-          }
         }
       }
 
-      // Populate Tree
-      TreeView_DeleteAllItems(m_hTreeView);
-      for (size_t i = 0; i < nodes.size(); i++) {
-        std::string rootName = "ROOT";
-        if (nodes.size() > 1)
-          rootName += " [" + std::to_string(i) + "]";
-        HTREEITEM hRoot =
-            AddYamlToTree(m_hTreeView, TVI_ROOT, rootName, nodes[i], "/");
-        TreeView_Expand(m_hTreeView, hRoot, TVE_EXPAND);
-      }
+      // Unchanged parts of the previous index are reused
+      doc.sourceLines =
+          std::make_shared<const std::vector<int>>(std::move(lines));
+      doc.index = std::make_shared<const ModelIndex>(roots, doc.index.get());
+      PopulateTree(doc);
+      if (!doc.schema && doc.schemaPath.empty())
+        LoadDeclaredSchema(doc);
+      if (doc.schema)
+        ValidateSchema(doc);
       return;
     }
   } catch (...) {
@@ -1069,41 +3748,263 @@ void EditorWindow::UpdateTreeFromText() {
 
   // Fallback
   doc.format = Document::FMT_TEXT;
-  doc.jsonData = json(); // Clear model
+  doc.model = nullptr; // Clear model
+  doc.firstMatch = NULL;
   TreeView_DeleteAllItems(m_hTreeView);
 }
 
+void EditorWindow::PopulateTree(Document &doc) {
+  TreeView_DeleteAllItems(doc.hTree);
+  doc.firstMatch = NULL;
+  if (!doc.model)
+    return;
+
+  TreeFilter filter;
+  TreeFilter *pFilter = nullptr;
+  if (!doc.treeFilter.empty() && doc.index) {
+    pFilter = &filter;
+    size_t matches = BuildTreeFilter(*doc.index, doc.treeFilter, filter);
+    std::wstring label = L"Filter: " + StringToWide(doc.treeFilter) + L" (" +
+                         std::to_wstring(matches) + L" matches";
+    if (matches > kMaxFilterMatches)
+      label += L", first " + std::to_wstring(kMaxFilterMatches) + L" shown";
+    label += L")";
+    TVINSERTSTRUCTW tvis = {0};
+    tvis.hParent = TVI_ROOT;
+    tvis.hInsertAfter = TVI_LAST;
+    tvis.item.mask = TVIF_TEXT;
+    tvis.item.pszText = (LPWSTR)label.c_str();
+    SendMessage(doc.hTree, TVM_INSERTITEMW, 0, (LPARAM)&tvis);
+    SendMessage(doc.hTree, WM_SETREDRAW, FALSE, 0);
+  }
+
+  size_t count = doc.multiDocument ? doc.model->Size() : 1;
+  size_t cursor = 0;
+  for (size_t i = 0; i < count; i++) {
+    std::string rootName = "ROOT";
+    std::string rootPath = "/";
+    if (doc.multiDocument) {
+      rootName += " [" + std::to_string(i) + "]";
+      rootPath += std::to_string(i);
+    }
+    HTREEITEM hRoot = AddModelToTree(
+        doc.hTree, TVI_ROOT, rootName,
+        doc.multiDocument ? Model::Item(doc.model, i) : doc.model,
+        *doc.sourceLines, cursor, rootPath, false, pFilter);
+    if (hRoot)
+      TreeView_Expand(doc.hTree, hRoot, TVE_EXPAND);
+  }
+  doc.firstMatch = filter.firstMatch;
+  if (pFilter) {
+    SendMessage(doc.hTree, WM_SETREDRAW, TRUE, 0);
+    if (doc.firstMatch)
+      TreeView_EnsureVisible(doc.hTree, doc.firstMatch);
+  }
+}
+
+void EditorWindow::ApplyTreeFilter(bool complete) {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.jsonLines)
+    return; // Records are indexed by line, not by key
+
+  int len = GetWindowTextLength(m_hFilterBox);
+  std::vector<wchar_t> buffer(len + 1);
+  GetWindowText(m_hFilterBox, buffer.data(), len + 1);
+  std::string text = WideToString(buffer.data());
+  bool changed = text != doc.treeFilter;
+  doc.treeFilter = text;
+  if (doc.treeGeneration != doc.generation)
+    UpdateTreeFromText(); // Builds the filtered tree
+  else if (changed)
+    PopulateTree(doc);
+
+  if (complete) {
+    // CB_RESETCONTENT would also clear the text being typed
+    for (LRESULT n = SendMessage(m_hFilterBox, CB_GETCOUNT, 0, 0); n > 0; n--)
+      SendMessage(m_hFilterBox, CB_DELETESTRING, n - 1, 0);
+    if (doc.model && doc.index && !text.empty() &&
+        text.find('=') == std::string::npos) {
+      for (const std::string &key :
+           doc.index->CompleteKey(text, kMaxCompletions))
+        SendMessage(m_hFilterBox, CB_ADDSTRING, 0,
+                    (LPARAM)StringToWide(key).c_str());
+    }
+  }
+}
+
+// Filters at once and selects the first match in the tree.
+void EditorWindow::GoToFirstMatch() {
+  KillTimer(m_hwnd, kFilterTimer);
+  ApplyTreeFilter(m_filterTyped);
+  m_filterTyped = false;
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.firstMatch) {
+    TreeView_SelectItem(doc.hTree, doc.firstMatch);
+    SetFocus(doc.hTree);
+  }
+}
+
 void EditorWindow::SyncModelToTree() {
   UpdateTreeFromText(); // Unified
 }
 
+void EditorWindow::ApplyTreeEdit(Document &doc, ModelPtr root,
+                                 const ScalarEdit *edit) {
+  // Roots share structure, so keeping old versions costs only the nodes
+  // that each edit rebuilt. Roots from before a typed change would undo
+  // it too, so they are dropped.
+  const size_t kMaxHistory = 100;
+  if (doc.historyGeneration != doc.generation)
+    doc.modelHistory.clear();
+  if (doc.modelHistory.size() >= kMaxHistory)
+    doc.modelHistory.erase(doc.modelHistory.begin());
+  Document::TreeEdit undo;
+  undo.root = doc.model;
+  doc.model = std::move(root);
+  // Rewriting the whole text would lose what the model does not keep:
+  // comments, tags (Unity's --- !u!), directives and formatting
+  if (!edit || !EditTextInPlace(doc, *edit, undo))
+    UpdateTextFromModel();
+  doc.modelHistory.push_back(std::move(undo));
+  doc.historyGeneration = doc.generation;
+}
+
+bool EditorWindow::EditTextInPlace(Document &doc, const ScalarEdit &edit,
+                                   Document::TreeEdit &undo) {
+  if (doc.format == Document::FMT_TEXT)
+    return false;
+  std::string utf8 = GetEditTextUtf8(doc.hEdit);
+  bool json = doc.format == Document::FMT_JSON;
+  size_t begin, end;
+  bool flow;
+  std::string text;
+  try {
+    if (!Model::FindScalarText(utf8, edit.path, doc.multiDocument,
+                               !edit.value, begin, end, flow))
+      return false;
+    if (json)
+      text = Model::ToJsonText(edit.value ? edit.value
+                                          : Model::String(edit.key));
+    else if (edit.value)
+      YamlEmitter::AppendInline(text, edit.value, flow);
+    else
+      YamlEmitter::AppendString(text, edit.key, flow);
+
+    // Quoting, tags or anchors around the span could give the new text
+    // another meaning; then the whole text is rewritten instead
+    std::string updated = utf8.substr(0, begin) + text + utf8.substr(end);
+    std::istringstream in(updated);
+    std::vector<ModelPtr> roots = Model::ParseYaml(in);
+    if (roots.size() != (doc.multiDocument ? doc.model->Size() : 1) ||
+        !Model::Equal(doc.multiDocument ? Model::Array(roots) : roots[0],
+                      doc.model))
+      return false;
+  } catch (...) {
+    return false;
+  }
+
+  size_t wBegin = WideOffset(utf8.data(), begin);
+  size_t wEnd = wBegin + WideOffset(utf8.data() + begin, end - begin);
+  std::wstring wText = StringToWide(text);
+  undo.begin = wBegin;
+  undo.length = wText.size();
+  undo.text = StringToWide(utf8.substr(begin, end - begin));
+  SendMessage(doc.hEdit, EM_SETSEL, wBegin, wEnd);
+  SendMessage(doc.hEdit, EM_REPLACESEL, TRUE, (LPARAM)wText.c_str());
+  return true;
+}
+
+void EditorWindow::UndoTreeEdit() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (doc.historyGeneration != doc.generation)
+    doc.modelHistory.clear(); // The text was edited since
+  if (doc.modelHistory.empty()) {
+    MessageBeep(MB_OK);
+    return;
+  }
+
+  Document::TreeEdit undo = std::move(doc.modelHistory.back());
+  doc.modelHistory.pop_back();
+  doc.model = undo.root;
+  if (undo.length == SIZE_MAX) {
+    UpdateTextFromModel();
+  } else {
+    // The text is as the edit left it, so the span is still where it was
+    SendMessage(doc.hEdit, EM_SETSEL, undo.begin, undo.begin + undo.length);
+    SendMessage(doc.hEdit, EM_REPLACESEL, TRUE, (LPARAM)undo.text.c_str());
+  }
+  doc.historyGeneration = doc.generation;
+  UpdateTreeFromText();
+}
+
+void EditorWindow::ExpandAliases() {
+  if (m_activePageIndex == -1)
+    return;
+  Document &doc = m_documents[m_activePageIndex];
+  if (!doc.model)
+    return;
+
+  if (Model::LogicalSize(doc.model, m_aliasBudget) > m_aliasBudget) {
+    MessageBox(m_hwnd,
+               L"Expanding the aliases in this document would exceed the "
+               L"alias expansion budget.",
+               L"Expand Aliases", MB_OK | MB_ICONERROR);
+    return;
+  }
+  ModelPtr expanded = Model::ExpandAliases(doc.model);
+  if (!expanded) {
+    MessageBox(m_hwnd, L"The document contains a recursive alias.",
+               L"Expand Aliases", MB_OK | MB_ICONERROR);
+    return;
+  }
+  ApplyTreeEdit(doc, expanded);
+  UpdateTreeFromText();
+}
+
 void EditorWindow::UpdateTextFromModel(bool toYaml) {
   if (m_activePageIndex == -1)
     return;
   Document &doc = m_documents[m_activePageIndex];
+  if (!doc.model)
+    return;
 
   std::string formatted;
-  if (toYaml || doc.format == Document::FMT_YAML) {
-    // Convert json to yaml (basic)
-    // For robust json->yaml, we might need to iterate json and build YAML::Node
-    // But for now, let's just use json dump if not forcing yaml
-    if (toYaml) {
-      // Placeholder: Properly implementing JSON -> YAML via yaml-cpp requires
-      // recursive build For now, dump JSON as it's valid YAML superset (mostly)
-      formatted = doc.jsonData.dump(2);
+  try {
+    if (toYaml || doc.format == Document::FMT_YAML) {
+      // YAML keeps aliases as aliases, so nothing is expanded
+      std::vector<ModelPtr> documents;
+      if (doc.multiDocument) {
+        for (size_t i = 0; i < doc.model->Size(); i++)
+          documents.push_back(Model::Item(doc.model, i));
+      } else {
+        documents.push_back(doc.model);
+      }
+      formatted = YamlEmitter::Emit(documents, m_yamlOptions);
     } else {
-      formatted = doc.jsonData.dump(4);
+      // JSON expands every alias; refuse documents that would blow up
+      // (e.g. "billion laughs") instead of running out of memory.
+      if (Model::LogicalSize(doc.model, m_aliasBudget) > m_aliasBudget) {
+        MessageBox(m_hwnd,
+                   L"Expanding the aliases in this document would exceed the "
+                   L"alias expansion budget.",
+                   L"Error", MB_OK | MB_ICONERROR);
+        return;
+      }
+      std::string compact = Model::ToJsonText(doc.model);
+      formatted = JsonFormatter::Format(compact.data(), compact.size(), 4);
     }
-  } else {
-    formatted = doc.jsonData.dump(4);
+  } catch (const std::runtime_error &e) {
+    std::string err = e.what();
+    std::wstring wErr(err.begin(), err.end());
+    MessageBox(m_hwnd, wErr.c_str(), L"Error", MB_OK | MB_ICONERROR);
+    return;
   }
 
-  // Convert back to Wide
-  int wLen = MultiByteToWideChar(CP_UTF8, 0, formatted.c_str(), -1, NULL, 0);
-  std::vector<wchar_t> wOut(wLen + 1);
-  MultiByteToWideChar(CP_UTF8, 0, formatted.c_str(), -1, wOut.data(), wLen);
-  wOut[wLen] = 0;
-
-  std::wstring wFormatted = FileUtils::NormalizeToCrlf(wOut.data());
-  SetWindowText(doc.hEdit, wFormatted.c_str());
+  SetEditTextUtf8(doc.hEdit, formatted);
 }
@@ -1,4 +1,21 @@
 #pragma once
+#include "BinaryFormat.h"
+#include "FileSearch.h"
+#include "FileUtils.h"
+#include "FindDialog.h"
+#include "GuidIndex.h"
+#include "JsonLines.h"
+#include "JsonSchema.h"
+#include "Model.h"
+#include "ModelIndex.h"
+#include "SearchEngine.h"
+#include "StreamConverter.h"
+#include "SyntaxHighlighter.h"
+#include "UnityRefs.h"
+#include "YamlEmitter.h"
+#include "YamlLint.h"
+#include <atomic>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
@@ -15,6 +32,22 @@ public:
               HWND hWndParent = 0, HMENU hMenu = 0);
   HWND Window() const { return m_hwnd; }
   void UpdateLineNumbers(HWND hEdit);
+  // Keyboard navigation for the modeless Find window; true if handled.
+  bool PreTranslateMessage(MSG *msg);
+
+  // Syntax highlighting, driven from the edit control's subclass: edits
+  // are reported with the lines they touch, and the token runs of the
+  // visible lines are drawn over the control's own painting.
+  struct TextEdit {
+    size_t firstLine = 0, lastLine = 0, lineCount = 0;
+    unsigned generation = 0;
+  };
+  TextEdit BeginTextEdit(HWND hEdit);
+  void EndTextEdit(HWND hEdit, const TextEdit &before, bool whole);
+  // A multiline edit control sends no EN_CHANGE for WM_SETTEXT, so the
+  // subclass reports it to move the document's generation on
+  void TextReplaced(HWND hEdit);
+  void PaintHighlights(HWND hEdit);
 
 protected:
   static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
@@ -29,13 +62,46 @@ protected:
   // File operations
   void NewFile();
   void OpenFile();
+  void OpenPath(const std::wstring &path); // Text or binary, into a new tab
+  void OpenJsonLines(const std::wstring &path);
   void SaveFile();
   void SaveFileAs();
   void CloseCurrentTab();
   void UpdateTitle();
   void SwitchTab(int index);
-  void FormatJson();
+  void UpdateEolMenu();
+  void FormatJson(bool minify = false);
   void FormatYaml();
+  void FormatRange(bool selectionOnly);
+  void ConvertFile(int command); // IDM_CONVERT_*, file to file
+  // Brackets and blocks, from the highlighter's structure index
+  void GoToMatchingBracket();
+  void SelectBlock();
+
+  // Find / Replace
+  void ShowFindDialog();
+  void FindNext();
+  void ReplaceOne();
+  void ReplaceAll();
+  void FindAll(); // Results stream in from a worker thread
+  // Open tabs, and with inFolder the Find window's folder, on a pool
+  void FindInFiles(bool inFolder);
+  void GoToFindResult();
+  // Unity fileID cross-references at the caret; lists go to the Find window
+  void GoToDefinition();
+  void FindReferences(bool dangling);
+  // Unity project GUID index, built on a worker thread and saved so the
+  // next start rescans only changed files; pick asks for the folder
+  void IndexUnityProject(bool pick);
+  void FindAssetReferences(); // Files referencing the GUID at the caret
+  // JSONPath query bar: runs on a worker thread, results go in the tree
+  void RunQuery();
+  void CancelQuery();
+  // JSON Schema validation: runs on a worker thread after each parse, the
+  // errors go in the tree
+  void PickSchema();
+  // Lint over parser events on a worker thread; the findings go in the tree
+  void Lint();
 
   // Settings & Persistence
   void LoadSettings();
@@ -47,14 +113,83 @@ private:
   struct Document {
     HWND hEdit;
     HWND hLineNum;
+    HWND hTree; // Kept per tab so expansion, selection and scroll survive
     std::wstring filePath; // Empty for new untitled files
     std::wstring fileName; // Display name
     bool isDirty;
     int eolMode; // 0: CRLF, 1: LF, 2: CR
 
-    // Internal Data Structure
-    nlohmann::json jsonData;
+    // Internal Data Structure (persistent; copying it is a snapshot)
+    ModelPtr model;
+    // Earlier roots for tree-edit undo. An edit made in place also keeps
+    // the text it replaced, so undoing it puts back exactly that text.
+    struct TreeEdit {
+      ModelPtr root;
+      // The span the edit wrote; length is SIZE_MAX if it rewrote the text
+      size_t begin = 0, length = SIZE_MAX;
+      std::wstring text;
+    };
+    std::vector<TreeEdit> modelHistory;
+    // Generation of the text the last tree edit wrote; once the text moves
+    // past it, the history no longer matches what is in the control
+    unsigned historyGeneration = 0;
+    std::shared_ptr<ModelInterner> interner; // Set when sharing subtrees
+    // Bumped on every text change; the tree is rebuilt only when it was
+    // built from an older generation.
+    unsigned generation = 1;
+    unsigned treeGeneration = 0;
     enum { FMT_TEXT, FMT_JSON, FMT_YAML } format = FMT_TEXT;
+    bool multiDocument = false; // model is an array of YAML documents
+    // Set when the file is MessagePack/CBOR/BSON/UBJSON: the tab shows it
+    // as JSON and saving encodes the JSON back into this format.
+    BinaryFormat::Format binaryFormat = BinaryFormat::NONE;
+    // Set when the file was gzip or zstd compressed; saving compresses it
+    // the same way.
+    FileUtils::Compression compression = FileUtils::NONE;
+    // JSON Lines: the file stays mapped and is not loaded into the edit
+    // control. The tree lists records lazily and the edit control shows
+    // the selected one (read-only).
+    std::shared_ptr<MappedFile> mappedFile;
+    std::shared_ptr<JsonLinesIndex> jsonLines;
+    std::vector<JsonLinesError> jsonLinesErrors;
+    // Copy of the text for searching, reused until the text changes.
+    std::shared_ptr<const std::wstring> searchText;
+    unsigned searchGeneration = 0;
+    // fileID index of searchText, for Unity scenes and prefabs; dropped
+    // whenever searchText is read afresh
+    std::shared_ptr<const UnityRefIndex> unityRefs;
+    // Source line of every model node, in the pre-order of
+    // Model::ParseYaml; maps query results and lazily added tree items back
+    // to the text.
+    std::shared_ptr<const std::vector<int>> sourceLines;
+    // Keys and values of the model, rebuilt with it; the tree shows only
+    // what treeFilter matches when it is set.
+    std::shared_ptr<const ModelIndex> index;
+    std::string treeFilter;
+    HTREEITEM firstMatch = NULL; // In the filtered tree
+    // Created on first paint; null for plain text
+    std::shared_ptr<SyntaxHighlighter> highlighter;
+    // Indentation guides and bracket marks last drawn over the text, so
+    // that stale ones are repainted away
+    std::vector<FoldRange> guides;
+    size_t guidesFirst = SIZE_MAX; // First visible line when drawn
+    size_t bracketMarks[2] = {SIZE_MAX, SIZE_MAX};
+    // JSON Schema the model is validated against after each parse, from
+    // Format > Validate Against Schema or the root's "$schema" path. The
+    // cache lets each validation reuse results for unchanged subtrees.
+    std::shared_ptr<const JsonSchema> schema;
+    std::wstring schemaPath; // Set once tried, so a bad $schema is not retried
+    std::shared_ptr<JsonSchema::Cache> schemaCache;
+    // The tab's running validation; its results are matched on hEdit and
+    // schemaId, so tabs validate independently
+    unsigned schemaId = 0;
+    std::shared_ptr<std::atomic<bool>> schemaCancel; // Null when none runs
+    // The tab's running query, matched the same way
+    unsigned queryId = 0;
+    std::shared_ptr<std::atomic<bool>> queryCancel; // Null when none runs
+    // And its running lint
+    unsigned lintId = 0;
+    std::shared_ptr<std::atomic<bool>> lintCancel; // Null when none runs
   };
 
   HWND m_hwnd;
@@ -64,6 +199,13 @@ private:
 
   // Localization
   std::string m_currentLang; // "en", "jp", etc.
+  bool m_shareSubtrees;      // Hash-cons identical subtrees when parsing
+  size_t m_aliasBudget;      // Max node count when aliases are expanded
+  YamlEmitOptions m_yamlOptions; // Indent and flow style for YAML output
+  ConvertOptions m_convertOptions; // File > Convert settings
+  SearchOptions m_searchOptions;   // Last used Find options
+  LintRules m_lintRules;           // Format > Lint settings
+  FileSearchOptions m_fileSearchOptions; // Find in Files folder and filters
   std::wstring GetLocalizedString(const std::string &key);
   void UpdateMenus();
 
@@ -71,10 +213,98 @@ private:
                     const std::wstring &content = L"");
   void ResizeTabControl();
   std::wstring GetFileNameFromPath(const std::wstring &path);
+  Document *DocumentOf(HWND hEdit);
+  SyntaxHighlighter::Language HighlightLanguage(const Document &doc) const;
+  // The document's highlighter, made afresh if the text's line count or
+  // language changed; null if it has no language
+  SyntaxHighlighter *Highlighter(Document &doc);
 
   // Tree View & Data Model
   void UpdateTreeFromText();
   void UpdateTextFromModel(bool toYaml = false);
-  void SyncModelToTree(); // Uses internal jsonData
-  HWND m_hTreeView;
+  void SyncModelToTree(); // Uses internal model
+  void PopulateTree(Document &doc);
+  // Loads the root's "$schema" file; validates against the tab's schema
+  void LoadDeclaredSchema(Document &doc);
+  void ValidateSchema(Document &doc);
+  // Filters the tree by the filter box and lists keys completing it
+  void ApplyTreeFilter(bool complete);
+  void GoToFirstMatch();
+  HWND m_hFilterBox = NULL;
+  bool m_filterTyped = false; // The filter text was typed, not picked
+  // The one scalar a tree edit changed: the value at path became value,
+  // or, with value null, its key became key
+  struct ScalarEdit {
+    std::string path;
+    ModelPtr value;
+    std::string key;
+  };
+  // Makes root the model, keeping the old root for UndoTreeEdit. The text
+  // is rewritten from the model unless edit can be made in place.
+  void ApplyTreeEdit(Document &doc, ModelPtr root,
+                     const ScalarEdit *edit = nullptr);
+  // Replaces edit's scalar in the text, as one undoable edit, if the text
+  // then reads back as the model; undo receives the text it replaced
+  bool EditTextInPlace(Document &doc, const ScalarEdit &edit,
+                       Document::TreeEdit &undo);
+  void UndoTreeEdit();
+  void ExpandAliases();
+  void ExpandLazyItem(HTREEITEM hItem);
+  void ShowJsonLinesRecord(HTREEITEM hItem);
+  void OnJsonLinesValidated(const JsonLinesIndex *index,
+                            std::vector<JsonLinesError> errors);
+  HWND m_hTreeView; // Tree of the active document
+  HWND CreateTreeView();
+
+  FindDialog m_findDialog;
+  std::shared_ptr<const std::wstring> SearchText(Document &doc);
+  std::shared_ptr<const UnityRefIndex> UnityRefs(Document &doc);
+  // Compiles the Find window's pattern; shows the error and returns null
+  // if it is malformed.
+  std::unique_ptr<SearchEngine> CompileSearch();
+  void SelectMatch(Document &doc, const SearchMatch &match);
+  // Where results can be: an open tab, a file, or both once it is opened
+  struct FindTarget {
+    HWND hEdit;
+    std::wstring path;
+    std::wstring name; // Heading in the result list
+  };
+  // One line of the result list; headings go to their file's first match
+  struct FindRow {
+    size_t target;
+    size_t line, column, length;
+  };
+  // Cancels the running search and clears the results; returns the new id
+  unsigned BeginFind(std::vector<FindTarget> targets, bool grouped);
+  void OnFindResults(unsigned searchId, std::vector<FileHits> hits,
+                     size_t searched, bool done);
+  std::vector<FindTarget> m_findTargets;
+  std::vector<FindRow> m_findRows;
+  size_t m_findCount = 0;     // All matches, listed or not
+  bool m_findGrouped = false; // Rows under a heading per file
+  unsigned m_findId = 0;
+  std::shared_ptr<std::atomic<bool>> m_findCancel;
+
+  // Opens the asset the external reference ref points to, at its object
+  void GoToAsset(Document &doc, const UnityRefIndex &refs, size_t ref);
+  struct GuidIndexResult;
+  void OnGuidIndexed(GuidIndexResult &result);
+  std::wstring m_unityProject; // Root of the indexed project
+  std::shared_ptr<const GuidIndex> m_guidIndex; // Null until built
+  unsigned m_guidIndexId = 0;
+  std::shared_ptr<std::atomic<bool>> m_guidIndexCancel;
+
+  HWND m_hQueryEdit = NULL;
+  struct QueryResults;
+  void OnQueryResults(QueryResults &result);
+  void ShowQueryResult(HTREEITEM hItem);
+
+  struct SchemaResults;
+  void OnSchemaValidated(SchemaResults &result);
+  // Last id given to a tab's background run; unique across tabs, so late
+  // results for a closed tab never match one that reuses its hEdit
+  unsigned m_runId = 0;
+
+  struct LintResults;
+  void OnLintResults(LintResults &result);
 };
@@ -0,0 +1,198 @@
+#include "FileSearch.h"
+#include "FileUtils.h"
+#include "OutputSink.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <windows.h>
+#include <shlwapi.h>
+
+// Longest line text kept per match; on longer lines it starts a little
+// before the match instead of at the line start.
+static const size_t kMaxLineText = 200;
+static const size_t kContextBefore = 40;
+// A NUL byte this close to the start marks a file as binary, as in grep.
+static const size_t kBinaryProbe = 8000;
+
+FileMatch MatchLocator::Locate(const SearchMatch &match) {
+  size_t start = match.start;
+  while (m_pos < start) {
+    size_t i = FindLineBreak(m_text, m_pos, start);
+    if (i == start) {
+      m_pos = start;
+      break;
+    }
+    if (m_text[i] == L'\r' && i + 1 < m_size && m_text[i + 1] == L'\n')
+      i++;
+    m_line++;
+    m_lineStart = m_pos = i + 1;
+  }
+
+  FileMatch result;
+  result.line = m_line;
+  // A match can start on the LF of a CRLF, which belongs to the line before
+  result.column = start > m_lineStart ? start - m_lineStart : 0;
+  result.length = match.length;
+  size_t from = m_lineStart;
+  if (start > from + kMaxLineText / 2)
+    from = start - kContextBefore;
+  size_t limit = std::min(m_size, from + kMaxLineText);
+  size_t end = FindLineBreak(m_text, std::min(from, limit), limit);
+  result.text.assign(m_text + from, m_text + end);
+  if (from > m_lineStart)
+    result.text.insert(0, L"...");
+  return result;
+}
+
+static void SearchText(SearchEngine &engine, const wchar_t *text, size_t size,
+                       size_t maxListed, const std::atomic<bool> &cancel,
+                       FileHits &hits) {
+  MatchLocator locator(text, size);
+  hits.count = engine.FindAll(
+      text, size, [&](const std::vector<SearchMatch> &batch) {
+        for (const SearchMatch &match : batch) {
+          if (hits.matches.size() == maxListed)
+            break;
+          hits.matches.push_back(locator.Locate(match));
+        }
+        return !cancel;
+      });
+}
+
+// Decodes a file the way FileUtils::ReadFileUtf8 does for a tab, so line
+// and column numbers agree. False if it cannot be read or looks binary.
+static bool LoadFile(const std::wstring &path, std::wstring &text) {
+  MappedFile file(path);
+  const char *data = (const char *)file.Data();
+  size_t size = file.Size();
+  if (!data)
+    return false;
+  if (FileUtils::DetectCompression(data, size) != FileUtils::NONE) {
+    text = FileUtils::ReadFileUtf8(path);
+    return !text.empty();
+  }
+  if (memchr(data, 0, std::min(size, kBinaryProbe)) || size > INT_MAX)
+    return false;
+  text.resize(size);
+  int n = MultiByteToWideChar(CP_UTF8, 0, data, (int)size, &text[0],
+                              (int)size);
+  text.resize(n);
+  return n > 0;
+}
+
+static bool MatchesSpec(const std::wstring &name, const std::wstring &spec) {
+  return PathMatchSpecEx(name.c_str(), spec.c_str(), PMSF_MULTIPLE) == S_OK;
+}
+
+// Paths are compared as Windows does: case-insensitively.
+static std::wstring PathKey(const std::wstring &path) {
+  std::wstring key = std::filesystem::path(path).lexically_normal().wstring();
+  std::transform(key.begin(), key.end(), key.begin(),
+                 [](wchar_t c) { return (wchar_t)towlower(c); });
+  return key;
+}
+
+FileSearch::FileSearch(const std::wstring &pattern,
+                       const SearchOptions &options,
+                       const FileSearchOptions &fileOptions)
+    : m_pattern(pattern), m_options(options), m_fileOptions(fileOptions) {
+  SearchEngine check(pattern, options); // Throws here, not on a worker
+}
+
+size_t FileSearch::Run(const std::vector<Source> &sources,
+                       const std::atomic<bool> &cancel,
+                       const HitsCallback &onHits) {
+  ThreadPool pool(m_fileOptions.threads);
+  std::vector<std::unique_ptr<SearchEngine>> engines;
+  for (unsigned i = 0; i < pool.Size(); i++)
+    engines.emplace_back(new SearchEngine(m_pattern, m_options));
+  std::vector<std::wstring> buffers(pool.Size()); // Decoded file, per worker
+  std::mutex reportMutex;
+  std::atomic<size_t> searched(0);
+  auto report = [&](FileHits &hits) {
+    searched++;
+    if (hits.count == 0)
+      return;
+    std::lock_guard<std::mutex> lock(reportMutex);
+    onHits(std::move(hits));
+  };
+
+  std::set<std::wstring> openPaths;
+  for (size_t i = 0; i < sources.size(); i++) {
+    if (!sources[i].path.empty())
+      openPaths.insert(PathKey(sources[i].path));
+    pool.Submit([&, i](unsigned worker) {
+      if (cancel)
+        return;
+      FileHits hits;
+      hits.source = i;
+      hits.path = sources[i].path;
+      const std::wstring &text = *sources[i].text;
+      SearchText(*engines[worker], text.data(), text.size(),
+                 m_fileOptions.maxListed, cancel, hits);
+      report(hits);
+    });
+  }
+
+  auto searchFile = [&](const std::wstring &path) {
+    pool.Submit([&, path](unsigned worker) {
+      if (cancel)
+        return;
+      FileHits hits;
+      hits.path = path;
+      std::wstring &text = buffers[worker];
+      try {
+        if (!LoadFile(path, text))
+          return;
+        SearchText(*engines[worker], text.data(), text.size(),
+                   m_fileOptions.maxListed, cancel, hits);
+      } catch (const std::exception &) {
+        return; // Out of memory for this file; go on with the rest
+      }
+      report(hits);
+    });
+  };
+  for (const std::wstring &path : m_fileOptions.files)
+    if (!openPaths.count(PathKey(path)))
+      searchFile(path);
+
+  // Files are searched while the walk goes on
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::path root = m_fileOptions.folder.empty()
+                      ? fs::path()
+                      : fs::absolute(m_fileOptions.folder, ec);
+  fs::recursive_directory_iterator it, end;
+  if (!root.empty() && !ec)
+    it = fs::recursive_directory_iterator(
+        root, fs::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != end && !cancel; it.increment(ec)) {
+    const fs::directory_entry &entry = *it;
+    std::wstring name = entry.path().filename().wstring();
+    std::error_code entryEc;
+    if (entry.is_directory(entryEc)) {
+      if (!m_fileOptions.excludeFolders.empty() &&
+          MatchesSpec(name, m_fileOptions.excludeFolders))
+        it.disable_recursion_pending();
+      continue;
+    }
+    if (!entry.is_regular_file(entryEc) ||
+        !MatchesSpec(name, m_fileOptions.include))
+      continue;
+    uintmax_t size = entry.file_size(entryEc);
+    if (entryEc || size == 0 || size > m_fileOptions.maxFileSize)
+      continue;
+    std::wstring path = entry.path().wstring();
+    if (openPaths.count(PathKey(path)))
+      continue; // The open document, maybe edited, was searched instead
+    searchFile(path);
+  }
+  pool.Wait();
+  return searched;
+}
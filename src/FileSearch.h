@@ -0,0 +1,83 @@
+#pragma once
+#include "SearchEngine.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A match located by line and column, so it can be found again after the
+// file is opened in a tab, whatever its line endings.
+struct FileMatch {
+  size_t line;   // 0-based; CRLF, lone CR and lone LF each end a line
+  size_t column; // UTF-16 units from the line start
+  size_t length;
+  std::wstring text; // The line around the match, for the result list
+};
+
+// Matches in one open document or file, in order.
+struct FileHits {
+  static const size_t kFile = (size_t)-1;
+  size_t source = kFile; // Index into the open documents, or kFile
+  std::wstring path;
+  size_t count = 0; // All matches; matches holds the first maxListed
+  std::vector<FileMatch> matches;
+};
+
+// Turns the matches of one text, given in order, into FileMatches with a
+// single forward pass over the line breaks.
+class MatchLocator {
+public:
+  MatchLocator(const wchar_t *text, size_t size) : m_text(text), m_size(size) {}
+  FileMatch Locate(const SearchMatch &match);
+
+private:
+  const wchar_t *m_text;
+  size_t m_size;
+  size_t m_pos = 0; // Line breaks before here are counted
+  size_t m_line = 0;
+  size_t m_lineStart = 0;
+};
+
+struct FileSearchOptions {
+  std::wstring folder;              // Searched recursively; empty for none
+  std::vector<std::wstring> files;  // Searched as well, whatever their name
+  std::wstring include = L"*";      // File name patterns, ';'-separated
+  std::wstring excludeFolders;      // Folder name patterns not entered
+  uint64_t maxFileSize = 64 << 20;  // Larger files are skipped
+  size_t maxListed = 1000;          // Located matches per file
+  unsigned threads = 0;             // 0: one per hardware thread
+};
+
+// Find in open documents and in a folder tree.
+//
+// Files are memory-mapped, skipped if they look binary (a NUL byte near
+// the start) and decoded from UTF-8; gzip and zstd files are decompressed.
+// The folder is walked on the calling thread while a work-stealing
+// ThreadPool searches the files already found, each worker with its own
+// SearchEngine.
+class FileSearch {
+public:
+  struct Source {
+    std::wstring path; // Skipped when the folder walk reaches it
+    std::shared_ptr<const std::wstring> text;
+  };
+  typedef std::function<void(FileHits &&)> HitsCallback;
+
+  // Throws std::runtime_error if the regular expression is malformed.
+  FileSearch(const std::wstring &pattern, const SearchOptions &options,
+             const FileSearchOptions &fileOptions);
+
+  // Searches sources, then the listed files and those under the folder,
+  // skipping the paths of sources. onHits is called once for each text
+  // with matches, by one thread at a time but in no particular order.
+  // Stops early once cancel is set. Returns the number of texts searched.
+  size_t Run(const std::vector<Source> &sources,
+             const std::atomic<bool> &cancel, const HitsCallback &onHits);
+
+private:
+  std::wstring m_pattern;
+  SearchOptions m_options;
+  FileSearchOptions m_fileOptions;
+};
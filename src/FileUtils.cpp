@@ -1,121 +1,349 @@
 #include "FileUtils.h"
+#include "OutputSink.h"
+#include <algorithm>
+#include <cwctype>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <windows.h>
+#include <zlib.h>
+#include <zstd.h>
 
-std::wstring FileUtils::ReadFileUtf8(const std::wstring &path) {
+// Compressed files are read and written in chunks of this size
+static const size_t kIoChunk = 64 * 1024;
+
+FileUtils::Compression FileUtils::DetectCompression(const void *data,
+                                                    size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+  if (size >= 2 && p[0] == 0x1F && p[1] == 0x8B)
+    return GZIP;
+  if (size >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F &&
+      p[3] == 0xFD)
+    return ZSTD;
+  return NONE;
+}
+
+FileUtils::Compression FileUtils::CompressionFromPath(const std::wstring &path) {
+  size_t dot = path.find_last_of(L".\\/");
+  if (dot == std::wstring::npos || path[dot] != L'.')
+    return NONE;
+  std::wstring ext = path.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](wchar_t c) { return (wchar_t)towlower(c); });
+  if (ext == L"gz")
+    return GZIP;
+  if (ext == L"zst" || ext == L"zstd")
+    return ZSTD;
+  return NONE;
+}
+
+// Inflates a gzip file into out, reading one chunk of it at a time.
+// Concatenated members (as written by pigz or cat a.gz b.gz) are all read.
+static bool InflateFile(HANDLE hFile, std::string &out) {
+  z_stream zs = {};
+  if (inflateInit2(&zs, 15 + 32) != Z_OK)
+    return false;
+  std::vector<unsigned char> in(kIoChunk), buf(kIoChunk);
+  bool ended = false, ok = true;
+  for (;;) {
+    if (zs.avail_in == 0) {
+      DWORD bytesRead;
+      if (!ReadFile(hFile, in.data(), (DWORD)in.size(), &bytesRead, NULL)) {
+        ok = false;
+        break;
+      }
+      if (bytesRead == 0)
+        break;
+      zs.next_in = in.data();
+      zs.avail_in = bytesRead;
+    }
+    if (ended) {
+      inflateReset(&zs);
+      ended = false;
+    }
+    zs.next_out = buf.data();
+    zs.avail_out = (uInt)buf.size();
+    int ret = inflate(&zs, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      ok = false;
+      break;
+    }
+    out.append((const char *)buf.data(), buf.size() - zs.avail_out);
+    ended = ret == Z_STREAM_END;
+  }
+  inflateEnd(&zs);
+  // A stream cut off mid-member is an error, not a shorter document
+  return ok && ended;
+}
+
+static bool DecompressZstdFile(HANDLE hFile, std::string &out) {
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  if (!dctx)
+    return false;
+  std::vector<char> in(ZSTD_DStreamInSize()), buf(ZSTD_DStreamOutSize());
+  size_t pending = 0;
+  bool ok = true;
+  DWORD bytesRead;
+  while (ok && ReadFile(hFile, in.data(), (DWORD)in.size(), &bytesRead, NULL) &&
+         bytesRead > 0) {
+    ZSTD_inBuffer input = {in.data(), bytesRead, 0};
+    // zstd keeps the last byte of a frame until all of its output is
+    // flushed, so consuming the input also drains the output
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = {buf.data(), buf.size(), 0};
+      pending = ZSTD_decompressStream(dctx, &output, &input);
+      if (ZSTD_isError(pending)) {
+        ok = false;
+        break;
+      }
+      out.append(buf.data(), output.pos);
+    }
+  }
+  ZSTD_freeDCtx(dctx);
+  // Non-zero means the last frame is incomplete
+  return ok && pending == 0;
+}
+
+std::wstring FileUtils::ReadFileUtf8(const std::wstring &path,
+                                     Compression *compression) {
+  if (compression)
+    *compression = NONE;
   HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
   if (hFile == INVALID_HANDLE_VALUE)
     return L"";
 
-  DWORD fileSize = GetFileSize(hFile, NULL);
-  if (fileSize == INVALID_FILE_SIZE) {
+  unsigned char magic[4];
+  DWORD magicSize = 0;
+  if (!ReadFile(hFile, magic, sizeof(magic), &magicSize, NULL) ||
+      SetFilePointer(hFile, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER) {
     CloseHandle(hFile);
     return L"";
   }
+  Compression detected = DetectCompression(magic, magicSize);
 
-  std::vector<char> buffer(fileSize + 1);
-  DWORD bytesRead;
-  if (!ReadFile(hFile, buffer.data(), fileSize, &bytesRead, NULL)) {
-    CloseHandle(hFile);
-    return L"";
+  // Compressed input is decompressed chunk by chunk, so only the
+  // decompressed text is ever held in full
+  std::string buffer;
+  bool ok;
+  if (detected == GZIP) {
+    ok = InflateFile(hFile, buffer);
+  } else if (detected == ZSTD) {
+    ok = DecompressZstdFile(hFile, buffer);
+  } else {
+    DWORD fileSize = GetFileSize(hFile, NULL);
+    ok = fileSize != INVALID_FILE_SIZE;
+    if (ok) {
+      buffer.resize(fileSize);
+      DWORD bytesRead = 0;
+      ok = fileSize == 0 ||
+           ReadFile(hFile, &buffer[0], fileSize, &bytesRead, NULL);
+      buffer.resize(bytesRead);
+    }
   }
-  buffer[bytesRead] = 0;
   CloseHandle(hFile);
+  if (!ok)
+    return L"";
+  if (compression)
+    *compression = detected;
+  if (buffer.empty())
+    return L"";
 
   // Convert UTF-8 to Wide Char
-  int wlen = MultiByteToWideChar(CP_UTF8, 0, buffer.data(), -1, NULL, 0);
+  int wlen = MultiByteToWideChar(CP_UTF8, 0, buffer.data(), (int)buffer.size(),
+                                 NULL, 0);
   if (wlen == 0)
     return L"";
 
-  std::vector<wchar_t> wBuffer(wlen);
-  MultiByteToWideChar(CP_UTF8, 0, buffer.data(), -1, wBuffer.data(), wlen);
-
-  std::wstring result = wBuffer.data();
+  std::wstring result(wlen, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, buffer.data(), (int)buffer.size(),
+                      &result[0], wlen);
+  // Text after an embedded NUL was never shown; keep it that way
+  result.resize(wcslen(result.c_str()));
   return NormalizeToCrlf(result);
 }
 
 std::wstring FileUtils::NormalizeToCrlf(const std::wstring &text) {
   std::wstring displayResult;
-  displayResult.reserve(text.size());
-  for (size_t i = 0; i < text.size(); ++i) {
-    if (text[i] == L'\r') {
-      if (i + 1 < text.size() && text[i + 1] == L'\n') {
-        displayResult += L"\r\n"; // Keep CRLF
-        i++;
-      } else {
-        displayResult += L"\r\n"; // Treat raw CR as newline
-      }
-    } else if (text[i] == L'\n') {
-      displayResult += L"\r\n"; // Treat raw LF as newline
-    } else {
-      displayResult += text[i];
-    }
-  }
+  displayResult.reserve(text.size() + text.size() / 32);
+  StringSink<wchar_t> sink(displayResult);
+  WriteWithEol<CRLF>(sink, text.data(), text.size());
   return displayResult;
 }
 
-bool FileUtils::WriteFileUtf8(const std::wstring &path,
-                              const std::wstring &content, EolMode eol) {
-  // Convert logic to desired EOL
-  std::wstring output;
-  output.reserve(content.size());
-
-  const wchar_t *p = content.c_str();
-  while (*p) {
-    if (*p == L'\r' && *(p + 1) == L'\n') {
-      // Found CRLF
-      if (eol == EolMode::CRLF)
-        output += L"\r\n";
-      else if (eol == EolMode::LF)
-        output += L"\n";
-      else if (eol == EolMode::CR)
-        output += L"\r";
-      p += 2;
-    } else if (*p == L'\r') { // CR
-      if (eol == EolMode::CRLF)
-        output += L"\r\n";
-      else if (eol == EolMode::LF)
-        output += L"\n";
-      else if (eol == EolMode::CR)
-        output += L"\r";
-      p++;
-    } else if (*p ==
-               L'\n') { // LF (sometimes Edit control might insert just LF?)
-      if (eol == EolMode::CRLF)
-        output += L"\r\n";
-      else if (eol == EolMode::LF)
-        output += L"\n";
-      else if (eol == EolMode::CR)
-        output += L"\r";
-      p++;
-    } else {
-      output += *p++;
+// Writes to a file handle, through a gzip or zstd stream when compressing.
+// After the first failure everything else is dropped and Finish returns
+// false.
+class CompressedWriter {
+public:
+  CompressedWriter(HANDLE hFile, FileUtils::Compression compression)
+      : m_file(hFile), m_compression(compression), m_buf(kIoChunk) {
+    if (m_compression == FileUtils::GZIP) {
+      m_ok = deflateInit2(&m_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+                          8, Z_DEFAULT_STRATEGY) == Z_OK;
+      m_zsInit = m_ok;
+    } else if (m_compression == FileUtils::ZSTD) {
+      m_cctx = ZSTD_createCCtx();
+      m_ok = m_cctx != nullptr;
     }
   }
+  ~CompressedWriter() {
+    if (m_zsInit)
+      deflateEnd(&m_zs);
+    if (m_cctx)
+      ZSTD_freeCCtx(m_cctx);
+  }
+  CompressedWriter(const CompressedWriter &) = delete;
+  CompressedWriter &operator=(const CompressedWriter &) = delete;
 
-  // Convert Wide to UTF-8
-  int len =
-      WideCharToMultiByte(CP_UTF8, 0, output.c_str(), -1, NULL, 0, NULL, NULL);
-  if (len == 0)
-    return false;
+  void Write(const char *data, size_t size) {
+    if (!m_ok)
+      return;
+    if (m_compression == FileUtils::GZIP)
+      Deflate(data, size, Z_NO_FLUSH);
+    else if (m_compression == FileUtils::ZSTD)
+      CompressZstd(data, size, ZSTD_e_continue);
+    else
+      Put(data, size);
+  }
 
-  std::vector<char> utf8Buffer(len);
-  WideCharToMultiByte(CP_UTF8, 0, output.c_str(), -1, utf8Buffer.data(), len,
-                      NULL, NULL);
-  // Remove null terminator from file write if present (length includes it)
-  int writeLen = len - 1;
+  bool Finish() {
+    if (m_ok && m_compression == FileUtils::GZIP)
+      Deflate(nullptr, 0, Z_FINISH);
+    else if (m_ok && m_compression == FileUtils::ZSTD)
+      CompressZstd(nullptr, 0, ZSTD_e_end);
+    return m_ok;
+  }
+
+private:
+  void Put(const void *data, size_t size) {
+    DWORD bytesWritten;
+    if (size > 0 && (!WriteFile(m_file, data, (DWORD)size, &bytesWritten,
+                                NULL) ||
+                     bytesWritten != size))
+      m_ok = false;
+  }
+
+  void Deflate(const char *data, size_t size, int flush) {
+    m_zs.next_in = (Bytef *)data;
+    m_zs.avail_in = (uInt)size;
+    int ret;
+    do {
+      m_zs.next_out = (Bytef *)m_buf.data();
+      m_zs.avail_out = (uInt)m_buf.size();
+      ret = deflate(&m_zs, flush);
+      if (ret == Z_STREAM_ERROR) {
+        m_ok = false;
+        return;
+      }
+      Put(m_buf.data(), m_buf.size() - m_zs.avail_out);
+    } while (m_ok && (m_zs.avail_out == 0 ||
+                      (flush == Z_FINISH && ret != Z_STREAM_END)));
+  }
+
+  void CompressZstd(const char *data, size_t size, ZSTD_EndDirective mode) {
+    ZSTD_inBuffer input = {data, size, 0};
+    size_t remaining;
+    do {
+      ZSTD_outBuffer output = {m_buf.data(), m_buf.size(), 0};
+      remaining = ZSTD_compressStream2(m_cctx, &output, &input, mode);
+      if (ZSTD_isError(remaining)) {
+        m_ok = false;
+        return;
+      }
+      Put(m_buf.data(), output.pos);
+    } while (m_ok && (mode == ZSTD_e_end ? remaining != 0
+                                          : input.pos < input.size));
+  }
+
+  HANDLE m_file;
+  FileUtils::Compression m_compression;
+  std::vector<char> m_buf;
+  z_stream m_zs = {};
+  bool m_zsInit = false;
+  ZSTD_CCtx *m_cctx = nullptr;
+  bool m_ok = true;
+};
+
+bool FileUtils::WriteFileUtf8(const std::wstring &path,
+                              const std::wstring &content, EolMode eol,
+                              Compression compression) {
+  // Convert Wide to UTF-8 first; line endings are converted on the way to
+  // the file
+  std::string utf8;
+  if (!content.empty()) {
+    int len = WideCharToMultiByte(CP_UTF8, 0, content.data(),
+                                  (int)content.size(), NULL, 0, NULL, NULL);
+    if (len == 0)
+      return false;
+    utf8.resize(len);
+    WideCharToMultiByte(CP_UTF8, 0, content.data(), (int)content.size(),
+                        &utf8[0], len, NULL, NULL);
+  }
 
   HANDLE hFile = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
                             FILE_ATTRIBUTE_NORMAL, NULL);
   if (hFile == INVALID_HANDLE_VALUE)
     return false;
 
-  DWORD bytesWritten;
   // Write BOM if needed? User didn't specify. Standard UTF-8 usually no BOM.
-  bool res = WriteFile(hFile, utf8Buffer.data(), writeLen, &bytesWritten, NULL);
+  // Chunks go from the line ending pass straight into the compressor, so
+  // no converted or compressed copy of the whole file is built.
+  bool res;
+  {
+    CompressedWriter writer(hFile, compression);
+    auto flush = [&](const char *data, size_t size) {
+      writer.Write(data, size);
+    };
+    {
+      ChunkSink<char, decltype(flush)> sink(flush);
+      DispatchEol(eol, [&](auto mode) {
+        WriteWithEol<decltype(mode)::value>(sink, utf8.data(), utf8.size());
+      });
+    }
+    res = writer.Finish();
+  }
   CloseHandle(hFile);
   return res;
 }
+
+bool FileUtils::WriteFileBytes(const std::wstring &path, const void *data,
+                               size_t size) {
+  HANDLE hFile = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+  DWORD bytesWritten;
+  bool res = WriteFile(hFile, data, (DWORD)size, &bytesWritten, NULL) &&
+             bytesWritten == size;
+  CloseHandle(hFile);
+  return res;
+}
+
+MappedFile::MappedFile(const std::wstring &path) {
+  HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return;
+  m_file = hFile;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+    return;
+  m_mapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!m_mapping)
+    return;
+  m_data = (const unsigned char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0,
+                                                0, 0);
+  if (m_data)
+    m_size = (size_t)size.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file)
+    CloseHandle(m_file);
+}
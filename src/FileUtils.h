@@ -1,12 +1,46 @@
 #pragma once
+#include <cstddef>
 #include <string>
 
 class FileUtils {
 public:
   enum EolMode { CRLF = 0, LF = 1, CR = 2 };
+  enum Compression { NONE, GZIP, ZSTD };
 
-  static std::wstring ReadFileUtf8(const std::wstring &path);
+  // Compression of data starting with these bytes (gzip 1F 8B, zstd
+  // 28 B5 2F FD), or NONE.
+  static Compression DetectCompression(const void *data, size_t size);
+  // Compression implied by the extension (.gz, .zst/.zstd), or NONE.
+  static Compression CompressionFromPath(const std::wstring &path);
+
+  // gzip and zstd files are recognized by their magic bytes and streamed
+  // through the decompressor; *compression, if given, receives what was
+  // found.
+  static std::wstring ReadFileUtf8(const std::wstring &path,
+                                   Compression *compression = nullptr);
   static bool WriteFileUtf8(const std::wstring &path,
-                            const std::wstring &content, EolMode eol);
+                            const std::wstring &content, EolMode eol,
+                            Compression compression = NONE);
   static std::wstring NormalizeToCrlf(const std::wstring &text);
+  static bool WriteFileBytes(const std::wstring &path, const void *data,
+                             size_t size);
+};
+
+// Read-only view of a whole file mapped into memory. Data() is nullptr if
+// the file could not be opened or is empty.
+class MappedFile {
+public:
+  explicit MappedFile(const std::wstring &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const unsigned char *Data() const { return m_data; }
+  size_t Size() const { return m_size; }
+
+private:
+  void *m_file = nullptr;    // HANDLE
+  void *m_mapping = nullptr; // HANDLE
+  const unsigned char *m_data = nullptr;
+  size_t m_size = 0;
 };
@@ -0,0 +1,225 @@
+#include "FindDialog.h"
+#include "../resources/resource.h"
+#include <commctrl.h>
+#include <cwchar>
+#include <shobjidl.h>
+#include <windowsx.h>
+
+static const wchar_t kClassName[] = L"JYEditorFindClass";
+
+std::wstring FindDialog::GetText(HWND hwnd) {
+  int len = GetWindowTextLength(hwnd);
+  std::wstring text(len + 1, L'\0');
+  GetWindowText(hwnd, &text[0], len + 1);
+  text.resize(len);
+  return text;
+}
+
+void FindDialog::Show(HWND owner, const Localizer &localize,
+                      const SearchOptions &options,
+                      const FileSearchOptions &scope) {
+  if (!m_hwnd) {
+    Create(owner);
+    Localize(localize);
+    SetWindowText(m_hFolder, scope.folder.c_str());
+    SetWindowText(m_hFilter, scope.include.c_str());
+    Button_SetCheck(m_hCase, options.matchCase ? BST_CHECKED : BST_UNCHECKED);
+    Button_SetCheck(m_hWord, options.wholeWord ? BST_CHECKED : BST_UNCHECKED);
+    Button_SetCheck(m_hRegex, options.regex ? BST_CHECKED : BST_UNCHECKED);
+  }
+  ShowWindow(m_hwnd, SW_SHOW);
+  SetFocus(m_hFind);
+  SendMessage(m_hFind, EM_SETSEL, 0, -1);
+}
+
+void FindDialog::Create(HWND owner) {
+  HINSTANCE hInstance = GetModuleHandle(NULL);
+  WNDCLASSEX wc = {0};
+  wc.cbSize = sizeof(WNDCLASSEX);
+  wc.lpfnWndProc = FindDialog::WindowProc;
+  wc.hInstance = hInstance;
+  wc.lpszClassName = kClassName;
+  wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+  wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+  RegisterClassEx(&wc);
+
+  m_owner = owner;
+  RECT rcOwner;
+  GetWindowRect(owner, &rcOwner);
+  m_hwnd = CreateWindowEx(WS_EX_TOOLWINDOW, kClassName, L"",
+                          WS_POPUP | WS_CAPTION | WS_SYSMENU,
+                          rcOwner.right - 520, rcOwner.top + 80, 500, 440,
+                          owner, NULL, hInstance, this);
+
+  auto control = [&](const wchar_t *cls, DWORD style, int x, int y, int w,
+                     int h, int id) {
+    bool sunken = wcscmp(cls, WC_EDIT) == 0 || wcscmp(cls, WC_LISTBOX) == 0;
+    HWND hwnd = CreateWindowEx(sunken ? WS_EX_CLIENTEDGE : 0, cls, L"",
+                               WS_CHILD | WS_VISIBLE | style, x, y, w, h,
+                               m_hwnd, (HMENU)(INT_PTR)id, hInstance, NULL);
+    SendMessage(hwnd, WM_SETFONT, (WPARAM)GetStockObject(DEFAULT_GUI_FONT),
+                0);
+    return hwnd;
+  };
+  // Labels and edits on the left, buttons in a column on the right
+  m_hFindLabel = control(WC_STATIC, 0, 10, 14, 80, 20, 0);
+  m_hFind = control(WC_EDIT, WS_TABSTOP | ES_AUTOHSCROLL, 90, 10, 270, 22,
+                    IDC_FIND_TEXT);
+  m_hReplaceLabel = control(WC_STATIC, 0, 10, 44, 80, 20, 0);
+  m_hReplace = control(WC_EDIT, WS_TABSTOP | ES_AUTOHSCROLL, 90, 40, 270, 22,
+                       IDC_REPLACE_TEXT);
+  m_hFolderLabel = control(WC_STATIC, 0, 10, 74, 80, 20, 0);
+  m_hFolder = control(WC_EDIT, WS_TABSTOP | ES_AUTOHSCROLL, 90, 70, 240, 22,
+                      IDC_FIND_FOLDER);
+  m_hBrowse = control(WC_BUTTON, WS_TABSTOP, 334, 70, 26, 22,
+                      IDC_FIND_BROWSE);
+  SetWindowText(m_hBrowse, L"...");
+  m_hFilterLabel = control(WC_STATIC, 0, 10, 104, 80, 20, 0);
+  m_hFilter = control(WC_EDIT, WS_TABSTOP | ES_AUTOHSCROLL, 90, 100, 270, 22,
+                      IDC_FIND_FILTER);
+  m_hCase = control(WC_BUTTON, WS_TABSTOP | BS_AUTOCHECKBOX, 90, 128, 270, 20,
+                    IDC_FIND_CASE);
+  m_hWord = control(WC_BUTTON, WS_TABSTOP | BS_AUTOCHECKBOX, 90, 150, 270, 20,
+                    IDC_FIND_WORD);
+  m_hRegex = control(WC_BUTTON, WS_TABSTOP | BS_AUTOCHECKBOX, 90, 172, 270,
+                     20, IDC_FIND_REGEX);
+  m_hFindNext = control(WC_BUTTON, WS_TABSTOP | BS_DEFPUSHBUTTON, 370, 9, 110,
+                        24, IDM_SEARCH_FIND_NEXT);
+  m_hReplaceOne = control(WC_BUTTON, WS_TABSTOP, 370, 39, 110, 24,
+                          IDM_SEARCH_REPLACE);
+  m_hReplaceAll = control(WC_BUTTON, WS_TABSTOP, 370, 69, 110, 24,
+                          IDM_SEARCH_REPLACE_ALL);
+  m_hFindAll = control(WC_BUTTON, WS_TABSTOP, 370, 99, 110, 24,
+                       IDM_SEARCH_FIND_ALL);
+  m_hFindInTabs = control(WC_BUTTON, WS_TABSTOP, 370, 129, 110, 24,
+                          IDM_SEARCH_FIND_IN_TABS);
+  m_hFindInFiles = control(WC_BUTTON, WS_TABSTOP, 370, 159, 110, 24,
+                           IDM_SEARCH_FIND_IN_FILES);
+  m_hStatus = control(WC_STATIC, 0, 10, 200, 470, 20, 0);
+  m_hResults = control(WC_LISTBOX,
+                       WS_TABSTOP | WS_VSCROLL | WS_HSCROLL | LBS_NOTIFY |
+                           LBS_NOINTEGRALHEIGHT,
+                       10, 222, 470, 172, IDC_FIND_RESULTS);
+  // Room for long result lines
+  SendMessage(m_hResults, LB_SETHORIZONTALEXTENT, 2000, 0);
+}
+
+void FindDialog::Localize(const Localizer &localize) {
+  if (!m_hwnd)
+    return;
+  SetWindowText(m_hwnd, localize("FindReplaceTitle").c_str());
+  SetWindowText(m_hFindLabel, localize("FindWhat").c_str());
+  SetWindowText(m_hReplaceLabel, localize("ReplaceWith").c_str());
+  SetWindowText(m_hFolderLabel, localize("LookIn").c_str());
+  SetWindowText(m_hFilterLabel, localize("FileTypes").c_str());
+  SetWindowText(m_hCase, localize("MatchCase").c_str());
+  SetWindowText(m_hWord, localize("WholeWord").c_str());
+  SetWindowText(m_hRegex, localize("RegularExpression").c_str());
+  SetWindowText(m_hFindNext, localize("FindNextButton").c_str());
+  SetWindowText(m_hReplaceOne, localize("Replace").c_str());
+  SetWindowText(m_hReplaceAll, localize("ReplaceAll").c_str());
+  SetWindowText(m_hFindAll, localize("FindAll").c_str());
+  SetWindowText(m_hFindInTabs, localize("FindInTabs").c_str());
+  SetWindowText(m_hFindInFiles, localize("FindInFiles").c_str());
+}
+
+void FindDialog::BrowseFolder() {
+  IFileOpenDialog *pDialog;
+  if (FAILED(CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_ALL,
+                              IID_IFileOpenDialog,
+                              reinterpret_cast<void **>(&pDialog))))
+    return;
+  DWORD options;
+  if (SUCCEEDED(pDialog->GetOptions(&options)))
+    pDialog->SetOptions(options | FOS_PICKFOLDERS);
+  if (SUCCEEDED(pDialog->Show(m_hwnd))) {
+    IShellItem *pItem;
+    if (SUCCEEDED(pDialog->GetResult(&pItem))) {
+      PWSTR pszPath;
+      if (SUCCEEDED(pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+        SetWindowText(m_hFolder, pszPath);
+        CoTaskMemFree(pszPath);
+      }
+      pItem->Release();
+    }
+  }
+  pDialog->Release();
+}
+
+SearchOptions FindDialog::Options() const {
+  SearchOptions options;
+  if (!m_hwnd)
+    return options;
+  options.matchCase = Button_GetCheck(m_hCase) == BST_CHECKED;
+  options.wholeWord = Button_GetCheck(m_hWord) == BST_CHECKED;
+  options.regex = Button_GetCheck(m_hRegex) == BST_CHECKED;
+  return options;
+}
+
+void FindDialog::SetStatus(const std::wstring &text) {
+  if (m_hwnd)
+    SetWindowText(m_hStatus, text.c_str());
+}
+
+void FindDialog::ClearResults() {
+  if (m_hwnd)
+    SendMessage(m_hResults, LB_RESETCONTENT, 0, 0);
+}
+
+void FindDialog::AddResults(const std::vector<std::wstring> &labels) {
+  if (!m_hwnd || labels.empty())
+    return;
+  SendMessage(m_hResults, WM_SETREDRAW, FALSE, 0);
+  for (const auto &label : labels)
+    SendMessage(m_hResults, LB_ADDSTRING, 0, (LPARAM)label.c_str());
+  SendMessage(m_hResults, WM_SETREDRAW, TRUE, 0);
+  InvalidateRect(m_hResults, NULL, TRUE);
+}
+
+int FindDialog::SelectedResult() const {
+  if (!m_hwnd)
+    return -1;
+  return (int)SendMessage(m_hResults, LB_GETCURSEL, 0, 0);
+}
+
+LRESULT CALLBACK FindDialog::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
+                                        LPARAM lParam) {
+  FindDialog *pThis;
+  if (uMsg == WM_NCCREATE) {
+    pThis = (FindDialog *)((CREATESTRUCT *)lParam)->lpCreateParams;
+    SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)pThis);
+  } else {
+    pThis = (FindDialog *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+  }
+
+  switch (uMsg) {
+  case WM_COMMAND: {
+    int id = LOWORD(wParam);
+    int code = HIWORD(wParam);
+    if (id == IDOK) // Enter in the find box
+      id = IDM_SEARCH_FIND_NEXT;
+    if (id == IDCANCEL) {
+      ShowWindow(hwnd, SW_HIDE);
+      return 0;
+    }
+    if (id == IDC_FIND_BROWSE) {
+      pThis->BrowseFolder();
+      return 0;
+    }
+    if (id == IDC_FIND_RESULTS) {
+      if (code == LBN_DBLCLK)
+        SendMessage(pThis->m_owner, WM_COMMAND, IDM_SEARCH_GOTO_RESULT, 0);
+      return 0;
+    }
+    if (id == IDM_SEARCH_FIND_NEXT || id == IDM_SEARCH_REPLACE ||
+        id == IDM_SEARCH_REPLACE_ALL || id == IDM_SEARCH_FIND_ALL ||
+        id == IDM_SEARCH_FIND_IN_TABS || id == IDM_SEARCH_FIND_IN_FILES)
+      SendMessage(pThis->m_owner, WM_COMMAND, id, 0);
+    return 0;
+  }
+  case WM_CLOSE:
+    ShowWindow(hwnd, SW_HIDE); // Kept for the next Find
+    return 0;
+  }
+  return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
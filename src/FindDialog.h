@@ -0,0 +1,51 @@
+#pragma once
+#include "FileSearch.h"
+#include "SearchEngine.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <windows.h>
+
+// Modeless Find / Replace window. Its buttons are forwarded to the owner
+// as WM_COMMAND with the IDM_SEARCH_* ids, and double-clicking a result as
+// IDM_SEARCH_GOTO_RESULT; the owner reads the pattern, options and the
+// Find in Files folder and file filter back.
+class FindDialog {
+public:
+  typedef std::function<std::wstring(const std::string &)> Localizer;
+
+  // Creates the window on first use, then shows and focuses it.
+  void Show(HWND owner, const Localizer &localize,
+            const SearchOptions &options, const FileSearchOptions &scope);
+  void Localize(const Localizer &localize);
+  HWND Window() const { return m_hwnd; }
+
+  std::wstring Pattern() const { return GetText(m_hFind); }
+  std::wstring Replacement() const { return GetText(m_hReplace); }
+  SearchOptions Options() const;
+  std::wstring Folder() const { return GetText(m_hFolder); }
+  std::wstring Filter() const { return GetText(m_hFilter); }
+
+  void SetStatus(const std::wstring &text);
+  void ClearResults();
+  void AddResults(const std::vector<std::wstring> &labels);
+  int SelectedResult() const; // -1 if none
+
+private:
+  static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam,
+                                     LPARAM lParam);
+  static std::wstring GetText(HWND hwnd);
+  void Create(HWND owner);
+  void BrowseFolder();
+
+  HWND m_hwnd = NULL;
+  HWND m_owner = NULL;
+  HWND m_hFindLabel = NULL, m_hReplaceLabel = NULL, m_hFolderLabel = NULL,
+       m_hFilterLabel = NULL;
+  HWND m_hFind = NULL, m_hReplace = NULL, m_hFolder = NULL, m_hFilter = NULL;
+  HWND m_hBrowse = NULL;
+  HWND m_hCase = NULL, m_hWord = NULL, m_hRegex = NULL;
+  HWND m_hFindNext = NULL, m_hReplaceOne = NULL, m_hReplaceAll = NULL,
+       m_hFindAll = NULL, m_hFindInTabs = NULL, m_hFindInFiles = NULL;
+  HWND m_hStatus = NULL, m_hResults = NULL;
+};
@@ -0,0 +1,294 @@
+#include "GuidIndex.h"
+#include "FileUtils.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <deque>
+#include <filesystem>
+#include <string_view>
+#include <windows.h>
+#include <shlwapi.h>
+
+static const char kMagic[4] = {'J', 'Y', 'G', 'I'};
+static const uint32_t kVersion = 1;
+// A NUL byte this close to the start marks a file as binary, as in grep.
+static const size_t kBinaryProbe = 8000;
+
+template <typename CharT>
+bool Guid::Parse(const CharT *text, size_t size, Guid &guid) {
+  if (size < 32)
+    return false;
+  uint64_t half[2] = {0, 0};
+  for (size_t i = 0; i < 32; i++) {
+    CharT c = text[i];
+    unsigned digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      return false;
+    half[i / 16] = half[i / 16] << 4 | digit;
+  }
+  guid.hi = half[0];
+  guid.lo = half[1];
+  return true;
+}
+
+template bool Guid::Parse<char>(const char *, size_t, Guid &);
+template bool Guid::Parse<wchar_t>(const wchar_t *, size_t, Guid &);
+
+std::wstring Guid::ToString() const {
+  static const wchar_t kDigits[] = L"0123456789abcdef";
+  std::wstring text(32, L'0');
+  for (int i = 0; i < 16; i++) {
+    text[15 - i] = kDigits[(hi >> (4 * i)) & 15];
+    text[31 - i] = kDigits[(lo >> (4 * i)) & 15];
+  }
+  return text;
+}
+
+// Paths are compared as Windows does: case-insensitively.
+static std::wstring Lower(std::wstring text) {
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](wchar_t c) { return (wchar_t)towlower(c); });
+  return text;
+}
+
+static bool IsMeta(const std::wstring &path) {
+  return path.size() > 5 && Lower(path.substr(path.size() - 5)) == L".meta";
+}
+
+static bool MatchesSpec(const std::wstring &name, const std::wstring &spec) {
+  return PathMatchSpecEx(name.c_str(), spec.c_str(), PMSF_MULTIPLE) == S_OK;
+}
+
+// The GUID of a .meta file, or every GUID a scene or asset references
+static void ScanFile(const std::wstring &path, GuidIndex::File &file) {
+  MappedFile mapped(path);
+  const char *data = (const char *)mapped.Data();
+  size_t size = mapped.Size();
+  if (!data || memchr(data, 0, std::min(size, kBinaryProbe)))
+    return; // Empty, unreadable or binary
+  bool meta = IsMeta(file.path);
+  std::string_view text(data, size);
+  for (size_t i = text.find("guid:"); i != std::string_view::npos;
+       i = text.find("guid:", i + 5)) {
+    size_t p = i + 5;
+    while (p < size && text[p] == ' ')
+      p++;
+    Guid guid;
+    if (!Guid::Parse(data + p, size - p, guid) || guid.Empty())
+      continue;
+    if (meta) {
+      file.guid = guid;
+      return;
+    }
+    file.refs.push_back(guid);
+  }
+  std::sort(file.refs.begin(), file.refs.end());
+  file.refs.erase(std::unique(file.refs.begin(), file.refs.end()),
+                  file.refs.end());
+}
+
+GuidIndex::GuidIndex(const std::wstring &root, const GuidIndexOptions &options,
+                     const GuidIndex *previous,
+                     const std::atomic<bool> &cancel)
+    : m_root(root) {
+  namespace fs = std::filesystem;
+  const std::unordered_map<std::wstring, size_t> *known =
+      previous && Lower(previous->m_root) == Lower(root) ? &previous->m_byPath
+                                                         : nullptr;
+
+  // Files are scanned while the walk goes on; a deque keeps the entries
+  // the workers fill in place
+  std::deque<File> files;
+  ThreadPool pool(options.threads);
+  fs::path rootPath(root);
+  std::error_code ec;
+  fs::recursive_directory_iterator it(
+      rootPath, fs::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != fs::recursive_directory_iterator() && !cancel;
+       it.increment(ec)) {
+    const fs::directory_entry &entry = *it;
+    std::wstring name = entry.path().filename().wstring();
+    std::error_code entryEc;
+    if (entry.is_directory(entryEc)) {
+      if (!options.excludeFolders.empty() &&
+          MatchesSpec(name, options.excludeFolders))
+        it.disable_recursion_pending();
+      continue;
+    }
+    if (!entry.is_regular_file(entryEc) ||
+        !MatchesSpec(name, options.include))
+      continue;
+    uint64_t size = entry.file_size(entryEc);
+    uint64_t time =
+        (uint64_t)entry.last_write_time(entryEc).time_since_epoch().count();
+    if (entryEc || size > options.maxFileSize)
+      continue;
+
+    File &file = files.emplace_back();
+    file.path = entry.path().lexically_relative(rootPath).wstring();
+    file.time = time;
+    file.size = size;
+    if (known) {
+      auto old = known->find(Lower(file.path));
+      if (old != known->end()) {
+        const File &before = previous->m_files[old->second];
+        if (before.time == time && before.size == size) {
+          file.guid = before.guid;
+          file.refs = before.refs;
+          continue;
+        }
+      }
+    }
+    m_rescanned++;
+    std::wstring path = entry.path().wstring();
+    pool.Submit([&file, path](unsigned) { ScanFile(path, file); });
+  }
+  pool.Wait();
+  m_files.assign(std::make_move_iterator(files.begin()),
+                 std::make_move_iterator(files.end()));
+  Link();
+}
+
+void GuidIndex::Link() {
+  for (size_t i = 0; i < m_files.size(); i++) {
+    const File &file = m_files[i];
+    m_byPath.emplace(Lower(file.path), i);
+    if (!file.guid.Empty())
+      m_byGuid.emplace(file.guid, i);
+    for (const Guid &guid : file.refs)
+      m_referrers[guid].push_back(i);
+  }
+}
+
+std::wstring GuidIndex::FullPath(size_t file) const {
+  return (std::filesystem::path(m_root) / m_files[file].path).wstring();
+}
+
+std::wstring GuidIndex::AssetPath(const Guid &guid) const {
+  auto it = m_byGuid.find(guid);
+  if (it == m_byGuid.end())
+    return L"";
+  std::wstring path = FullPath(it->second);
+  return path.substr(0, path.size() - 5); // Without ".meta"
+}
+
+Guid GuidIndex::GuidOf(const std::wstring &path) const {
+  namespace fs = std::filesystem;
+  fs::path relative = fs::path(path).lexically_normal().lexically_relative(
+      fs::path(m_root).lexically_normal());
+  auto it = m_byPath.find(Lower(relative.wstring() + L".meta"));
+  return it == m_byPath.end() ? Guid() : m_files[it->second].guid;
+}
+
+std::vector<std::wstring> GuidIndex::Referrers(const Guid &guid) const {
+  std::vector<std::wstring> paths;
+  auto it = m_referrers.find(guid);
+  if (it != m_referrers.end())
+    for (size_t file : it->second)
+      paths.push_back(FullPath(file));
+  return paths;
+}
+
+// Saved layout, in native byte order: magic, version, root, file count,
+// then per file its path, time, size, GUID, reference count and
+// references. Strings are a 32-bit length and UTF-16 units.
+template <typename T> static void Append(std::string &out, const T &value) {
+  out.append((const char *)&value, sizeof(T));
+}
+
+static void AppendString(std::string &out, const std::wstring &text) {
+  Append(out, (uint32_t)text.size());
+  out.append((const char *)text.data(), text.size() * sizeof(wchar_t));
+}
+
+bool GuidIndex::Save(const std::wstring &path) const {
+  std::string out(kMagic, sizeof(kMagic));
+  Append(out, kVersion);
+  AppendString(out, m_root);
+  Append(out, (uint64_t)m_files.size());
+  for (const File &file : m_files) {
+    AppendString(out, file.path);
+    Append(out, file.time);
+    Append(out, file.size);
+    Append(out, file.guid);
+    Append(out, (uint32_t)file.refs.size());
+    out.append((const char *)file.refs.data(), file.refs.size() * sizeof(Guid));
+  }
+  return FileUtils::WriteFileBytes(path, out.data(), out.size());
+}
+
+// Bounds-checked reads from a saved index; ok turns false on a short read.
+class IndexReader {
+public:
+  IndexReader(const unsigned char *data, size_t size)
+      : m_data(data), m_size(size) {}
+  bool ok = true;
+
+  template <typename T> T Read() {
+    T value = T();
+    Bytes(&value, sizeof(T));
+    return value;
+  }
+  void Bytes(void *out, size_t size) {
+    if (!ok || size > m_size - m_pos) {
+      ok = false;
+      return;
+    }
+    if (size > 0)
+      memcpy(out, m_data + m_pos, size);
+    m_pos += size;
+  }
+  std::wstring String() {
+    uint32_t length = Read<uint32_t>();
+    if (!ok || length > (m_size - m_pos) / sizeof(wchar_t)) {
+      ok = false;
+      return L"";
+    }
+    std::wstring text(length, L'\0');
+    Bytes(&text[0], length * sizeof(wchar_t));
+    return text;
+  }
+
+private:
+  const unsigned char *m_data;
+  size_t m_size;
+  size_t m_pos = 0;
+};
+
+std::unique_ptr<GuidIndex> GuidIndex::Load(const std::wstring &path) {
+  MappedFile mapped(path);
+  IndexReader reader(mapped.Data(), mapped.Size());
+  char magic[4];
+  reader.Bytes(magic, sizeof(magic));
+  if (!mapped.Data() || !reader.ok || memcmp(magic, kMagic, 4) != 0 ||
+      reader.Read<uint32_t>() != kVersion)
+    return nullptr;
+
+  std::unique_ptr<GuidIndex> index(new GuidIndex());
+  index->m_root = reader.String();
+  uint64_t count = reader.Read<uint64_t>();
+  while (reader.ok && count-- > 0) {
+    File file;
+    file.path = reader.String();
+    file.time = reader.Read<uint64_t>();
+    file.size = reader.Read<uint64_t>();
+    file.guid = reader.Read<Guid>();
+    uint32_t refs = reader.Read<uint32_t>();
+    if (!reader.ok || refs > mapped.Size() / sizeof(Guid))
+      return nullptr;
+    file.refs.resize(refs);
+    reader.Bytes(file.refs.data(), refs * sizeof(Guid));
+    index->m_files.push_back(std::move(file));
+  }
+  if (!reader.ok)
+    return nullptr;
+  index->Link();
+  return index;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A Unity asset GUID: 32 hex digits, as in "guid: 0123...".
+struct Guid {
+  uint64_t hi = 0, lo = 0;
+
+  bool Empty() const { return hi == 0 && lo == 0; }
+  bool operator==(const Guid &other) const {
+    return hi == other.hi && lo == other.lo;
+  }
+  bool operator<(const Guid &other) const {
+    return hi != other.hi ? hi < other.hi : lo < other.lo;
+  }
+  std::wstring ToString() const;
+
+  // Parses the 32 hex digits at text; false if there are fewer.
+  template <typename CharT>
+  static bool Parse(const CharT *text, size_t size, Guid &guid);
+};
+
+struct GuidHash {
+  size_t operator()(const Guid &guid) const {
+    return (size_t)(guid.hi ^ (guid.lo * 0x9E3779B97F4A7C15ull));
+  }
+};
+
+struct GuidIndexOptions {
+  // Files scanned, ';'-separated name patterns; .meta files give the
+  // GUIDs, the others the references
+  std::wstring include =
+      L"*.meta;*.unity;*.prefab;*.asset;*.mat;*.anim;*.controller;"
+      L"*.overrideController;*.playable;*.mask;*.physicMaterial;"
+      L"*.spriteatlas;*.lighting;*.mixer;*.preset;*.terrainlayer";
+  std::wstring excludeFolders = L".git;Library;Temp;Logs;obj";
+  uint64_t maxFileSize = 64 << 20; // Larger files are skipped
+  unsigned threads = 0;            // 0: one per hardware thread
+};
+
+// GUID index of a Unity project: which asset each GUID names (from the
+// .meta files) and which files reference each GUID (from the "guid:"
+// entries of scenes, prefabs and other YAML assets).
+//
+// The folder is walked on the calling thread while a work-stealing
+// ThreadPool scans the memory-mapped files for "guid:". The index is
+// saved to disk with each file's time and size, so a rebuild from the
+// saved index rescans only the files that changed. Lookups are hash table
+// hits.
+class GuidIndex {
+public:
+  struct File {
+    std::wstring path; // Relative to the root
+    uint64_t time = 0, size = 0;
+    Guid guid;              // Of a .meta file; empty for other files
+    std::vector<Guid> refs; // GUIDs referenced, sorted, without repeats
+  };
+
+  // Indexes root. Files whose time and size match their entry in previous
+  // are taken from it rather than scanned again. Stops early once cancel
+  // is set; the index is then incomplete.
+  GuidIndex(const std::wstring &root, const GuidIndexOptions &options,
+            const GuidIndex *previous, const std::atomic<bool> &cancel);
+
+  // Reads an index written by Save; null if missing or unreadable.
+  static std::unique_ptr<GuidIndex> Load(const std::wstring &path);
+  bool Save(const std::wstring &path) const;
+
+  const std::wstring &Root() const { return m_root; }
+  size_t FileCount() const { return m_files.size(); }
+  size_t Rescanned() const { return m_rescanned; } // Files read this time
+
+  // Full path of the asset guid names (its .meta file's path without
+  // ".meta"), or empty.
+  std::wstring AssetPath(const Guid &guid) const;
+  // GUID of the asset at path, from its .meta file; empty if unknown.
+  Guid GuidOf(const std::wstring &path) const;
+  // Full paths of the files referencing guid.
+  std::vector<std::wstring> Referrers(const Guid &guid) const;
+
+private:
+  GuidIndex() = default;
+  void Link(); // Builds the lookup tables from m_files
+  std::wstring FullPath(size_t file) const;
+
+  std::wstring m_root;
+  std::vector<File> m_files;
+  size_t m_rescanned = 0;
+  std::unordered_map<Guid, size_t, GuidHash> m_byGuid; // .meta file
+  std::unordered_map<Guid, std::vector<size_t>, GuidHash> m_referrers;
+  std::unordered_map<std::wstring, size_t> m_byPath; // Lowercase, relative
+};
@@ -0,0 +1,182 @@
+#include "JsonEscape.h"
+#include "Simd.h"
+#include <cstdint>
+
+static bool NeedsEscape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+size_t JsonEscape::FindEscape(const char *data, size_t size) {
+  size_t i = 0;
+#ifdef JY_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  while (i + 16 <= size) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    // Unsigned v <= 0x1F is max(v, 0x1F) == 0x1F
+    __m128i hit = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+    unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+    if (mask)
+      return i + CountTrailingZeros(mask);
+    i += 16;
+  }
+#endif
+  while (i < size && !NeedsEscape((unsigned char)data[i]))
+    i++;
+  return i;
+}
+
+void JsonEscape::Escape(std::string &out, const char *data, size_t size) {
+  static const char kHex[] = "0123456789abcdef";
+  size_t i = 0;
+  while (i < size) {
+    size_t run = FindEscape(data + i, size - i);
+    out.append(data + i, run);
+    i += run;
+    if (i >= size)
+      break;
+    unsigned char c = (unsigned char)data[i++];
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      out += "\\u00";
+      out += kHex[c >> 4];
+      out += kHex[c & 0xF];
+      break;
+    }
+  }
+}
+
+static size_t FindBackslash(const char *data, size_t size) {
+  size_t i = 0;
+#ifdef JY_SSE2
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (i + 16 <= size) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash));
+    if (mask)
+      return i + CountTrailingZeros(mask);
+    i += 16;
+  }
+#endif
+  while (i < size && data[i] != '\\')
+    i++;
+  return i;
+}
+
+static bool ReadHex4(const char *p, uint32_t &value) {
+  value = 0;
+  for (int k = 0; k < 4; k++) {
+    char c = p[k];
+    value <<= 4;
+    if (c >= '0' && c <= '9')
+      value |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      value |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      value |= c - 'A' + 10;
+    else
+      return false;
+  }
+  return true;
+}
+
+static void AppendUtf8(std::string &out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += (char)cp;
+  } else if (cp < 0x800) {
+    out += (char)(0xC0 | (cp >> 6));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += (char)(0xE0 | (cp >> 12));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else {
+    out += (char)(0xF0 | (cp >> 18));
+    out += (char)(0x80 | ((cp >> 12) & 0x3F));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+bool JsonEscape::Unescape(std::string &out, const char *data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    size_t run = FindBackslash(data + i, size - i);
+    out.append(data + i, run);
+    i += run;
+    if (i >= size)
+      break;
+    if (i + 1 >= size)
+      return false;
+    char c = data[i + 1];
+    i += 2;
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      out += c;
+      break;
+    case 'b':
+      out += '\b';
+      break;
+    case 'f':
+      out += '\f';
+      break;
+    case 'n':
+      out += '\n';
+      break;
+    case 'r':
+      out += '\r';
+      break;
+    case 't':
+      out += '\t';
+      break;
+    case 'u': {
+      uint32_t cp;
+      if (i + 4 > size || !ReadHex4(data + i, cp))
+        return false;
+      i += 4;
+      if (cp >= 0xD800 && cp <= 0xDBFF) {
+        // High surrogate: must be followed by \uDC00-\uDFFF
+        uint32_t low;
+        if (i + 6 > size || data[i] != '\\' || data[i + 1] != 'u' ||
+            !ReadHex4(data + i + 2, low) || low < 0xDC00 || low > 0xDFFF)
+          return false;
+        i += 6;
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+      } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        return false; // Lone low surrogate
+      }
+      AppendUtf8(out, cp);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// JSON string escaping. Both directions scan 16 bytes at a time (SSE2) for
+// the next byte that needs work and copy the clean run before it in bulk,
+// so strings without escapes cost little more than a memcpy.
+class JsonEscape {
+public:
+  // Index of the first byte that must be escaped (quote, backslash or a
+  // control character), or size if there is none.
+  static size_t FindEscape(const char *data, size_t size);
+
+  // Appends data to out as the body of a JSON string (without quotes).
+  static void Escape(std::string &out, const char *data, size_t size);
+
+  // Appends the decoded body of a JSON string (without quotes) to out.
+  // \uXXXX escapes, including surrogate pairs, become UTF-8. Returns false
+  // on an invalid escape sequence.
+  static bool Unescape(std::string &out, const char *data, size_t size);
+};
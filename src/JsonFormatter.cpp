@@ -0,0 +1,294 @@
+#include "JsonFormatter.h"
+#include "OutputSink.h"
+#include "Simd.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+static bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Index of the first non-whitespace byte at or after i.
+static size_t SkipWhitespace(const char *p, size_t i, size_t n) {
+  // Runs between tokens are usually short, so test a byte first.
+  if (i < n && !IsSpace(p[i]))
+    return i;
+#ifdef JY_SSE2
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  while (i + 16 <= n) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+    unsigned mask = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFF;
+    if (mask)
+      return i + CountTrailingZeros(mask);
+    i += 16;
+  }
+#endif
+  while (i < n && IsSpace(p[i]))
+    i++;
+  return i;
+}
+
+static bool IsHexDigit(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+         (c >= 'A' && c <= 'F');
+}
+
+// Index just past the closing quote of the string whose opening quote is at
+// i, or npos if it is unterminated. Strict also checks the contents against
+// the JSON grammar: no raw control characters, and a backslash only before
+// one of "\/bfnrt or before u and four hex digits. An invalid string returns
+// npos too, with *bad set to the offending byte (npos if unterminated).
+template <bool Strict = false>
+static size_t ScanString(const char *p, size_t i, size_t n,
+                         size_t *bad = nullptr) {
+  if (Strict)
+    *bad = std::string::npos;
+  i++;
+  for (;;) {
+#ifdef JY_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (i + 16 <= n) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+      __m128i stop =
+          _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+      if (Strict) // Bytes up to 0x1F, unsigned
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+      unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+      if (mask) {
+        i += CountTrailingZeros(mask);
+        break;
+      }
+      i += 16;
+    }
+#endif
+    while (i < n && p[i] != '"' && p[i] != '\\' &&
+           (!Strict || (unsigned char)p[i] >= 0x20))
+      i++;
+    if (i >= n)
+      return std::string::npos;
+    if (p[i] == '"')
+      return i + 1;
+    if (Strict && p[i] != '\\') {
+      *bad = i;
+      return std::string::npos;
+    }
+    if (i + 1 >= n)
+      return std::string::npos;
+    if (Strict && p[i + 1] == 'u') {
+      for (size_t k = i + 2; k < i + 6; k++) {
+        if (k >= n)
+          return std::string::npos;
+        if (!IsHexDigit(p[k])) {
+          *bad = i;
+          return std::string::npos;
+        }
+      }
+      i += 6;
+      continue;
+    }
+    if (Strict && !memchr("\"\\/bfnrt", p[i + 1], 8)) {
+      *bad = i;
+      return std::string::npos;
+    }
+    i += 2; // Skip the escaped character
+  }
+}
+
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Validates a number literal against the JSON grammar.
+static bool IsNumber(const char *p, size_t len) {
+  size_t i = 0;
+  if (i < len && p[i] == '-')
+    i++;
+  if (i >= len)
+    return false;
+  if (p[i] == '0') {
+    i++;
+  } else if (IsDigit(p[i])) {
+    while (i < len && IsDigit(p[i]))
+      i++;
+  } else {
+    return false;
+  }
+  if (i < len && p[i] == '.') {
+    i++;
+    if (i >= len || !IsDigit(p[i]))
+      return false;
+    while (i < len && IsDigit(p[i]))
+      i++;
+  }
+  if (i < len && (p[i] == 'e' || p[i] == 'E')) {
+    i++;
+    if (i < len && (p[i] == '+' || p[i] == '-'))
+      i++;
+    if (i >= len || !IsDigit(p[i]))
+      return false;
+    while (i < len && IsDigit(p[i]))
+      i++;
+  }
+  return i == len;
+}
+
+static void SyntaxError(const char *p, size_t pos, const char *what) {
+  size_t line = 1, column = 1;
+  for (size_t i = 0; i < pos; i++) {
+    if (p[i] == '\n') {
+      line++;
+      column = 1;
+    } else {
+      column++;
+    }
+  }
+  throw std::runtime_error("JSON syntax error at line " + std::to_string(line) +
+                           ", column " + std::to_string(column) + ": " + what);
+}
+
+// Single pass over the source, instantiated once per sink and layout:
+// with a NullSink the text is only validated, and Pretty = false minifies.
+template <bool Pretty, typename Sink>
+static void Reformat(const char *p, size_t n, int indent, const char *newline,
+                     size_t baseColumn, Sink &out) {
+  enum Expect { VALUE, KEY, COLON, COMMA };
+  std::vector<char> stack; // Open brackets
+  Expect expect = VALUE;
+  size_t newlineLen = newline ? strlen(newline) : 0;
+
+  auto breakLine = [&](size_t depth) {
+    if (!Pretty)
+      return;
+    out.Write(newline, newlineLen);
+    out.Fill(' ', baseColumn + depth * indent);
+  };
+
+  size_t i = SkipWhitespace(p, 0, n);
+  if (i >= n)
+    SyntaxError(p, i, "empty document");
+
+  while (i < n) {
+    char c = p[i];
+    if (expect == COLON) {
+      if (c != ':')
+        SyntaxError(p, i, "expected ':'");
+      if (Pretty)
+        out.Write(": ", 2);
+      else
+        out.Put(':');
+      expect = VALUE;
+      i = SkipWhitespace(p, i + 1, n);
+      continue;
+    }
+    if (expect == COMMA) {
+      if (stack.empty())
+        SyntaxError(p, i, "unexpected content after the value");
+      if (c == ',') {
+        out.Put(',');
+        breakLine(stack.size());
+        expect = stack.back() == '{' ? KEY : VALUE;
+        i = SkipWhitespace(p, i + 1, n);
+        continue;
+      }
+      if (c != (stack.back() == '{' ? '}' : ']'))
+        SyntaxError(p, i, "expected ',' or a closing bracket");
+      stack.pop_back();
+      breakLine(stack.size());
+      out.Put(c);
+      i = SkipWhitespace(p, i + 1, n);
+      continue;
+    }
+
+    // KEY or VALUE
+    if (c == '"') {
+      size_t bad;
+      size_t end = ScanString<true>(p, i, n, &bad);
+      if (end == std::string::npos) {
+        if (bad == std::string::npos)
+          SyntaxError(p, i, "unterminated string");
+        SyntaxError(p, bad,
+                    p[bad] == '\\' ? "invalid escape in a string"
+                                    : "control character in a string");
+      }
+      out.Write(p + i, end - i);
+      expect = (expect == KEY) ? COLON : COMMA;
+      i = SkipWhitespace(p, end, n);
+      continue;
+    }
+    if (expect == KEY)
+      SyntaxError(p, i, "expected a string key");
+
+    if (c == '{' || c == '[') {
+      char close = (c == '{') ? '}' : ']';
+      size_t next = SkipWhitespace(p, i + 1, n);
+      if (next < n && p[next] == close) {
+        // Empty containers stay on one line
+        out.Put(c);
+        out.Put(close);
+        expect = COMMA;
+        i = SkipWhitespace(p, next + 1, n);
+        continue;
+      }
+      stack.push_back(c);
+      out.Put(c);
+      breakLine(stack.size());
+      expect = (c == '{') ? KEY : VALUE;
+      i = next;
+      continue;
+    }
+
+    // Number or literal: copied as written
+    size_t end = i;
+    while (end < n && !IsSpace(p[end]) && p[end] != ',' && p[end] != ']' &&
+           p[end] != '}' && p[end] != ':')
+      end++;
+    size_t len = end - i;
+    bool ok = (len == 4 && memcmp(p + i, "true", 4) == 0) ||
+              (len == 5 && memcmp(p + i, "false", 5) == 0) ||
+              (len == 4 && memcmp(p + i, "null", 4) == 0) ||
+              IsNumber(p + i, len);
+    if (!ok)
+      SyntaxError(p, i, "invalid value");
+    out.Write(p + i, len);
+    expect = COMMA;
+    i = SkipWhitespace(p, end, n);
+  }
+
+  if (!stack.empty() || expect != COMMA)
+    SyntaxError(p, n, "unexpected end of input");
+}
+
+std::string JsonFormatter::Format(const char *data, size_t size, int indent,
+                                  const char *newline, size_t baseColumn) {
+  std::string out;
+  out.reserve(size + size / 4);
+  StringSink<char> sink(out);
+  Reformat<true>(data, size, indent < 0 ? 0 : indent, newline, baseColumn,
+                 sink);
+  return out;
+}
+
+std::string JsonFormatter::Minify(const char *data, size_t size) {
+  std::string out;
+  out.reserve(size);
+  StringSink<char> sink(out);
+  Reformat<false>(data, size, 0, nullptr, 0, sink);
+  return out;
+}
+
+bool JsonFormatter::IsValid(const char *data, size_t size) {
+  try {
+    NullSink<char> sink;
+    Reformat<false>(data, size, 0, nullptr, 0, sink);
+    return true;
+  } catch (const std::runtime_error &) {
+    return false;
+  }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Streaming JSON reformatter.
+//
+// Reads the source once, token by token, and writes the reformatted text
+// straight into the output string. No DOM is built: the only state is a
+// stack of open brackets, so extra memory is proportional to the nesting
+// depth. Object keys keep their order, and strings and numbers are copied
+// byte for byte, so the output differs from the input only in whitespace.
+class JsonFormatter {
+public:
+  // Pretty-prints with indent spaces per level and newline between lines.
+  // Lines after the first start at baseColumn, for reformatting a value
+  // nested inside a larger document. Throws std::runtime_error with the
+  // line and column of a syntax error.
+  static std::string Format(const char *data, size_t size, int indent,
+                            const char *newline = "\r\n",
+                            size_t baseColumn = 0);
+  // Removes all insignificant whitespace.
+  static std::string Minify(const char *data, size_t size);
+
+  // True if the text is a single syntactically valid JSON value.
+  static bool IsValid(const char *data, size_t size);
+};
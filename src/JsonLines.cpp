@@ -0,0 +1,143 @@
+#include "JsonLines.h"
+#include "JsonFormatter.h"
+#include "Simd.h"
+#include <cstring>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <thread>
+
+// Below this size a single thread is faster than starting more.
+static const size_t kMinChunk = 4 << 20;
+
+static unsigned ThreadCount(unsigned threads, size_t work, size_t minChunk) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  size_t useful = work / minChunk + 1;
+  if (threads > useful)
+    threads = (unsigned)useful;
+  return threads == 0 ? 1 : threads;
+}
+
+// True if the line starting at i has only spaces, tabs or a CR.
+static bool IsBlankLine(const char *p, size_t i, size_t n) {
+  for (; i < n && p[i] != '\n'; i++) {
+    if (p[i] != ' ' && p[i] != '\t' && p[i] != '\r')
+      return false;
+  }
+  return true;
+}
+
+// Appends the start of every non-blank line beginning after a newline in
+// [begin, end). Each 16-byte block yields a bit mask of its newlines,
+// which is walked bit by bit, so short lines cost no rescanning.
+static void ScanLineStarts(const char *p, size_t n, size_t begin, size_t end,
+                           std::vector<uint64_t> &starts) {
+  auto newline = [&](size_t at) {
+    if (at + 1 < n && !IsBlankLine(p, at + 1, n))
+      starts.push_back(at + 1);
+  };
+  size_t i = begin;
+#ifdef JY_SSE2
+  const __m128i lf = _mm_set1_epi8('\n');
+  for (; i + 16 <= end; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+    while (mask != 0) {
+      newline(i + CountTrailingZeros(mask));
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < end; i++) {
+    if (p[i] == '\n')
+      newline(i);
+  }
+}
+
+void JsonLinesIndex::Build(const char *data, size_t size, unsigned threads) {
+  m_data = data;
+  m_size = size;
+  m_starts.clear();
+  if (size == 0)
+    return;
+  if (!IsBlankLine(data, 0, size))
+    m_starts.push_back(0);
+
+  unsigned count = ThreadCount(threads, size, kMinChunk);
+  std::vector<std::vector<uint64_t>> parts(count);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < count; t++) {
+    size_t begin = size * t / count, end = size * (t + 1) / count;
+    if (t + 1 == count)
+      ScanLineStarts(data, size, begin, end, parts[t]);
+    else
+      workers.emplace_back(ScanLineStarts, data, size, begin, end,
+                           std::ref(parts[t]));
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  size_t total = m_starts.size();
+  for (const auto &part : parts)
+    total += part.size();
+  m_starts.reserve(total);
+  for (const auto &part : parts)
+    m_starts.insert(m_starts.end(), part.begin(), part.end());
+}
+
+void JsonLinesIndex::Record(size_t i, const char *&begin, size_t &size) const {
+  size_t start = (size_t)m_starts[i];
+  const char *eol =
+      (const char *)memchr(m_data + start, '\n', m_size - start);
+  size_t end = eol ? (size_t)(eol - m_data) : m_size;
+  if (end > start && m_data[end - 1] == '\r')
+    end--;
+  begin = m_data + start;
+  size = end - start;
+}
+
+ModelPtr JsonLinesIndex::Parse(size_t i) const {
+  const char *begin;
+  size_t size;
+  Record(i, begin, size);
+  return Model::FromJson(nlohmann::json::parse(begin, begin + size));
+}
+
+std::vector<JsonLinesError> JsonLinesIndex::Validate(unsigned threads) const {
+  size_t records = Count();
+  unsigned count = ThreadCount(threads, m_size, kMinChunk);
+  std::vector<std::vector<JsonLinesError>> parts(count);
+  auto check = [this](size_t first, size_t last,
+                       std::vector<JsonLinesError> &errors) {
+    for (size_t i = first; i < last; i++) {
+      const char *begin;
+      size_t size;
+      Record(i, begin, size);
+      if (JsonFormatter::IsValid(begin, size))
+        continue;
+      // Invalid records are rare; run again for the message
+      try {
+        JsonFormatter::Minify(begin, size);
+      } catch (const std::runtime_error &e) {
+        errors.push_back({i, e.what()});
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < count; t++) {
+    size_t first = records * t / count, last = records * (t + 1) / count;
+    if (t + 1 == count)
+      check(first, last, parts[t]);
+    else
+      workers.emplace_back(check, first, last, std::ref(parts[t]));
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  std::vector<JsonLinesError> errors;
+  for (auto &part : parts)
+    errors.insert(errors.end(), std::make_move_iterator(part.begin()),
+                  std::make_move_iterator(part.end()));
+  return errors;
+}
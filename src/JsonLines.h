@@ -0,0 +1,37 @@
+#pragma once
+#include "Model.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct JsonLinesError {
+  size_t record;
+  std::string message;
+};
+
+// Record index over a JSON Lines / NDJSON buffer, typically a MappedFile.
+//
+// Build finds every line start with an SSE2 newline scan, split across
+// threads, and keeps only the start offset of each non-blank line (8 bytes
+// per record), so opening a file costs one pass over it and no parsing.
+// Records are parsed one at a time on demand, and Validate checks them all
+// in parallel, so one bad line never fails the whole file. The buffer must
+// outlive the index.
+class JsonLinesIndex {
+public:
+  // threads == 0 uses one thread per hardware thread.
+  void Build(const char *data, size_t size, unsigned threads = 0);
+
+  size_t Count() const { return m_starts.size(); }
+  // Text of record i without its line break.
+  void Record(size_t i, const char *&begin, size_t &size) const;
+  // Parses record i; throws std::exception if it is not valid JSON.
+  ModelPtr Parse(size_t i) const;
+  // Syntax errors of every record, ordered by record.
+  std::vector<JsonLinesError> Validate(unsigned threads = 0) const;
+
+private:
+  const char *m_data = nullptr;
+  size_t m_size = 0;
+  std::vector<uint64_t> m_starts;
+};
@@ -0,0 +1,826 @@
+#include "JsonPath.h"
+#include <cstring>
+#include <stdexcept>
+
+// -- Plan --
+
+struct FilterExpr;
+
+struct Selector {
+  enum Kind { NAME, WILDCARD, INDEX, SLICE, FILTER } kind = NAME;
+  std::string name;
+  int64_t index = 0; // INDEX, or SLICE start
+  int64_t end = 0, step = 1;
+  bool hasStart = false, hasEnd = false;
+  std::shared_ptr<const FilterExpr> filter;
+};
+
+struct Segment {
+  bool descendant = false;
+  std::vector<Selector> selectors;
+};
+
+struct JsonPath::Query {
+  bool absolute = true; // $ rather than @
+  std::vector<Segment> segments;
+
+  // Only single names and indexes: selects at most one node.
+  bool Singular() const {
+    for (const Segment &segment : segments) {
+      if (segment.descendant || segment.selectors.size() != 1 ||
+          (segment.selectors[0].kind != Selector::NAME &&
+           segment.selectors[0].kind != Selector::INDEX))
+        return false;
+    }
+    return true;
+  }
+};
+
+struct FilterExpr {
+  enum Kind { OR, AND, NOT, EXISTS, COMPARE } kind;
+  explicit FilterExpr(Kind kind) : kind(kind) {}
+  enum Op { EQ, NE, LT, LE, GT, GE } op = EQ;
+  std::vector<std::unique_ptr<FilterExpr>> operands; // OR, AND, NOT
+  JsonPath::Query query;                             // EXISTS
+  // COMPARE: each side is a literal or, if that is null, a singular query
+  ModelPtr literal[2];
+  JsonPath::Query side[2];
+};
+
+// -- Parser --
+
+class PathParser {
+public:
+  explicit PathParser(const std::string &text) : m_text(text) {}
+
+  JsonPath::Query Parse() {
+    SkipSpace();
+    if (!Eat('$'))
+      Fail("expected $");
+    JsonPath::Query query = ParseSegments(true);
+    SkipSpace();
+    if (m_pos != m_text.size())
+      Fail("unexpected character");
+    return query;
+  }
+
+private:
+  [[noreturn]] void Fail(const std::string &message) const {
+    throw std::runtime_error("JSONPath: " + message + " at position " +
+                             std::to_string(m_pos + 1));
+  }
+  char Peek() const { return m_pos < m_text.size() ? m_text[m_pos] : '\0'; }
+  bool Eat(char c) {
+    if (Peek() != c)
+      return false;
+    m_pos++;
+    return true;
+  }
+  bool Eat(const char *token) {
+    size_t n = strlen(token);
+    if (m_text.compare(m_pos, n, token) != 0)
+      return false;
+    m_pos += n;
+    return true;
+  }
+  void SkipSpace() {
+    while (Peek() == ' ' || Peek() == '\t' || Peek() == '\r' || Peek() == '\n')
+      m_pos++;
+  }
+  static bool IsNameFirst(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+           (unsigned char)c >= 0x80;
+  }
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+  JsonPath::Query ParseSegments(bool absolute) {
+    JsonPath::Query query;
+    query.absolute = absolute;
+    for (;;) {
+      size_t start = m_pos;
+      SkipSpace();
+      Segment segment;
+      if (Eat("..")) {
+        segment.descendant = true;
+        if (Peek() == '[')
+          ParseBracket(segment);
+        else
+          ParseMember(segment);
+      } else if (Eat('.')) {
+        ParseMember(segment);
+      } else if (Peek() == '[') {
+        ParseBracket(segment);
+      } else {
+        m_pos = start; // Not part of the query, e.g. " == 1"
+        return query;
+      }
+      query.segments.push_back(std::move(segment));
+    }
+  }
+
+  // .name or .* (also after ..)
+  void ParseMember(Segment &segment) {
+    Selector selector;
+    if (Eat('*')) {
+      selector.kind = Selector::WILDCARD;
+    } else {
+      if (!IsNameFirst(Peek()))
+        Fail("expected a member name");
+      size_t start = m_pos;
+      while (IsNameFirst(Peek()) || IsDigit(Peek()))
+        m_pos++;
+      selector.name = m_text.substr(start, m_pos - start);
+      if (Peek() == '(')
+        Fail("functions are not supported");
+    }
+    segment.selectors.push_back(std::move(selector));
+  }
+
+  void ParseBracket(Segment &segment) {
+    Eat('[');
+    do {
+      SkipSpace();
+      segment.selectors.push_back(ParseSelector());
+      SkipSpace();
+    } while (Eat(','));
+    if (!Eat(']'))
+      Fail("expected ]");
+  }
+
+  Selector ParseSelector() {
+    Selector selector;
+    char c = Peek();
+    if (c == '\'' || c == '"') {
+      selector.name = ParseString();
+    } else if (Eat('*')) {
+      selector.kind = Selector::WILDCARD;
+    } else if (Eat('?')) {
+      selector.kind = Selector::FILTER;
+      selector.filter = ParseOr();
+    } else if (c == '-' || IsDigit(c) || c == ':') {
+      // n, or start:end:step with every part optional
+      selector.kind = Selector::INDEX;
+      if (c != ':') {
+        selector.index = ParseInt();
+        selector.hasStart = true;
+      }
+      SkipSpace();
+      if (Eat(':')) {
+        selector.kind = Selector::SLICE;
+        SkipSpace();
+        if (Peek() == '-' || IsDigit(Peek())) {
+          selector.end = ParseInt();
+          selector.hasEnd = true;
+        }
+        SkipSpace();
+        if (Eat(':')) {
+          SkipSpace();
+          if (Peek() == '-' || IsDigit(Peek()))
+            selector.step = ParseInt();
+        }
+      }
+    } else {
+      Fail("expected a selector");
+    }
+    return selector;
+  }
+
+  int64_t ParseInt() {
+    size_t start = m_pos;
+    Eat('-');
+    if (!IsDigit(Peek()))
+      Fail("expected an integer");
+    while (IsDigit(Peek()))
+      m_pos++;
+    try {
+      return std::stoll(m_text.substr(start, m_pos - start));
+    } catch (const std::out_of_range &) {
+      Fail("integer out of range");
+    }
+  }
+
+  static void AppendUtf8(std::string &out, unsigned cp) {
+    if (cp < 0x80) {
+      out += (char)cp;
+    } else if (cp < 0x800) {
+      out += (char)(0xC0 | (cp >> 6));
+      out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+      out += (char)(0xE0 | (cp >> 12));
+      out += (char)(0x80 | ((cp >> 6) & 0x3F));
+      out += (char)(0x80 | (cp & 0x3F));
+    } else {
+      out += (char)(0xF0 | (cp >> 18));
+      out += (char)(0x80 | ((cp >> 12) & 0x3F));
+      out += (char)(0x80 | ((cp >> 6) & 0x3F));
+      out += (char)(0x80 | (cp & 0x3F));
+    }
+  }
+
+  unsigned ParseHex4() {
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = Peek();
+      int digit = IsDigit(c)               ? c - '0'
+                  : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                  : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+                                           : -1;
+      if (digit < 0)
+        Fail("bad \\u escape");
+      value = value * 16 + (unsigned)digit;
+      m_pos++;
+    }
+    return value;
+  }
+
+  std::string ParseString() {
+    char quote = m_text[m_pos++];
+    std::string out;
+    for (;;) {
+      if (m_pos >= m_text.size())
+        Fail("unterminated string");
+      char c = m_text[m_pos++];
+      if (c == quote)
+        return out;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      char e = Peek();
+      m_pos++;
+      switch (e) {
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case '/':
+      case '\\':
+      case '\'':
+      case '"':
+        out += e;
+        break;
+      case 'u': {
+        unsigned cp = ParseHex4();
+        if (cp >= 0xD800 && cp < 0xDC00 && Eat("\\u")) {
+          unsigned low = ParseHex4();
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        AppendUtf8(out, cp);
+        break;
+      }
+      default:
+        Fail("bad escape");
+      }
+    }
+  }
+
+  // -- Filter expressions --
+
+  std::unique_ptr<FilterExpr> Binary(FilterExpr::Kind kind,
+                                     std::unique_ptr<FilterExpr> left,
+                                     std::unique_ptr<FilterExpr> right) {
+    std::unique_ptr<FilterExpr> expr(new FilterExpr(kind));
+    expr->operands.push_back(std::move(left));
+    expr->operands.push_back(std::move(right));
+    return expr;
+  }
+
+  std::unique_ptr<FilterExpr> ParseOr() {
+    std::unique_ptr<FilterExpr> expr = ParseAnd();
+    for (SkipSpace(); Eat("||"); SkipSpace())
+      expr = Binary(FilterExpr::OR, std::move(expr), ParseAnd());
+    return expr;
+  }
+
+  std::unique_ptr<FilterExpr> ParseAnd() {
+    std::unique_ptr<FilterExpr> expr = ParseUnary();
+    for (SkipSpace(); Eat("&&"); SkipSpace())
+      expr = Binary(FilterExpr::AND, std::move(expr), ParseUnary());
+    return expr;
+  }
+
+  std::unique_ptr<FilterExpr> ParseUnary() {
+    SkipSpace();
+    if (Peek() == '!' && m_text.compare(m_pos, 2, "!=") != 0) {
+      m_pos++;
+      std::unique_ptr<FilterExpr> expr(new FilterExpr(FilterExpr::NOT));
+      expr->operands.push_back(ParseUnary());
+      return expr;
+    }
+    if (Eat('(')) {
+      std::unique_ptr<FilterExpr> expr = ParseOr();
+      SkipSpace();
+      if (!Eat(')'))
+        Fail("expected )");
+      return expr;
+    }
+    return ParseTest();
+  }
+
+  // A comparison, or a query on its own as an existence test
+  std::unique_ptr<FilterExpr> ParseTest() {
+    std::unique_ptr<FilterExpr> expr(new FilterExpr(FilterExpr::COMPARE));
+    size_t start = m_pos;
+    ParseComparable(expr->literal[0], expr->side[0]);
+    SkipSpace();
+    static const struct {
+      const char *token;
+      FilterExpr::Op op;
+    } ops[] = {{"==", FilterExpr::EQ}, {"!=", FilterExpr::NE},
+               {"<=", FilterExpr::LE}, {">=", FilterExpr::GE},
+               {"<", FilterExpr::LT},  {">", FilterExpr::GT}};
+    for (const auto &op : ops) {
+      if (!Eat(op.token))
+        continue;
+      expr->op = op.op;
+      SkipSpace();
+      size_t right = m_pos;
+      ParseComparable(expr->literal[1], expr->side[1]);
+      for (int i = 0; i < 2; i++) {
+        if (!expr->literal[i] && !expr->side[i].Singular()) {
+          m_pos = i == 0 ? start : right;
+          Fail("a comparison needs a singular query (names and indexes)");
+        }
+      }
+      return expr;
+    }
+    if (expr->literal[0]) {
+      m_pos = start;
+      Fail("a literal cannot be a test on its own");
+    }
+    expr->kind = FilterExpr::EXISTS;
+    expr->query = std::move(expr->side[0]);
+    return expr;
+  }
+
+  void ParseComparable(ModelPtr &literal, JsonPath::Query &query) {
+    char c = Peek();
+    if (Eat('@')) {
+      query = ParseSegments(false);
+    } else if (Eat('$')) {
+      query = ParseSegments(true);
+    } else if (c == '\'' || c == '"') {
+      literal = Model::String(ParseString());
+    } else if (c == '-' || IsDigit(c)) {
+      literal = ParseNumber();
+    } else if (Eat("true")) {
+      literal = Model::Boolean(true);
+    } else if (Eat("false")) {
+      literal = Model::Boolean(false);
+    } else if (Eat("null")) {
+      literal = Model::Null();
+    } else if (IsNameFirst(c)) {
+      Fail("functions are not supported");
+    } else {
+      Fail("expected a query or a literal");
+    }
+  }
+
+  ModelPtr ParseNumber() {
+    size_t start = m_pos;
+    bool real = false;
+    Eat('-');
+    if (!IsDigit(Peek()))
+      Fail("expected a number");
+    while (IsDigit(Peek()))
+      m_pos++;
+    if (Peek() == '.') {
+      real = true;
+      m_pos++;
+      while (IsDigit(Peek()))
+        m_pos++;
+    }
+    if (Peek() == 'e' || Peek() == 'E') {
+      real = true;
+      m_pos++;
+      if (Peek() == '+' || Peek() == '-')
+        m_pos++;
+      while (IsDigit(Peek()))
+        m_pos++;
+    }
+    std::string text = m_text.substr(start, m_pos - start);
+    try {
+      if (!real)
+        return Model::Integer(std::stoll(text));
+    } catch (const std::out_of_range &) {
+      // Past int64: exact if it fits uint64, else compared as a real
+      try {
+        if (text[0] != '-')
+          return Model::Unsigned(std::stoull(text));
+      } catch (const std::out_of_range &) {
+      }
+    }
+    try {
+      return Model::Real(std::stod(text));
+    } catch (const std::exception &) {
+      Fail("bad number");
+    }
+  }
+
+  const std::string &m_text;
+  size_t m_pos = 0;
+};
+
+// -- Evaluation --
+
+namespace {
+
+struct Entry {
+  ModelPtr node;
+  std::string path;
+};
+typedef std::vector<Entry> NodeList;
+
+bool IsNumber(const ModelNode &node) {
+  return node.kind == ModelNode::INTEGER || node.kind == ModelNode::REAL;
+}
+
+double NumberValue(const ModelNode &node) {
+  if (node.kind == ModelNode::REAL)
+    return node.real;
+  return node.isUnsigned ? (double)node.uinteger : (double)node.integer;
+}
+
+// RFC 9535 comparison; a null pointer is "Nothing" (no such node).
+bool Equal(const ModelPtr &first, const ModelPtr &second) {
+  if (!first || !second)
+    return !first && !second;
+  ModelPtr a = Model::Resolve(first), b = Model::Resolve(second);
+  if (IsNumber(*a) && IsNumber(*b)) {
+    if (a->kind == ModelNode::INTEGER && b->kind == ModelNode::INTEGER)
+      return a->integer == b->integer && a->isUnsigned == b->isUnsigned;
+    return NumberValue(*a) == NumberValue(*b);
+  }
+  return Model::Equal(a, b);
+}
+
+bool Less(const ModelPtr &first, const ModelPtr &second) {
+  if (!first || !second)
+    return false;
+  ModelPtr a = Model::Resolve(first), b = Model::Resolve(second);
+  if (IsNumber(*a) && IsNumber(*b)) {
+    if (a->kind == ModelNode::INTEGER && b->kind == ModelNode::INTEGER) {
+      // Unsigned integers are all above INT64_MAX
+      if (a->isUnsigned != b->isUnsigned)
+        return b->isUnsigned;
+      return a->isUnsigned ? a->uinteger < b->uinteger
+                           : a->integer < b->integer;
+    }
+    return NumberValue(*a) < NumberValue(*b);
+  }
+  if (a->kind == ModelNode::STRING && b->kind == ModelNode::STRING)
+    return a->Text() < b->Text(); // UTF-8 byte order is code point order
+  return false;
+}
+
+// Index into an array of size, counting from the end if negative.
+bool NormalizeIndex(int64_t index, size_t size, size_t &out) {
+  if (index < 0)
+    index += (int64_t)size;
+  if (index < 0 || (uint64_t)index >= size)
+    return false;
+  out = (size_t)index;
+  return true;
+}
+
+class Evaluator {
+public:
+  Evaluator(const ModelPtr &root, const std::atomic<bool> *cancel,
+            size_t limit, bool paths)
+      : m_root(root), m_cancel(cancel), m_limit(limit), m_paths(paths) {}
+
+  bool Stopped() const { return m_stopped; }
+
+  NodeList Run(const JsonPath::Query &query, const ModelPtr &start) {
+    NodeList current;
+    current.push_back({start, std::string()});
+    for (size_t i = 0; i < query.segments.size() && !m_stopped; i++) {
+      const Segment &segment = query.segments[i];
+      m_final = i + 1 == query.segments.size();
+      NodeList next;
+      for (const Entry &entry : current) {
+        if (segment.descendant) {
+          std::string path = entry.path;
+          Descend(segment, entry.node, path, next);
+        } else {
+          for (const Selector &selector : segment.selectors)
+            Select(selector, entry.node, entry.path, next);
+        }
+        if (m_stopped)
+          break;
+      }
+      current.swap(next);
+    }
+    return current;
+  }
+
+private:
+  // Polls the cancel flag now and then; false once stopped.
+  bool Tick() {
+    if ((++m_ticks & 4095) == 0 && m_cancel && *m_cancel)
+      m_stopped = true;
+    return !m_stopped;
+  }
+
+  template <typename Token>
+  void Emit(NodeList &out, const ModelPtr &node, const std::string &parent,
+            Token token) {
+    if (m_stopped)
+      return;
+    out.push_back({node, m_paths ? parent + "/" + token() : std::string()});
+    if (m_final && out.size() >= m_limit)
+      m_stopped = true;
+  }
+
+  void EmitItem(NodeList &out, const ModelPtr &array, size_t i,
+                const std::string &path) {
+    Emit(out, Model::Item(array, i), path,
+         [i] { return std::to_string(i); });
+  }
+
+  void EmitMember(NodeList &out, const ModelPtr &object, size_t i,
+                  const std::string &path) {
+    Emit(out, object->items[i], path,
+         [&] { return Model::EscapePointerToken(object->Keys()[i]); });
+  }
+
+  void Select(const Selector &selector, const ModelPtr &target,
+              const std::string &path, NodeList &out) {
+    ModelPtr node = Model::Resolve(target);
+    bool object = node->kind == ModelNode::OBJECT;
+    bool array = node->kind == ModelNode::ARRAY;
+    switch (selector.kind) {
+    case Selector::NAME:
+      if (object) {
+        int i = node->FindKey(selector.name);
+        if (i >= 0)
+          EmitMember(out, node, (size_t)i, path);
+      }
+      break;
+    case Selector::WILDCARD:
+      for (size_t i = 0; (object || array) && i < node->Size(); i++) {
+        if (object)
+          EmitMember(out, node, i, path);
+        else
+          EmitItem(out, node, i, path);
+      }
+      break;
+    case Selector::INDEX: {
+      size_t i;
+      if (array && NormalizeIndex(selector.index, node->Size(), i))
+        EmitItem(out, node, i, path);
+      break;
+    }
+    case Selector::SLICE:
+      if (array)
+        SelectSlice(selector, node, path, out);
+      break;
+    case Selector::FILTER:
+      for (size_t i = 0; (object || array) && i < node->Size() && Tick();
+           i++) {
+        ModelPtr child = object ? node->items[i] : Model::Item(node, i);
+        if (!Test(*selector.filter, child))
+          continue;
+        if (object)
+          EmitMember(out, node, i, path);
+        else
+          Emit(out, child, path, [i] { return std::to_string(i); });
+      }
+      break;
+    }
+  }
+
+  void SelectSlice(const Selector &selector, const ModelPtr &array,
+                   const std::string &path, NodeList &out) {
+    int64_t step = selector.step, size = (int64_t)array->Size();
+    if (step == 0)
+      return;
+    auto bound = [size](int64_t i, int64_t low, int64_t high) {
+      if (i < 0)
+        i += size;
+      return i < low ? low : i > high ? high : i;
+    };
+    if (step > 0) {
+      int64_t lower = selector.hasStart ? bound(selector.index, 0, size) : 0;
+      int64_t upper = selector.hasEnd ? bound(selector.end, 0, size) : size;
+      for (int64_t i = lower; i < upper && !m_stopped; i += step)
+        EmitItem(out, array, (size_t)i, path);
+    } else {
+      int64_t upper =
+          selector.hasStart ? bound(selector.index, -1, size - 1) : size - 1;
+      int64_t lower = selector.hasEnd ? bound(selector.end, -1, size - 1) : -1;
+      for (int64_t i = upper; lower < i && !m_stopped; i += step)
+        EmitItem(out, array, (size_t)i, path);
+    }
+  }
+
+  // Applies the selectors to node and every node below it, in pre-order.
+  // Packed arrays hold only scalars, which have nothing to select, and
+  // aliases are not entered.
+  void Descend(const Segment &segment, const ModelPtr &node, std::string &path,
+               NodeList &out) {
+    if (!Tick())
+      return;
+    for (const Selector &selector : segment.selectors)
+      Select(selector, node, path, out);
+    size_t length = path.size();
+    if (node->kind == ModelNode::OBJECT) {
+      for (size_t i = 0; i < node->items.size() && !m_stopped; i++) {
+        if (!node->items[i]->IsContainer())
+          continue;
+        if (m_paths)
+          path += "/" + Model::EscapePointerToken(node->Keys()[i]);
+        Descend(segment, node->items[i], path, out);
+        path.resize(length);
+      }
+    } else if (node->kind == ModelNode::ARRAY && !node->IsPacked()) {
+      for (size_t i = 0; i < node->items.size() && !m_stopped; i++) {
+        if (!node->items[i]->IsContainer())
+          continue;
+        if (m_paths)
+          path += "/" + std::to_string(i);
+        Descend(segment, node->items[i], path, out);
+        path.resize(length);
+      }
+    }
+  }
+
+  // The node a singular query selects, or nullptr.
+  ModelPtr Navigate(const JsonPath::Query &query, ModelPtr node) {
+    for (const Segment &segment : query.segments) {
+      const Selector &selector = segment.selectors[0];
+      node = Model::Resolve(node);
+      size_t i;
+      if (selector.kind == Selector::NAME && node->kind == ModelNode::OBJECT) {
+        int key = node->FindKey(selector.name);
+        if (key < 0)
+          return nullptr;
+        node = node->items[key];
+      } else if (selector.kind == Selector::INDEX &&
+                 node->kind == ModelNode::ARRAY &&
+                 NormalizeIndex(selector.index, node->Size(), i)) {
+        node = Model::Item(node, i);
+      } else {
+        return nullptr;
+      }
+    }
+    return node;
+  }
+
+  bool Exists(const JsonPath::Query &query, const ModelPtr &current) {
+    const ModelPtr &start = query.absolute ? m_root : current;
+    if (query.Singular())
+      return Navigate(query, start) != nullptr;
+    // Any node will do, so stop at the first
+    Evaluator inner(m_root, m_cancel, 1, false);
+    bool found = !inner.Run(query, start).empty();
+    if (inner.Stopped() && !found)
+      m_stopped = true; // Cancelled inside
+    return found;
+  }
+
+  ModelPtr Operand(const FilterExpr &expr, int i, const ModelPtr &current) {
+    if (expr.literal[i])
+      return expr.literal[i];
+    return Navigate(expr.side[i], expr.side[i].absolute ? m_root : current);
+  }
+
+  bool Test(const FilterExpr &expr, const ModelPtr &current) {
+    switch (expr.kind) {
+    case FilterExpr::OR:
+      return Test(*expr.operands[0], current) ||
+             Test(*expr.operands[1], current);
+    case FilterExpr::AND:
+      return Test(*expr.operands[0], current) &&
+             Test(*expr.operands[1], current);
+    case FilterExpr::NOT:
+      return !Test(*expr.operands[0], current);
+    case FilterExpr::EXISTS:
+      return Exists(expr.query, current);
+    case FilterExpr::COMPARE:
+      break;
+    }
+    ModelPtr a = Operand(expr, 0, current), b = Operand(expr, 1, current);
+    switch (expr.op) {
+    case FilterExpr::EQ:
+      return Equal(a, b);
+    case FilterExpr::NE:
+      return !Equal(a, b);
+    case FilterExpr::LT:
+      return Less(a, b);
+    case FilterExpr::LE:
+      return Less(a, b) || Equal(a, b);
+    case FilterExpr::GT:
+      return Less(b, a);
+    case FilterExpr::GE:
+      return Less(b, a) || Equal(a, b);
+    }
+    return false;
+  }
+
+  ModelPtr m_root;
+  const std::atomic<bool> *m_cancel;
+  size_t m_limit;
+  bool m_paths;
+  bool m_final = false; // Evaluating the last segment; m_limit applies
+  bool m_stopped = false;
+  unsigned m_ticks = 0;
+};
+
+} // namespace
+
+JsonPath::JsonPath(const std::string &expression)
+    : m_query(new Query(PathParser(expression).Parse())) {}
+
+JsonPath::~JsonPath() = default;
+
+std::vector<QueryResult> JsonPath::Evaluate(const ModelPtr &root,
+                                            const std::atomic<bool> *cancel,
+                                            size_t limit,
+                                            bool *complete) const {
+  std::vector<QueryResult> results;
+  if (complete)
+    *complete = true;
+  if (!root || limit == 0)
+    return results;
+  Evaluator evaluator(root, cancel, limit, true);
+  NodeList nodes = evaluator.Run(*m_query, root);
+  bool cancelled = cancel && *cancel;
+  if (complete)
+    *complete = !evaluator.Stopped();
+  if (cancelled)
+    return results; // Stopped partway; even the last segment is partial
+  results.reserve(nodes.size());
+  for (Entry &entry : nodes)
+    results.push_back({std::move(entry.path), std::move(entry.node)});
+  return results;
+}
+
+// -- Node numbering --
+
+const std::vector<size_t> &NodeNumbering::Offsets(const ModelNode *node) {
+  auto it = m_offsets.find(node);
+  if (it != m_offsets.end())
+    return it->second;
+  std::vector<size_t> offsets(node->items.size() + 1);
+  size_t number = 1;
+  for (size_t i = 0; i < node->items.size(); i++) {
+    offsets[i] = number;
+    number += Count(node->items[i]);
+  }
+  offsets.back() = number;
+  return m_offsets.emplace(node, std::move(offsets)).first->second;
+}
+
+size_t NodeNumbering::Count(const ModelPtr &node) {
+  // As in ParseYaml: an alias is one node, a packed array one plus one per
+  // element
+  if (!node->IsContainer())
+    return 1;
+  if (node->IsPacked())
+    return 1 + node->Size();
+  return Offsets(node.get()).back();
+}
+
+size_t NodeNumbering::Find(const std::string &pointer) {
+  ModelPtr node = m_root;
+  // The document array of a multi-document file has no number, so its
+  // first element is number 0
+  size_t number = m_multiDocument ? SIZE_MAX : 0;
+  for (const std::string &token : Model::SplitPointer(pointer)) {
+    if (node->kind == ModelNode::ALIAS)
+      return number;
+    size_t index;
+    if (node->kind == ModelNode::OBJECT) {
+      int key = node->FindKey(token);
+      if (key < 0)
+        return SIZE_MAX;
+      index = (size_t)key;
+    } else if (node->kind == ModelNode::ARRAY) {
+      if (token.empty() || token.size() > 18 ||
+          token.find_first_not_of("0123456789") != std::string::npos)
+        return SIZE_MAX;
+      index = (size_t)std::stoull(token);
+      if (index >= node->Size())
+        return SIZE_MAX;
+      if (node->IsPacked())
+        return number + 1 + index;
+    } else {
+      return SIZE_MAX;
+    }
+    number += Offsets(node.get())[index];
+    node = node->items[index];
+  }
+  return number;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Model.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct QueryResult {
+  std::string path; // JSON Pointer; "" for the root
+  ModelPtr node;
+};
+
+// A JSONPath query (RFC 9535) compiled into a plan over the model.
+//
+// The expression is parsed once into segments of selectors; evaluation
+// walks the model directly, with no conversion to nlohmann::json. Filter
+// expressions short-circuit, comparisons only take singular queries
+// (@.a.b, $['x'][0]), which navigate straight to the node, and an
+// existence test stops at the first node found. Aliases are followed by
+// child selectors but not by descendant (..) segments, so an alias cannot
+// multiply the work.
+//
+// Supported: $ @ .name ['name'] .* [*] [n] [start:end:step] [a,b] ..
+// [?expr] with || && ! ( ) == != < <= > >= and string, number, true,
+// false and null literals. Function extensions are not supported.
+class JsonPath {
+public:
+  // Throws std::runtime_error, with the position, on a syntax error.
+  explicit JsonPath(const std::string &expression);
+  ~JsonPath();
+  JsonPath(const JsonPath &) = delete;
+  JsonPath &operator=(const JsonPath &) = delete;
+
+  // Selected nodes, in nodelist order. Stops early once cancel is set or
+  // limit nodes are selected; *complete then receives false.
+  std::vector<QueryResult> Evaluate(const ModelPtr &root,
+                                    const std::atomic<bool> *cancel = nullptr,
+                                    size_t limit = SIZE_MAX,
+                                    bool *complete = nullptr) const;
+
+  struct Query;
+
+private:
+  std::unique_ptr<Query> m_query;
+};
+
+// Numbers nodes in the pre-order Model::ParseYaml uses for the source
+// lines it reports, so a JSON Pointer can be mapped back to its line.
+// The offsets of each container's children are cached, so mapping many
+// pointers costs about one walk.
+class NodeNumbering {
+public:
+  // multiDocument: root is the array holding several YAML documents,
+  // which has no number of its own.
+  NodeNumbering(const ModelPtr &root, bool multiDocument)
+      : m_root(root), m_multiDocument(multiDocument) {}
+
+  // Number of the node at pointer; for a node reached through an alias,
+  // the alias's number. SIZE_MAX if there is no such node.
+  size_t Find(const std::string &pointer);
+
+private:
+  size_t Count(const ModelPtr &node);
+  // offsets[i]: number of child i less the container's; offsets[size]: the
+  // container's node count
+  const std::vector<size_t> &Offsets(const ModelNode *node);
+
+  ModelPtr m_root;
+  bool m_multiDocument;
+  std::unordered_map<const ModelNode *, std::vector<size_t>> m_offsets;
+};
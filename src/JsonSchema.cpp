@@ -0,0 +1,1005 @@
+#include "JsonSchema.h"
+#include "SearchEngine.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+#include <windows.h>
+
+// Checks nested deeper than this, through the value or through $refs that
+// never reach a keyword, are given up on: a cycle or a stack overflow.
+static const size_t kMaxDepth = 1024;
+
+enum TypeBits : uint8_t {
+  kNull = 1,
+  kBoolean = 2,
+  kObject = 4,
+  kArray = 8,
+  kNumber = 16,
+  kString = 32,
+  kInteger = 64,
+};
+
+static const char *const kTypeNames[] = {"null",   "boolean", "object",
+                                         "array",  "number",  "string",
+                                         "integer"};
+
+struct JsonSchema::Node {
+  enum Kind { ANY, NONE, CHECK }; // The schemas true, false, and an object
+  Kind kind = CHECK;
+  std::string location;
+  uint8_t types = 0; // TypeBits allowed, 0 for any
+  int ref = -1;
+  int enumValues = -1; // Into m_enums
+  ModelPtr constValue;
+  std::optional<double> minimum, maximum, exclusiveMinimum, exclusiveMaximum,
+      multipleOf;
+  size_t minLength = 0, maxLength = SIZE_MAX;
+  int pattern = -1; // Into m_patterns
+  std::vector<int> prefixItems;
+  int items = -1, contains = -1;
+  size_t minItems = 0, maxItems = SIZE_MAX;
+  size_t minContains = 1, maxContains = SIZE_MAX;
+  bool uniqueItems = false;
+  std::vector<std::pair<std::string, int>> properties; // Sorted by name
+  std::vector<std::pair<int, int>> patternProperties;  // pattern, schema
+  int additionalProperties = -1, propertyNames = -1;
+  std::vector<std::string> required;
+  size_t minProperties = 0, maxProperties = SIZE_MAX;
+  std::vector<std::pair<std::string, std::vector<std::string>>>
+      dependentRequired;
+  std::vector<std::pair<std::string, int>> dependentSchemas;
+  std::vector<int> allOf, anyOf, oneOf;
+  int notSchema = -1, ifSchema = -1, thenSchema = -1, elseSchema = -1;
+};
+
+struct JsonSchema::Enum {
+  std::unordered_set<std::string> strings;
+  std::vector<double> numbers; // Sorted
+  bool null = false, yes = false, no = false;
+  std::vector<ModelPtr> containers;
+  std::string text; // The values for messages, shortened
+};
+
+struct JsonSchema::Run {
+  Cache *cache;
+  Cache::Map next; // Results of this validation, for the cache
+  const std::atomic<bool> *cancel;
+  size_t limit;
+  size_t depth = 0;
+  size_t reused = 0;
+  bool truncated = false;
+
+  bool Cancelled() const { return cancel && *cancel; }
+};
+
+// -- Values --
+
+static std::wstring Utf8ToWide(const std::string &text) {
+  if (text.empty())
+    return std::wstring();
+  int size = MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(),
+                                 NULL, 0);
+  std::wstring wide(size, 0);
+  MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(), &wide[0],
+                      size);
+  return wide;
+}
+
+static bool IsNumber(const ModelNode &node) {
+  return node.kind == ModelNode::INTEGER || node.kind == ModelNode::REAL;
+}
+
+static double NumberValue(const ModelNode &node) {
+  if (node.kind == ModelNode::REAL)
+    return node.real;
+  return node.isUnsigned ? (double)node.uinteger : (double)node.integer;
+}
+
+static uint8_t TypeOf(const ModelNode &node) {
+  switch (node.kind) {
+  case ModelNode::NUL:
+    return kNull;
+  case ModelNode::BOOLEAN:
+    return kBoolean;
+  case ModelNode::INTEGER:
+    return kNumber | kInteger;
+  case ModelNode::REAL:
+    return std::isfinite(node.real) && node.real == std::floor(node.real)
+               ? kNumber | kInteger
+               : kNumber;
+  case ModelNode::STRING:
+    return kString;
+  case ModelNode::ARRAY:
+    return kArray;
+  case ModelNode::OBJECT:
+    return kObject;
+  default:
+    return 0;
+  }
+}
+
+static std::string TypeName(const ModelNode &node) {
+  if (node.kind == ModelNode::INTEGER)
+    return "integer";
+  uint8_t type = TypeOf(node) & ~kInteger;
+  for (int bit = 0; bit < 7; bit++) {
+    if (type & (1 << bit))
+      return kTypeNames[bit];
+  }
+  return "alias";
+}
+
+static std::string TypeNames(uint8_t types) {
+  std::string names;
+  for (int bit = 0; bit < 7; bit++) {
+    if (types & (1 << bit))
+      names += (names.empty() ? "" : " or ") + std::string(kTypeNames[bit]);
+  }
+  return names;
+}
+
+static std::string NumberText(double number) {
+  if (number == std::floor(number) && std::fabs(number) < 1e15)
+    return std::to_string((long long)number);
+  return Model::ScalarText(Model::Real(number));
+}
+
+// JSON Schema equality: numbers compare by value, so 1 equals 1.0, and
+// object members in any order.
+static bool SameValue(const ModelPtr &first, const ModelPtr &second) {
+  ModelPtr a = Model::Resolve(first), b = Model::Resolve(second);
+  if (a == b)
+    return true;
+  if (!a || !b)
+    return false;
+  if (IsNumber(*a) && IsNumber(*b)) {
+    if (a->kind == ModelNode::INTEGER && b->kind == ModelNode::INTEGER)
+      return a->integer == b->integer && a->isUnsigned == b->isUnsigned;
+    return NumberValue(*a) == NumberValue(*b);
+  }
+  if (a->kind != b->kind)
+    return false;
+  switch (a->kind) {
+  case ModelNode::NUL:
+    return true;
+  case ModelNode::BOOLEAN:
+    return a->boolean == b->boolean;
+  case ModelNode::STRING:
+    return a->Text() == b->Text();
+  case ModelNode::ARRAY: {
+    size_t size = a->Size();
+    if (size != b->Size())
+      return false;
+    for (size_t i = 0; i < size; i++) {
+      if (!SameValue(Model::Item(a, i), Model::Item(b, i)))
+        return false;
+    }
+    return true;
+  }
+  case ModelNode::OBJECT:
+    if (a->Keys().size() != b->Keys().size())
+      return false;
+    for (size_t i = 0; i < a->Keys().size(); i++) {
+      int other = b->FindKey(a->Keys()[i]);
+      if (other < 0 || !SameValue(a->items[i], b->items[other]))
+        return false;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Hash agreeing with SameValue, for uniqueItems.
+static size_t ValueHash(const ModelPtr &input) {
+  ModelPtr node = Model::Resolve(input);
+  if (!node)
+    return 0;
+  if (IsNumber(*node))
+    return std::hash<double>()(NumberValue(*node) + 0.0); // -0.0 as 0.0
+  switch (node->kind) {
+  case ModelNode::BOOLEAN:
+    return node->boolean ? 1 : 2;
+  case ModelNode::STRING:
+    return std::hash<std::string>()(node->Text());
+  case ModelNode::ARRAY: {
+    size_t hash = 3;
+    for (size_t i = 0; i < node->Size(); i++)
+      hash = hash * 31 + ValueHash(Model::Item(node, i));
+    return hash;
+  }
+  case ModelNode::OBJECT: {
+    size_t hash = 4; // Summed, so member order does not matter
+    for (size_t i = 0; i < node->Keys().size(); i++)
+      hash += std::hash<std::string>()(node->Keys()[i]) * 31 +
+              ValueHash(node->items[i]);
+    return hash;
+  }
+  default:
+    return 5;
+  }
+}
+
+static size_t CodePoints(const std::string &text) {
+  size_t count = 0;
+  for (unsigned char c : text)
+    count += (c & 0xC0) != 0x80;
+  return count;
+}
+
+static bool MultipleOf(const ModelNode &node, double divisor) {
+  if (node.kind == ModelNode::INTEGER && divisor == std::floor(divisor) &&
+      divisor < 9.2e18) {
+    if (node.isUnsigned)
+      return node.uinteger % (uint64_t)divisor == 0;
+    return node.integer % (int64_t)divisor == 0;
+  }
+  double quotient = NumberValue(node) / divisor;
+  if (!std::isfinite(quotient))
+    return false;
+  return std::fabs(quotient - std::nearbyint(quotient)) <=
+         1e-9 * std::max(1.0, std::fabs(quotient));
+}
+
+// -- Compiling --
+
+class JsonSchema::Compiler {
+public:
+  Compiler(JsonSchema &schema, const nlohmann::json &root)
+      : m_schema(schema), m_root(root) {}
+
+  void Run() {
+    Collect(m_root, "");
+    Compile(m_root, "", "");
+    while (!m_pending.empty()) {
+      Pending pending = m_pending.back();
+      m_pending.pop_back();
+      int target = Resolve(pending.ref, pending.resource, pending.location);
+      m_schema.m_nodes[pending.node].ref = target;
+    }
+  }
+
+private:
+  struct Pending {
+    int node;
+    std::string ref, resource, location;
+  };
+
+  [[noreturn]] static void Fail(const std::string &location,
+                                const std::string &message) {
+    throw std::runtime_error("Schema " + (location.empty() ? "/" : location) +
+                             ": " + message);
+  }
+
+  // Records where each $id and $anchor is.
+  void Collect(const nlohmann::json &value, const std::string &location) {
+    if (value.is_object()) {
+      auto id = value.find("$id");
+      if (id != value.end() && id->is_string())
+        m_ids[id->get<std::string>()] = location;
+      for (const char *keyword : {"$anchor", "$dynamicAnchor"}) {
+        auto anchor = value.find(keyword);
+        if (anchor != value.end() && anchor->is_string())
+          m_anchors[anchor->get<std::string>()] = location;
+      }
+      for (auto &item : value.items())
+        Collect(item.value(),
+                location + "/" + Model::EscapePointerToken(item.key()));
+    } else if (value.is_array()) {
+      for (size_t i = 0; i < value.size(); i++)
+        Collect(value[i], location + "/" + std::to_string(i));
+    }
+  }
+
+  // Location of the schema resource, the nearest $id, holding location.
+  std::string ResourceOf(const std::string &location) const {
+    std::string resource;
+    for (auto &id : m_ids) {
+      const std::string &at = id.second;
+      if (at.size() > resource.size() &&
+          location.compare(0, at.size(), at) == 0 &&
+          (location.size() == at.size() || location[at.size()] == '/'))
+        resource = at;
+    }
+    return resource;
+  }
+
+  int Resolve(const std::string &ref, const std::string &resource,
+              const std::string &from) {
+    size_t hash = ref.find('#');
+    std::string uri = ref.substr(0, hash);
+    std::string fragment;
+    if (hash != std::string::npos) {
+      // Percent-decoded
+      for (size_t i = hash + 1; i < ref.size(); i++) {
+        if (ref[i] == '%' && i + 2 < ref.size() &&
+            isxdigit((unsigned char)ref[i + 1]) &&
+            isxdigit((unsigned char)ref[i + 2])) {
+          fragment += (char)std::stoi(ref.substr(i + 1, 2), nullptr, 16);
+          i += 2;
+        } else {
+          fragment += ref[i];
+        }
+      }
+    }
+    std::string base = resource;
+    if (!uri.empty()) {
+      auto id = m_ids.find(uri);
+      if (id == m_ids.end()) {
+        // A relative reference: match an $id by its last segments
+        std::string name = uri.substr(uri.find_last_of('/') + 1);
+        for (id = m_ids.begin(); id != m_ids.end(); ++id) {
+          const std::string &full = id->first;
+          if (full.size() >= name.size() &&
+              full.compare(full.size() - name.size(), name.size(), name) == 0 &&
+              (full.size() == name.size() ||
+               full[full.size() - name.size() - 1] == '/'))
+            break;
+        }
+      }
+      if (id == m_ids.end())
+        Fail(from, "$ref \"" + ref + "\" is not in this schema document");
+      base = id->second;
+    }
+    std::string location = base;
+    if (!fragment.empty() && fragment[0] == '/') {
+      location += fragment;
+    } else if (!fragment.empty()) {
+      auto anchor = m_anchors.find(fragment);
+      if (anchor == m_anchors.end())
+        Fail(from, "no $anchor \"" + fragment + "\"");
+      location = anchor->second;
+    }
+    auto compiled = m_compiled.find(location);
+    if (compiled != m_compiled.end())
+      return compiled->second;
+    const nlohmann::json *target;
+    try {
+      target = &m_root.at(nlohmann::json::json_pointer(location));
+    } catch (const nlohmann::json::exception &) {
+      Fail(from, "$ref \"" + ref + "\" does not resolve");
+    }
+    return Compile(*target, location, ResourceOf(location));
+  }
+
+  size_t Count(const nlohmann::json &value, const std::string &location) {
+    if (value.is_number_unsigned() ||
+        (value.is_number_integer() && value.get<int64_t>() >= 0))
+      return value.get<size_t>();
+    if (value.is_number_float() && value.get<double>() >= 0 &&
+        value.get<double>() == std::floor(value.get<double>()))
+      return (size_t)value.get<double>();
+    Fail(location, "must be a non-negative integer");
+  }
+
+  double Number(const nlohmann::json &value, const std::string &location) {
+    if (!value.is_number())
+      Fail(location, "must be a number");
+    return value.get<double>();
+  }
+
+  int Pattern(const nlohmann::json &value, const std::string &location) {
+    if (!value.is_string())
+      Fail(location, "must be a string");
+    std::string source = value.get<std::string>();
+    auto known = m_patternIndex.find(source);
+    if (known != m_patternIndex.end())
+      return known->second;
+    SearchOptions options;
+    options.matchCase = true;
+    options.regex = true;
+    options.multiline = false; // ECMA-262 anchors, as schemas expect
+    try {
+      m_schema.m_patterns.push_back(
+          std::make_unique<SearchEngine>(Utf8ToWide(source), options));
+    } catch (const std::runtime_error &e) {
+      Fail(location, e.what());
+    }
+    m_schema.m_patternSources.push_back(source);
+    int index = (int)m_schema.m_patterns.size() - 1;
+    m_patternIndex[source] = index;
+    return index;
+  }
+
+  std::vector<std::string> Names(const nlohmann::json &value,
+                                 const std::string &location) {
+    if (!value.is_array())
+      Fail(location, "must be an array of strings");
+    std::vector<std::string> names;
+    for (auto &name : value) {
+      if (!name.is_string())
+        Fail(location, "must be an array of strings");
+      names.push_back(name.get<std::string>());
+    }
+    return names;
+  }
+
+  std::vector<int> List(const nlohmann::json &value,
+                        const std::string &location,
+                        const std::string &resource) {
+    if (!value.is_array() || value.empty())
+      Fail(location, "must be a non-empty array of schemas");
+    std::vector<int> schemas;
+    for (size_t i = 0; i < value.size(); i++)
+      schemas.push_back(
+          Compile(value[i], location + "/" + std::to_string(i), resource));
+    return schemas;
+  }
+
+  int AddEnum(const nlohmann::json &value, const std::string &location) {
+    if (!value.is_array())
+      Fail(location, "must be an array");
+    Enum values;
+    for (auto &item : value) {
+      if (item.is_string())
+        values.strings.insert(item.get<std::string>());
+      else if (item.is_number())
+        values.numbers.push_back(item.get<double>());
+      else if (item.is_null())
+        values.null = true;
+      else if (item.is_boolean())
+        (item.get<bool>() ? values.yes : values.no) = true;
+      else
+        values.containers.push_back(Model::FromJson(item));
+    }
+    std::sort(values.numbers.begin(), values.numbers.end());
+    values.text = value.dump();
+    if (values.text.size() > 80)
+      values.text = values.text.substr(0, 77) + "...";
+    m_schema.m_enums.push_back(std::move(values));
+    return (int)m_schema.m_enums.size() - 1;
+  }
+
+  // Compiles the schema value at location into a new node. Nodes are
+  // referred to by index as compiling subschemas grows m_nodes.
+  int Compile(const nlohmann::json &value, const std::string &location,
+              std::string resource) {
+    int index = (int)m_schema.m_nodes.size();
+    m_schema.m_nodes.emplace_back();
+    m_compiled[location] = index;
+    Node node;
+    node.location = location;
+    if (value.is_boolean()) {
+      node.kind = value.get<bool>() ? Node::ANY : Node::NONE;
+      m_schema.m_nodes[index] = std::move(node);
+      return index;
+    }
+    if (!value.is_object())
+      Fail(location, "a schema must be an object or a boolean");
+    if (value.contains("$id") && value["$id"].is_string())
+      resource = location;
+
+    bool itemsList = false; // Draft 7 items array, then additionalItems
+    for (auto &member : value.items()) {
+      const std::string &key = member.key();
+      const nlohmann::json &v = member.value();
+      std::string at = location + "/" + Model::EscapePointerToken(key);
+      if (key == "type") {
+        std::vector<std::string> names =
+            v.is_string() ? std::vector<std::string>{v.get<std::string>()}
+                          : Names(v, at);
+        for (const std::string &name : names) {
+          auto known = std::find(std::begin(kTypeNames), std::end(kTypeNames),
+                                 name);
+          if (known == std::end(kTypeNames))
+            Fail(at, "unknown type \"" + name + "\"");
+          node.types |= 1 << (known - std::begin(kTypeNames));
+        }
+      } else if (key == "enum") {
+        node.enumValues = AddEnum(v, at);
+      } else if (key == "const") {
+        node.constValue = Model::FromJson(v);
+      } else if (key == "minimum") {
+        node.minimum = Number(v, at);
+      } else if (key == "maximum") {
+        node.maximum = Number(v, at);
+      } else if (key == "exclusiveMinimum") {
+        node.exclusiveMinimum = Number(v, at);
+      } else if (key == "exclusiveMaximum") {
+        node.exclusiveMaximum = Number(v, at);
+      } else if (key == "multipleOf") {
+        node.multipleOf = Number(v, at);
+        if (*node.multipleOf <= 0)
+          Fail(at, "must be greater than 0");
+      } else if (key == "minLength") {
+        node.minLength = Count(v, at);
+      } else if (key == "maxLength") {
+        node.maxLength = Count(v, at);
+      } else if (key == "pattern") {
+        node.pattern = Pattern(v, at);
+      } else if (key == "prefixItems") {
+        node.prefixItems = List(v, at, resource);
+      } else if (key == "items") {
+        if (v.is_array()) {
+          node.prefixItems = List(v, at, resource);
+          itemsList = true;
+        } else {
+          node.items = Compile(v, at, resource);
+        }
+      } else if (key == "contains") {
+        node.contains = Compile(v, at, resource);
+      } else if (key == "minContains") {
+        node.minContains = Count(v, at);
+      } else if (key == "maxContains") {
+        node.maxContains = Count(v, at);
+      } else if (key == "minItems") {
+        node.minItems = Count(v, at);
+      } else if (key == "maxItems") {
+        node.maxItems = Count(v, at);
+      } else if (key == "uniqueItems") {
+        node.uniqueItems = v.is_boolean() && v.get<bool>();
+      } else if (key == "properties" || key == "dependentSchemas") {
+        if (!v.is_object())
+          Fail(at, "must be an object of schemas");
+        auto &schemas =
+            key == "properties" ? node.properties : node.dependentSchemas;
+        for (auto &property : v.items())
+          schemas.emplace_back(
+              property.key(),
+              Compile(property.value(),
+                      at + "/" + Model::EscapePointerToken(property.key()),
+                      resource));
+        std::sort(schemas.begin(), schemas.end());
+      } else if (key == "patternProperties") {
+        if (!v.is_object())
+          Fail(at, "must be an object of schemas");
+        for (auto &property : v.items()) {
+          std::string path =
+              at + "/" + Model::EscapePointerToken(property.key());
+          node.patternProperties.emplace_back(
+              Pattern(property.key(), path),
+              Compile(property.value(), path, resource));
+        }
+      } else if (key == "additionalProperties") {
+        node.additionalProperties = Compile(v, at, resource);
+      } else if (key == "propertyNames") {
+        node.propertyNames = Compile(v, at, resource);
+      } else if (key == "required") {
+        node.required = Names(v, at);
+      } else if (key == "minProperties") {
+        node.minProperties = Count(v, at);
+      } else if (key == "maxProperties") {
+        node.maxProperties = Count(v, at);
+      } else if (key == "dependentRequired" || key == "dependencies") {
+        // dependencies is the draft 7 form of both dependent keywords
+        if (!v.is_object())
+          Fail(at, "must be an object");
+        for (auto &property : v.items()) {
+          std::string path =
+              at + "/" + Model::EscapePointerToken(property.key());
+          if (property.value().is_array())
+            node.dependentRequired.emplace_back(
+                property.key(), Names(property.value(), path));
+          else
+            node.dependentSchemas.emplace_back(
+                property.key(), Compile(property.value(), path, resource));
+        }
+      } else if (key == "allOf") {
+        node.allOf = List(v, at, resource);
+      } else if (key == "anyOf") {
+        node.anyOf = List(v, at, resource);
+      } else if (key == "oneOf") {
+        node.oneOf = List(v, at, resource);
+      } else if (key == "not") {
+        node.notSchema = Compile(v, at, resource);
+      } else if (key == "if") {
+        node.ifSchema = Compile(v, at, resource);
+      } else if (key == "then") {
+        node.thenSchema = Compile(v, at, resource);
+      } else if (key == "else") {
+        node.elseSchema = Compile(v, at, resource);
+      } else if (key == "$ref" || key == "$dynamicRef" ||
+                 key == "$recursiveRef") {
+        if (!v.is_string())
+          Fail(at, "must be a string");
+        m_pending.push_back({index, v.get<std::string>(), resource, at});
+      }
+      // Anything else ($defs, annotations, format, unevaluated*) is only
+      // reached through a $ref or not checked
+    }
+    if (itemsList && value.contains("additionalItems"))
+      node.items = Compile(value["additionalItems"],
+                           location + "/additionalItems", resource);
+    std::sort(node.dependentSchemas.begin(), node.dependentSchemas.end());
+    m_schema.m_nodes[index] = std::move(node);
+    return index;
+  }
+
+  JsonSchema &m_schema;
+  const nlohmann::json &m_root;
+  std::unordered_map<std::string, std::string> m_ids;     // $id -> location
+  std::unordered_map<std::string, std::string> m_anchors; // name -> location
+  std::unordered_map<std::string, int> m_compiled;        // location -> node
+  std::unordered_map<std::string, int> m_patternIndex;    // source -> pattern
+  std::vector<Pending> m_pending;
+};
+
+JsonSchema::JsonSchema(const nlohmann::json &schema) {
+  Compiler(*this, schema).Run();
+}
+
+JsonSchema::~JsonSchema() = default;
+
+// -- Validating --
+
+// Appends errors found in a member or element, at most limit in all.
+static void AddErrors(std::vector<SchemaError> &errors,
+                      std::vector<SchemaError> &found,
+                      const std::string &prefix, size_t limit,
+                      bool &truncated) {
+  for (SchemaError &error : found) {
+    if (errors.size() >= limit) {
+      truncated = true;
+      return;
+    }
+    error.path = prefix + error.path;
+    errors.push_back(std::move(error));
+  }
+}
+
+std::vector<SchemaError>
+JsonSchema::Validate(const ModelPtr &root, bool multiDocument, Cache *cache,
+                     const std::atomic<bool> *cancel, size_t limit,
+                     bool *complete) const {
+  std::lock_guard<std::mutex> lock(m_running);
+  Run run{cache, {}, cancel, limit};
+  std::vector<SchemaError> errors;
+  if (root && multiDocument && root->kind == ModelNode::ARRAY) {
+    for (size_t i = 0; i < root->Size() && !run.Cancelled(); i++)
+      CheckItem(0, Model::Item(root, i), nullptr, i, run, &errors);
+  } else if (root) {
+    Check(0, root, run, &errors);
+  }
+  if (cache) {
+    // Entries in next are complete even if this run was cancelled
+    cache->m_entries = std::move(run.next);
+    cache->m_reused = run.reused;
+  }
+  if (complete)
+    *complete = !run.truncated && !run.Cancelled();
+  return errors;
+}
+
+bool JsonSchema::Check(int schema, const ModelPtr &input, Run &run,
+                       std::vector<SchemaError> *errors) const {
+  const Node &node = m_nodes[schema];
+  if (node.kind == Node::ANY || run.Cancelled())
+    return true;
+  if (node.kind == Node::NONE) {
+    if (errors && errors->size() < run.limit)
+      errors->push_back({"", node.location, "no value is allowed here"});
+    return false;
+  }
+  ModelPtr value = Model::Resolve(input);
+  if (!value || value->kind == ModelNode::ALIAS)
+    return true; // An alias inside the node it refers to
+  if (run.depth >= kMaxDepth) {
+    if (errors && errors->size() < run.limit)
+      errors->push_back({"", node.location, "nested too deeply to check"});
+    return false;
+  }
+  if (!run.cache || !value->IsContainer()) {
+    run.depth++;
+    bool valid = CheckKeywords(node, value, run, errors);
+    run.depth--;
+    return valid;
+  }
+
+  size_t key = value->hash ^ ((size_t)schema * (size_t)0x9E3779B97F4A7C15ull);
+  for (Cache::Map *map : {&run.next, &run.cache->m_entries}) {
+    auto range = map->equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+      Cache::Entry &entry = it->second;
+      if (entry.schema != schema || (errors && !entry.listed) ||
+          !Model::Equal(entry.value, value))
+        continue;
+      bool valid = entry.valid;
+      if (errors) {
+        std::vector<SchemaError> found = entry.errors;
+        AddErrors(*errors, found, "", run.limit, run.truncated);
+      }
+      if (map != &run.next) {
+        // Moved: the old entries are dropped at the end of the run, and a
+        // moved-from entry's null value never compares equal again
+        run.reused++;
+        run.next.emplace(key, std::move(entry));
+      }
+      return valid;
+    }
+  }
+  std::vector<SchemaError> found;
+  run.depth++;
+  bool valid = CheckKeywords(node, value, run, errors ? &found : nullptr);
+  run.depth--;
+  if (!run.Cancelled())
+    run.next.emplace(
+        key, Cache::Entry{value, schema, valid, errors != nullptr, found});
+  if (errors)
+    AddErrors(*errors, found, "", run.limit, run.truncated);
+  return valid;
+}
+
+bool JsonSchema::CheckItem(int schema, const ModelPtr &item,
+                           const std::string *key, size_t index, Run &run,
+                           std::vector<SchemaError> *errors) const {
+  if (!errors)
+    return Check(schema, item, run, nullptr);
+  std::vector<SchemaError> found;
+  bool valid = Check(schema, item, run, &found);
+  if (!found.empty())
+    AddErrors(*errors, found,
+              "/" + (key ? Model::EscapePointerToken(*key)
+                         : std::to_string(index)),
+              run.limit, run.truncated);
+  return valid;
+}
+
+bool JsonSchema::Matches(int pattern, const std::string &text) const {
+  std::wstring wide = Utf8ToWide(text);
+  SearchMatch match;
+  return m_patterns[pattern]->Find(wide.data(), wide.size(), 0, match);
+}
+
+bool JsonSchema::CheckKeywords(const Node &node, const ModelPtr &value,
+                               Run &run,
+                               std::vector<SchemaError> *errors) const {
+  bool valid = true;
+  // Records a failed keyword; false when only validity is wanted, so the
+  // caller stops at the first failure.
+  auto fail = [&](const char *keyword, const std::string &message) {
+    valid = false;
+    if (!errors)
+      return false;
+    if (errors->size() < run.limit)
+      errors->push_back({"", node.location + "/" + keyword, message});
+    else
+      run.truncated = true;
+    return true;
+  };
+  // Same for a subschema's result, whose errors are already listed
+  auto sub = [&](bool subValid) {
+    if (!subValid)
+      valid = false;
+    return subValid || errors != nullptr;
+  };
+  const ModelNode &v = *value;
+  uint8_t type = TypeOf(v);
+
+  if (node.types && !(node.types & type) &&
+      !fail("type", "expected " + TypeNames(node.types) + ", got " +
+                        TypeName(v)))
+    return false;
+  if (node.enumValues >= 0) {
+    const Enum &values = m_enums[node.enumValues];
+    bool found = false;
+    switch (v.kind) {
+    case ModelNode::NUL:
+      found = values.null;
+      break;
+    case ModelNode::BOOLEAN:
+      found = v.boolean ? values.yes : values.no;
+      break;
+    case ModelNode::STRING:
+      found = values.strings.count(v.Text()) != 0;
+      break;
+    case ModelNode::INTEGER:
+    case ModelNode::REAL:
+      found = std::binary_search(values.numbers.begin(), values.numbers.end(),
+                                 NumberValue(v));
+      break;
+    default:
+      for (const ModelPtr &container : values.containers)
+        found = found || SameValue(container, value);
+    }
+    if (!found && !fail("enum", "not one of " + values.text))
+      return false;
+  }
+  if (node.constValue && !SameValue(node.constValue, value) &&
+      !fail("const", "expected " + Model::ToJsonText(node.constValue)))
+    return false;
+
+  if (type & kNumber) {
+    double number = NumberValue(v);
+    if (node.minimum && number < *node.minimum &&
+        !fail("minimum", "less than " + NumberText(*node.minimum)))
+      return false;
+    if (node.maximum && number > *node.maximum &&
+        !fail("maximum", "greater than " + NumberText(*node.maximum)))
+      return false;
+    if (node.exclusiveMinimum && number <= *node.exclusiveMinimum &&
+        !fail("exclusiveMinimum",
+              "not greater than " + NumberText(*node.exclusiveMinimum)))
+      return false;
+    if (node.exclusiveMaximum && number >= *node.exclusiveMaximum &&
+        !fail("exclusiveMaximum",
+              "not less than " + NumberText(*node.exclusiveMaximum)))
+      return false;
+    if (node.multipleOf && !MultipleOf(v, *node.multipleOf) &&
+        !fail("multipleOf",
+              "not a multiple of " + NumberText(*node.multipleOf)))
+      return false;
+  }
+
+  if (v.kind == ModelNode::STRING) {
+    if (node.minLength > 0 || node.maxLength != SIZE_MAX) {
+      size_t length = CodePoints(v.Text());
+      if (length < node.minLength &&
+          !fail("minLength", "shorter than " +
+                                 std::to_string(node.minLength) +
+                                 " characters"))
+        return false;
+      if (length > node.maxLength &&
+          !fail("maxLength", "longer than " + std::to_string(node.maxLength) +
+                                 " characters"))
+        return false;
+    }
+    if (node.pattern >= 0 && !Matches(node.pattern, v.Text()) &&
+        !fail("pattern",
+              "does not match " + m_patternSources[node.pattern]))
+      return false;
+  }
+
+  if (v.kind == ModelNode::ARRAY) {
+    size_t size = v.Size();
+    if (size < node.minItems &&
+        !fail("minItems",
+              "fewer than " + std::to_string(node.minItems) + " items"))
+      return false;
+    if (size > node.maxItems &&
+        !fail("maxItems",
+              "more than " + std::to_string(node.maxItems) + " items"))
+      return false;
+    size_t contained = 0;
+    for (size_t i = 0; i < size; i++) {
+      if (run.Cancelled())
+        return valid;
+      int schema =
+          i < node.prefixItems.size() ? node.prefixItems[i] : node.items;
+      if (schema < 0 && node.contains < 0)
+        break;
+      ModelPtr item = Model::Item(value, i);
+      if (schema >= 0 &&
+          !sub(CheckItem(schema, item, nullptr, i, run, errors)))
+        return false;
+      if (node.contains >= 0 && Check(node.contains, item, run, nullptr))
+        contained++;
+    }
+    if (node.contains >= 0) {
+      if (contained < node.minContains &&
+          !fail(node.minContains == 1 ? "contains" : "minContains",
+                contained ? "too few items match contains"
+                          : "no item matches contains"))
+        return false;
+      if (contained > node.maxContains &&
+          !fail("maxContains", "too many items match contains"))
+        return false;
+    }
+    if (node.uniqueItems && size > 1) {
+      std::unordered_multimap<size_t, size_t> seen;
+      for (size_t i = 0; i < size; i++) {
+        ModelPtr item = Model::Item(value, i);
+        size_t hash = ValueHash(item);
+        auto range = seen.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+          if (SameValue(Model::Item(value, it->second), item)) {
+            if (!fail("uniqueItems", "items " + std::to_string(it->second) +
+                                         " and " + std::to_string(i) +
+                                         " are equal"))
+              return false;
+            i = size; // One report is enough
+            break;
+          }
+        }
+        if (i < size)
+          seen.emplace(hash, i);
+      }
+    }
+  }
+
+  if (v.kind == ModelNode::OBJECT) {
+    size_t size = v.Keys().size();
+    if (size < node.minProperties &&
+        !fail("minProperties", "fewer than " +
+                                   std::to_string(node.minProperties) +
+                                   " properties"))
+      return false;
+    if (size > node.maxProperties &&
+        !fail("maxProperties", "more than " +
+                                   std::to_string(node.maxProperties) +
+                                   " properties"))
+      return false;
+    for (const std::string &name : node.required) {
+      if (v.FindKey(name) < 0 &&
+          !fail("required", "missing property \"" + name + "\""))
+        return false;
+    }
+    for (auto &dependent : node.dependentRequired) {
+      if (v.FindKey(dependent.first) < 0)
+        continue;
+      for (const std::string &name : dependent.second) {
+        if (v.FindKey(name) < 0 &&
+            !fail("dependentRequired", "missing property \"" + name +
+                                           "\", required with \"" +
+                                           dependent.first + "\""))
+          return false;
+      }
+    }
+    for (size_t i = 0; i < size; i++) {
+      if (run.Cancelled())
+        return valid;
+      const std::string &key = v.Keys()[i];
+      bool known = false;
+      auto property = std::lower_bound(
+          node.properties.begin(), node.properties.end(), key,
+          [](const std::pair<std::string, int> &entry,
+             const std::string &name) { return entry.first < name; });
+      if (property != node.properties.end() && property->first == key) {
+        known = true;
+        if (!sub(CheckItem(property->second, v.items[i], &key, 0, run,
+                           errors)))
+          return false;
+      }
+      for (auto &pattern : node.patternProperties) {
+        if (!Matches(pattern.first, key))
+          continue;
+        known = true;
+        if (!sub(CheckItem(pattern.second, v.items[i], &key, 0, run, errors)))
+          return false;
+      }
+      if (!known && node.additionalProperties >= 0 &&
+          !sub(CheckItem(node.additionalProperties, v.items[i], &key, 0, run,
+                         errors)))
+        return false;
+      if (node.propertyNames >= 0 &&
+          !Check(node.propertyNames, Model::String(key), run, nullptr) &&
+          !fail("propertyNames",
+                "property name \"" + key + "\" is not allowed"))
+        return false;
+    }
+    for (auto &dependent : node.dependentSchemas) {
+      if (v.FindKey(dependent.first) >= 0 &&
+          !sub(Check(dependent.second, value, run, errors)))
+        return false;
+    }
+  }
+
+  for (int schema : node.allOf) {
+    if (!sub(Check(schema, value, run, errors)))
+      return false;
+  }
+  if (!node.anyOf.empty()) {
+    bool any = false;
+    for (size_t i = 0; i < node.anyOf.size() && !any; i++)
+      any = Check(node.anyOf[i], value, run, nullptr);
+    if (!any && !fail("anyOf", "matches none of the " +
+                                   std::to_string(node.anyOf.size()) +
+                                   " alternatives"))
+      return false;
+  }
+  if (!node.oneOf.empty()) {
+    size_t matched = 0;
+    for (size_t i = 0; i < node.oneOf.size() && matched < 2; i++)
+      matched += Check(node.oneOf[i], value, run, nullptr);
+    if (matched != 1 &&
+        !fail("oneOf", matched ? "matches more than one alternative"
+                               : "matches none of the " +
+                                     std::to_string(node.oneOf.size()) +
+                                     " alternatives"))
+      return false;
+  }
+  if (node.notSchema >= 0 && Check(node.notSchema, value, run, nullptr) &&
+      !fail("not", "matches a schema it must not"))
+    return false;
+  if (node.ifSchema >= 0) {
+    int branch = Check(node.ifSchema, value, run, nullptr) ? node.thenSchema
+                                                           : node.elseSchema;
+    if (branch >= 0 && !sub(Check(branch, value, run, errors)))
+      return false;
+  }
+  if (node.ref >= 0 && !sub(Check(node.ref, value, run, errors)))
+    return false;
+  return valid;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "Model.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class SearchEngine;
+
+struct SchemaError {
+  std::string path;     // JSON Pointer to the value; "" for the root
+  std::string location; // JSON Pointer to the failing keyword in the schema
+  std::string message;
+};
+
+// A JSON Schema (draft 2020-12) compiled into a validation program.
+//
+// Every subschema is compiled once into a node with its keywords decoded:
+// $ref points straight at the target node, patterns are compiled into
+// SearchEngines and enums are split into a hash set of strings and sorted
+// numbers. Validation walks the immutable model, so it runs on a worker
+// thread while the tab is edited.
+//
+// A Cache keeps the result of each container checked against each
+// subschema, looked up by the subtree's structural hash. Validating the
+// next version of the document takes the results of unchanged subtrees
+// from it, so after an edit only the containers on the path to the edited
+// value are checked again. With Share Identical Subtrees on, unchanged
+// subtrees are recognized by pointer; otherwise by a deep comparison,
+// which is still much cheaper than checking them.
+//
+// Supported: type enum const multipleOf maximum exclusiveMaximum minimum
+// exclusiveMinimum maxLength minLength pattern prefixItems items contains
+// maxContains minContains maxItems minItems uniqueItems properties
+// patternProperties additionalProperties propertyNames required
+// dependentRequired dependentSchemas maxProperties minProperties allOf
+// anyOf oneOf not if then else, and $ref or $dynamicRef to a JSON Pointer,
+// an $anchor or an $id within the schema document. format and the
+// unevaluated* keywords are not checked; patterns use SearchEngine syntax
+// with ^ and $ anchored to the whole string, as in ECMA-262.
+class JsonSchema {
+public:
+  class Cache;
+
+  // Throws std::runtime_error, with the schema location, for a malformed
+  // schema, a bad pattern or a $ref that does not resolve.
+  explicit JsonSchema(const nlohmann::json &schema);
+  ~JsonSchema();
+  JsonSchema(const JsonSchema &) = delete;
+  JsonSchema &operator=(const JsonSchema &) = delete;
+
+  // Errors in root, at most limit. multiDocument: root is the array of
+  // YAML documents, each validated on its own. cache, if given, supplies
+  // and receives results; it must only be used with this schema. Stops
+  // early once cancel is set; *complete then receives false, as it does
+  // when errors were left out for the limit.
+  std::vector<SchemaError> Validate(const ModelPtr &root, bool multiDocument,
+                                    Cache *cache = nullptr,
+                                    const std::atomic<bool> *cancel = nullptr,
+                                    size_t limit = SIZE_MAX,
+                                    bool *complete = nullptr) const;
+
+private:
+  struct Node;
+  struct Enum;
+  struct Run;
+  class Compiler;
+
+  bool Check(int schema, const ModelPtr &value, Run &run,
+             std::vector<SchemaError> *errors) const;
+  bool CheckKeywords(const Node &node, const ModelPtr &value, Run &run,
+                     std::vector<SchemaError> *errors) const;
+  // Checks a member (key set) or element (at index) of the value being
+  // checked, prefixing its errors' paths
+  bool CheckItem(int schema, const ModelPtr &item, const std::string *key,
+                 size_t index, Run &run,
+                 std::vector<SchemaError> *errors) const;
+  bool Matches(int pattern, const std::string &text) const;
+
+  std::vector<Node> m_nodes; // m_nodes[0] is the root schema
+  std::vector<Enum> m_enums;
+  std::vector<std::unique_ptr<SearchEngine>> m_patterns;
+  std::vector<std::string> m_patternSources;
+  // Patterns cache DFA states, so one validation runs at a time
+  mutable std::mutex m_running;
+};
+
+// Results of the last validation for the next one to reuse.
+class JsonSchema::Cache {
+public:
+  size_t Size() const { return m_entries.size(); }
+  size_t Reused() const { return m_reused; } // By the last validation
+
+private:
+  friend class JsonSchema;
+  struct Entry {
+    ModelPtr value;
+    int schema;
+    bool valid;
+    bool listed; // errors were collected, not just validity
+    std::vector<SchemaError> errors; // Paths relative to value
+  };
+  typedef std::unordered_multimap<size_t, Entry> Map;
+  Map m_entries; // By value hash and schema
+  size_t m_reused = 0;
+};
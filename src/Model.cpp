@@ -0,0 +1,1367 @@
+#include "Model.h"
+#include "JsonEscape.h"
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/yaml.h>
+
+using json = nlohmann::json;
+
+int ModelNode::FindKey(const std::string &key) const {
+  const std::vector<std::string> &names = Keys();
+  for (size_t i = 0; i < names.size(); i++) {
+    if (names[i] == key)
+      return (int)i;
+  }
+  return -1;
+}
+
+// -- Hashing & Equality --
+
+static size_t HashCombine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// Reals are told apart by bit pattern, not ==: -0.0 and 0.0 print
+// differently, so they must not intern to one node, and a NaN must equal
+// itself. Every NaN maps to the one quiet NaN, as it is written the same.
+static uint64_t RealBits(double real) {
+  if (std::isnan(real))
+    return 0x7FF8000000000000ULL;
+  uint64_t bits;
+  std::memcpy(&bits, &real, sizeof(bits));
+  return bits;
+}
+
+static bool SameReals(const std::vector<double> &a,
+                      const std::vector<double> &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (RealBits(a[i]) != RealBits(b[i]))
+      return false;
+  }
+  return true;
+}
+
+// Packed elements hash exactly like the boxed scalars they stand for, so a
+// packed array and its generic equivalent hash the same.
+static size_t ScalarHash(ModelNode::Kind kind, int64_t integer, double real) {
+  size_t h = std::hash<int>()(kind);
+  if (kind == ModelNode::REAL)
+    return HashCombine(h, std::hash<uint64_t>()(RealBits(real)));
+  if (kind == ModelNode::BOOLEAN)
+    return HashCombine(h, integer != 0);
+  return HashCombine(h, std::hash<int64_t>()(integer));
+}
+
+void Model::Rehash(ModelNode &node) {
+  size_t h = std::hash<int>()(node.kind);
+  switch (node.kind) {
+  case ModelNode::BOOLEAN:
+    h = ScalarHash(node.kind, node.boolean, 0.0);
+    break;
+  case ModelNode::INTEGER:
+    h = ScalarHash(node.kind, node.integer, 0.0);
+    if (node.isUnsigned)
+      h = HashCombine(h, 1);
+    break;
+  case ModelNode::REAL:
+    h = ScalarHash(node.kind, 0, node.real);
+    break;
+  case ModelNode::STRING:
+    h = HashCombine(h, std::hash<std::string>()(node.Text()));
+    break;
+  case ModelNode::ALIAS:
+    h = HashCombine(h, std::hash<std::string>()(node.Text()));
+    if (!node.items.empty())
+      h = HashCombine(h, node.items[0]->hash);
+    break;
+  case ModelNode::OBJECT:
+    for (const auto &key : node.Keys())
+      h = HashCombine(h, std::hash<std::string>()(key));
+    // fall through
+  case ModelNode::ARRAY:
+    if (node.packedKind == ModelNode::REAL) {
+      for (double d : node.PackedReals())
+        h = HashCombine(h, ScalarHash(ModelNode::REAL, 0, d));
+    } else if (node.IsPacked()) {
+      for (int64_t i : node.PackedInts())
+        h = HashCombine(h, ScalarHash(node.packedKind, i, 0.0));
+    } else {
+      for (const auto &item : node.items)
+        h = HashCombine(h, item->hash);
+    }
+    break;
+  default:
+    break;
+  }
+  node.hash = h;
+}
+
+bool Model::Equal(const ModelPtr &first, const ModelPtr &second) {
+  if (first == second)
+    return true;
+  // An alias is equal to the value it refers to.
+  ModelPtr a = first ? Resolve(first) : first;
+  ModelPtr b = second ? Resolve(second) : second;
+  if (a == b)
+    return true;
+  if (!a || !b || a->hash != b->hash || a->kind != b->kind)
+    return false;
+  switch (a->kind) {
+  case ModelNode::BOOLEAN:
+    return a->boolean == b->boolean;
+  case ModelNode::INTEGER:
+    return a->integer == b->integer && a->isUnsigned == b->isUnsigned;
+  case ModelNode::REAL:
+    return RealBits(a->real) == RealBits(b->real);
+  case ModelNode::STRING:
+  case ModelNode::ALIAS: // Unresolved (recursive) aliases compare by name
+    return a->Text() == b->Text();
+  case ModelNode::ARRAY:
+  case ModelNode::OBJECT:
+    if (a->Keys() != b->Keys() || a->Size() != b->Size())
+      return false;
+    if (a->IsPacked() && a->packedKind == b->packedKind)
+      return a->PackedInts() == b->PackedInts() &&
+             SameReals(a->PackedReals(), b->PackedReals());
+    for (size_t i = 0; i < a->Size(); i++) {
+      if (!Equal(Item(a, i), Item(b, i)))
+        return false;
+    }
+    return true;
+  default:
+    return true;
+  }
+}
+
+// Children of an interned node are interned themselves, so candidates only
+// need a shallow comparison: children match exactly when they are the same
+// pointer.
+static bool ShallowEqual(const ModelNode &a, const ModelNode &b) {
+  if (a.kind != b.kind || a.hash != b.hash)
+    return false;
+  switch (a.kind) {
+  case ModelNode::BOOLEAN:
+    return a.boolean == b.boolean;
+  case ModelNode::INTEGER:
+    return a.integer == b.integer && a.isUnsigned == b.isUnsigned;
+  case ModelNode::REAL:
+    return RealBits(a.real) == RealBits(b.real);
+  case ModelNode::STRING:
+    return a.Text() == b.Text();
+  case ModelNode::ALIAS:
+    return a.Text() == b.Text() && a.items == b.items;
+  case ModelNode::ARRAY:
+  case ModelNode::OBJECT:
+    return a.Keys() == b.Keys() && a.items == b.items &&
+           a.packedKind == b.packedKind && a.PackedInts() == b.PackedInts() &&
+           SameReals(a.PackedReals(), b.PackedReals());
+  default:
+    return true;
+  }
+}
+
+ModelPtr ModelInterner::Intern(const ModelPtr &node) {
+  auto range = m_table.equal_range(node->hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    ModelPtr existing = it->second.lock();
+    if (existing && ShallowEqual(*existing, *node))
+      return existing;
+  }
+  m_table.emplace(node->hash, node);
+  if (++m_live >= m_sweepAt)
+    Sweep();
+  return node;
+}
+
+// Drops entries whose nodes are no longer referenced by any model.
+void ModelInterner::Sweep() {
+  for (auto it = m_table.begin(); it != m_table.end();) {
+    if (it->second.expired())
+      it = m_table.erase(it);
+    else
+      ++it;
+  }
+  m_live = m_table.size();
+  m_sweepAt = m_live * 2 > 4096 ? m_live * 2 : 4096;
+}
+
+// -- Construction --
+
+ModelPtr Model::Null() {
+  static const ModelPtr null = [] {
+    auto n = std::make_shared<ModelNode>();
+    Rehash(*n);
+    return n;
+  }();
+  return null;
+}
+
+ModelPtr Model::Boolean(bool value) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::BOOLEAN;
+  n->boolean = value;
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Integer(int64_t value) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::INTEGER;
+  n->integer = value;
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Unsigned(uint64_t value) {
+  if (value <= (uint64_t)INT64_MAX)
+    return Integer((int64_t)value);
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::INTEGER;
+  n->isUnsigned = true;
+  n->uinteger = value;
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Real(double value) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::REAL;
+  n->real = value;
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::String(std::string value) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::STRING;
+  n->payload = std::move(value);
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Array(std::vector<ModelPtr> items) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::ARRAY;
+  n->items = std::move(items);
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Object(std::vector<std::string> keys,
+                       std::vector<ModelPtr> items) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::OBJECT;
+  n->payload = std::move(keys);
+  n->items = std::move(items);
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Alias(std::string anchor, const ModelPtr &target) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::ALIAS;
+  n->payload = std::move(anchor);
+  if (target)
+    n->items.push_back(target);
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Resolve(const ModelPtr &node) {
+  if (node->kind == ModelNode::ALIAS && !node->items.empty())
+    return node->items[0];
+  return node;
+}
+
+std::string Model::ScalarText(const ModelPtr &node) {
+  switch (node->kind) {
+  case ModelNode::NUL:
+    return "null";
+  case ModelNode::BOOLEAN:
+    return node->boolean ? "true" : "false";
+  case ModelNode::INTEGER:
+    if (node->isUnsigned)
+      return std::to_string(node->uinteger);
+    return std::to_string(node->integer);
+  case ModelNode::REAL: {
+    // Spelled the way ParseScalar reads them back
+    if (std::isnan(node->real))
+      return ".nan";
+    if (std::isinf(node->real))
+      return node->real < 0 ? "-.inf" : ".inf";
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), node->real);
+    std::string text(buf, res.ptr);
+    // Keep reals recognizable as reals when they happen to be integral
+    if (text.find_first_of(".eEn") == std::string::npos)
+      text += ".0";
+    return text;
+  }
+  case ModelNode::STRING:
+    return node->Text();
+  case ModelNode::ALIAS:
+    return "*" + node->Text();
+  default:
+    return "";
+  }
+}
+
+ModelPtr Model::PackedInts(ModelNode::Kind elementKind,
+                           std::vector<int64_t> values) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::ARRAY;
+  n->packedKind = elementKind;
+  n->payload = std::move(values);
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::PackedReals(std::vector<double> values) {
+  auto n = std::make_shared<ModelNode>();
+  n->kind = ModelNode::ARRAY;
+  n->packedKind = ModelNode::REAL;
+  n->payload = std::move(values);
+  Rehash(*n);
+  return n;
+}
+
+ModelPtr Model::Item(const ModelPtr &array, size_t index) {
+  switch (array->packedKind) {
+  case ModelNode::BOOLEAN:
+    return Boolean(array->PackedInts()[index] != 0);
+  case ModelNode::INTEGER:
+    return Integer(array->PackedInts()[index]);
+  case ModelNode::REAL:
+    return Real(array->PackedReals()[index]);
+  default:
+    return array->items[index];
+  }
+}
+
+// Plain loops over contiguous storage so the compiler can vectorize them.
+template <typename T>
+static void SummarizeRange(const std::vector<T> &values,
+                           ModelSummary &summary) {
+  T lo = values[0], hi = values[0];
+  double sum = 0.0;
+  for (T v : values) {
+    lo = v < lo ? v : lo;
+    hi = v > hi ? v : hi;
+    sum += (double)v;
+  }
+  summary.count = values.size();
+  summary.min = (double)lo;
+  summary.max = (double)hi;
+  summary.sum = sum;
+}
+
+bool Model::Summarize(const ModelPtr &array, ModelSummary &summary) {
+  if (!array || !array->IsPacked() || array->Size() == 0)
+    return false;
+  if (array->packedKind == ModelNode::REAL)
+    SummarizeRange(array->PackedReals(), summary);
+  else
+    SummarizeRange(array->PackedInts(), summary);
+  return true;
+}
+
+// -- Conversion --
+
+// Classifies a plain YAML scalar into node's kind and value fields.
+void Model::ParseScalar(const std::string &s, ModelNode &node) {
+  node.kind = ModelNode::STRING;
+  if (s == "true" || s == "false") {
+    node.kind = ModelNode::BOOLEAN;
+    node.boolean = (s == "true");
+    return;
+  }
+  if (s == "null" || s == "~") {
+    node.kind = ModelNode::NUL;
+    return;
+  }
+  // Only text that starts like a number can be one; skipping the rest
+  // avoids an exception per string.
+  static const std::string kNumberStart = "0123456789+-.iInN";
+  if (s.empty() || kNumberStart.find(s[0]) == std::string::npos)
+    return;
+  // The YAML 1.2 core schema spells infinity and NaN as .inf and .nan,
+  // which stod does not accept.
+  size_t sign = (s[0] == '+' || s[0] == '-') ? 1 : 0;
+  std::string rest = s.substr(sign);
+  if (rest == ".inf" || rest == ".Inf" || rest == ".INF") {
+    node.kind = ModelNode::REAL;
+    node.real = s[0] == '-' ? -HUGE_VAL : HUGE_VAL;
+    return;
+  }
+  if (!sign && (rest == ".nan" || rest == ".NaN" || rest == ".NAN")) {
+    node.kind = ModelNode::REAL;
+    node.real = NAN;
+    return;
+  }
+  try {
+    size_t used = 0;
+    if (s.find('.') != std::string::npos || s.find('e') != std::string::npos ||
+        s.find('E') != std::string::npos) {
+      double d = std::stod(s, &used);
+      if (used == s.size()) {
+        node.kind = ModelNode::REAL;
+        node.real = d;
+      }
+    } else {
+      long long i = std::stoll(s, &used);
+      if (used == s.size()) {
+        node.kind = ModelNode::INTEGER;
+        node.integer = i;
+      }
+    }
+  } catch (const std::out_of_range &) {
+    // Past int64 but still a uint64 (stoull would wrap a negative value)
+    try {
+      size_t used = 0;
+      unsigned long long u = s[0] != '-' && s.find('.') == std::string::npos
+                                 ? std::stoull(s, &used)
+                                 : 0;
+      if (used == s.size()) {
+        node.kind = ModelNode::INTEGER;
+        node.isUnsigned = true;
+        node.uinteger = u;
+      }
+    } catch (...) {
+    }
+  } catch (...) {
+  }
+}
+
+bool Model::IsPlainString(const std::string &text) {
+  ModelNode node;
+  ParseScalar(text, node);
+  return node.kind == ModelNode::STRING;
+}
+
+static bool IsPackableKind(ModelNode::Kind kind) {
+  return kind == ModelNode::BOOLEAN || kind == ModelNode::INTEGER ||
+         kind == ModelNode::REAL;
+}
+
+// Builds models straight from yaml-cpp parser events instead of going
+// through YAML::Node. Each anchored node is built once; an alias becomes an
+// ALIAS node pointing at it, so anchor-heavy documents stay linear in size.
+class ModelBuilder : public YAML::EventHandler {
+public:
+  ModelBuilder(ModelInterner *interner, std::vector<int> *lines)
+      : m_interner(interner), m_lines(lines) {}
+
+  std::vector<ModelPtr> &Documents() { return m_documents; }
+
+  void OnDocumentStart(const YAML::Mark &) override {
+    m_anchors.clear();
+    m_anchorNames.clear();
+    m_dropped.clear();
+    m_root = nullptr;
+  }
+
+  void OnDocumentEnd() override {
+    m_documents.push_back(m_root ? m_root : Model::Null());
+  }
+
+  void OnNull(const YAML::Mark &mark, YAML::anchor_t anchor) override {
+    NameAnchor(anchor);
+    if (TakeKey("null"))
+      return;
+    BeginValue(mark);
+    Add(Model::Null(), anchor);
+  }
+
+  void OnAlias(const YAML::Mark &mark, YAML::anchor_t anchor) override {
+    auto target = m_anchors.find(anchor);
+    // An anchor that is still being built is referenced from inside itself.
+    ModelPtr resolved = (target != m_anchors.end()) ? target->second : nullptr;
+    ModelPtr alias = Model::Alias(m_anchorNames[anchor], resolved);
+    if (TakeKey(KeyText(alias)))
+      return;
+    BeginValue(mark);
+    if (resolved && m_dropped.erase(anchor)) {
+      // The anchored value went with a duplicate key, so the first alias
+      // to it takes its place and later ones refer to it there.
+      if (m_lines && m_keyDepth == 0)
+        m_lines->insert(m_lines->end(), LineCount(resolved) - 1, mark.line);
+      Add(resolved, 0);
+      return;
+    }
+    Add(alias, 0);
+  }
+
+  void OnScalar(const YAML::Mark &mark, const std::string &tag,
+                YAML::anchor_t anchor, const std::string &value) override {
+    NameAnchor(anchor);
+    if (TakeKey(value))
+      return;
+    BeginValue(mark);
+
+    ModelNode scalar;
+    // Quoted and !!str scalars are strings; only plain ones are typed.
+    if (tag == "!" || tag == "tag:yaml.org,2002:str")
+      scalar.kind = ModelNode::STRING;
+    else
+      Model::ParseScalar(value, scalar);
+
+    if (anchor == 0 && !m_stack.empty() && m_stack.back().packing &&
+        PushPacked(m_stack.back(), scalar))
+      return;
+    Add(BoxScalar(scalar, value), anchor);
+  }
+
+  void OnSequenceStart(const YAML::Mark &mark, const std::string &,
+                       YAML::anchor_t anchor,
+                       YAML::EmitterStyle::value) override {
+    Push(mark, anchor, false);
+  }
+
+  void OnSequenceEnd() override {
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+    if (frame.isKey)
+      m_keyDepth--;
+
+    ModelPtr node;
+    if (frame.packing && frame.packedKind != ModelNode::NUL &&
+        frame.Size() >= Model::kMinPackedSize) {
+      node = (frame.packedKind == ModelNode::REAL)
+                 ? Model::PackedReals(std::move(frame.reals))
+                 : Model::PackedInts(frame.packedKind, std::move(frame.ints));
+    } else {
+      Unpack(frame);
+      node = Model::Array(std::move(frame.items));
+    }
+    Finish(node, frame.anchor);
+  }
+
+  void OnMapStart(const YAML::Mark &mark, const std::string &,
+                  YAML::anchor_t anchor, YAML::EmitterStyle::value) override {
+    Push(mark, anchor, true);
+  }
+
+  void OnMapEnd() override {
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+    if (frame.isKey)
+      m_keyDepth--;
+    Finish(Model::Object(std::move(frame.keys), std::move(frame.items)),
+           frame.anchor);
+  }
+
+  void OnAnchor(const YAML::Mark &, const std::string &name) override {
+    m_pendingAnchorName = name;
+  }
+
+private:
+  struct Frame {
+    bool isMap = false;
+    bool isKey = false; // This collection is itself a mapping key
+    YAML::anchor_t anchor = 0;
+    std::vector<std::string> keys;
+    std::vector<ModelPtr> items;
+    // Maps: pending key, key positions, and where each value's lines start
+    bool haveKey = false;
+    std::string key;
+    std::unordered_map<std::string, size_t> keyIndex;
+    std::vector<size_t> lineStarts;
+    size_t valueLineStart = 0;
+    // Sequences: elements stay unboxed while they all share one kind
+    bool packing = false;
+    ModelNode::Kind packedKind = ModelNode::NUL;
+    std::vector<int64_t> ints;
+    std::vector<double> reals;
+
+    size_t Size() const {
+      return packedKind == ModelNode::REAL ? reals.size() : ints.size();
+    }
+  };
+
+  static std::string KeyText(const ModelPtr &node) {
+    ModelPtr target = Model::Resolve(node);
+    if (target->kind == ModelNode::STRING)
+      return target->Text();
+    if (target->IsContainer() || target->kind == ModelNode::ALIAS)
+      return "???";
+    return Model::ScalarText(target);
+  }
+
+  static ModelPtr BoxScalar(const ModelNode &scalar, const std::string &text) {
+    switch (scalar.kind) {
+    case ModelNode::BOOLEAN:
+      return Model::Boolean(scalar.boolean);
+    case ModelNode::INTEGER:
+      if (scalar.isUnsigned)
+        return Model::Unsigned(scalar.uinteger);
+      return Model::Integer(scalar.integer);
+    case ModelNode::REAL:
+      return Model::Real(scalar.real);
+    case ModelNode::NUL:
+      return Model::Null();
+    default:
+      return Model::String(text);
+    }
+  }
+
+  // Nodes value adds to the source lines: an alias is not entered and a
+  // packed array has one per element.
+  static size_t LineCount(const ModelPtr &value) {
+    if (value->IsPacked())
+      return 1 + value->Size();
+    size_t count = 1;
+    if (value->kind != ModelNode::ALIAS) {
+      for (const ModelPtr &child : value->items)
+        count += LineCount(child);
+    }
+    return count;
+  }
+
+  // Notes the anchors defined inside a value leaving the tree.
+  void DropAnchors(const ModelPtr &value) {
+    if (m_anchors.empty())
+      return;
+    std::unordered_set<const ModelNode *> inside;
+    std::vector<const ModelNode *> pending{value.get()};
+    while (!pending.empty()) {
+      const ModelNode *node = pending.back();
+      pending.pop_back();
+      if (node->kind == ModelNode::ALIAS || !inside.insert(node).second)
+        continue;
+      for (const ModelPtr &child : node->items)
+        pending.push_back(child.get());
+    }
+    for (const auto &entry : m_anchors) {
+      if (inside.count(entry.second.get()))
+        m_dropped.insert(entry.first);
+    }
+  }
+
+  // Records the anchor name announced by OnAnchor for the node being built.
+  void NameAnchor(YAML::anchor_t anchor) {
+    if (anchor != 0 && !m_pendingAnchorName.empty())
+      m_anchorNames[anchor] = m_pendingAnchorName;
+    m_pendingAnchorName.clear();
+  }
+
+  bool InKey() const {
+    return m_keyDepth > 0 || (!m_stack.empty() && m_stack.back().isMap &&
+                              !m_stack.back().haveKey);
+  }
+
+  // Consumes a scalar that is a mapping key. Returns false for values.
+  bool TakeKey(const std::string &text) {
+    if (m_keyDepth > 0)
+      return false; // Part of a complex key; built and discarded as "???"
+    if (m_stack.empty() || !m_stack.back().isMap || m_stack.back().haveKey)
+      return false;
+    m_stack.back().key = text;
+    m_stack.back().haveKey = true;
+    return true;
+  }
+
+  // Called as a value node starts: notes its source line in pre-order.
+  void BeginValue(const YAML::Mark &mark) {
+    if (!m_lines || m_keyDepth > 0)
+      return;
+    if (!m_stack.empty() && m_stack.back().isMap)
+      m_stack.back().valueLineStart = m_lines->size();
+    m_lines->push_back(mark.line);
+  }
+
+  void Push(const YAML::Mark &mark, YAML::anchor_t anchor, bool isMap) {
+    NameAnchor(anchor);
+    bool isKey = InKey();
+    if (!isKey)
+      BeginValue(mark);
+    if (!isKey && !m_stack.empty() && m_stack.back().packing)
+      Unpack(m_stack.back());
+    Frame frame;
+    frame.isMap = isMap;
+    frame.isKey = isKey;
+    frame.anchor = anchor;
+    frame.packing = !isMap;
+    m_stack.push_back(std::move(frame));
+    if (isKey)
+      m_keyDepth++;
+  }
+
+  bool PushPacked(Frame &frame, const ModelNode &scalar) {
+    if (!IsPackableKind(scalar.kind) || scalar.isUnsigned)
+      return false;
+    if (frame.packedKind == ModelNode::NUL && frame.items.empty())
+      frame.packedKind = scalar.kind;
+    if (scalar.kind != frame.packedKind)
+      return false;
+    if (scalar.kind == ModelNode::REAL)
+      frame.reals.push_back(scalar.real);
+    else if (scalar.kind == ModelNode::INTEGER)
+      frame.ints.push_back(scalar.integer);
+    else
+      frame.ints.push_back(scalar.boolean ? 1 : 0);
+    return true;
+  }
+
+  // Boxes the unboxed elements gathered so far; the sequence is mixed.
+  void Unpack(Frame &frame) {
+    if (!frame.packing)
+      return;
+    frame.packing = false;
+    if (frame.packedKind == ModelNode::NUL)
+      return;
+    ModelPtr packed =
+        (frame.packedKind == ModelNode::REAL)
+            ? Model::PackedReals(std::move(frame.reals))
+            : Model::PackedInts(frame.packedKind, std::move(frame.ints));
+    frame.items.reserve(packed->Size());
+    for (size_t i = 0; i < packed->Size(); i++)
+      frame.items.push_back(Intern(Model::Item(packed, i)));
+    frame.packedKind = ModelNode::NUL;
+  }
+
+  ModelPtr Intern(const ModelPtr &node) {
+    return m_interner ? m_interner->Intern(node) : node;
+  }
+
+  // Hands a completed collection to its parent, as a key or as a value.
+  void Finish(const ModelPtr &node, YAML::anchor_t anchor) {
+    if (m_keyDepth == 0 && !m_stack.empty() && m_stack.back().isMap &&
+        !m_stack.back().haveKey) {
+      ModelPtr interned = Intern(node);
+      if (anchor != 0)
+        m_anchors[anchor] = interned;
+      TakeKey(KeyText(interned));
+      return;
+    }
+    Add(node, anchor);
+  }
+
+  void Add(const ModelPtr &built, YAML::anchor_t anchor) {
+    ModelPtr node = Intern(built);
+    if (anchor != 0)
+      m_anchors[anchor] = node;
+    if (m_stack.empty()) {
+      m_root = node;
+      return;
+    }
+
+    Frame &frame = m_stack.back();
+    if (!frame.isMap) {
+      Unpack(frame);
+      frame.items.push_back(node);
+      return;
+    }
+
+    frame.haveKey = false;
+    auto found = frame.keyIndex.find(frame.key);
+    if (found != frame.keyIndex.end()) {
+      // Duplicate key: the last value wins. Drop the earlier entry, and
+      // its source lines, so the model stays in source order.
+      size_t index = found->second;
+      if (m_lines) {
+        size_t begin = frame.lineStarts[index];
+        size_t end = (index + 1 < frame.lineStarts.size())
+                         ? frame.lineStarts[index + 1]
+                         : frame.valueLineStart;
+        m_lines->erase(m_lines->begin() + begin, m_lines->begin() + end);
+        frame.valueLineStart -= end - begin;
+        for (size_t i = index + 1; i < frame.lineStarts.size(); i++)
+          frame.lineStarts[i] -= end - begin;
+        frame.lineStarts.erase(frame.lineStarts.begin() + index);
+      }
+      DropAnchors(frame.items[index]);
+      frame.keys.erase(frame.keys.begin() + index);
+      frame.items.erase(frame.items.begin() + index);
+      for (auto &entry : frame.keyIndex) {
+        if (entry.second > index)
+          entry.second--;
+      }
+    }
+    frame.keyIndex[frame.key] = frame.keys.size();
+    frame.keys.push_back(std::move(frame.key));
+    frame.items.push_back(node);
+    if (m_lines)
+      frame.lineStarts.push_back(frame.valueLineStart);
+  }
+
+  ModelInterner *m_interner;
+  std::vector<int> *m_lines;
+  std::vector<ModelPtr> m_documents;
+  std::vector<Frame> m_stack;
+  int m_keyDepth = 0;
+  ModelPtr m_root;
+  std::unordered_map<YAML::anchor_t, ModelPtr> m_anchors;
+  std::unordered_map<YAML::anchor_t, std::string> m_anchorNames;
+  std::unordered_set<YAML::anchor_t> m_dropped; // Anchors out of the tree
+  std::string m_pendingAnchorName;
+};
+
+std::vector<ModelPtr> Model::ParseYaml(std::istream &in,
+                                       ModelInterner *interner,
+                                       std::vector<int> *lines) {
+  YAML::Parser parser(in);
+  ModelBuilder builder(interner, lines);
+  while (parser.HandleNextDocument(builder)) {
+  }
+  return std::move(builder.Documents());
+}
+
+static ModelNode::Kind JsonScalarKind(const json &j) {
+  switch (j.type()) {
+  case json::value_t::boolean:
+    return ModelNode::BOOLEAN;
+  case json::value_t::number_integer:
+    return ModelNode::INTEGER;
+  case json::value_t::number_unsigned: // Only int64 values can be packed
+    return j.get<uint64_t>() <= (uint64_t)INT64_MAX ? ModelNode::INTEGER
+                                                     : ModelNode::NUL;
+  case json::value_t::number_float:
+    return ModelNode::REAL;
+  default:
+    return ModelNode::NUL;
+  }
+}
+
+static ModelPtr TryPackJson(const json &j) {
+  if (j.size() < Model::kMinPackedSize)
+    return nullptr;
+  ModelNode::Kind kind = JsonScalarKind(j[0]);
+  if (kind == ModelNode::NUL)
+    return nullptr;
+  for (const auto &e : j) {
+    if (JsonScalarKind(e) != kind)
+      return nullptr;
+  }
+  if (kind == ModelNode::REAL) {
+    std::vector<double> reals;
+    reals.reserve(j.size());
+    for (const auto &e : j)
+      reals.push_back(e.get<double>());
+    return Model::PackedReals(std::move(reals));
+  }
+  std::vector<int64_t> ints;
+  ints.reserve(j.size());
+  for (const auto &e : j)
+    ints.push_back(kind == ModelNode::BOOLEAN ? (e.get<bool>() ? 1 : 0)
+                                              : e.get<int64_t>());
+  return Model::PackedInts(kind, std::move(ints));
+}
+
+ModelPtr Model::FromJson(const json &j) {
+  switch (j.type()) {
+  case json::value_t::boolean:
+    return Boolean(j.get<bool>());
+  case json::value_t::number_integer:
+    return Integer(j.get<int64_t>());
+  case json::value_t::number_unsigned:
+    return Unsigned(j.get<uint64_t>());
+  case json::value_t::number_float:
+    return Real(j.get<double>());
+  case json::value_t::string:
+    return String(j.get<std::string>());
+  case json::value_t::array: {
+    if (ModelPtr packed = TryPackJson(j))
+      return packed;
+    std::vector<ModelPtr> items;
+    items.reserve(j.size());
+    for (const auto &e : j)
+      items.push_back(FromJson(e));
+    return Array(std::move(items));
+  }
+  case json::value_t::object: {
+    std::vector<std::string> keys;
+    std::vector<ModelPtr> items;
+    keys.reserve(j.size());
+    items.reserve(j.size());
+    for (auto it = j.begin(); it != j.end(); ++it) {
+      keys.push_back(it.key());
+      items.push_back(FromJson(it.value()));
+    }
+    return Object(std::move(keys), std::move(items));
+  }
+  default:
+    return Null();
+  }
+}
+
+json Model::ToJson(const ModelPtr &node) {
+  if (!node)
+    return json();
+  switch (node->kind) {
+  case ModelNode::ALIAS:
+    if (node->items.empty())
+      throw std::runtime_error("Recursive alias *" + node->Text());
+    return ToJson(node->items[0]);
+  case ModelNode::BOOLEAN:
+    return node->boolean;
+  case ModelNode::INTEGER:
+    if (node->isUnsigned)
+      return node->uinteger;
+    return node->integer;
+  case ModelNode::REAL:
+    return node->real;
+  case ModelNode::STRING:
+    return node->Text();
+  case ModelNode::ARRAY: {
+    json j = json::array();
+    if (node->packedKind == ModelNode::REAL) {
+      for (double d : node->PackedReals())
+        j.push_back(d);
+    } else if (node->packedKind == ModelNode::BOOLEAN) {
+      for (int64_t i : node->PackedInts())
+        j.push_back(i != 0);
+    } else if (node->IsPacked()) {
+      for (int64_t i : node->PackedInts())
+        j.push_back(i);
+    } else {
+      for (const auto &item : node->items)
+        j.push_back(ToJson(item));
+    }
+    return j;
+  }
+  case ModelNode::OBJECT: {
+    json j = json::object();
+    for (size_t i = 0; i < node->items.size(); i++)
+      j[node->Keys()[i]] = ToJson(node->items[i]);
+    return j;
+  }
+  default:
+    return json();
+  }
+}
+
+static void AppendJsonReal(std::string &out, double value) {
+  if (std::isnan(value) || std::isinf(value)) {
+    out += "null";
+    return;
+  }
+  char buf[32];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  size_t start = out.size();
+  out.append(buf, res.ptr);
+  if (out.find_first_of(".e", start) == std::string::npos)
+    out += ".0";
+}
+
+static void AppendJsonInteger(std::string &out, int64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static void AppendJsonInteger(std::string &out, uint64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static void AppendJsonString(std::string &out, const std::string &s) {
+  out += '"';
+  JsonEscape::Escape(out, s.data(), s.size());
+  out += '"';
+}
+
+static void WriteJsonText(const ModelPtr &node, std::string &out) {
+  switch (node->kind) {
+  case ModelNode::ALIAS:
+    if (node->items.empty())
+      throw std::runtime_error("Recursive alias *" + node->Text());
+    WriteJsonText(node->items[0], out);
+    break;
+  case ModelNode::BOOLEAN:
+    out += node->boolean ? "true" : "false";
+    break;
+  case ModelNode::INTEGER:
+    if (node->isUnsigned)
+      AppendJsonInteger(out, node->uinteger);
+    else
+      AppendJsonInteger(out, node->integer);
+    break;
+  case ModelNode::REAL:
+    AppendJsonReal(out, node->real);
+    break;
+  case ModelNode::STRING:
+    AppendJsonString(out, node->Text());
+    break;
+  case ModelNode::ARRAY:
+    out += '[';
+    for (size_t i = 0; i < node->Size(); i++) {
+      if (i > 0)
+        out += ',';
+      if (node->packedKind == ModelNode::REAL)
+        AppendJsonReal(out, node->PackedReals()[i]);
+      else if (node->packedKind == ModelNode::BOOLEAN)
+        out += node->PackedInts()[i] ? "true" : "false";
+      else if (node->IsPacked())
+        AppendJsonInteger(out, node->PackedInts()[i]);
+      else
+        WriteJsonText(node->items[i], out);
+    }
+    out += ']';
+    break;
+  case ModelNode::OBJECT:
+    out += '{';
+    for (size_t i = 0; i < node->items.size(); i++) {
+      if (i > 0)
+        out += ',';
+      AppendJsonString(out, node->Keys()[i]);
+      out += ':';
+      WriteJsonText(node->items[i], out);
+    }
+    out += '}';
+    break;
+  default:
+    out += "null";
+    break;
+  }
+}
+
+std::string Model::ToJsonText(const ModelPtr &node) {
+  std::string out;
+  if (node)
+    WriteJsonText(node, out);
+  else
+    out = "null";
+  return out;
+}
+
+// -- Aliases --
+
+static ModelPtr ExpandNode(const ModelPtr &node,
+                           std::unordered_map<const ModelNode *, ModelPtr> &done) {
+  auto found = done.find(node.get());
+  if (found != done.end())
+    return found->second;
+
+  ModelPtr result = node;
+  if (node->kind == ModelNode::ALIAS) {
+    result = node->items.empty() ? nullptr : ExpandNode(node->items[0], done);
+  } else if (node->IsContainer() && !node->IsPacked()) {
+    std::shared_ptr<ModelNode> copy;
+    for (size_t i = 0; i < node->items.size(); i++) {
+      ModelPtr child = ExpandNode(node->items[i], done);
+      if (!child) {
+        result = nullptr;
+        break;
+      }
+      if (child != node->items[i]) {
+        if (!copy)
+          copy = std::make_shared<ModelNode>(*node);
+        copy->items[i] = child;
+      }
+    }
+    if (result && copy) {
+      Model::Rehash(*copy);
+      result = copy;
+    }
+  }
+  done.emplace(node.get(), result);
+  return result;
+}
+
+ModelPtr Model::ExpandAliases(const ModelPtr &root) {
+  std::unordered_map<const ModelNode *, ModelPtr> done;
+  return ExpandNode(root, done);
+}
+
+static size_t CountNodes(const ModelPtr &node, size_t limit,
+                         std::unordered_map<const ModelNode *, size_t> &sizes) {
+  auto found = sizes.find(node.get());
+  if (found != sizes.end())
+    return found->second;
+
+  size_t count = 1;
+  if (node->kind == ModelNode::ALIAS) {
+    if (!node->items.empty())
+      count = CountNodes(node->items[0], limit, sizes);
+  } else if (node->IsPacked()) {
+    count += node->Size();
+  } else {
+    for (const auto &item : node->items) {
+      count += CountNodes(item, limit, sizes);
+      if (count > limit) {
+        count = limit + 1;
+        break;
+      }
+    }
+  }
+  sizes.emplace(node.get(), count);
+  return count;
+}
+
+size_t Model::LogicalSize(const ModelPtr &root, size_t limit) {
+  if (!root)
+    return 0;
+  std::unordered_map<const ModelNode *, size_t> sizes;
+  return CountNodes(root, limit, sizes);
+}
+
+// -- JSON Pointer --
+
+std::vector<std::string> Model::SplitPointer(const std::string &pointer) {
+  std::vector<std::string> tokens;
+  if (pointer.empty() || pointer == "/")
+    return tokens;
+  size_t start = (pointer[0] == '/') ? 1 : 0;
+  while (start <= pointer.size()) {
+    size_t end = pointer.find('/', start);
+    if (end == std::string::npos)
+      end = pointer.size();
+    std::string token = pointer.substr(start, end - start);
+    // Unescape (~1 -> /, ~0 -> ~), in that order
+    size_t p = 0;
+    while ((p = token.find("~1", p)) != std::string::npos) {
+      token.replace(p, 2, "/");
+      p++;
+    }
+    p = 0;
+    while ((p = token.find("~0", p)) != std::string::npos) {
+      token.replace(p, 2, "~");
+      p++;
+    }
+    tokens.push_back(std::move(token));
+    start = end + 1;
+  }
+  return tokens;
+}
+
+std::string Model::EscapePointerToken(const std::string &token) {
+  std::string escaped;
+  escaped.reserve(token.size());
+  for (char c : token) {
+    if (c == '~')
+      escaped += "~0";
+    else if (c == '/')
+      escaped += "~1";
+    else
+      escaped += c;
+  }
+  return escaped;
+}
+
+// Index of token within a container node, or -1.
+static int ChildIndex(const ModelPtr &node, const std::string &token) {
+  if (node->kind == ModelNode::OBJECT)
+    return node->FindKey(token);
+  if (node->kind == ModelNode::ARRAY) {
+    if (token.empty() || token.find_first_not_of("0123456789") !=
+                             std::string::npos)
+      return -1;
+    size_t index = std::stoul(token);
+    return index < node->Size() ? (int)index : -1;
+  }
+  return -1;
+}
+
+ModelPtr Model::Find(const ModelPtr &root, const std::string &pointer) {
+  ModelPtr node = root;
+  for (const auto &token : SplitPointer(pointer)) {
+    if (!node)
+      return nullptr;
+    int index = ChildIndex(Resolve(node), token);
+    if (index < 0)
+      return nullptr;
+    node = Item(Resolve(node), index);
+  }
+  return node ? Resolve(node) : node;
+}
+
+// Rebuilds the path from node down to tokens[depth..], applying edit to the
+// node the path ends at. Siblings along the way are shared, not copied.
+static ModelPtr CopyPath(const ModelPtr &at,
+                         const std::vector<std::string> &tokens, size_t depth,
+                         const std::function<ModelPtr(const ModelPtr &)> &edit) {
+  if (!at)
+    return nullptr;
+  if (depth == tokens.size())
+    return edit(at);
+
+  // Editing through an alias gives this location its own edited copy of
+  // the anchored value; other aliases of it are unaffected.
+  ModelPtr node = Model::Resolve(at);
+
+  int index = ChildIndex(node, tokens[depth]);
+  if (index < 0)
+    return nullptr;
+  ModelPtr child = CopyPath(Model::Item(node, index), tokens, depth + 1, edit);
+  if (!child)
+    return nullptr;
+
+  auto copy = std::make_shared<ModelNode>(*node);
+  if (!node->IsPacked()) {
+    copy->items[index] = child;
+  } else if (child->kind == node->packedKind && !child->isUnsigned) {
+    if (child->kind == ModelNode::REAL)
+      std::get<std::vector<double>>(copy->payload)[index] = child->real;
+    else if (child->kind == ModelNode::INTEGER)
+      std::get<std::vector<int64_t>>(copy->payload)[index] = child->integer;
+    else
+      std::get<std::vector<int64_t>>(copy->payload)[index] =
+          child->boolean ? 1 : 0;
+  } else {
+    // A mismatched element turns the array back into generic storage.
+    copy->items.reserve(node->Size());
+    for (size_t i = 0; i < node->Size(); i++)
+      copy->items.push_back(i == (size_t)index ? child : Model::Item(node, i));
+    copy->packedKind = ModelNode::NUL;
+    copy->payload = std::monostate();
+  }
+  Model::Rehash(*copy);
+  return copy;
+}
+
+ModelPtr Model::SetAt(const ModelPtr &root, const std::string &pointer,
+                      const ModelPtr &value) {
+  return CopyPath(root, SplitPointer(pointer), 0,
+                  [&](const ModelPtr &) { return value; });
+}
+
+ModelPtr Model::RenameKey(const ModelPtr &root, const std::string &pointer,
+                          const std::string &newKey) {
+  std::vector<std::string> tokens = SplitPointer(pointer);
+  if (tokens.empty())
+    return nullptr;
+  std::string oldKey = tokens.back();
+  tokens.pop_back();
+
+  return CopyPath(root, tokens, 0, [&](const ModelPtr &at) -> ModelPtr {
+    // Renaming inside an aliased mapping edits a copy, as CopyPath does.
+    ModelPtr parent = Resolve(at);
+    if (parent->kind != ModelNode::OBJECT)
+      return nullptr;
+    int index = parent->FindKey(oldKey);
+    if (index < 0)
+      return nullptr;
+    if (oldKey == newKey)
+      return at;
+
+    // The renamed value is shared as-is; only the key list changes.
+    auto copy = std::make_shared<ModelNode>(*parent);
+    int existing = copy->FindKey(newKey);
+    auto &keys = std::get<std::vector<std::string>>(copy->payload);
+    keys[index] = newKey;
+    if (existing >= 0) {
+      keys.erase(keys.begin() + existing);
+      copy->items.erase(copy->items.begin() + existing);
+    }
+    Rehash(*copy);
+    return copy;
+  });
+}
+
+// End of the scalar starting at data[begin], or SIZE_MAX if it is not one
+// that sits on a single line: block scalars and collections are refused.
+static size_t ScalarEnd(const std::string &data, size_t begin, bool flow) {
+  size_t p = begin;
+  if (p >= data.size())
+    return SIZE_MAX;
+  char quote = data[p];
+  if (quote == '"' || quote == '\'') {
+    for (p++; p < data.size() && data[p] != '\n'; p++) {
+      if (quote == '"' && data[p] == '\\')
+        p++;
+      else if (data[p] == quote && quote == '\'' && p + 1 < data.size() &&
+               data[p + 1] == '\'')
+        p++;
+      else if (data[p] == quote)
+        return p + 1;
+    }
+    return SIZE_MAX;
+  }
+  if (strchr("|>[{", quote))
+    return SIZE_MAX;
+  // Plain: up to a comment, a line break, ": " or in flow context a flow
+  // indicator
+  for (; p < data.size() && data[p] != '\r' && data[p] != '\n'; p++) {
+    char next = p + 1 < data.size() ? data[p + 1] : ' ';
+    if ((data[p] == ' ' || data[p] == '\t') && next == '#')
+      break;
+    if (data[p] == ':' &&
+        (isspace((unsigned char)next) || (flow && strchr(",[]{}", next))))
+      break;
+    if (flow && strchr(",[]{}", data[p]))
+      break;
+  }
+  while (p > begin && (data[p - 1] == ' ' || data[p - 1] == '\t'))
+    p--;
+  return p > begin ? p : SIZE_MAX;
+}
+
+bool Model::FindScalarText(const std::string &data, const std::string &pointer,
+                           bool multiDocument, bool key, size_t &begin,
+                           size_t &end, bool &flow) {
+  std::vector<std::string> tokens = SplitPointer(pointer);
+  std::vector<YAML::Node> documents = YAML::LoadAll(data);
+  auto index = [](const std::string &token, size_t size) {
+    if (token.empty() ||
+        token.find_first_not_of("0123456789") != std::string::npos)
+      return SIZE_MAX;
+    size_t i = std::stoul(token);
+    return i < size ? i : SIZE_MAX;
+  };
+  size_t depth = 0;
+  size_t document = 0;
+  if (multiDocument) {
+    document = tokens.empty() ? SIZE_MAX
+                              : index(tokens[depth++], documents.size());
+  } else if (documents.size() != 1) {
+    return false;
+  }
+  if (document == SIZE_MAX)
+    return false;
+
+  // reset() rebinds a node; assigning one would overwrite the document
+  YAML::Node node, keyNode;
+  node.reset(documents[document]);
+  flow = false;
+  for (; depth < tokens.size(); depth++) {
+    flow = node.Style() == YAML::EmitterStyle::Flow;
+    if (node.IsMap()) {
+      YAML::Node value;
+      bool found = false;
+      // The last of duplicate keys wins, as in ParseYaml
+      for (auto it = node.begin(); it != node.end(); ++it) {
+        if (it->first.IsScalar() && it->first.Scalar() == tokens[depth]) {
+          keyNode.reset(it->first);
+          value.reset(it->second);
+          found = true;
+        }
+      }
+      if (!found)
+        return false;
+      node.reset(value);
+    } else if (node.IsSequence()) {
+      size_t i = index(tokens[depth], node.size());
+      if (i == SIZE_MAX)
+        return false;
+      keyNode.reset();
+      YAML::Node element = node[i];
+      node.reset(element);
+    } else {
+      return false;
+    }
+  }
+
+  const YAML::Node &target = key ? keyNode : node;
+  if (!target.IsDefined() || !target.IsScalar())
+    return false;
+  // The mark is where the node's anchor and tag begin
+  begin = target.Mark().pos;
+  while (begin < data.size() && (data[begin] == '&' || data[begin] == '!')) {
+    while (begin < data.size() && !isspace((unsigned char)data[begin]))
+      begin++;
+    while (begin < data.size() && (data[begin] == ' ' || data[begin] == '\t'))
+      begin++;
+  }
+  end = ScalarEnd(data, begin, flow);
+  return end != SIZE_MAX;
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// Persistent document model.
+//
+// Nodes are immutable once built. An edit never touches an existing node:
+// it rebuilds only the nodes on the path from the root to the edited value
+// and shares every other subtree with the previous version. Holding a
+// ModelPtr is therefore a complete, stable snapshot of the document that
+// can be read from any thread without locking, and undoing a structural
+// edit is just a matter of going back to an earlier root.
+struct ModelNode;
+using ModelPtr = std::shared_ptr<const ModelNode>;
+
+struct ModelNode {
+  enum Kind : uint8_t {
+    NUL,
+    BOOLEAN,
+    INTEGER,
+    REAL,
+    STRING,
+    ARRAY,
+    OBJECT,
+    ALIAS
+  };
+
+  Kind kind = NUL;
+  // Homogeneous numeric ARRAYs keep their elements unboxed instead of in
+  // items: BOOLEAN and INTEGER elements as int64_t, REAL as double.
+  Kind packedKind = NUL; // Element kind, or NUL for a generic array
+  // An INTEGER above INT64_MAX, held exactly in uinteger. Smaller values
+  // are always signed, so each integer has one form. Never packed.
+  bool isUnsigned = false;
+  union { // Value of a BOOLEAN, INTEGER or REAL, by kind
+    bool boolean;
+    int64_t integer = 0;
+    uint64_t uinteger;
+    double real;
+  };
+  size_t hash = 0; // Structural hash, fixed when the node is built
+  std::vector<ModelPtr> items; // ARRAY elements, OBJECT values or ALIAS target
+  // What only some kinds have, by kind: the STRING value or ALIAS anchor
+  // name, the OBJECT keys (parallel to items), or a packed ARRAY's
+  // elements. Nodes are the bulk of a document, so each holds one of these
+  // rather than room for all of them.
+  std::variant<std::monostate, std::string, std::vector<std::string>,
+               std::vector<int64_t>, std::vector<double>>
+      payload;
+
+  // The payload, or empty if the node has none of that type
+  const std::string &Text() const { return Payload<std::string>(); }
+  const std::vector<std::string> &Keys() const {
+    return Payload<std::vector<std::string>>();
+  }
+  const std::vector<int64_t> &PackedInts() const {
+    return Payload<std::vector<int64_t>>();
+  }
+  const std::vector<double> &PackedReals() const {
+    return Payload<std::vector<double>>();
+  }
+
+  bool IsContainer() const { return kind == ARRAY || kind == OBJECT; }
+  bool IsPacked() const { return packedKind != NUL; }
+  size_t Size() const {
+    if (packedKind == REAL)
+      return PackedReals().size();
+    return packedKind != NUL ? PackedInts().size() : items.size();
+  }
+  // Index of key in an OBJECT, or -1 if absent.
+  int FindKey(const std::string &key) const;
+
+private:
+  template <class T> const T &Payload() const {
+    static const T empty;
+    const T *value = std::get_if<T>(&payload);
+    return value ? *value : empty;
+  }
+};
+
+// Hash-consing table. Interning a node whose children are already interned
+// returns the existing structurally identical node if there is one, so
+// repeated subtrees such as {fileID: 0} are stored once and shared by every
+// use. Nodes are immutable, so sharing is safe: an edit path-copies and
+// never writes through a shared node.
+class ModelInterner {
+public:
+  ModelPtr Intern(const ModelPtr &node);
+  size_t Size() const { return m_live; }
+
+private:
+  void Sweep();
+
+  std::unordered_multimap<size_t, std::weak_ptr<const ModelNode>> m_table;
+  size_t m_live = 0;
+  size_t m_sweepAt = 4096;
+};
+
+// Aggregate over the elements of a packed numeric array.
+struct ModelSummary {
+  size_t count = 0;
+  double min = 0.0;
+  double max = 0.0;
+  double sum = 0.0;
+};
+
+class Model {
+public:
+  // Arrays shorter than this are not worth packing.
+  static const size_t kMinPackedSize = 8;
+
+  // Node construction
+  static ModelPtr Null();
+  static ModelPtr Boolean(bool value);
+  static ModelPtr Integer(int64_t value);
+  // An INTEGER that may exceed INT64_MAX, as JSON and binary formats allow.
+  static ModelPtr Unsigned(uint64_t value);
+  static ModelPtr Real(double value);
+  static ModelPtr String(std::string value);
+  static ModelPtr Array(std::vector<ModelPtr> items);
+  static ModelPtr Object(std::vector<std::string> keys,
+                         std::vector<ModelPtr> items);
+  // elementKind is BOOLEAN (values 0/1) or INTEGER.
+  static ModelPtr PackedInts(ModelNode::Kind elementKind,
+                             std::vector<int64_t> values);
+  static ModelPtr PackedReals(std::vector<double> values);
+  // Reference to an anchored node. target is nullptr when the alias occurs
+  // inside the node it refers to (a cycle).
+  static ModelPtr Alias(std::string anchor, const ModelPtr &target);
+
+  // The node an ALIAS refers to; any other node is returned as-is.
+  static ModelPtr Resolve(const ModelPtr &node);
+  // Display text of a scalar (reals in shortest round-trip form).
+  static std::string ScalarText(const ModelPtr &node);
+  // Types a plain (unquoted) YAML scalar the way ParseYaml does: null,
+  // boolean, integer, real, or else string (no payload is set).
+  static void ParseScalar(const std::string &text, ModelNode &node);
+  // True if text, written as a plain (unquoted) scalar, is read back by
+  // ParseYaml as a string rather than a number, boolean or null.
+  static bool IsPlainString(const std::string &text);
+
+  // Element of an ARRAY; packed elements are boxed on demand.
+  static ModelPtr Item(const ModelPtr &array, size_t index);
+  // min/max/sum of a packed numeric array. Returns false for other nodes.
+  static bool Summarize(const ModelPtr &array, ModelSummary &summary);
+
+  // Recomputes node.hash after its fields were changed in place (only valid
+  // before the node is published as a ModelPtr).
+  static void Rehash(ModelNode &node);
+
+  // Deep equality; shared or interned subtrees compare in O(1).
+  static bool Equal(const ModelPtr &a, const ModelPtr &b);
+
+  // Builds one root per YAML document directly from parser events. Each
+  // anchored node is built once and aliases refer to it, so memory stays
+  // linear in the source size. With an interner, identical subtrees are
+  // shared. If lines is given it receives the source line of every value
+  // node in pre-order (an alias counts as one node, a packed array as one
+  // node plus one per element). Throws YAML::Exception on syntax errors.
+  static std::vector<ModelPtr> ParseYaml(std::istream &in,
+                                         ModelInterner *interner = nullptr,
+                                         std::vector<int> *lines = nullptr);
+  static ModelPtr FromJson(const nlohmann::json &j);
+  // Expands aliases; throws std::runtime_error on a recursive alias.
+  static nlohmann::json ToJson(const ModelPtr &node);
+  // Compact JSON text written straight from the model. Unlike ToJson it
+  // keeps key order. Reals JSON cannot represent (inf, nan) become null.
+  // Expands aliases; throws std::runtime_error on a recursive alias.
+  static std::string ToJsonText(const ModelPtr &node);
+
+  // Replaces every alias by the node it refers to. Expanded values are
+  // shared, not copied. Returns nullptr if a recursive alias is found.
+  static ModelPtr ExpandAliases(const ModelPtr &root);
+  // Number of nodes the document has with all aliases expanded, counting
+  // no further than limit + 1.
+  static size_t LogicalSize(const ModelPtr &root, size_t limit);
+
+  // JSON Pointer helpers ("/a/0/b", with ~0 and ~1 escapes)
+  static std::vector<std::string> SplitPointer(const std::string &pointer);
+  static std::string EscapePointerToken(const std::string &token);
+
+  // Lookup; returns nullptr if the path does not exist.
+  static ModelPtr Find(const ModelPtr &root, const std::string &pointer);
+
+  // Path-copying edits. Each returns the new root, or nullptr if the path
+  // does not exist. The old root stays valid and unchanged.
+  static ModelPtr SetAt(const ModelPtr &root, const std::string &pointer,
+                        const ModelPtr &value);
+  static ModelPtr RenameKey(const ModelPtr &root, const std::string &pointer,
+                            const std::string &newKey);
+
+  // Span [begin, end) of the single-line scalar at pointer in the YAML or
+  // JSON text data, or of its key if key is set, for editing it in place.
+  // pointer indexes the documents first if multiDocument. flow is set
+  // inside [...] or {...}. Returns false if the value is not such a scalar.
+  // Throws YAML::Exception on syntax errors.
+  static bool FindScalarText(const std::string &data,
+                             const std::string &pointer, bool multiDocument,
+                             bool key, size_t &begin, size_t &end, bool &flow);
+};
@@ -0,0 +1,334 @@
+#include "ModelIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+static const uint32_t kNoParent = UINT32_MAX;
+static const uint32_t kNoKey = UINT32_MAX;
+
+struct ModelIndex::KeyTable {
+  std::unordered_map<std::string, uint32_t> ids;
+  std::vector<std::string> names;
+  std::vector<std::string> folded; // Lowercase, for FindKey
+
+  uint32_t Intern(const std::string &key) {
+    auto it = ids.find(key);
+    if (it != ids.end())
+      return it->second;
+    uint32_t id = (uint32_t)names.size();
+    ids.emplace(key, id);
+    names.push_back(key);
+    std::string lower = key;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return (char)tolower(c); });
+    folded.push_back(std::move(lower));
+    return id;
+  }
+};
+
+// One top-level value and its subtree, with node numbers relative to it.
+struct ModelIndex::Chunk {
+  size_t hash; // Of the subtree
+  std::vector<uint32_t> parent; // kNoParent for the chunk's own node
+  std::vector<uint32_t> end;
+  std::vector<std::pair<uint32_t, uint32_t>> keys;   // (key id, value node)
+  std::vector<std::pair<uint64_t, uint32_t>> values; // (text hash, node)
+  std::vector<std::pair<uint32_t, uint32_t>> keyCounts; // (key id, uses)
+};
+
+// FNV-1a, 64-bit on every platform.
+static uint64_t HashText(const std::string &text) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Same shape and values with aliases left unresolved (unlike Model::Equal),
+// so the two subtrees number and index alike.
+static bool Identical(const ModelPtr &a, const ModelPtr &b) {
+  if (a == b)
+    return true;
+  if (!a || !b || a->kind != b->kind || a->hash != b->hash ||
+      a->packedKind != b->packedKind)
+    return false;
+  switch (a->kind) {
+  case ModelNode::NUL:
+    return true;
+  case ModelNode::BOOLEAN:
+    return a->boolean == b->boolean;
+  case ModelNode::INTEGER:
+    return a->integer == b->integer && a->isUnsigned == b->isUnsigned;
+  case ModelNode::REAL: // Bitwise, so 0 and -0 differ as their text does
+    return memcmp(&a->real, &b->real, sizeof(double)) == 0;
+  case ModelNode::STRING:
+  case ModelNode::ALIAS:
+    return a->Text() == b->Text();
+  case ModelNode::ARRAY:
+  case ModelNode::OBJECT:
+    if (a->Keys() != b->Keys() || a->items.size() != b->items.size())
+      return false;
+    if (a->PackedInts() != b->PackedInts() ||
+        a->PackedReals().size() != b->PackedReals().size() ||
+        (!a->PackedReals().empty() &&
+         memcmp(a->PackedReals().data(), b->PackedReals().data(),
+                a->PackedReals().size() * sizeof(double)) != 0))
+      return false;
+    for (size_t i = 0; i < a->items.size(); i++) {
+      if (!Identical(a->items[i], b->items[i]))
+        return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+// Appends node and its subtree in Model::ParseYaml's numbering: an alias
+// is one node and is not entered, a packed array is one node plus one per
+// element.
+void ModelIndex::IndexNode(const ModelPtr &node, uint32_t parent,
+                           KeyTable &table, Chunk &chunk) {
+  uint32_t id = (uint32_t)chunk.parent.size();
+  chunk.parent.push_back(parent);
+  chunk.end.push_back(0);
+  if (node->kind == ModelNode::OBJECT) {
+    for (size_t i = 0; i < node->items.size(); i++) {
+      chunk.keys.emplace_back(table.Intern(node->Keys()[i]),
+                              (uint32_t)chunk.parent.size());
+      IndexNode(node->items[i], id, table, chunk);
+    }
+  } else if (node->kind == ModelNode::ARRAY && node->IsPacked()) {
+    for (size_t i = 0; i < node->Size(); i++) {
+      uint32_t element = (uint32_t)chunk.parent.size();
+      chunk.parent.push_back(id);
+      chunk.end.push_back(element + 1);
+      chunk.values.emplace_back(
+          HashText(Model::ScalarText(Model::Item(node, i))), element);
+    }
+  } else if (node->kind == ModelNode::ARRAY) {
+    for (const ModelPtr &item : node->items)
+      IndexNode(item, id, table, chunk);
+  } else if (node->kind != ModelNode::ALIAS) {
+    chunk.values.emplace_back(HashText(Model::ScalarText(node)), id);
+  }
+  chunk.end[id] = (uint32_t)chunk.parent.size();
+}
+
+std::shared_ptr<const ModelIndex::Chunk>
+ModelIndex::BuildChunk(const ModelPtr &node, KeyTable &table) {
+  auto chunk = std::make_shared<Chunk>();
+  chunk->hash = node->hash;
+  IndexNode(node, kNoParent, table, *chunk);
+  std::sort(chunk->keys.begin(), chunk->keys.end());
+  std::sort(chunk->values.begin(), chunk->values.end());
+  for (const auto &key : chunk->keys) {
+    if (chunk->keyCounts.empty() || chunk->keyCounts.back().first != key.first)
+      chunk->keyCounts.emplace_back(key.first, 0);
+    chunk->keyCounts.back().second++;
+  }
+  return chunk;
+}
+
+ModelIndex::ModelIndex(const std::vector<ModelPtr> &roots,
+                       const ModelIndex *previous) {
+  m_keys = previous ? previous->m_keys : std::make_shared<KeyTable>();
+
+  m_rootNode =
+      roots.size() == 1 && roots[0]->IsContainer() && !roots[0]->IsPacked();
+  m_tops = m_rootNode ? roots[0]->items : roots;
+  if (m_rootNode) {
+    const ModelPtr &root = roots[0];
+    m_size = 1;
+    for (size_t i = 0; i < root->items.size(); i++)
+      m_chunkKey.push_back(root->kind == ModelNode::OBJECT
+                               ? m_keys->Intern(root->Keys()[i])
+                               : kNoKey);
+  } else {
+    m_chunkKey.assign(roots.size(), kNoKey);
+  }
+
+  size_t next = 0; // Previous chunk expected to come next
+  for (const ModelPtr &top : m_tops) {
+    std::shared_ptr<const Chunk> chunk;
+    if (previous && next < previous->m_chunks.size() &&
+        Identical(previous->m_tops[next], top)) {
+      chunk = previous->m_chunks[next++]; // Usually the chunks keep order
+    } else if (previous) {
+      auto it = std::lower_bound(previous->m_byHash.begin(),
+                                 previous->m_byHash.end(),
+                                 std::make_pair(top->hash, (size_t)0));
+      for (; it != previous->m_byHash.end() && it->first == top->hash;
+           ++it) {
+        if (Identical(previous->m_tops[it->second], top)) {
+          chunk = previous->m_chunks[it->second];
+          next = it->second + 1;
+          break;
+        }
+      }
+    }
+    if (chunk)
+      m_reused++;
+    else
+      chunk = BuildChunk(top, *m_keys);
+    m_base.push_back(m_size);
+    m_size += chunk->parent.size();
+    m_byHash.emplace_back(chunk->hash, m_chunks.size());
+    m_chunks.push_back(std::move(chunk));
+  }
+  std::sort(m_byHash.begin(), m_byHash.end());
+
+  m_keyCounts.assign(m_keys->names.size(), 0);
+  for (size_t c = 0; c < m_chunks.size(); c++) {
+    if (m_chunkKey[c] != kNoKey)
+      m_keyCounts[m_chunkKey[c]]++;
+    for (const auto &count : m_chunks[c]->keyCounts)
+      m_keyCounts[count.first] += count.second;
+  }
+}
+
+const ModelIndex::Chunk *ModelIndex::ChunkOf(size_t node,
+                                             size_t &local) const {
+  auto it = std::upper_bound(m_base.begin(), m_base.end(), node);
+  if (it == m_base.begin())
+    return nullptr; // The root
+  size_t c = it - m_base.begin() - 1;
+  local = node - m_base[c];
+  return m_chunks[c].get();
+}
+
+size_t ModelIndex::Parent(size_t node) const {
+  size_t local;
+  const Chunk *chunk = ChunkOf(node, local);
+  if (!chunk || node >= m_size)
+    return kNone;
+  if (chunk->parent[local] != kNoParent)
+    return node - local + chunk->parent[local];
+  return m_rootNode ? 0 : kNone;
+}
+
+size_t ModelIndex::End(size_t node) const {
+  size_t local;
+  const Chunk *chunk = ChunkOf(node, local);
+  if (!chunk || node >= m_size)
+    return m_size;
+  return node - local + chunk->end[local];
+}
+
+std::vector<size_t>
+ModelIndex::FindKeyIds(const std::vector<bool> &wanted) const {
+  std::vector<size_t> found;
+  std::vector<uint32_t> ids;
+  for (uint32_t id = 0; id < wanted.size(); id++) {
+    if (wanted[id])
+      ids.push_back(id);
+  }
+  for (size_t c = 0; c < m_chunks.size(); c++) {
+    const Chunk &chunk = *m_chunks[c];
+    size_t base = m_base[c];
+    if (m_chunkKey[c] != kNoKey && wanted[m_chunkKey[c]])
+      found.push_back(base);
+    size_t first = found.size();
+    if (ids.size() * 8 < chunk.keys.size()) {
+      // A few keys: look each one up
+      for (uint32_t id : ids) {
+        auto it = std::lower_bound(chunk.keys.begin(), chunk.keys.end(),
+                                   std::make_pair(id, (uint32_t)0));
+        for (; it != chunk.keys.end() && it->first == id; ++it)
+          found.push_back(base + it->second);
+      }
+    } else {
+      for (const auto &key : chunk.keys) {
+        if (key.first < wanted.size() && wanted[key.first])
+          found.push_back(base + key.second);
+      }
+    }
+    std::sort(found.begin() + first, found.end());
+  }
+  return found;
+}
+
+std::vector<size_t> ModelIndex::FindKey(const std::string &text) const {
+  std::string lower = text;
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](unsigned char c) { return (char)tolower(c); });
+  std::vector<bool> wanted(m_keyCounts.size());
+  for (size_t id = 0; id < m_keyCounts.size(); id++) {
+    if (m_keyCounts[id] && m_keys->folded[id].find(lower) != std::string::npos)
+      wanted[id] = true;
+  }
+  return FindKeyIds(wanted);
+}
+
+std::vector<size_t> ModelIndex::FindValue(const std::string &text) const {
+  std::vector<size_t> found;
+  uint64_t hash = HashText(text);
+  for (size_t c = 0; c < m_chunks.size(); c++) {
+    const Chunk &chunk = *m_chunks[c];
+    auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(),
+                               std::make_pair(hash, (uint32_t)0));
+    for (; it != chunk.values.end() && it->first == hash; ++it)
+      found.push_back(m_base[c] + it->second);
+  }
+  return found;
+}
+
+// Score of pattern (lowercase) as a subsequence of key, or -1. Matches at
+// the start of a word and runs of consecutive characters score higher;
+// skipped characters cost a little.
+static int FuzzyScore(const std::string &pattern, const std::string &key) {
+  int score = 0;
+  size_t p = 0;
+  bool run = false;
+  for (size_t i = 0; i < key.size() && p < pattern.size(); i++) {
+    unsigned char c = key[i];
+    if ((char)tolower(c) != pattern[p]) {
+      run = false;
+      score--;
+      continue;
+    }
+    unsigned char before = i ? key[i - 1] : ' ';
+    bool wordStart = !isalnum(before) || (isupper(c) && islower(before));
+    score += 10 + (wordStart ? 20 : 0) + (run ? 15 : 0);
+    run = true;
+    p++;
+  }
+  return p == pattern.size() ? score : -1;
+}
+
+std::vector<std::string> ModelIndex::CompleteKey(const std::string &text,
+                                                 size_t limit) const {
+  std::string lower = text;
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](unsigned char c) { return (char)tolower(c); });
+  struct Candidate {
+    int score;
+    uint32_t id;
+  };
+  std::vector<Candidate> candidates;
+  for (uint32_t id = 0; id < m_keyCounts.size(); id++) {
+    if (!m_keyCounts[id])
+      continue;
+    int score = FuzzyScore(lower, m_keys->names[id]);
+    if (score >= 0)
+      candidates.push_back({score, id});
+  }
+  // Best score, then the shorter key, then the more used one
+  auto better = [this](const Candidate &a, const Candidate &b) {
+    if (a.score != b.score)
+      return a.score > b.score;
+    size_t lengthA = m_keys->names[a.id].size();
+    size_t lengthB = m_keys->names[b.id].size();
+    if (lengthA != lengthB)
+      return lengthA < lengthB;
+    return m_keyCounts[a.id] > m_keyCounts[b.id];
+  };
+  size_t n = std::min(limit, candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + n,
+                    candidates.end(), better);
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < n; i++)
+    keys.push_back(m_keys->names[candidates[i].id]);
+  return keys;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "Model.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Inverted index of a parsed document: from each key to the value nodes
+// under it and from each scalar value to its nodes.
+//
+// Nodes are identified by the pre-order number Model::ParseYaml gives them
+// (the index into its source lines), which is also the order the tree is
+// built in. The document is indexed in chunks, one per top-level value (a
+// member or element of the root, or a document of a multi-document file).
+// Rebuilding after a reparse reuses the chunks whose subtree did not
+// change, so editing one document of a large file re-indexes only that
+// document. Keys are interned once and compared as integers; values are
+// compared by a 64-bit hash of their text.
+class ModelIndex {
+public:
+  static const size_t kNone = SIZE_MAX;
+
+  // roots as returned by Model::ParseYaml. previous, if given, is the
+  // index of an earlier version of the same document; its unchanged
+  // chunks and key table are shared.
+  ModelIndex(const std::vector<ModelPtr> &roots,
+             const ModelIndex *previous = nullptr);
+
+  size_t Size() const { return m_size; } // Nodes indexed
+  size_t Parent(size_t node) const;      // kNone for a root
+  size_t End(size_t node) const;         // One past the node's subtree
+
+  // Values under any key containing text, case-insensitively (every key
+  // if text is empty), in node order.
+  std::vector<size_t> FindKey(const std::string &text) const;
+  // Scalars whose text is exactly text, in node order.
+  std::vector<size_t> FindValue(const std::string &text) const;
+  // Keys that text fuzzily matches (its characters in order), best first.
+  std::vector<std::string> CompleteKey(const std::string &text,
+                                       size_t limit) const;
+
+  size_t ChunksReused() const { return m_reused; }
+
+private:
+  struct KeyTable;
+  struct Chunk;
+  static void IndexNode(const ModelPtr &node, uint32_t parent,
+                        KeyTable &table, Chunk &chunk);
+  static std::shared_ptr<const Chunk> BuildChunk(const ModelPtr &node,
+                                                 KeyTable &table);
+  const Chunk *ChunkOf(size_t node, size_t &local) const;
+  // Values under the keys whose ids are set in wanted, in node order
+  std::vector<size_t> FindKeyIds(const std::vector<bool> &wanted) const;
+
+  std::shared_ptr<KeyTable> m_keys;
+  // With a single container root, node 0 is the root and the chunks are
+  // its values; otherwise the chunks are the roots.
+  bool m_rootNode = false;
+  // The chunks' subtrees, to recognize them after a reparse. Chunks do not
+  // hold them, so a reused chunk does not keep the old subtree alive.
+  std::vector<ModelPtr> m_tops;
+  std::vector<std::shared_ptr<const Chunk>> m_chunks;
+  std::vector<size_t> m_base;        // First node of each chunk
+  // (subtree hash, chunk), sorted, for the next rebuild to look chunks up
+  std::vector<std::pair<size_t, size_t>> m_byHash;
+  std::vector<uint32_t> m_chunkKey;  // Key of each chunk in the root
+  std::vector<uint32_t> m_keyCounts; // Uses of each key id
+  size_t m_size = 0;
+  size_t m_reused = 0;
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include "FileUtils.h"
+#include "Simd.h"
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Output sinks for the serializers.
+//
+// A sink receives characters through Put, Write and Fill. Writers are
+// templates over the sink and over settings that would otherwise be tested
+// per character (line ending, pretty or compact), so every configuration
+// is compiled into its own loop and the sink calls inline away.
+
+// Appends to a string.
+template <typename CharT> class StringSink {
+public:
+  explicit StringSink(std::basic_string<CharT> &out) : m_out(out) {}
+  void Put(CharT c) { m_out.push_back(c); }
+  void Write(const CharT *data, size_t size) { m_out.append(data, size); }
+  void Fill(CharT c, size_t count) { m_out.append(count, c); }
+
+private:
+  std::basic_string<CharT> &m_out;
+};
+
+// Discards everything; a writer instantiated with it only validates.
+template <typename CharT> class NullSink {
+public:
+  void Put(CharT) {}
+  void Write(const CharT *, size_t) {}
+  void Fill(CharT, size_t) {}
+};
+
+// Collects output in a fixed buffer and hands it to flush(data, size) one
+// chunk at a time, e.g. to WriteFile. Writes larger than the buffer bypass
+// it. Whatever is left is flushed by the destructor.
+template <typename CharT, typename FlushFn, size_t Size = 32 * 1024>
+class ChunkSink {
+public:
+  explicit ChunkSink(FlushFn flush) : m_flush(flush) {}
+  ~ChunkSink() { Flush(); }
+  ChunkSink(const ChunkSink &) = delete;
+  ChunkSink &operator=(const ChunkSink &) = delete;
+
+  void Put(CharT c) {
+    if (m_used == Size)
+      Flush();
+    m_buf[m_used++] = c;
+  }
+  void Write(const CharT *data, size_t size) {
+    if (size > Size - m_used) {
+      Flush();
+      if (size >= Size) {
+        m_flush(data, size);
+        return;
+      }
+    }
+    memcpy(m_buf + m_used, data, size * sizeof(CharT));
+    m_used += size;
+  }
+  void Fill(CharT c, size_t count) {
+    while (count-- > 0)
+      Put(c);
+  }
+  void Flush() {
+    if (m_used > 0)
+      m_flush(m_buf, m_used);
+    m_used = 0;
+  }
+
+private:
+  FlushFn m_flush;
+  CharT m_buf[Size];
+  size_t m_used = 0;
+};
+
+template <FileUtils::EolMode Eol, typename Sink>
+inline void WriteLineBreak(Sink &sink) {
+  if constexpr (Eol == FileUtils::CRLF) {
+    sink.Put('\r');
+    sink.Put('\n');
+  } else {
+    sink.Put(Eol == FileUtils::LF ? '\n' : '\r');
+  }
+}
+
+// Index of the first '\r' or '\n' at or after i, or size.
+inline size_t FindLineBreak(const char *data, size_t i, size_t size) {
+#ifdef JY_SSE2
+  const __m128i cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    unsigned mask = (unsigned)_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+    if (mask != 0)
+      return i + CountTrailingZeros(mask);
+  }
+#endif
+  for (; i < size; i++)
+    if (data[i] == '\r' || data[i] == '\n')
+      return i;
+  return size;
+}
+
+inline size_t FindLineBreak(const wchar_t *data, size_t i, size_t size) {
+#ifdef JY_SSE2
+  if (sizeof(wchar_t) == 2) {
+    const __m128i cr = _mm_set1_epi16(L'\r'), lf = _mm_set1_epi16(L'\n');
+    for (; i + 8 <= size; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+      unsigned mask = (unsigned)_mm_movemask_epi8(
+          _mm_or_si128(_mm_cmpeq_epi16(v, cr), _mm_cmpeq_epi16(v, lf)));
+      if (mask != 0)
+        return i + CountTrailingZeros(mask) / 2;
+    }
+  }
+#endif
+  for (; i < size; i++)
+    if (data[i] == L'\r' || data[i] == L'\n')
+      return i;
+  return size;
+}
+
+// Copies text to sink with every line break (CRLF, lone CR or lone LF)
+// written as Eol. Text between line breaks is written in one call.
+template <FileUtils::EolMode Eol, typename CharT, typename Sink>
+void WriteWithEol(Sink &sink, const CharT *data, size_t size) {
+  size_t run = 0;
+  while (run < size) {
+    size_t i = FindLineBreak(data, run, size);
+    sink.Write(data + run, i - run);
+    if (i == size)
+      break;
+    WriteLineBreak<Eol>(sink);
+    if (data[i] == '\r' && i + 1 < size && data[i + 1] == '\n')
+      i++;
+    run = i + 1;
+  }
+}
+
+// Calls f(std::integral_constant<FileUtils::EolMode, eol>()), so a line
+// ending chosen at run time selects one of the compiled variants.
+template <typename F> decltype(auto) DispatchEol(FileUtils::EolMode eol, F &&f) {
+  switch (eol) {
+  case FileUtils::LF:
+    return f(std::integral_constant<FileUtils::EolMode, FileUtils::LF>());
+  case FileUtils::CR:
+    return f(std::integral_constant<FileUtils::EolMode, FileUtils::CR>());
+  default:
+    return f(std::integral_constant<FileUtils::EolMode, FileUtils::CRLF>());
+  }
+}
+
+template <typename Sink> void WriteDecimal(Sink &sink, unsigned value) {
+  char digits[10];
+  size_t n = 0;
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n > 0)
+    sink.Put(digits[--n]);
+}
@@ -0,0 +1,1091 @@
+#include "SearchEngine.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+static const size_t npos = (size_t)-1;
+
+// Letters, digits and '_': \w, \b and whole-word matching.
+static bool IsWordChar(wchar_t c) { return c == L'_' || iswalnum(c) != 0; }
+
+static wchar_t FoldCase(wchar_t c) { return (wchar_t)towlower(c); }
+
+// -- Literal search --
+
+static bool EqualAt(const wchar_t *text, const std::wstring &needle,
+                    bool matchCase) {
+  if (matchCase)
+    return wmemcmp(text, needle.data(), needle.size()) == 0;
+  for (size_t k = 0; k < needle.size(); k++)
+    if (FoldCase(text[k]) != needle[k])
+      return false;
+  return true;
+}
+
+// First i >= from where needle occurs. Without matchCase, needle must be
+// lower-cased. Each 8-character block is tested against the first and the
+// last character of needle at once, so most blocks cost two loads and
+// compares.
+static size_t FindText(const wchar_t *text, size_t size, size_t from,
+                       const std::wstring &needle, bool matchCase) {
+  size_t n = needle.size();
+  if (n == 0 || size < n || from > size - n)
+    return npos;
+  size_t last = size - n; // Last possible start
+  size_t i = from;
+  wchar_t first = needle[0], end = needle[n - 1];
+  wchar_t firstAlt = matchCase ? first : (wchar_t)towupper(first);
+#ifdef JY_SSE2
+  if (sizeof(wchar_t) == 2) {
+    wchar_t endAlt = matchCase ? end : (wchar_t)towupper(end);
+    const __m128i f0 = _mm_set1_epi16((short)first);
+    const __m128i f1 = _mm_set1_epi16((short)firstAlt);
+    const __m128i e0 = _mm_set1_epi16((short)end);
+    const __m128i e1 = _mm_set1_epi16((short)endAlt);
+    for (; i + 8 <= last + 1; i += 8) {
+      __m128i vf = _mm_loadu_si128((const __m128i *)(text + i));
+      __m128i ve = _mm_loadu_si128((const __m128i *)(text + i + n - 1));
+      __m128i hit = _mm_and_si128(
+          _mm_or_si128(_mm_cmpeq_epi16(vf, f0), _mm_cmpeq_epi16(vf, f1)),
+          _mm_or_si128(_mm_cmpeq_epi16(ve, e0), _mm_cmpeq_epi16(ve, e1)));
+      unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+      while (mask != 0) {
+        unsigned bit = CountTrailingZeros(mask);
+        size_t at = i + bit / 2;
+        if (EqualAt(text + at, needle, matchCase))
+          return at;
+        mask &= ~(3u << (bit & ~1u)); // Both bytes of the lane
+      }
+    }
+  }
+#endif
+  for (; i <= last; i++) {
+    if ((text[i] == first || text[i] == firstAlt) &&
+        EqualAt(text + i, needle, matchCase))
+      return i;
+  }
+  return npos;
+}
+
+// -- Regular expressions --
+
+// Sorted, non-overlapping, non-adjacent ranges of characters.
+typedef std::vector<std::pair<uint32_t, uint32_t>> CharSet;
+
+static const uint32_t kMaxChar = 0x10FFFF;
+
+static void Normalize(CharSet &set) {
+  std::sort(set.begin(), set.end());
+  CharSet merged;
+  for (const auto &r : set) {
+    if (!merged.empty() && r.first <= merged.back().second + 1)
+      merged.back().second = std::max(merged.back().second, r.second);
+    else
+      merged.push_back(r);
+  }
+  set.swap(merged);
+}
+
+static CharSet Negate(const CharSet &set) {
+  CharSet out;
+  uint32_t next = 0;
+  for (const auto &r : set) {
+    if (r.first > next)
+      out.push_back({next, r.first - 1});
+    next = r.second + 1;
+  }
+  if (next <= kMaxChar)
+    out.push_back({next, kMaxChar});
+  return out;
+}
+
+static bool Contains(const CharSet &set, uint32_t c) {
+  auto it = std::upper_bound(
+      set.begin(), set.end(), c,
+      [](uint32_t v, const std::pair<uint32_t, uint32_t> &r) {
+        return v < r.first;
+      });
+  return it != set.begin() && (it - 1)->second >= c;
+}
+
+// Adds the other case of every cased character. Only the blocks with case
+// (Latin through Cyrillic, Armenian, Greek Extended, fullwidth Latin) are
+// walked, so negated classes stay cheap.
+static void AddCaseVariants(CharSet &set) {
+  static const std::pair<uint32_t, uint32_t> kCased[] = {
+      {0x41, 0x5A}, {0x61, 0x7A}, {0xB5, 0x587}, {0x10A0, 0x10FF},
+      {0x1E00, 0x1FFF}, {0x2C00, 0x2D2F}, {0xA640, 0xA7FF},
+      {0xFF21, 0xFF5A}};
+  CharSet extra;
+  for (const auto &r : set) {
+    for (const auto &cased : kCased) {
+      uint32_t lo = std::max(r.first, cased.first);
+      uint32_t hi = std::min(r.second, cased.second);
+      for (uint32_t c = lo; c <= hi && lo <= hi; c++) {
+        uint32_t lower = (uint32_t)towlower((wint_t)c);
+        uint32_t upper = (uint32_t)towupper((wint_t)c);
+        if (lower != c)
+          extra.push_back({lower, lower});
+        if (upper != c)
+          extra.push_back({upper, upper});
+      }
+    }
+  }
+  set.insert(set.end(), extra.begin(), extra.end());
+  Normalize(set);
+}
+
+static const CharSet &WordSet() {
+  static const CharSet set = [] {
+    CharSet s;
+    for (uint32_t c = 0; c <= 0xFFFF; c++) {
+      if (!IsWordChar((wchar_t)c))
+        continue;
+      if (!s.empty() && s.back().second + 1 == c)
+        s.back().second = c;
+      else
+        s.push_back({c, c});
+    }
+    return s;
+  }();
+  return set;
+}
+
+enum Assertion {
+  LINE_START,
+  LINE_END,
+  TEXT_START,
+  TEXT_END,
+  WORD_BOUNDARY,
+  NOT_WORD_BOUNDARY,
+  NOT_WORD_BEFORE, // Whole-word start
+  NOT_WORD_AFTER   // Whole-word end
+};
+
+// What a character means to the assertions. EDGE is the start or the end
+// of the text.
+enum CharKind : uint8_t { EDGE, LF, CR, WORD, OTHER };
+
+// before/after are the characters on each side of the position in text
+// order.
+static bool Holds(Assertion a, CharKind before, CharKind after) {
+  switch (a) {
+  case LINE_START:
+    return before == EDGE || before == LF;
+  case LINE_END:
+    return after == EDGE || after == LF || after == CR;
+  case TEXT_START:
+    return before == EDGE;
+  case TEXT_END:
+    return after == EDGE;
+  case WORD_BOUNDARY:
+    return (before == WORD) != (after == WORD);
+  case NOT_WORD_BOUNDARY:
+    return (before == WORD) == (after == WORD);
+  case NOT_WORD_BEFORE:
+    return before != WORD;
+  default:
+    return after != WORD;
+  }
+}
+
+struct RegexNode {
+  enum Type { SET, CONCAT, ALT, REPEAT, ASSERT, EMPTY } type;
+  int value = 0;        // SET: index into sets; ASSERT: Assertion
+  int min = 0, max = 0; // REPEAT; max < 0 is unbounded
+  bool greedy = true;
+  std::vector<int> children;
+};
+
+// Recursive descent parser producing a node arena.
+class RegexParser {
+public:
+  RegexParser(const std::wstring &pattern, bool foldCase, bool multiline,
+              std::vector<RegexNode> &nodes, std::vector<CharSet> &sets)
+      : m_p(pattern), m_fold(foldCase), m_multiline(multiline), m_nodes(nodes),
+        m_sets(sets) {}
+
+  int Parse() {
+    int root = ParseAlt();
+    if (m_i < m_p.size())
+      Fail("Unmatched )");
+    return root;
+  }
+
+private:
+  static const int kMaxRepeat = 1000;
+
+  [[noreturn]] void Fail(const char *message) {
+    throw std::runtime_error(std::string(message) + " at position " +
+                             std::to_string(m_i + 1));
+  }
+
+  bool More() const { return m_i < m_p.size(); }
+  wchar_t Peek() const { return m_p[m_i]; }
+
+  int Add(RegexNode node) {
+    m_nodes.push_back(std::move(node));
+    return (int)m_nodes.size() - 1;
+  }
+
+  // Classes from [...] arrive already folded.
+  int AddSet(CharSet set, bool fold) {
+    Normalize(set);
+    if (fold)
+      AddCaseVariants(set);
+    m_sets.push_back(std::move(set));
+    RegexNode node;
+    node.type = RegexNode::SET;
+    node.value = (int)m_sets.size() - 1;
+    return Add(std::move(node));
+  }
+
+  int AddAssert(Assertion a) {
+    RegexNode node;
+    node.type = RegexNode::ASSERT;
+    node.value = a;
+    return Add(std::move(node));
+  }
+
+  int ParseAlt() {
+    std::vector<int> alternatives{ParseConcat()};
+    while (More() && Peek() == L'|') {
+      m_i++;
+      alternatives.push_back(ParseConcat());
+    }
+    if (alternatives.size() == 1)
+      return alternatives[0];
+    RegexNode node;
+    node.type = RegexNode::ALT;
+    node.children = std::move(alternatives);
+    return Add(std::move(node));
+  }
+
+  int ParseConcat() {
+    RegexNode node;
+    node.type = RegexNode::CONCAT;
+    while (More() && Peek() != L'|' && Peek() != L')')
+      node.children.push_back(ParseRepeat());
+    if (node.children.empty()) {
+      node.type = RegexNode::EMPTY;
+    } else if (node.children.size() == 1) {
+      return node.children[0];
+    }
+    return Add(std::move(node));
+  }
+
+  // Reads digits; false if there are none.
+  bool ParseNumber(int &value) {
+    size_t begin = m_i;
+    value = 0;
+    while (More() && Peek() >= L'0' && Peek() <= L'9') {
+      value = value * 10 + (Peek() - L'0');
+      if (value > kMaxRepeat)
+        Fail("Repeat count too large");
+      m_i++;
+    }
+    return m_i > begin;
+  }
+
+  // {m}, {m,} or {m,n}; anything else leaves '{' to be read as a literal.
+  bool ParseBraces(int &min, int &max) {
+    size_t save = m_i;
+    m_i++; // '{'
+    if (ParseNumber(min)) {
+      max = min;
+      if (More() && Peek() == L',') {
+        m_i++;
+        if (!ParseNumber(max))
+          max = -1;
+      }
+      if (More() && Peek() == L'}') {
+        m_i++;
+        if (max >= 0 && max < min)
+          Fail("Bad repeat range");
+        return true;
+      }
+    }
+    m_i = save;
+    return false;
+  }
+
+  int ParseRepeat() {
+    int atom = ParseAtom();
+    while (More()) {
+      int min, max;
+      wchar_t c = Peek();
+      if (c == L'*') {
+        min = 0, max = -1;
+        m_i++;
+      } else if (c == L'+') {
+        min = 1, max = -1;
+        m_i++;
+      } else if (c == L'?') {
+        min = 0, max = 1;
+        m_i++;
+      } else if (c != L'{' || !ParseBraces(min, max)) {
+        break;
+      }
+      if (m_nodes[atom].type == RegexNode::ASSERT)
+        Fail("Nothing to repeat");
+      RegexNode node;
+      node.type = RegexNode::REPEAT;
+      node.min = min;
+      node.max = max;
+      if (More() && Peek() == L'?') {
+        node.greedy = false;
+        m_i++;
+      }
+      node.children.push_back(atom);
+      atom = Add(std::move(node));
+    }
+    return atom;
+  }
+
+  int ParseAtom() {
+    wchar_t c = Peek();
+    switch (c) {
+    case L'(': {
+      m_i++;
+      if (m_p.compare(m_i, 2, L"?:") == 0)
+        m_i += 2;
+      else if (More() && Peek() == L'?')
+        Fail("Unsupported group");
+      int inner = ParseAlt();
+      if (!More() || Peek() != L')')
+        Fail("Missing )");
+      m_i++;
+      return inner;
+    }
+    case L'*':
+    case L'+':
+    case L'?':
+      Fail("Nothing to repeat");
+    case L'[':
+      m_i++;
+      return AddSet(ParseClass(), false);
+    case L'.':
+      m_i++;
+      return AddSet(Negate({{L'\n', L'\n'}, {L'\r', L'\r'}}), false);
+    case L'^':
+      m_i++;
+      return AddAssert(m_multiline ? LINE_START : TEXT_START);
+    case L'$':
+      m_i++;
+      return AddAssert(m_multiline ? LINE_END : TEXT_END);
+    case L'\\': {
+      m_i++;
+      if (!More())
+        Fail("Trailing backslash");
+      wchar_t e = Peek();
+      if (e == L'b' || e == L'B') {
+        m_i++;
+        return AddAssert(e == L'b' ? WORD_BOUNDARY : NOT_WORD_BOUNDARY);
+      }
+      CharSet set;
+      ParseEscape(set);
+      return AddSet(std::move(set), m_fold);
+    }
+    default:
+      m_i++;
+      return AddSet({{(uint32_t)c, (uint32_t)c}}, m_fold);
+    }
+  }
+
+  uint32_t ParseHex(size_t digits) {
+    uint32_t value = 0;
+    for (size_t k = 0; k < digits; k++, m_i++) {
+      if (!More() || !iswxdigit(Peek()))
+        Fail("Bad hex escape");
+      wchar_t h = Peek();
+      value = value * 16 + (h <= L'9' ? h - L'0' : (towlower(h) - L'a' + 10));
+    }
+    return value;
+  }
+
+  // After '\': adds the escaped character or class to set.
+  void ParseEscape(CharSet &set) {
+    static const CharSet digits = {{L'0', L'9'}};
+    static const CharSet spaces = {{L'\t', L'\r'}, {L' ', L' '},
+                                   {0xA0, 0xA0},   {0x3000, 0x3000}};
+    wchar_t e = m_p[m_i++];
+    const CharSet *cls = nullptr;
+    bool negate = false;
+    switch (e) {
+    case L'd':
+    case L'D':
+      cls = &digits;
+      negate = e == L'D';
+      break;
+    case L'w':
+    case L'W':
+      cls = &WordSet();
+      negate = e == L'W';
+      break;
+    case L's':
+    case L'S':
+      cls = &spaces;
+      negate = e == L'S';
+      break;
+    case L'n':
+      set.push_back({L'\n', L'\n'});
+      return;
+    case L'r':
+      set.push_back({L'\r', L'\r'});
+      return;
+    case L't':
+      set.push_back({L'\t', L'\t'});
+      return;
+    case L'f':
+      set.push_back({L'\f', L'\f'});
+      return;
+    case L'v':
+      set.push_back({L'\v', L'\v'});
+      return;
+    case L'0':
+      set.push_back({0, 0});
+      return;
+    case L'x': {
+      uint32_t v = ParseHex(2);
+      set.push_back({v, v});
+      return;
+    }
+    case L'u': {
+      uint32_t v = ParseHex(4);
+      set.push_back({v, v});
+      return;
+    }
+    default:
+      if (iswalnum(e))
+        Fail("Unknown escape");
+      set.push_back({(uint32_t)e, (uint32_t)e});
+      return;
+    }
+    CharSet add = negate ? Negate(*cls) : *cls;
+    set.insert(set.end(), add.begin(), add.end());
+  }
+
+  // After '[': the class up to and including ']'.
+  CharSet ParseClass() {
+    bool negate = false;
+    if (More() && Peek() == L'^') {
+      negate = true;
+      m_i++;
+    }
+    CharSet set;
+    bool first = true;
+    while (true) {
+      if (!More())
+        Fail("Missing ]");
+      wchar_t c = Peek();
+      if (c == L']' && !first) {
+        m_i++;
+        break;
+      }
+      first = false;
+      uint32_t lo;
+      if (c == L'\\') {
+        m_i++;
+        if (!More())
+          Fail("Trailing backslash");
+        CharSet escaped;
+        ParseEscape(escaped);
+        if (escaped.size() != 1 || escaped[0].first != escaped[0].second) {
+          set.insert(set.end(), escaped.begin(), escaped.end());
+          continue; // A class such as \d cannot start a range
+        }
+        lo = escaped[0].first;
+      } else {
+        lo = c;
+        m_i++;
+      }
+      uint32_t hi = lo;
+      if (m_i + 1 < m_p.size() && Peek() == L'-' && m_p[m_i + 1] != L']') {
+        m_i++;
+        if (Peek() == L'\\') {
+          m_i++;
+          if (!More())
+            Fail("Trailing backslash");
+          CharSet escaped;
+          ParseEscape(escaped);
+          if (escaped.size() != 1 || escaped[0].first != escaped[0].second)
+            Fail("Bad range");
+          hi = escaped[0].first;
+        } else {
+          hi = Peek();
+          m_i++;
+        }
+        if (hi < lo)
+          Fail("Bad range");
+      }
+      set.push_back({lo, hi});
+    }
+    Normalize(set);
+    // Folding before negating keeps [^a] from matching 'A'
+    if (m_fold)
+      AddCaseVariants(set);
+    return negate ? Negate(set) : set;
+  }
+
+  const std::wstring &m_p;
+  size_t m_i = 0;
+  bool m_fold;
+  bool m_multiline;
+  std::vector<RegexNode> &m_nodes;
+  std::vector<CharSet> &m_sets;
+};
+
+struct RegexInst {
+  enum Op { SET, SPLIT, ASSERT, MATCH } op;
+  int arg = 0;       // SET: set index; ASSERT: Assertion
+  int x = -1, y = -1; // Next instruction; SPLIT prefers x
+};
+
+struct RegexProgram {
+  std::vector<RegexInst> insts;
+  int start = 0;
+};
+
+// Builds a program by continuation: each node is emitted in front of the
+// code that follows it. A reversed program matches the reversed language,
+// which only changes the order in which concatenations are emitted.
+class RegexCompiler {
+public:
+  RegexCompiler(const std::vector<RegexNode> &nodes, RegexProgram &prog,
+                bool reverse)
+      : m_nodes(nodes), m_prog(prog), m_reverse(reverse) {}
+
+  void Compile(int root) {
+    m_prog.insts.clear();
+    int match = Add({RegexInst::MATCH});
+    m_prog.start = Emit(root, match);
+  }
+
+private:
+  static const size_t kMaxInsts = 1 << 18;
+
+  int Add(RegexInst inst) {
+    if (m_prog.insts.size() >= kMaxInsts)
+      throw std::runtime_error("Pattern too large");
+    m_prog.insts.push_back(inst);
+    return (int)m_prog.insts.size() - 1;
+  }
+
+  int Split(int preferred, int other) {
+    RegexInst inst{RegexInst::SPLIT};
+    inst.x = preferred;
+    inst.y = other;
+    return Add(inst);
+  }
+
+  // Loop: body repeated zero or more times, then next.
+  int Star(int body, int next, bool greedy) {
+    int loop = Add({RegexInst::SPLIT});
+    int entry = Emit(body, loop);
+    m_prog.insts[loop].x = greedy ? entry : next;
+    m_prog.insts[loop].y = greedy ? next : entry;
+    return loop;
+  }
+
+  int Emit(int index, int next) {
+    const RegexNode &node = m_nodes[index];
+    switch (node.type) {
+    case RegexNode::SET:
+    case RegexNode::ASSERT: {
+      RegexInst inst{node.type == RegexNode::SET ? RegexInst::SET
+                                                 : RegexInst::ASSERT};
+      inst.arg = node.value;
+      inst.x = next;
+      return Add(inst);
+    }
+    case RegexNode::EMPTY:
+      return next;
+    case RegexNode::CONCAT:
+      if (m_reverse) {
+        for (int child : node.children)
+          next = Emit(child, next);
+      } else {
+        for (size_t k = node.children.size(); k-- > 0;)
+          next = Emit(node.children[k], next);
+      }
+      return next;
+    case RegexNode::ALT: {
+      int entry = Emit(node.children.back(), next);
+      for (size_t k = node.children.size() - 1; k-- > 0;)
+        entry = Split(Emit(node.children[k], next), entry);
+      return entry;
+    }
+    default: { // REPEAT
+      int body = node.children[0];
+      int entry = next;
+      if (node.max < 0) {
+        entry = Star(body, next, node.greedy);
+      } else {
+        for (int k = node.min; k < node.max; k++) {
+          int once = Emit(body, entry);
+          entry = node.greedy ? Split(once, next) : Split(next, once);
+        }
+      }
+      for (int k = 0; k < node.min; k++)
+        entry = Emit(body, entry);
+      return entry;
+    }
+    }
+  }
+
+  const std::vector<RegexNode> &m_nodes;
+  RegexProgram &m_prog;
+  bool m_reverse;
+};
+
+// Input alphabet: characters that no set or assertion tells apart share a
+// class, so DFA transitions are indexed by class instead of by character.
+struct CharClasses {
+  std::vector<uint32_t> starts;    // Segment starts, ascending
+  std::vector<uint16_t> ofSegment; // Class of each segment
+  std::vector<uint16_t> bmp;       // Class of every character below 0x10000
+  std::vector<uint32_t> sample;    // A character of each class
+  std::vector<CharKind> kind;      // Assertion meaning of each class
+  int count = 0;                   // Class count; EDGE's class is count
+
+  void Build(const std::vector<CharSet> &sets) {
+    std::vector<uint32_t> bounds = {0, L'\n', L'\n' + 1, L'\r', L'\r' + 1};
+    auto addBounds = [&](const CharSet &set) {
+      for (const auto &r : set) {
+        bounds.push_back(r.first);
+        if (r.second < kMaxChar)
+          bounds.push_back(r.second + 1);
+      }
+    };
+    for (const CharSet &set : sets)
+      addBounds(set);
+    addBounds(WordSet());
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    // Segments with the same set membership and kind share a class
+    std::map<std::vector<bool>, uint16_t> ids;
+    for (uint32_t start : bounds) {
+      std::vector<bool> signature;
+      for (const CharSet &set : sets)
+        signature.push_back(Contains(set, start));
+      CharKind k = KindOf(start);
+      signature.push_back(k == LF);
+      signature.push_back(k == CR);
+      signature.push_back(k == WORD);
+      auto it = ids.find(signature);
+      if (it == ids.end()) {
+        it = ids.emplace(signature, (uint16_t)sample.size()).first;
+        sample.push_back(start);
+        kind.push_back(k);
+      }
+      starts.push_back(start);
+      ofSegment.push_back(it->second);
+    }
+    count = (int)sample.size();
+    kind.push_back(EDGE);
+
+    bmp.resize(0x10000);
+    for (size_t s = 0; s < starts.size() && starts[s] < 0x10000; s++) {
+      uint32_t end = s + 1 < starts.size() ? starts[s + 1] : 0x10000;
+      std::fill(bmp.begin() + starts[s], bmp.begin() + std::min(end, 0x10000u),
+                ofSegment[s]);
+    }
+  }
+
+  static CharKind KindOf(uint32_t c) {
+    if (c == L'\n')
+      return LF;
+    if (c == L'\r')
+      return CR;
+    return Contains(WordSet(), c) ? WORD : OTHER;
+  }
+
+  int Of(wchar_t c) const {
+    uint32_t u = (uint32_t)c;
+    if (u < 0x10000)
+      return bmp[u];
+    size_t s = std::upper_bound(starts.begin(), starts.end(), u) -
+               starts.begin() - 1;
+    return ofSegment[s];
+  }
+};
+
+// A DFA built on demand from a program. A state is the ordered list of
+// NFA instructions still waiting to consume a character plus the kind of
+// the character before it. Assertions are resolved and matches detected
+// when the next character is known, so a transition on the character at i
+// reports a match that ended at i.
+//
+// Unanchored DFAs add a new thread at the lowest priority before every
+// character until the first match; a match then drops every thread of
+// lower priority (leftmost-first, as in Perl). Longest DFAs keep all
+// threads and report every match until they die.
+class LazyDfa {
+public:
+  enum Flags : uint8_t { MATCH = 1, DEAD = 2, IDLE = 4, STARTED = 8 };
+
+  LazyDfa(const RegexProgram &prog, const std::vector<CharSet> &sets,
+          const CharClasses &classes, bool reverse, bool anchored,
+          bool longest)
+      : m_prog(prog), m_sets(sets), m_classes(classes), m_reverse(reverse),
+        m_anchored(anchored), m_longest(longest),
+        m_stride(classes.count + 1), m_mark(prog.insts.size(), 0),
+        m_added(prog.insts.size(), 0) {
+    // Bound the transition table to about 8 MB
+    m_maxStates = std::max<size_t>(64, (8 << 20) / (m_stride * sizeof(int)));
+  }
+
+  int Edge() const { return m_classes.count; }
+  uint8_t Flags(int state) const { return m_flags[state]; }
+
+  // State before the first character; prev is the character before it in
+  // scan order.
+  int Start(CharKind prev) {
+    State state;
+    state.prev = prev;
+    state.flags = 0;
+    if (m_anchored) {
+      state.insts.push_back(m_prog.start);
+      state.flags = STARTED;
+    }
+    return Intern(std::move(state));
+  }
+
+  int Next(int state, int cls) {
+    int t = m_next[(size_t)state * m_stride + cls];
+    return t >= 0 ? t : Compute(state, cls);
+  }
+
+private:
+  struct State {
+    std::vector<int> insts;
+    CharKind prev;
+    uint8_t flags;
+  };
+
+  static std::string Key(const State &state) {
+    std::string key;
+    key.reserve(2 + state.insts.size() * sizeof(int));
+    key.push_back((char)state.prev);
+    key.push_back((char)(state.flags & (MATCH | STARTED)));
+    key.append((const char *)state.insts.data(),
+               state.insts.size() * sizeof(int));
+    return key;
+  }
+
+  int Intern(State state) {
+    if (state.insts.empty())
+      state.flags |= (state.flags & STARTED) ? DEAD : IDLE;
+    std::string key = Key(state);
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+      return it->second;
+    int id = (int)m_states.size();
+    m_flags.push_back(state.flags);
+    m_states.push_back(std::move(state));
+    m_next.resize(m_next.size() + m_stride, -1);
+    m_index.emplace(std::move(key), id);
+    return id;
+  }
+
+  int Compute(int from, int cls) {
+    if (m_states.size() >= m_maxStates) {
+      // Start over with only the current state; the caller's index for
+      // it changes, which is fine since it only keeps the result
+      State keep = m_states[from];
+      m_states.clear();
+      m_flags.clear();
+      m_next.clear();
+      m_index.clear();
+      from = Intern(std::move(keep));
+    }
+
+    const State &state = m_states[from];
+    CharKind next = m_classes.kind[cls];
+    CharKind before = m_reverse ? next : state.prev;
+    CharKind after = m_reverse ? state.prev : next;
+    uint32_t c = cls < m_classes.count ? m_classes.sample[cls] : 0;
+
+    // Closure of the waiting threads in priority order; each thread's
+    // consumers are stepped over c right away.
+    State out;
+    out.prev = next;
+    out.flags = state.flags & STARTED;
+    bool matched = false;
+    if (++m_generation == 0) {
+      std::fill(m_mark.begin(), m_mark.end(), 0);
+      std::fill(m_added.begin(), m_added.end(), 0);
+      m_generation = 1;
+    }
+    std::vector<int> stack;
+    auto run = [&](int root) {
+      stack.push_back(root);
+      while (!stack.empty()) {
+        int pc = stack.back();
+        stack.pop_back();
+        if (m_mark[pc] == m_generation)
+          continue;
+        m_mark[pc] = m_generation;
+        const RegexInst &inst = m_prog.insts[pc];
+        switch (inst.op) {
+        case RegexInst::SET:
+          if (cls < m_classes.count && Contains(m_sets[inst.arg], c) &&
+              m_added[inst.x] != m_generation) {
+            m_added[inst.x] = m_generation;
+            out.insts.push_back(inst.x);
+          }
+          break;
+        case RegexInst::SPLIT:
+          stack.push_back(inst.y);
+          stack.push_back(inst.x);
+          break;
+        case RegexInst::ASSERT:
+          if (Holds((Assertion)inst.arg, before, after))
+            stack.push_back(inst.x);
+          break;
+        case RegexInst::MATCH:
+          matched = true;
+          if (!m_longest) {
+            stack.clear(); // Lower-priority alternatives lose
+            return false;
+          }
+          break;
+        }
+      }
+      return true;
+    };
+    bool more = true;
+    for (size_t k = 0; more && k < state.insts.size(); k++)
+      more = run(state.insts[k]);
+    if (more && !m_anchored && !(state.flags & STARTED))
+      run(m_prog.start);
+
+    if (matched)
+      out.flags |= MATCH | STARTED;
+    int to = Intern(std::move(out));
+    m_next[(size_t)from * m_stride + cls] = to;
+    return to;
+  }
+
+  const RegexProgram &m_prog;
+  const std::vector<CharSet> &m_sets;
+  const CharClasses &m_classes;
+  bool m_reverse, m_anchored, m_longest;
+  size_t m_stride;
+  size_t m_maxStates;
+  std::vector<State> m_states;
+  std::vector<uint8_t> m_flags;
+  std::vector<int> m_next; // m_stride entries per state; -1 not computed
+  std::unordered_map<std::string, int> m_index;
+  std::vector<unsigned> m_mark;  // Closure visit marks
+  std::vector<unsigned> m_added; // Instructions already in the next state
+  unsigned m_generation = 0;
+};
+
+class Regex {
+public:
+  Regex(const std::wstring &pattern, const SearchOptions &options) {
+    int root = RegexParser(pattern, !options.matchCase, options.multiline,
+                           m_nodes, m_sets)
+                   .Parse();
+    if (options.wholeWord) {
+      RegexNode before, after, concat;
+      before.type = after.type = RegexNode::ASSERT;
+      before.value = NOT_WORD_BEFORE;
+      after.value = NOT_WORD_AFTER;
+      m_nodes.push_back(before);
+      m_nodes.push_back(after);
+      concat.type = RegexNode::CONCAT;
+      concat.children = {(int)m_nodes.size() - 2, root,
+                         (int)m_nodes.size() - 1};
+      m_nodes.push_back(concat);
+      root = (int)m_nodes.size() - 1;
+    }
+    bool complete = true;
+    CollectPrefix(root, complete);
+
+    RegexCompiler(m_nodes, m_forward, false).Compile(root);
+    RegexCompiler(m_nodes, m_backward, true).Compile(root);
+    m_classes.Build(m_sets);
+    m_forwardDfa.reset(
+        new LazyDfa(m_forward, m_sets, m_classes, false, false, false));
+    m_backwardDfa.reset(
+        new LazyDfa(m_backward, m_sets, m_classes, true, true, true));
+  }
+
+  bool Find(const wchar_t *text, size_t size, size_t from,
+            SearchMatch &match) {
+    if (from > size)
+      return false;
+    LazyDfa &dfa = *m_forwardDfa;
+    int s = dfa.Start(KindBefore(text, from));
+    size_t end = npos;
+    for (size_t i = from;; i++) {
+      if (!m_prefix.empty() && (dfa.Flags(s) & LazyDfa::IDLE)) {
+        // No thread is running: skip to where the literal prefix occurs
+        size_t at = FindText(text, size, i, m_prefix, true);
+        if (at == npos)
+          return false;
+        if (at != i) {
+          i = at;
+          s = dfa.Start(KindBefore(text, i));
+        }
+      }
+      int cls = i < size ? m_classes.Of(text[i]) : dfa.Edge();
+      s = dfa.Next(s, cls);
+      uint8_t flags = dfa.Flags(s);
+      if (flags & LazyDfa::MATCH)
+        end = i;
+      if ((flags & LazyDfa::DEAD) || i == size)
+        break;
+    }
+    if (end == npos)
+      return false;
+
+    // The leftmost match ends at end; scan back for its start
+    LazyDfa &back = *m_backwardDfa;
+    int r = back.Start(end < size ? CharClasses::KindOf(text[end]) : EDGE);
+    size_t start = end;
+    for (size_t i = end;; i--) {
+      int cls = i > 0 ? m_classes.Of(text[i - 1]) : back.Edge();
+      r = back.Next(r, cls);
+      uint8_t flags = back.Flags(r);
+      if (flags & LazyDfa::MATCH)
+        start = i;
+      if (i == from || (flags & LazyDfa::DEAD))
+        break;
+    }
+    match.start = start;
+    match.length = end - start;
+    return true;
+  }
+
+private:
+  static CharKind KindBefore(const wchar_t *text, size_t i) {
+    return i > 0 ? CharClasses::KindOf(text[i - 1]) : EDGE;
+  }
+
+  // Characters every match must begin with, for skipping ahead.
+  void CollectPrefix(int index, bool &complete) {
+    const RegexNode &node = m_nodes[index];
+    if (node.type == RegexNode::CONCAT) {
+      for (int child : node.children) {
+        CollectPrefix(child, complete);
+        if (!complete)
+          return;
+      }
+    } else if (node.type == RegexNode::SET) {
+      const CharSet &set = m_sets[node.value];
+      if (set.size() == 1 && set[0].first == set[0].second &&
+          set[0].first <= 0xFFFF)
+        m_prefix.push_back((wchar_t)set[0].first);
+      else
+        complete = false;
+    } else if (node.type != RegexNode::ASSERT) {
+      complete = false;
+    }
+  }
+
+  std::vector<RegexNode> m_nodes;
+  std::vector<CharSet> m_sets;
+  RegexProgram m_forward, m_backward;
+  CharClasses m_classes;
+  std::wstring m_prefix;
+  std::unique_ptr<LazyDfa> m_forwardDfa, m_backwardDfa;
+};
+
+// -- SearchEngine --
+
+SearchEngine::SearchEngine(const std::wstring &pattern,
+                           const SearchOptions &options)
+    : m_options(options) {
+  if (options.regex) {
+    if (!pattern.empty())
+      m_regex.reset(new Regex(pattern, options));
+    return;
+  }
+  m_literal = pattern;
+  if (!options.matchCase)
+    std::transform(m_literal.begin(), m_literal.end(), m_literal.begin(),
+                   FoldCase);
+}
+
+SearchEngine::~SearchEngine() {}
+
+bool SearchEngine::FindLiteral(const wchar_t *text, size_t size, size_t from,
+                               SearchMatch &match) const {
+  size_t n = m_literal.size();
+  while (true) {
+    size_t at = FindText(text, size, from, m_literal, m_options.matchCase);
+    if (at == npos)
+      return false;
+    if (!m_options.wholeWord ||
+        ((at == 0 || !IsWordChar(text[at - 1])) &&
+         (at + n == size || !IsWordChar(text[at + n])))) {
+      match.start = at;
+      match.length = n;
+      return true;
+    }
+    from = at + 1;
+  }
+}
+
+bool SearchEngine::Find(const wchar_t *text, size_t size, size_t from,
+                        SearchMatch &match) {
+  if (m_regex)
+    return m_regex->Find(text, size, from, match);
+  return !m_literal.empty() && FindLiteral(text, size, from, match);
+}
+
+size_t SearchEngine::FindAll(
+    const wchar_t *text, size_t size,
+    const std::function<bool(const std::vector<SearchMatch> &)> &onBatch,
+    size_t batchSize) {
+  std::vector<SearchMatch> batch;
+  batch.reserve(batchSize);
+  size_t total = 0;
+  size_t from = 0;
+  SearchMatch match;
+  while (from <= size && Find(text, size, from, match)) {
+    batch.push_back(match);
+    // An empty match must not be found again at the same place
+    from = match.start + (match.length > 0 ? match.length : 1);
+    if (batch.size() == batchSize) {
+      total += batch.size();
+      if (!onBatch(batch))
+        return total;
+      batch.clear();
+    }
+  }
+  if (!batch.empty()) {
+    total += batch.size();
+    onBatch(batch);
+  }
+  return total;
+}
+
+std::wstring SearchEngine::Replace(const wchar_t *text, size_t begin,
+                                   size_t end,
+                                   const std::vector<SearchMatch> &matches,
+                                   const std::wstring &replacement) {
+  size_t removed = 0;
+  for (const SearchMatch &m : matches)
+    removed += m.length;
+  std::wstring out;
+  out.reserve(end - begin - removed + matches.size() * replacement.size());
+  size_t at = begin;
+  for (const SearchMatch &m : matches) {
+    out.append(text + at, m.start - at);
+    out.append(replacement);
+    at = m.start + m.length;
+  }
+  out.append(text + at, end - at);
+  return out;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct SearchOptions {
+  bool matchCase = false;
+  bool wholeWord = false; // Not preceded or followed by a letter, digit or _
+  bool regex = false;
+  bool multiline = true; // ^ and $ also match at line breaks
+};
+
+struct SearchMatch {
+  size_t start;
+  size_t length;
+};
+
+class Regex;
+
+// Find and replace over UTF-16 text, i.e. the edit control's buffer.
+//
+// Literal patterns are found by comparing the pattern's first and last
+// character against 8 positions at a time with SSE2; only positions where
+// both agree are compared in full. Regular expressions compile to an NFA
+// that is run as a lazily built DFA: a state is created the first time a
+// transition leads to it and cached, up to a fixed memory budget after
+// which the cache is cleared. A forward pass finds where the leftmost
+// match ends and a reverse pass from there finds where it starts, so there
+// is no backtracking and no pattern can make a search superlinear.
+//
+// Regex syntax: . [...] [^...] \d \w \s \D \W \S \b \B ^ $ (...) (?:...) |
+// * + ? {m} {m,} {m,n} and their lazy forms (*? ...). ^ and $ match at line
+// boundaries, or only at the ends of the text without multiline, and .
+// does not match a line break. Alternatives are tried in
+// order as in Perl; groups do not capture.
+//
+// The DFA cache is not shared, so an engine must not be used from two
+// threads at once; compile one per thread instead.
+class SearchEngine {
+public:
+  // Throws std::runtime_error if the regular expression is malformed.
+  SearchEngine(const std::wstring &pattern, const SearchOptions &options);
+  ~SearchEngine();
+  SearchEngine(const SearchEngine &) = delete;
+  SearchEngine &operator=(const SearchEngine &) = delete;
+
+  // First match starting at or after from.
+  bool Find(const wchar_t *text, size_t size, size_t from, SearchMatch &match);
+
+  // Reports every match in order, up to batchSize at a time. Stops early if
+  // onBatch returns false. Returns the number of matches reported.
+  size_t
+  FindAll(const wchar_t *text, size_t size,
+          const std::function<bool(const std::vector<SearchMatch> &)> &onBatch,
+          size_t batchSize = 4096);
+
+  // text[begin, end) with each match, all inside it and in order, replaced
+  // by replacement, built in one pass.
+  static std::wstring Replace(const wchar_t *text, size_t begin, size_t end,
+                              const std::vector<SearchMatch> &matches,
+                              const std::wstring &replacement);
+
+private:
+  bool FindLiteral(const wchar_t *text, size_t size, size_t from,
+                   SearchMatch &match) const;
+
+  std::wstring m_literal; // Lower-cased unless matchCase
+  SearchOptions m_options;
+  std::unique_ptr<Regex> m_regex;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+// SSE2 is part of the x64 baseline, so code guarded by JY_SSE2 needs no
+// runtime CPU check. Every SIMD loop keeps a scalar tail/fallback.
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define JY_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit; mask must not be 0.
+inline unsigned CountTrailingZeros(unsigned mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (unsigned)index;
+#else
+  return (unsigned)__builtin_ctz(mask);
+#endif
+}
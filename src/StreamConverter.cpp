@@ -0,0 +1,742 @@
+#include "StreamConverter.h"
+#include "JsonEscape.h"
+#include "Model.h"
+#include "YamlEmitter.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/parser.h>
+
+using json = nlohmann::json;
+
+// Output is handed to the stream in chunks of about this size.
+static const size_t kFlushSize = 1 << 20;
+
+static const char kYamlTagPrefix[] = "tag:yaml.org,2002:";
+static const char kUnityTagPrefix[] = "tag:unity3d.com,2011:";
+
+static bool StartsWith(const std::string &s, const char *prefix) {
+  return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static void AppendJsonString(std::string &out, const std::string &s) {
+  out += '"';
+  JsonEscape::Escape(out, s.data(), s.size());
+  out += '"';
+}
+
+static void AppendNumber(std::string &out, int64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static void AppendNumber(std::string &out, uint64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+// YAML to JSON: parser events are written as compact JSON into the current
+// document's buffer. An anchored node remembers where its text starts and
+// ends in that buffer, so an alias is a copy of bytes already written.
+class JsonEventWriter : public YAML::EventHandler {
+public:
+  JsonEventWriter(std::ostream &out, StreamConverter::JsonStyle style,
+                  const ConvertOptions &options)
+      : m_out(out), m_style(style), m_options(options) {}
+
+  // Writes whatever the JSON style still holds back. Returns the number of
+  // documents.
+  size_t Finish() {
+    if (m_style == StreamConverter::JSON) {
+      if (m_documents == 1)
+        m_out << m_pending << '\n';
+      else if (m_documents > 1)
+        m_out << "\n]\n";
+    }
+    return m_documents;
+  }
+
+  void OnDocumentStart(const YAML::Mark &) override {
+    m_doc.clear();
+    m_stack.clear();
+    m_anchors.clear();
+    m_keyAnchors.clear();
+    m_anchorNames.clear();
+    m_tagMeta.clear();
+    m_anchorMeta.clear();
+    m_keyDepth = 0;
+    m_expanded = 0;
+  }
+
+  void OnDocumentEnd() override {
+    if (m_doc.empty())
+      m_doc = "null";
+    if (m_options.metadata)
+      WrapMetadata();
+    Emit();
+  }
+
+  void OnNull(const YAML::Mark &, YAML::anchor_t anchor) override {
+    NameAnchor(anchor);
+    if (TakeKey("null"))
+      return;
+    size_t start = BeginValue(std::string(), anchor);
+    m_doc += "null";
+    EndValue(anchor, start);
+  }
+
+  void OnAlias(const YAML::Mark &, YAML::anchor_t anchor) override {
+    auto key = m_keyAnchors.find(anchor);
+    if (key != m_keyAnchors.end()) {
+      // Anchored mapping key; its text is not in the document buffer
+      if (!TakeKey(KeyText(key->second.data(), key->second.size()))) {
+        BeginValue(std::string(), 0);
+        m_doc += key->second;
+      }
+      return;
+    }
+    auto target = m_anchors.find(anchor);
+    // An anchor that is still being written is referenced from inside itself.
+    if (target == m_anchors.end())
+      throw std::runtime_error("Recursive alias *" + m_anchorNames[anchor]);
+    size_t begin = target->second.first, len = target->second.second - begin;
+    if (m_keyDepth > 0)
+      return;
+    if (!m_stack.empty() && m_stack.back().isMap && !m_stack.back().haveKey) {
+      TakeKey(KeyText(m_doc.data() + begin, len));
+      return;
+    }
+    m_expanded += len;
+    if (m_expanded > m_options.aliasBudget)
+      throw std::runtime_error("Alias expansion exceeds the budget");
+    BeginValue(std::string(), 0);
+    m_doc.reserve(m_doc.size() + len); // Keeps the source bytes in place
+    m_doc.append(m_doc.data() + begin, len);
+  }
+
+  void OnScalar(const YAML::Mark &, const std::string &tag,
+                YAML::anchor_t anchor, const std::string &value) override {
+    NameAnchor(anchor);
+    if (TakeKey(value)) {
+      if (anchor != 0) {
+        std::string text;
+        AppendJsonString(text, value);
+        m_keyAnchors[anchor] = std::move(text);
+      }
+      return;
+    }
+    size_t start = BeginValue(tag, anchor);
+
+    ModelNode scalar;
+    // Quoted and !!str scalars are strings; only plain ones are typed.
+    if (tag == "!" || tag == "tag:yaml.org,2002:str")
+      scalar.kind = ModelNode::STRING;
+    else
+      Model::ParseScalar(value, scalar);
+    switch (scalar.kind) {
+    case ModelNode::NUL:
+      m_doc += "null";
+      break;
+    case ModelNode::BOOLEAN:
+      m_doc += scalar.boolean ? "true" : "false";
+      break;
+    case ModelNode::INTEGER:
+      if (scalar.isUnsigned)
+        AppendNumber(m_doc, scalar.uinteger);
+      else
+        AppendNumber(m_doc, scalar.integer);
+      break;
+    case ModelNode::REAL:
+      AppendReal(scalar.real);
+      break;
+    default:
+      AppendJsonString(m_doc, value);
+      break;
+    }
+    EndValue(anchor, start);
+  }
+
+  void OnSequenceStart(const YAML::Mark &, const std::string &tag,
+                       YAML::anchor_t anchor,
+                       YAML::EmitterStyle::value) override {
+    Push(tag, anchor, false);
+  }
+
+  void OnSequenceEnd() override { Pop(']'); }
+
+  void OnMapStart(const YAML::Mark &, const std::string &tag,
+                  YAML::anchor_t anchor, YAML::EmitterStyle::value) override {
+    Push(tag, anchor, true);
+  }
+
+  void OnMapEnd() override { Pop('}'); }
+
+  void OnAnchor(const YAML::Mark &, const std::string &name) override {
+    m_pendingAnchorName = name;
+  }
+
+private:
+  struct Frame {
+    bool isMap = false;
+    size_t count = 0;
+    bool haveKey = false;
+    std::string key;
+    std::string token; // Pointer token of the current child
+    YAML::anchor_t anchor = 0;
+    size_t start = 0; // Offset of '[' or '{' in the document
+  };
+
+  void NameAnchor(YAML::anchor_t anchor) {
+    if (anchor != 0)
+      m_anchorNames[anchor] = std::move(m_pendingAnchorName);
+    m_pendingAnchorName.clear();
+  }
+
+  // Consumes a scalar in mapping key position. Keys inside a complex key
+  // are dropped; the complex key itself reads as "???", as in the model.
+  bool TakeKey(const std::string &key) {
+    if (m_keyDepth > 0)
+      return true;
+    if (m_stack.empty() || !m_stack.back().isMap || m_stack.back().haveKey)
+      return false;
+    m_stack.back().key = key;
+    m_stack.back().haveKey = true;
+    return true;
+  }
+
+  // Key text of an aliased node: a string's contents, a scalar's text.
+  static std::string KeyText(const char *p, size_t len) {
+    if (len >= 2 && p[0] == '"') {
+      std::string key;
+      JsonEscape::Unescape(key, p + 1, len - 2);
+      return key;
+    }
+    if (len > 0 && (p[0] == '[' || p[0] == '{'))
+      return "???";
+    return std::string(p, len);
+  }
+
+  // Writes the separator and key before a value and records its metadata.
+  // Returns the offset the value's text starts at.
+  size_t BeginValue(const std::string &tag, YAML::anchor_t anchor) {
+    if (!m_stack.empty()) {
+      Frame &parent = m_stack.back();
+      if (parent.count++ > 0)
+        m_doc += ',';
+      if (parent.isMap) {
+        AppendJsonString(m_doc, parent.key);
+        m_doc += ':';
+        parent.token = parent.key;
+        parent.haveKey = false;
+      } else {
+        parent.token = std::to_string(parent.count - 1);
+      }
+    }
+    if (m_options.metadata) {
+      if (!tag.empty() && tag != "?" && tag != "!")
+        m_tagMeta.emplace_back(Pointer(), tag);
+      if (anchor != 0)
+        m_anchorMeta.emplace_back(Pointer(), m_anchorNames[anchor]);
+    }
+    return m_doc.size();
+  }
+
+  void EndValue(YAML::anchor_t anchor, size_t start) {
+    if (anchor != 0)
+      m_anchors[anchor] = {start, m_doc.size()};
+  }
+
+  void Push(const std::string &tag, YAML::anchor_t anchor, bool isMap) {
+    NameAnchor(anchor);
+    if (m_keyDepth > 0 ||
+        (!m_stack.empty() && m_stack.back().isMap && !m_stack.back().haveKey)) {
+      m_keyDepth++;
+      return;
+    }
+    Frame frame;
+    frame.isMap = isMap;
+    frame.anchor = anchor;
+    frame.start = BeginValue(tag, anchor);
+    m_doc += isMap ? '{' : '[';
+    m_stack.push_back(std::move(frame));
+  }
+
+  void Pop(char close) {
+    if (m_keyDepth > 0) {
+      if (--m_keyDepth == 0)
+        TakeKey("???");
+      return;
+    }
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+    m_doc += close;
+    EndValue(frame.anchor, frame.start);
+  }
+
+  std::string Pointer() const {
+    std::string pointer;
+    for (const Frame &frame : m_stack) {
+      pointer += '/';
+      pointer += Model::EscapePointerToken(frame.token);
+    }
+    return pointer;
+  }
+
+  void AppendReal(double value) {
+    if (std::isnan(value) || std::isinf(value)) {
+      m_doc += "null";
+      return;
+    }
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    size_t start = m_doc.size();
+    m_doc.append(buf, res.ptr);
+    if (m_doc.find_first_of(".e", start) == std::string::npos)
+      m_doc += ".0";
+  }
+
+  static void AppendPairs(
+      std::string &out,
+      const std::vector<std::pair<std::string, std::string>> &pairs) {
+    out += '{';
+    for (size_t i = 0; i < pairs.size(); i++) {
+      if (i > 0)
+        out += ',';
+      AppendJsonString(out, pairs[i].first);
+      out += ':';
+      AppendJsonString(out, pairs[i].second);
+    }
+    out += '}';
+  }
+
+  void WrapMetadata() {
+    std::string wrapped;
+    wrapped.reserve(m_doc.size() + 64);
+    wrapped += "{\"tags\":";
+    AppendPairs(wrapped, m_tagMeta);
+    wrapped += ",\"anchors\":";
+    AppendPairs(wrapped, m_anchorMeta);
+    wrapped += ",\"value\":";
+    wrapped += m_doc;
+    wrapped += '}';
+    m_doc.swap(wrapped);
+  }
+
+  // The JSON style holds the first document back until it knows whether
+  // the stream has more than one.
+  void Emit() {
+    if (m_style == StreamConverter::JSON_LINES) {
+      m_out << m_doc << '\n';
+    } else if (m_documents == 0) {
+      m_pending.swap(m_doc);
+    } else {
+      if (m_documents == 1) {
+        m_out << "[\n" << m_pending;
+        m_pending = std::string();
+      }
+      m_out << ",\n" << m_doc;
+    }
+    m_documents++;
+  }
+
+  std::ostream &m_out;
+  StreamConverter::JsonStyle m_style;
+  const ConvertOptions &m_options;
+  size_t m_documents = 0;
+  std::string m_pending;
+
+  std::string m_doc;
+  std::vector<Frame> m_stack;
+  int m_keyDepth = 0;
+  size_t m_expanded = 0;
+  std::unordered_map<YAML::anchor_t, std::pair<size_t, size_t>> m_anchors;
+  std::unordered_map<YAML::anchor_t, std::string> m_keyAnchors;
+  std::unordered_map<YAML::anchor_t, std::string> m_anchorNames;
+  std::string m_pendingAnchorName;
+  std::vector<std::pair<std::string, std::string>> m_tagMeta, m_anchorMeta;
+};
+
+size_t StreamConverter::YamlToJson(std::istream &in, std::ostream &out,
+                                   JsonStyle style,
+                                   const ConvertOptions &options) {
+  JsonEventWriter writer(out, style, options);
+  YAML::Parser parser(in);
+  while (parser.HandleNextDocument(writer)) {
+  }
+  return writer.Finish();
+}
+
+// JSON to YAML: SAX events are written as block YAML. A container's layout
+// depends on whether it is empty, so its opening is deferred until its
+// first child or its end arrives.
+class YamlSaxWriter : public nlohmann::json_sax<json> {
+public:
+  YamlSaxWriter(std::ostream &out, const ConvertOptions &options)
+      : m_out(out), m_options(options),
+        m_indent(options.indent < 1 ? 2 : (size_t)options.indent) {}
+
+  size_t Documents() const { return m_documents; }
+
+  // Writes out the last document's tail.
+  void Flush() {
+    m_out << m_buf;
+    m_buf.clear();
+  }
+
+  bool null() override { return Scalar("null"); }
+  bool boolean(bool value) override { return Scalar(value ? "true" : "false"); }
+
+  bool number_integer(number_integer_t value) override {
+    std::string text;
+    AppendNumber(text, (int64_t)value);
+    return Scalar(text);
+  }
+
+  bool number_unsigned(number_unsigned_t value) override {
+    std::string text;
+    AppendNumber(text, (uint64_t)value);
+    return Scalar(text);
+  }
+
+  // A JSON float always has '.', 'e' or 'E', so its source text reads
+  // back as a YAML real unchanged.
+  bool number_float(number_float_t, const string_t &text) override {
+    return Scalar(text);
+  }
+
+  bool string(string_t &value) override {
+    if (!m_inBody) {
+      if (m_section == TAGS && m_depth == m_base + 2)
+        m_tags[m_metaKey] = value;
+      else if (m_section == ANCHORS && m_depth == m_base + 2)
+        m_anchorNames[m_metaKey] = value;
+      else if (BodyValueNext())
+        return BodyScalar(value, true);
+      return true;
+    }
+    return BodyScalar(value, true);
+  }
+
+  bool binary(binary_t &) override { return Scalar("null"); }
+
+  bool start_object(std::size_t) override { return Start(true); }
+  bool end_object() override { return End(); }
+  bool start_array(std::size_t) override { return Start(false); }
+  bool end_array() override { return End(); }
+
+  bool key(string_t &key) override {
+    if (!m_inBody) {
+      if (m_depth == m_base + 1)
+        m_section = key == "tags"      ? TAGS
+                    : key == "anchors" ? ANCHORS
+                    : key == "value"   ? VALUE
+                                       : SKIP;
+      else if (m_depth == m_base + 2)
+        m_metaKey = key;
+      return true;
+    }
+    Frame &map = m_stack.back();
+    Open(map);
+    map.token = key;
+    if (map.count++ > 0 || !map.inlineFirst)
+      NewLine(map.childColumn);
+    YamlEmitter::AppendString(m_buf, key);
+    m_buf += ':';
+    return true;
+  }
+
+  bool parse_error(std::size_t position, const std::string &,
+                   const nlohmann::detail::exception &e) override {
+    throw std::runtime_error("JSON syntax error at byte " +
+                             std::to_string(position) + ": " + e.what());
+  }
+
+private:
+  enum Section { NONE, TAGS, ANCHORS, VALUE, SKIP };
+  enum Context { ROOT, MAP_VALUE, SEQ_ITEM };
+  struct Frame {
+    bool isMap = false;
+    Context context = ROOT;
+    size_t column = 0;        // Column of the item or key that owns it
+    std::string props;        // " !tag &anchor", written when opened
+    bool opened = false;      // First child seen
+    bool inlineFirst = false; // First child shares the "- " line
+    size_t childColumn = 0;
+    size_t count = 0;
+    std::string token; // Pointer token of the current child
+  };
+
+  bool InMetadataEnvelope() const { return m_options.metadata; }
+
+  // True if the next value outside a body starts a document body.
+  bool BodyValueNext() const {
+    return !InMetadataEnvelope() ||
+           (m_section == VALUE && m_depth == m_base + 1);
+  }
+
+  bool Scalar(const std::string &text) {
+    if (!m_inBody && !BodyValueNext())
+      return true;
+    return BodyScalar(text, false);
+  }
+
+  bool Start(bool isMap) {
+    if (!m_inBody) {
+      if (BodyValueNext()) {
+        BeginDocument();
+      } else {
+        // Envelope structure: the document list, a metadata object, or
+        // the tags/anchors objects inside one
+        if (!isMap && m_depth == 0 && !m_list) {
+          m_list = true;
+          m_base = 1;
+        } else if (isMap && m_depth == m_base) {
+          m_tags.clear();
+          m_anchorNames.clear();
+          m_section = NONE;
+          m_haveBody = false;
+        }
+        m_depth++;
+        return true;
+      }
+    }
+    std::string props = Props();
+    Context context = ROOT;
+    size_t column = 0;
+    if (!m_stack.empty()) {
+      Frame &parent = m_stack.back();
+      BeginItem(parent);
+      context = parent.isMap ? MAP_VALUE : SEQ_ITEM;
+      column = parent.childColumn;
+    }
+    Frame frame;
+    frame.isMap = isMap;
+    frame.context = context;
+    frame.column = column;
+    frame.props = std::move(props);
+    m_stack.push_back(std::move(frame));
+    m_depth++;
+    return true;
+  }
+
+  bool End() {
+    m_depth--;
+    if (!m_inBody) {
+      // Closing a metadata object ends its document
+      if (m_depth == m_base) {
+        if (!m_haveBody) {
+          BeginDocument();
+          m_buf += "null";
+        }
+        EndDocument();
+      } else if (m_depth == m_base + 1) {
+        m_section = NONE;
+      }
+      return true;
+    }
+    Frame frame = std::move(m_stack.back());
+    m_stack.pop_back();
+    if (!frame.opened) {
+      if (frame.context == ROOT) {
+        m_buf += frame.isMap ? "{}" : "[]";
+      } else {
+        m_buf += frame.props;
+        m_buf += frame.isMap ? " {}" : " []";
+      }
+    }
+    if (m_stack.empty())
+      EndBody();
+    return true;
+  }
+
+  bool BodyScalar(const std::string &text, bool isString) {
+    if (!m_inBody)
+      BeginDocument();
+    std::string props = Props();
+    if (m_stack.empty()) {
+      // Root scalar; its properties went on the "---" line
+      AppendScalar(text, isString);
+      EndBody();
+      return true;
+    }
+    BeginItem(m_stack.back());
+    m_buf += props;
+    m_buf += ' ';
+    AppendScalar(text, isString);
+    if (m_buf.size() >= kFlushSize)
+      Flush();
+    return true;
+  }
+
+  void AppendScalar(const std::string &text, bool isString) {
+    if (isString)
+      YamlEmitter::AppendString(m_buf, text);
+    else
+      m_buf += text;
+  }
+
+  // Lays out a container once its first child shows up.
+  void Open(Frame &frame) {
+    if (frame.opened)
+      return;
+    frame.opened = true;
+    switch (frame.context) {
+    case ROOT:
+      frame.childColumn = 0;
+      break;
+    case MAP_VALUE:
+      m_buf += frame.props;
+      frame.childColumn = frame.column + m_indent;
+      break;
+    case SEQ_ITEM:
+      m_buf += frame.props;
+      frame.childColumn = frame.column + 2;
+      frame.inlineFirst = frame.props.empty();
+      if (frame.inlineFirst)
+        m_buf += ' ';
+      break;
+    }
+  }
+
+  // Starts a sequence item ("- "); map values follow their key directly.
+  void BeginItem(Frame &parent) {
+    if (parent.isMap)
+      return;
+    Open(parent);
+    parent.token = std::to_string(parent.count);
+    if (parent.count++ > 0 || !parent.inlineFirst)
+      NewLine(parent.childColumn);
+    m_buf += '-';
+  }
+
+  void NewLine(size_t column) {
+    if (m_lineStarted)
+      m_buf += '\n';
+    m_lineStarted = true;
+    m_buf.append(column, ' ');
+  }
+
+  // Pointer of the value about to be written. Tokens are set once a value
+  // starts, so the innermost sequence contributes its next index.
+  std::string Pointer() const {
+    std::string pointer;
+    for (size_t i = 0; i < m_stack.size(); i++) {
+      const Frame &frame = m_stack[i];
+      pointer += '/';
+      if (i + 1 == m_stack.size() && !frame.isMap)
+        pointer += std::to_string(frame.count);
+      else
+        pointer += Model::EscapePointerToken(frame.token);
+    }
+    return pointer;
+  }
+
+  std::string TagText(const std::string &tag) const {
+    if (StartsWith(tag, kYamlTagPrefix))
+      return "!!" + tag.substr(strlen(kYamlTagPrefix));
+    if (m_unityHeader && StartsWith(tag, kUnityTagPrefix))
+      return "!u!" + tag.substr(strlen(kUnityTagPrefix));
+    if (!tag.empty() && tag[0] == '!')
+      return tag;
+    return "!<" + tag + ">";
+  }
+
+  // " !tag &anchor" for the value about to be written, from the metadata.
+  std::string Props() const {
+    if (m_tags.empty() && m_anchorNames.empty())
+      return std::string();
+    std::string pointer = Pointer();
+    std::string props;
+    auto tag = m_tags.find(pointer);
+    if (tag != m_tags.end())
+      props += " " + TagText(tag->second);
+    auto anchor = m_anchorNames.find(pointer);
+    if (anchor != m_anchorNames.end())
+      props += " &" + anchor->second;
+    return props;
+  }
+
+  void BeginDocument() {
+    m_inBody = true;
+    m_haveBody = true;
+    m_lineStarted = true;
+    if (m_documents == 0) {
+      for (const auto &tag : m_tags) {
+        if (StartsWith(tag.second, kUnityTagPrefix)) {
+          m_buf += "%YAML 1.1\n%TAG !u! ";
+          m_buf += kUnityTagPrefix;
+          m_buf += "\n";
+          m_unityHeader = true;
+          break;
+        }
+      }
+    }
+    std::string props = Props();
+    if (m_documents > 0 || m_unityHeader || !props.empty()) {
+      m_buf += "---";
+      m_buf += props;
+      m_buf += '\n';
+    }
+    m_lineStarted = false;
+  }
+
+  void EndBody() {
+    m_inBody = false;
+    m_section = NONE;
+    if (!InMetadataEnvelope())
+      EndDocument();
+  }
+
+  void EndDocument() {
+    m_buf += '\n';
+    m_documents++;
+    Flush();
+  }
+
+  std::ostream &m_out;
+  const ConvertOptions &m_options;
+  size_t m_indent;
+  std::string m_buf;
+  size_t m_documents = 0;
+  bool m_unityHeader = false;
+
+  // Body
+  bool m_inBody = false;
+  bool m_lineStarted = false;
+  std::vector<Frame> m_stack;
+  int m_depth = 0; // JSON nesting depth, envelope included
+
+  // Metadata envelope
+  bool m_list = false; // Top-level array of metadata objects
+  int m_base = 0;      // Depth of the metadata objects
+  bool m_haveBody = false;
+  Section m_section = NONE;
+  std::string m_metaKey;
+  std::map<std::string, std::string> m_tags, m_anchorNames;
+};
+
+size_t StreamConverter::JsonToYaml(std::istream &in, std::ostream &out,
+                                   JsonStyle style,
+                                   const ConvertOptions &options) {
+  YamlSaxWriter writer(out, options);
+  if (style == JSON_LINES) {
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+      json::sax_parse(line, &writer);
+    }
+  } else {
+    json::sax_parse(in, &writer);
+  }
+  writer.Flush();
+  return writer.Documents();
+}
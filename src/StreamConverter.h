@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <ostream>
+
+struct ConvertOptions {
+  // Carry YAML tags and anchor names as side metadata. Each JSON document
+  // becomes {"tags": {pointer: tag}, "anchors": {pointer: name},
+  // "value": document}; converting back to YAML restores them.
+  bool metadata = false;
+  // Bytes that alias expansion may add to one JSON document.
+  size_t aliasBudget = 64 * 1024 * 1024;
+  int indent = 2; // YAML output
+};
+
+// Streaming conversion between YAML and JSON / JSON Lines.
+//
+// Neither direction builds a model or a DOM: YAML parser events and JSON
+// SAX events are written straight to the output, and at most one document
+// is buffered at a time, so memory is bounded by the largest document
+// rather than by the file.
+class StreamConverter {
+public:
+  enum JsonStyle {
+    JSON,      // One value; several YAML documents become a top-level array
+    JSON_LINES // One document per line
+  };
+
+  // Returns the number of documents written. Throws YAML::Exception on
+  // YAML syntax errors and std::runtime_error on recursive aliases or when
+  // the alias budget is exceeded.
+  static size_t YamlToJson(std::istream &in, std::ostream &out,
+                           JsonStyle style, const ConvertOptions &options);
+
+  // With metadata, a JSON input may also be a top-level array holding one
+  // metadata object per document. Returns the number of documents written.
+  // Throws std::runtime_error on JSON syntax errors.
+  static size_t JsonToYaml(std::istream &in, std::ostream &out,
+                           JsonStyle style, const ConvertOptions &options);
+};
@@ -0,0 +1,276 @@
+#include "StructureIndex.h"
+#include <algorithm>
+
+StructureIndex::StructureIndex(size_t lines) : m_items(1) {
+  m_root = Build(lines);
+}
+
+LineShape StructureIndex::Join(const LineShape &left, const LineShape &right) {
+  LineShape joined;
+  joined.net = left.net + right.net;
+  joined.low = std::min(left.low, left.net + right.low);
+  // Negative, no content, is larger than any indentation unsigned
+  joined.indent =
+      (int32_t)std::min((uint32_t)left.indent, (uint32_t)right.indent);
+  return joined;
+}
+
+uint32_t StructureIndex::Allocate() {
+  m_random ^= m_random << 13;
+  m_random ^= m_random >> 17;
+  m_random ^= m_random << 5;
+  Item fresh;
+  fresh.size = 1;
+  fresh.priority = m_random;
+  if (!m_free.empty()) {
+    uint32_t item = m_free.back();
+    m_free.pop_back();
+    m_items[item] = fresh;
+    return item;
+  }
+  m_items.push_back(fresh);
+  return (uint32_t)(m_items.size() - 1);
+}
+
+void StructureIndex::Update(uint32_t item) {
+  Item &node = m_items[item];
+  const Item &left = m_items[node.left], &right = m_items[node.right];
+  node.size = left.size + 1 + right.size;
+  node.sum = Join(Join(left.sum, node.shape), right.sum);
+}
+
+uint32_t StructureIndex::Build(size_t count) {
+  // Cartesian tree of the priorities, in line order: each new line is
+  // the right child of the last line above it in priority
+  std::vector<uint32_t> spine;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t item = Allocate();
+    uint32_t last = 0;
+    while (!spine.empty() &&
+           m_items[spine.back()].priority < m_items[item].priority) {
+      last = spine.back();
+      spine.pop_back();
+      Update(last);
+    }
+    m_items[item].left = last;
+    if (!spine.empty())
+      m_items[spine.back()].right = item;
+    spine.push_back(item);
+  }
+  while (spine.size() > 1) {
+    Update(spine.back());
+    spine.pop_back();
+  }
+  if (spine.empty())
+    return 0;
+  Update(spine[0]);
+  return spine[0];
+}
+
+void StructureIndex::Free(uint32_t item) {
+  if (item == 0)
+    return;
+  Free(m_items[item].left);
+  Free(m_items[item].right);
+  m_free.push_back(item);
+}
+
+void StructureIndex::Split(uint32_t tree, size_t count, uint32_t &left,
+                           uint32_t &right) {
+  if (tree == 0) {
+    left = right = 0;
+    return;
+  }
+  Item &node = m_items[tree];
+  if (count <= m_items[node.left].size) {
+    Split(node.left, count, left, m_items[tree].left);
+    right = tree;
+  } else {
+    Split(node.right, count - m_items[node.left].size - 1,
+          m_items[tree].right, right);
+    left = tree;
+  }
+  Update(tree);
+}
+
+uint32_t StructureIndex::Merge(uint32_t left, uint32_t right) {
+  if (left == 0 || right == 0)
+    return left | right;
+  if (m_items[left].priority > m_items[right].priority) {
+    uint32_t merged = Merge(m_items[left].right, right);
+    m_items[left].right = merged;
+    Update(left);
+    return left;
+  }
+  uint32_t merged = Merge(left, m_items[right].left);
+  m_items[right].left = merged;
+  Update(right);
+  return right;
+}
+
+const LineShape &StructureIndex::Shape(size_t line) const {
+  uint32_t item = m_root;
+  for (;;) {
+    const Item &node = m_items[item];
+    size_t before = m_items[node.left].size;
+    if (line == before)
+      return node.shape;
+    if (line < before) {
+      item = node.left;
+    } else {
+      line -= before + 1;
+      item = node.right;
+    }
+  }
+}
+
+void StructureIndex::Set(uint32_t item, size_t line, const LineShape &shape) {
+  size_t before = m_items[m_items[item].left].size;
+  if (line < before)
+    Set(m_items[item].left, line, shape);
+  else if (line > before)
+    Set(m_items[item].right, line - before - 1, shape);
+  else
+    m_items[item].shape = shape;
+  Update(item);
+}
+
+void StructureIndex::Set(size_t line, const LineShape &shape) {
+  Set(m_root, line, shape);
+}
+
+void StructureIndex::Assign(uint32_t item, const std::vector<LineShape> &shapes,
+                            size_t &next) {
+  if (item == 0)
+    return;
+  Assign(m_items[item].left, shapes, next);
+  m_items[item].shape = shapes[next++];
+  Assign(m_items[item].right, shapes, next);
+  Update(item);
+}
+
+void StructureIndex::Set(size_t first, const std::vector<LineShape> &shapes) {
+  uint32_t before, rest, range, after;
+  Split(m_root, first, before, rest);
+  Split(rest, shapes.size(), range, after);
+  size_t next = 0;
+  Assign(range, shapes, next);
+  m_root = Merge(Merge(before, range), after);
+}
+
+void StructureIndex::Edit(size_t first, size_t removed, size_t added) {
+  if (added == removed) {
+    for (size_t line = first; line < first + added; line++)
+      Set(line, LineShape());
+    return;
+  }
+  uint32_t before, rest, gone, after;
+  Split(m_root, first, before, rest);
+  Split(rest, removed, gone, after);
+  Free(gone);
+  m_root = Merge(Merge(before, Build(added)), after);
+}
+
+size_t StructureIndex::Forward(uint32_t item, size_t lo, size_t from,
+                               size_t end, int32_t &balance) const {
+  const Item &node = m_items[item];
+  if (item == 0 || lo + node.size <= from || lo >= end)
+    return kNone;
+  if (from <= lo && lo + node.size <= end && balance + node.sum.low > 0) {
+    balance += node.sum.net; // Never falls to 0 in here
+    return kNone;
+  }
+  size_t found = Forward(node.left, lo, from, end, balance);
+  if (found != kNone)
+    return found;
+  size_t line = lo + m_items[node.left].size;
+  if (line >= from && line < end) {
+    if (balance + node.shape.low <= 0)
+      return line;
+    balance += node.shape.net;
+  }
+  return Forward(node.right, line + 1, from, end, balance);
+}
+
+size_t StructureIndex::Backward(uint32_t item, size_t lo, size_t before,
+                                int32_t &balance) const {
+  const Item &node = m_items[item];
+  if (item == 0 || lo >= before)
+    return kNone;
+  if (lo + node.size <= before &&
+      balance + node.sum.low - node.sum.net > 0) {
+    balance -= node.sum.net;
+    return kNone;
+  }
+  size_t line = lo + m_items[node.left].size;
+  size_t found = Backward(node.right, line + 1, before, balance);
+  if (found != kNone)
+    return found;
+  if (line < before) {
+    if (balance + node.shape.low - node.shape.net <= 0)
+      return line;
+    balance -= node.shape.net;
+  }
+  return Backward(node.left, lo, before, balance);
+}
+
+size_t StructureIndex::FirstAtMost(uint32_t item, size_t lo, size_t from,
+                                   size_t end, int32_t indent) const {
+  const Item &node = m_items[item];
+  if (item == 0 || lo + node.size <= from || lo >= end ||
+      node.sum.indent < 0 || node.sum.indent > indent)
+    return kNone;
+  size_t found = FirstAtMost(node.left, lo, from, end, indent);
+  if (found != kNone)
+    return found;
+  size_t line = lo + m_items[node.left].size;
+  if (line >= from && line < end && node.shape.indent >= 0 &&
+      node.shape.indent <= indent)
+    return line;
+  return FirstAtMost(node.right, line + 1, from, end, indent);
+}
+
+size_t StructureIndex::LastBelow(uint32_t item, size_t lo, size_t before,
+                                 int32_t indent) const {
+  const Item &node = m_items[item];
+  if (item == 0 || lo >= before || node.sum.indent < 0 ||
+      node.sum.indent >= indent)
+    return kNone;
+  size_t line = lo + m_items[node.left].size;
+  size_t found = LastBelow(node.right, line + 1, before, indent);
+  if (found != kNone)
+    return found;
+  if (line < before && node.shape.indent >= 0 && node.shape.indent < indent)
+    return line;
+  return LastBelow(node.left, lo, before, indent);
+}
+
+size_t StructureIndex::FindClose(size_t line, int32_t &open,
+                                 size_t end) const {
+  end = std::min(end, LineCount());
+  if (open <= 0 || line + 1 >= end)
+    return kNone;
+  return Forward(m_root, 0, line + 1, end, open);
+}
+
+size_t StructureIndex::FindOpen(size_t line, int32_t &close) const {
+  line = std::min(line, LineCount());
+  if (close <= 0 || line == 0)
+    return kNone;
+  return Backward(m_root, 0, line, close);
+}
+
+size_t StructureIndex::FindOutdent(size_t line, int32_t indent,
+                                   size_t end) const {
+  end = std::min(end, LineCount());
+  if (line + 1 >= end)
+    return kNone;
+  return FirstAtMost(m_root, 0, line + 1, end, indent);
+}
+
+size_t StructureIndex::FindParent(size_t line, int32_t indent) const {
+  line = std::min(line, LineCount());
+  if (line == 0)
+    return kNone;
+  return LastBelow(m_root, 0, line, indent);
+}
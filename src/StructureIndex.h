@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bracket balance and indentation of one line as the lexer saw it, so
+// brackets inside strings and comments do not count. Counted back from
+// the line's end, with closing brackets up, the lowest balance is
+// low - net.
+struct LineShape {
+  static const int32_t kNoContent = -1; // Blank or comment-only line
+  static const int32_t kInScalar = -2;  // Inside a multi-line scalar
+
+  int32_t net = 0; // Opening minus closing brackets
+  int32_t low = 0; // Lowest balance from the line start, at most 0
+  // Column of the first token, one more for a "- " or "? " entry so that
+  // it nests under a key at its own column; negative for no content.
+  int32_t indent = kNoContent;
+};
+
+// Lines [first, last] of a foldable block: from a bracket to the line of
+// its match, or a YAML line and the lines indented under it.
+struct FoldRange {
+  size_t first, last;
+};
+
+// Line shapes of a document in a balanced tree keyed by line position (a
+// treap whose nodes also join the shapes under them), so the line holding
+// a bracket's match or ending an indented block is found in O(log n)
+// however far away it is.
+//
+// Shapes are set as lines are lexed, each updating the nodes above its
+// own. Inserting or removing lines splits the tree at the edit and joins
+// it back around the new lines, in O(log n) plus the lines added or
+// removed, so pressing Enter in a large file does not rebuild anything.
+class StructureIndex {
+public:
+  static const size_t kNone = SIZE_MAX;
+
+  explicit StructureIndex(size_t lines = 1);
+
+  size_t LineCount() const { return m_items[m_root].size; }
+  const LineShape &Shape(size_t line) const;
+  void Set(size_t line, const LineShape &shape);
+  // Shapes of lines [first, first + shapes.size()), in O(log n) plus their
+  // count rather than that many times O(log n)
+  void Set(size_t first, const std::vector<LineShape> &shapes);
+  // Lines [first, first + removed) were replaced by added lines.
+  void Edit(size_t first, size_t removed, size_t added);
+
+  // Each query looks at lines [0, end) only and returns kNone if nothing
+  // there qualifies.
+  // First line after line where a balance of open, counted from the start
+  // of the next line, falls to 0: where the outermost of open brackets
+  // left open on line closes. open is left as the balance at the start of
+  // the line found.
+  size_t FindClose(size_t line, int32_t &open, size_t end) const;
+  // Last line before line where close brackets still unmatched at its
+  // start, counted back from there, are all opened; close is left as the
+  // count at the end of the line found.
+  size_t FindOpen(size_t line, int32_t &close) const;
+  // First line after line with content indented at most indent.
+  size_t FindOutdent(size_t line, int32_t indent, size_t end) const;
+  // Last line before line with content indented less than indent.
+  size_t FindParent(size_t line, int32_t indent) const;
+
+private:
+  struct Item {
+    LineShape shape; // The line's own
+    LineShape sum;   // Joined over the subtree, in line order
+    uint32_t left = 0, right = 0; // 0 for none
+    uint32_t size = 0;            // Lines in the subtree
+    uint32_t priority = 0;        // Above those of the children
+  };
+
+  static LineShape Join(const LineShape &left, const LineShape &right);
+  uint32_t Allocate();
+  void Update(uint32_t item);
+  // Items of count blank lines, joined into a tree
+  uint32_t Build(size_t count);
+  void Free(uint32_t item);
+  // Splits tree into its first count lines and the rest
+  void Split(uint32_t tree, size_t count, uint32_t &left, uint32_t &right);
+  uint32_t Merge(uint32_t left, uint32_t right);
+  void Set(uint32_t item, size_t line, const LineShape &shape);
+  // Sets the subtree's shapes in line order from shapes[next]
+  void Assign(uint32_t item, const std::vector<LineShape> &shapes,
+              size_t &next);
+
+  // lo is the first line of the subtree at item
+  size_t Forward(uint32_t item, size_t lo, size_t from, size_t end,
+                 int32_t &balance) const;
+  size_t Backward(uint32_t item, size_t lo, size_t before,
+                  int32_t &balance) const;
+  size_t FirstAtMost(uint32_t item, size_t lo, size_t from, size_t end,
+                     int32_t indent) const;
+  size_t LastBelow(uint32_t item, size_t lo, size_t before,
+                   int32_t indent) const;
+
+  // Item 0 stands for an empty subtree: size 0, and a sum that joins as
+  // nothing
+  std::vector<Item> m_items;
+  std::vector<uint32_t> m_free; // Items of removed lines, for reuse
+  uint32_t m_root = 0;
+  uint32_t m_random = 2463534242u; // xorshift state for priorities
+};
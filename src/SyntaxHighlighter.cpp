@@ -0,0 +1,650 @@
+#include "SyntaxHighlighter.h"
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+
+// Kept for lines inside an edit, which no lexer state equals, so lexing
+// never stops early on one.
+static const uint32_t kUnknown = UINT32_MAX;
+
+static const uint32_t kJsonComment = 1; // Inside /* ... */
+
+// YAML state: what the line starts in (2 bits), the flow collection depth
+// (8 bits) and, in a block scalar, the indentation its lines must exceed
+// (22 bits, so no state is kUnknown).
+enum YamlKind : uint32_t { kYamlPlain, kYamlBlock, kYamlDouble, kYamlSingle };
+
+static uint32_t YamlState(uint32_t kind, size_t depth, size_t indent) {
+  return kind | (uint32_t)std::min<size_t>(depth, 255) << 2 |
+         (uint32_t)std::min<size_t>(indent, 0x1FFFFF) << 10;
+}
+
+static void Add(std::vector<TokenRun> *runs, size_t line, size_t begin,
+                size_t end, TokenRun::Kind kind) {
+  if (runs && end > begin)
+    runs->push_back({line, begin, end - begin, kind});
+}
+
+static void Bracket(LineShape *shape, int32_t delta) {
+  if (shape) {
+    shape->net += delta;
+    shape->low = std::min(shape->low, shape->net);
+  }
+}
+
+static void Indent(LineShape *shape, size_t column) {
+  if (shape && shape->indent == LineShape::kNoContent)
+    shape->indent = (int32_t)std::min<size_t>(column, INT32_MAX);
+}
+
+static bool IsSpace(wchar_t c) { return c == L' ' || c == L'\t'; }
+static bool IsDigit(wchar_t c) { return c >= L'0' && c <= L'9'; }
+static bool IsFlowChar(wchar_t c) {
+  return c == L',' || c == L'[' || c == L']' || c == L'{' || c == L'}';
+}
+
+// Index just past the quote closing the string whose contents start at
+// from, or the line's end if it is not closed there.
+static size_t QuoteEnd(std::wstring_view s, size_t from, wchar_t quote,
+                       bool &closed) {
+  size_t n = s.size();
+  for (size_t i = from; i < n; i++) {
+    if (quote == L'"' && s[i] == L'\\') {
+      i++;
+    } else if (s[i] == quote) {
+      if (quote == L'\'' && i + 1 < n && s[i + 1] == L'\'') {
+        i++; // '' is a quote inside a single-quoted scalar
+        continue;
+      }
+      closed = true;
+      return i + 1;
+    }
+  }
+  closed = false;
+  return n;
+}
+
+// Decimal, hexadecimal and octal numbers, and YAML's .inf and .nan.
+static bool IsNumber(std::wstring_view w) {
+  size_t i = 0, n = w.size();
+  if (i < n && (w[i] == L'-' || w[i] == L'+'))
+    i++;
+  std::wstring_view rest = w.substr(i);
+  if (rest == L".inf" || rest == L".Inf" || rest == L".INF")
+    return true;
+  if (i == 0 && (rest == L".nan" || rest == L".NaN" || rest == L".NAN"))
+    return true;
+  if (rest.size() > 2 && rest[0] == L'0' &&
+      (rest[1] == L'x' || rest[1] == L'o')) {
+    for (size_t k = 2; k < rest.size(); k++)
+      if (!iswxdigit(rest[k]) || (rest[1] == L'o' && rest[k] > L'7'))
+        return false;
+    return true;
+  }
+  bool digits = false;
+  while (i < n && IsDigit(w[i]))
+    i++, digits = true;
+  if (i < n && w[i] == L'.') {
+    i++;
+    while (i < n && IsDigit(w[i]))
+      i++, digits = true;
+  }
+  if (digits && i < n && (w[i] == L'e' || w[i] == L'E')) {
+    i++;
+    if (i < n && (w[i] == L'-' || w[i] == L'+'))
+      i++;
+    if (i == n || !IsDigit(w[i]))
+      return false;
+    while (i < n && IsDigit(w[i]))
+      i++;
+  }
+  return digits && i == n;
+}
+
+static bool IsJsonLiteral(std::wstring_view w) {
+  return w == L"true" || w == L"false" || w == L"null";
+}
+
+static bool IsYamlLiteral(std::wstring_view w) {
+  return IsJsonLiteral(w) || w == L"~" || w == L"True" || w == L"TRUE" ||
+         w == L"False" || w == L"FALSE" || w == L"Null" || w == L"NULL";
+}
+
+// The shape of a line without comments, skipping over strings.
+static void JsonShape(std::wstring_view s, LineShape *shape) {
+  for (size_t i = 0; i < s.size(); i++) {
+    wchar_t c = s[i];
+    if (IsSpace(c))
+      continue;
+    Indent(shape, i);
+    if (c == L'"') {
+      bool closed;
+      i = QuoteEnd(s, i + 1, L'"', closed) - 1;
+    } else if (c == L'{' || c == L'[') {
+      Bracket(shape, 1);
+    } else if (c == L'}' || c == L']') {
+      Bracket(shape, -1);
+    }
+  }
+}
+
+static uint32_t LexJson(std::wstring_view s, uint32_t state, size_t line,
+                        std::vector<TokenRun> *runs, LineShape *shape) {
+  size_t n = s.size(), i = 0;
+  // Only a comment changes the state, so most lines need no tokens
+  if (!runs && state == 0 && !wmemchr(s.data(), L'/', n)) {
+    if (shape)
+      JsonShape(s, shape);
+    return 0;
+  }
+  if (state == kJsonComment) {
+    size_t end = s.find(L"*/");
+    if (end == std::wstring_view::npos) {
+      Add(runs, line, 0, n, TokenRun::COMMENT);
+      return kJsonComment;
+    }
+    Add(runs, line, 0, end + 2, TokenRun::COMMENT);
+    i = end + 2;
+  }
+  while (i < n) {
+    wchar_t c = s[i];
+    size_t start = i;
+    TokenRun::Kind kind;
+    if (IsSpace(c)) {
+      i++;
+      continue;
+    }
+    if (c != L'/')
+      Indent(shape, i);
+    if (c == L'"') {
+      bool closed;
+      i = QuoteEnd(s, i + 1, L'"', closed);
+      size_t next = i;
+      while (next < n && IsSpace(s[next]))
+        next++;
+      kind = next < n && s[next] == L':' ? TokenRun::KEY : TokenRun::STRING;
+    } else if (c == L'-' || IsDigit(c)) {
+      i++;
+      while (i < n && (IsDigit(s[i]) || s[i] == L'.' || s[i] == L'e' ||
+                       s[i] == L'E' || s[i] == L'+' || s[i] == L'-'))
+        i++;
+      kind = TokenRun::NUMBER;
+    } else if (iswalpha(c)) {
+      while (i < n && iswalnum(s[i]))
+        i++;
+      if (!IsJsonLiteral(s.substr(start, i - start)))
+        continue;
+      kind = TokenRun::LITERAL;
+    } else if (c == L'/' && i + 1 < n && s[i + 1] == L'/') {
+      Add(runs, line, i, n, TokenRun::COMMENT);
+      break;
+    } else if (c == L'/' && i + 1 < n && s[i + 1] == L'*') {
+      size_t end = s.find(L"*/", i + 2);
+      if (end == std::wstring_view::npos) {
+        Add(runs, line, i, n, TokenRun::COMMENT);
+        return kJsonComment;
+      }
+      i = end + 2;
+      kind = TokenRun::COMMENT;
+    } else if (IsFlowChar(c) || c == L':') {
+      if (c == L'{' || c == L'[')
+        Bracket(shape, 1);
+      else if (c == L'}' || c == L']')
+        Bracket(shape, -1);
+      i++;
+      kind = TokenRun::PUNCTUATION;
+    } else {
+      i++;
+      continue;
+    }
+    Add(runs, line, start, i, kind);
+  }
+  return 0;
+}
+
+static uint32_t LexYaml(std::wstring_view s, uint32_t state, size_t line,
+                        std::vector<TokenRun> *runs, LineShape *shape) {
+  size_t n = s.size(), i = 0;
+  uint32_t kind = state & 3;
+  size_t depth = (state >> 2) & 255;
+  size_t indent = 0;
+  while (indent < n && s[indent] == L' ')
+    indent++;
+
+  if (kind == kYamlBlock) {
+    // Blank lines and lines indented past the header's belong to the scalar
+    if (indent == n || indent > (state >> 10)) {
+      Add(runs, line, indent, n, TokenRun::STRING);
+      if (shape)
+        shape->indent = LineShape::kInScalar;
+      return state;
+    }
+  } else if (kind == kYamlDouble || kind == kYamlSingle) {
+    if (shape)
+      shape->indent = LineShape::kInScalar;
+    bool closed;
+    i = QuoteEnd(s, 0, kind == kYamlDouble ? L'"' : L'\'', closed);
+    Add(runs, line, 0, i, TokenRun::STRING);
+    if (!closed)
+      return state;
+  } else if (depth == 0 && n >= 3 && (s.substr(0, 3) == L"---" ||
+                                      s.substr(0, 3) == L"...") &&
+             (n == 3 || IsSpace(s[3]))) {
+    Add(runs, line, 0, 3, TokenRun::DIRECTIVE);
+    Indent(shape, 0);
+    i = 3;
+  } else if (depth == 0 && n > 0 && s[0] == L'%') {
+    Add(runs, line, 0, n, TokenRun::DIRECTIVE);
+    Indent(shape, 0);
+    return 0;
+  }
+
+  // A block scalar header ends the line; its lines must be indented past
+  // the key it is the value of, or past the line's indentation
+  bool block = false;
+  size_t parent = indent;
+  while (i < n) {
+    wchar_t c = s[i];
+    size_t start = i;
+    bool spaceBefore = i == 0 || IsSpace(s[i - 1]);
+    bool spaceAfter = i + 1 >= n || IsSpace(s[i + 1]);
+    TokenRun::Kind token;
+    if (IsSpace(c)) {
+      i++;
+      continue;
+    } else if (c == L'#' && spaceBefore) {
+      Add(runs, line, i, n, TokenRun::COMMENT);
+      break;
+    }
+    // An entry's content nests past its indicator, like a key's value
+    Indent(shape, (c == L'-' || c == L'?') && spaceAfter ? i + 1 : i);
+    if ((c == L'-' || c == L'?' || c == L':') && spaceAfter) {
+      i++;
+      token = TokenRun::PUNCTUATION;
+    } else if (c == L'{' || c == L'[') {
+      depth = std::min<size_t>(depth + 1, 255);
+      Bracket(shape, 1);
+      i++;
+      token = TokenRun::PUNCTUATION;
+    } else if (c == L'}' || c == L']') {
+      if (depth > 0)
+        depth--;
+      Bracket(shape, -1);
+      i++;
+      token = TokenRun::PUNCTUATION;
+    } else if (c == L',' && depth > 0) {
+      i++;
+      token = TokenRun::PUNCTUATION;
+    } else if ((c == L'&' || c == L'*' || c == L'!') && !spaceAfter) {
+      i++;
+      while (i < n && !IsSpace(s[i]) && !(depth > 0 && IsFlowChar(s[i])))
+        i++;
+      token = c == L'!' ? TokenRun::TAG : TokenRun::ANCHOR;
+    } else if (c == L'"' || c == L'\'') {
+      bool closed;
+      i = QuoteEnd(s, i + 1, c, closed);
+      if (!closed) {
+        Add(runs, line, start, n, TokenRun::STRING);
+        return YamlState(c == L'"' ? kYamlDouble : kYamlSingle, depth, 0);
+      }
+      size_t next = i;
+      while (next < n && IsSpace(s[next]))
+        next++;
+      bool key = next < n && s[next] == L':' &&
+                 (depth > 0 || next + 1 >= n || IsSpace(s[next + 1]));
+      if (key)
+        parent = start;
+      token = key ? TokenRun::KEY : TokenRun::STRING;
+    } else if ((c == L'|' || c == L'>') && depth == 0) {
+      i++;
+      while (i < n && (s[i] == L'+' || s[i] == L'-' || IsDigit(s[i])))
+        i++;
+      block = true;
+      token = TokenRun::PUNCTUATION;
+    } else {
+      // Plain scalar: up to ": ", " #" or, in a flow collection, an
+      // indicator
+      size_t end = i;
+      while (end < n) {
+        wchar_t d = s[end];
+        if (d == L':' && (end + 1 >= n || IsSpace(s[end + 1]) ||
+                          (depth > 0 && IsFlowChar(s[end + 1]))))
+          break;
+        if (d == L'#' && end > i && IsSpace(s[end - 1]))
+          break;
+        if (depth > 0 && IsFlowChar(d))
+          break;
+        end++;
+      }
+      if (end == i) {
+        i++;
+        continue;
+      }
+      size_t textEnd = end;
+      while (textEnd > i && IsSpace(s[textEnd - 1]))
+        textEnd--;
+      i = end;
+      std::wstring_view word = s.substr(start, textEnd - start);
+      if (end < n && s[end] == L':') {
+        parent = start;
+        token = TokenRun::KEY;
+      } else if (IsNumber(word)) {
+        token = TokenRun::NUMBER;
+      } else if (IsYamlLiteral(word)) {
+        token = TokenRun::LITERAL;
+      } else {
+        continue; // Plain text
+      }
+      Add(runs, line, start, textEnd, token);
+      continue;
+    }
+    Add(runs, line, start, i, token);
+  }
+  return block ? YamlState(kYamlBlock, depth, parent)
+               : YamlState(kYamlPlain, depth, 0);
+}
+
+uint32_t SyntaxHighlighter::LexLine(Language language, std::wstring_view text,
+                                    uint32_t state, size_t line,
+                                    std::vector<TokenRun> *runs,
+                                    LineShape *shape) {
+  switch (language) {
+  case JSON:
+    return LexJson(text, state, line, runs, shape);
+  case YAML:
+    return LexYaml(text, state, line, runs, shape);
+  default:
+    return 0;
+  }
+}
+
+SyntaxHighlighter::SyntaxHighlighter(Language language, size_t lines)
+    : m_language(language), m_states(std::max<size_t>(lines, 1), kUnknown),
+      m_structure(m_states.size()) {
+  m_states[0] = 0;
+}
+
+void SyntaxHighlighter::Edit(size_t first, size_t removed, size_t added) {
+  first = std::min(first, m_states.size() - 1);
+  removed = std::max<size_t>(std::min(removed, m_states.size() - first), 1);
+  added = std::max<size_t>(added, 1);
+
+  // The states of the new lines are unknown; those after them are the old
+  // ones, kept as candidates
+  auto at = m_states.begin() + first + 1;
+  if (added > removed)
+    m_states.insert(at, added - removed, kUnknown);
+  else
+    m_states.erase(at, at + (removed - added));
+  std::fill(m_states.begin() + first + 1, m_states.begin() + first + added,
+            kUnknown);
+  m_structure.Edit(first, removed, added);
+
+  auto shift = [&](size_t line) {
+    if (line <= first)
+      return line;
+    if (line < first + removed)
+      return first;
+    return line + added - removed;
+  };
+  m_valid = std::min(m_valid, first);
+  m_lexed = m_lexed < first + removed ? std::min(m_lexed, first)
+                                      : m_lexed + added - removed;
+  for (size_t &edit : m_edits)
+    edit = shift(edit);
+  m_edits.push_back(first);
+  std::sort(m_edits.begin(), m_edits.end());
+  m_edits.erase(std::unique(m_edits.begin(), m_edits.end()), m_edits.end());
+}
+
+void SyntaxHighlighter::LexTo(size_t line, const LineReader &read) {
+  // Up to the line count, past the last state, for the last line's shape
+  line = std::min(line, m_states.size());
+  // Shapes of the lines lexed in a row, set together
+  std::vector<LineShape> shapes;
+  size_t shapesFirst = m_valid;
+  while (m_valid < line) {
+    size_t current = m_valid;
+    auto passed = std::upper_bound(m_edits.begin(), m_edits.end(), current);
+    m_edits.erase(m_edits.begin(), passed);
+    LineShape shape;
+    uint32_t state = LexLine(m_language, read(current), m_states[current],
+                             current, nullptr, &shape);
+    shapes.push_back(shape);
+    size_t next = current + 1;
+    if (next <= m_lexed && m_states[next] == state) {
+      // Back in step with the old states, which hold up to the next edit,
+      // as do the shapes of the lines before them
+      size_t end = m_edits.empty() ? m_lexed : std::min(m_lexed, m_edits[0]);
+      m_valid = std::max(next, end);
+      m_structure.Set(shapesFirst, shapes);
+      shapes.clear();
+      shapesFirst = m_valid;
+      continue;
+    }
+    m_valid = next;
+    if (next < m_states.size()) {
+      m_states[next] = state;
+      m_lexed = std::max(m_lexed, next);
+    }
+  }
+  if (!shapes.empty())
+    m_structure.Set(shapesFirst, shapes);
+  // The old states past a stop short of them no longer follow from the
+  // last one written, so lexing must not skip past it
+  if (m_valid < m_lexed && (m_edits.empty() || m_edits[0] != m_valid))
+    m_edits.insert(m_edits.begin(), m_valid);
+}
+
+std::vector<TokenRun> SyntaxHighlighter::Runs(size_t first, size_t last,
+                                              const LineReader &read) {
+  std::vector<TokenRun> runs;
+  last = std::min(last, m_states.size());
+  if (m_language == NONE || first >= last)
+    return runs;
+  LexTo(last - 1, read);
+  for (size_t line = first; line < last; line++)
+    LexLine(m_language, read(line), m_states[line], line, &runs);
+  return runs;
+}
+
+std::vector<std::pair<size_t, int32_t>>
+SyntaxHighlighter::Brackets(size_t line, const LineReader &read) {
+  std::vector<TokenRun> runs;
+  LexLine(m_language, read(line), m_states[line], line, &runs);
+  std::wstring_view text = read(line);
+  std::vector<std::pair<size_t, int32_t>> brackets;
+  for (const TokenRun &run : runs) {
+    if (run.kind != TokenRun::PUNCTUATION || run.length != 1)
+      continue;
+    wchar_t c = text[run.column];
+    if (c == L'{' || c == L'[')
+      brackets.push_back({run.column, 1});
+    else if (c == L'}' || c == L']')
+      brackets.push_back({run.column, -1});
+  }
+  return brackets;
+}
+
+bool SyntaxHighlighter::MatchBracket(size_t line, size_t column, size_t end,
+                                     const LineReader &read,
+                                     size_t &matchLine, size_t &matchColumn) {
+  end = std::min(end, m_states.size());
+  if (m_language == NONE || line >= end)
+    return false;
+  LexTo(end, read);
+  auto brackets = Brackets(line, read);
+  auto at = std::find_if(brackets.begin(), brackets.end(),
+                         [&](const auto &b) { return b.first == column; });
+  if (at == brackets.end())
+    return false; // Not a bracket, or one in a string or comment
+  int32_t direction = at->second, balance = 0;
+  auto scan = [&](const std::vector<std::pair<size_t, int32_t>> &in,
+                  size_t from) {
+    // Brackets in the search direction from index from, until the first
+    // bracket, which opened it all, is matched
+    for (size_t k = from; k < in.size(); k++) {
+      const auto &b = direction > 0 ? in[k] : in[in.size() - 1 - k];
+      balance += b.second * direction;
+      if (balance == 0) {
+        matchColumn = b.first;
+        return true;
+      }
+    }
+    return false;
+  };
+  size_t index = at - brackets.begin();
+  matchLine = line;
+  if (scan(brackets, direction > 0 ? index : brackets.size() - 1 - index))
+    return true;
+  matchLine = direction > 0 ? m_structure.FindClose(line, balance, end)
+                            : m_structure.FindOpen(line, balance);
+  return matchLine != StructureIndex::kNone &&
+         scan(Brackets(matchLine, read), 0);
+}
+
+bool SyntaxHighlighter::EnclosingBrackets(size_t line, size_t column,
+                                          const LineReader &read,
+                                          size_t &openLine,
+                                          size_t &openColumn,
+                                          size_t &closeLine,
+                                          size_t &closeColumn) {
+  size_t count = m_states.size();
+  if (m_language == NONE || line >= count)
+    return false;
+  LexTo(count, read);
+  // Back from column: closing brackets there still to be opened, plus the
+  // one around it all
+  int32_t balance = 1;
+  openLine = line;
+  auto brackets = Brackets(line, read);
+  auto open = brackets.rend();
+  for (auto it = brackets.rbegin(); it != brackets.rend(); ++it) {
+    if (it->first > column || (it->first == column && it->second < 0))
+      continue;
+    balance -= it->second;
+    if (balance == 0) {
+      open = it;
+      break;
+    }
+  }
+  if (open == brackets.rend()) {
+    openLine = m_structure.FindOpen(line, balance);
+    if (openLine == StructureIndex::kNone)
+      return false;
+    brackets = Brackets(openLine, read);
+    for (open = brackets.rbegin(); open != brackets.rend(); ++open) {
+      balance -= open->second;
+      if (balance == 0)
+        break;
+    }
+    if (open == brackets.rend())
+      return false;
+  }
+  openColumn = open->first;
+  if (!MatchBracket(openLine, openColumn, count, read, closeLine,
+                    closeColumn))
+    return false;
+  // The index counts { and [ alike
+  wchar_t opening = read(openLine)[openColumn];
+  return read(closeLine)[closeColumn] == (opening == L'{' ? L'}' : L']');
+}
+
+size_t SyntaxHighlighter::BlockEnd(size_t line, size_t end) {
+  // A block still open at end goes to the last line, or is cut at end
+  size_t open = end == m_states.size() ? end - 1 : end;
+  const LineShape &shape = m_structure.Shape(line);
+  if (m_language == JSON) {
+    int32_t balance = shape.net - shape.low;
+    if (balance <= 0)
+      return StructureIndex::kNone;
+    size_t close = m_structure.FindClose(line, balance, end);
+    return close != StructureIndex::kNone ? close : open;
+  }
+  if (shape.indent < 0)
+    return StructureIndex::kNone;
+  size_t next = m_structure.FindOutdent(line, shape.indent, end);
+  if (next == StructureIndex::kNone && end < m_states.size())
+    return end;
+  size_t last = next == StructureIndex::kNone ? open : next - 1;
+  // Blank and comment lines before the next block are not this one's
+  while (last > line &&
+         m_structure.Shape(last).indent == LineShape::kNoContent)
+    last--;
+  return last > line ? last : StructureIndex::kNone;
+}
+
+bool SyntaxHighlighter::Block(size_t line, const LineReader &read,
+                              FoldRange &range) {
+  size_t count = m_states.size();
+  if (m_language == NONE || line >= count)
+    return false;
+  LexTo(count, read);
+  size_t last = BlockEnd(line, count);
+  if (last != StructureIndex::kNone) {
+    range = {line, last};
+    return true;
+  }
+  if (m_language == JSON) {
+    int32_t balance = 1;
+    size_t open = m_structure.FindOpen(line, balance);
+    if (open == StructureIndex::kNone)
+      return false;
+    size_t close = m_structure.FindClose(line - 1, balance = 1, count);
+    range = {open, close != StructureIndex::kNone ? close : count - 1};
+    return true;
+  }
+  int32_t indent = m_structure.Shape(line).indent;
+  size_t parent = m_structure.FindParent(line, indent < 0 ? INT32_MAX : indent);
+  for (; parent != StructureIndex::kNone;
+       parent = m_structure.FindParent(parent,
+                                       m_structure.Shape(parent).indent)) {
+    last = BlockEnd(parent, count);
+    if (last != StructureIndex::kNone && last >= line) {
+      range = {parent, last};
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<FoldRange> SyntaxHighlighter::FoldRanges(size_t first,
+                                                     size_t last,
+                                                     const LineReader &read) {
+  std::vector<FoldRange> ranges;
+  last = std::min(last, m_states.size());
+  if (m_language == NONE || first >= last)
+    return ranges;
+  LexTo(last, read);
+  // Around first, innermost first until reversed
+  if (m_language == JSON) {
+    for (int32_t depth = 1;; depth++) {
+      int32_t balance = depth;
+      size_t open = m_structure.FindOpen(first, balance);
+      if (open == StructureIndex::kNone)
+        break;
+      size_t close = m_structure.FindClose(first - 1, balance = depth, last);
+      if (close == StructureIndex::kNone)
+        close = last == m_states.size() ? last - 1 : last;
+      ranges.push_back({open, close});
+    }
+  } else {
+    int32_t indent = m_structure.Shape(first).indent;
+    size_t parent =
+        m_structure.FindParent(first, indent < 0 ? INT32_MAX : indent);
+    for (; parent != StructureIndex::kNone;
+         parent = m_structure.FindParent(parent,
+                                         m_structure.Shape(parent).indent)) {
+      size_t end = BlockEnd(parent, last);
+      if (end != StructureIndex::kNone && end >= first)
+        ranges.push_back({parent, end});
+    }
+  }
+  std::reverse(ranges.begin(), ranges.end());
+  for (size_t line = first; line < last; line++) {
+    size_t end = BlockEnd(line, last);
+    if (end != StructureIndex::kNone)
+      ranges.push_back({line, end});
+  }
+  return ranges;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "StructureIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A highlighted stretch of one line; text between runs is plain.
+struct TokenRun {
+  enum Kind : uint8_t {
+    KEY,
+    STRING,
+    NUMBER,
+    LITERAL, // true, false, null
+    PUNCTUATION,
+    COMMENT,
+    ANCHOR,   // YAML &anchor and *alias
+    TAG,      // YAML !tag
+    DIRECTIVE // YAML %directive and the --- / ... document markers
+  };
+  size_t line;
+  size_t column, length; // UTF-16 units within the line
+  Kind kind;
+};
+
+// Incremental JSON and YAML lexer for highlighting.
+//
+// The lexer state at the start of every line is kept (4 bytes a line).
+// An edit marks the changed lines; lines are lexed again lazily, only when
+// a line at or after the edit is asked for, and only until the state at a
+// line start comes out equal to the one kept from before the edit. From
+// there on the old states hold up to the next edit, so typing in a large
+// file re-lexes a line or two. Runs are produced only for the lines asked
+// for, the visible ones.
+//
+// Strings cannot span lines in JSON, so its only state is being inside a
+// /* comment */. YAML keeps block scalars (| and >) with the indentation
+// that ends them, quoted scalars continued on the next line, and the depth
+// of flow collections.
+//
+// Lexing a line also gives its shape, kept in a StructureIndex, so bracket
+// matching and fold ranges come from the same incremental pass.
+class SyntaxHighlighter {
+public:
+  enum Language { NONE, JSON, YAML };
+  // Text of a line without its line break; valid until the next call.
+  typedef std::function<std::wstring_view(size_t line)> LineReader;
+
+  explicit SyntaxHighlighter(Language language = NONE, size_t lines = 1);
+
+  Language GetLanguage() const { return m_language; }
+  size_t LineCount() const { return m_states.size(); }
+
+  // Lines [first, first + removed) were replaced by added lines (both at
+  // least 1). Overstating the range is safe; it only lexes more.
+  void Edit(size_t first, size_t removed, size_t added);
+  // Runs of lines [first, last), in order.
+  std::vector<TokenRun> Runs(size_t first, size_t last,
+                             const LineReader &read);
+
+  // The bracket matching the one at column of line, if there is one there
+  // and its match is in lines [0, end).
+  bool MatchBracket(size_t line, size_t column, size_t end,
+                    const LineReader &read, size_t &matchLine,
+                    size_t &matchColumn);
+  // The innermost brackets around column of line, a bracket right at
+  // column counting as inside; false if there are none or they do not
+  // match.
+  bool EnclosingBrackets(size_t line, size_t column, const LineReader &read,
+                         size_t &openLine, size_t &openColumn,
+                         size_t &closeLine, size_t &closeColumn);
+  // The block starting at line, or else the innermost one around it.
+  bool Block(size_t line, const LineReader &read, FoldRange &range);
+  // The blocks around line first, outermost first, then those starting in
+  // lines [first, last); one going past last ends at last.
+  std::vector<FoldRange> FoldRanges(size_t first, size_t last,
+                                    const LineReader &read);
+
+  // Lexes one line from state and returns the state at the next line;
+  // runs and shape, if given, receive the line's runs and shape.
+  static uint32_t LexLine(Language language, std::wstring_view text,
+                          uint32_t state, size_t line,
+                          std::vector<TokenRun> *runs,
+                          LineShape *shape = nullptr);
+
+private:
+  // Until m_valid >= line, so shapes of lines before it are right too
+  void LexTo(size_t line, const LineReader &read);
+  // Brackets of a lexed line: column, and 1 opening or -1 closing
+  std::vector<std::pair<size_t, int32_t>> Brackets(size_t line,
+                                                   const LineReader &read);
+  // Where the block starting at line ends, looking at lines [0, end)
+  size_t BlockEnd(size_t line, size_t end);
+
+  Language m_language;
+  std::vector<uint32_t> m_states; // At the start of each line
+  StructureIndex m_structure;     // Right for lines before m_valid
+  size_t m_valid = 0; // States [0, m_valid] are right for the text
+  size_t m_lexed = 0; // States past this were never computed
+  // First changed line of each edit past m_valid, and where lexing last
+  // stopped, ascending; states after one are only candidates until lexing
+  // reaches it
+  std::vector<size_t> m_edits;
+};
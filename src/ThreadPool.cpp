@@ -0,0 +1,99 @@
+#include "ThreadPool.h"
+
+// Which pool and worker the current thread belongs to, for Submit.
+static thread_local const ThreadPool *t_pool = nullptr;
+static thread_local unsigned t_worker = 0;
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  for (unsigned i = 0; i < threads; i++)
+    m_queues.emplace_back(new Queue);
+  for (unsigned i = 0; i < threads; i++)
+    m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &worker : m_workers)
+    worker.join();
+}
+
+void ThreadPool::Submit(Task task) {
+  m_pending++;
+  // Counted before it is pushed, so m_queued never drops below the tasks
+  // still in the deques
+  m_queued++;
+  unsigned index = t_pool == this ? t_worker : m_next++ % Size();
+  {
+    std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+    m_queues[index]->tasks.push_back(std::move(task));
+  }
+  // A worker parks only after raising m_sleeping and then seeing m_queued
+  // at 0, so one that missed this task is seen here; under the lock, the
+  // notify cannot fall between its check and its wait.
+  if (m_sleeping > 0) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+  }
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this] { return m_pending == 0; });
+}
+
+// Own deque from the back, then the others from the front.
+bool ThreadPool::TryPop(unsigned index, Task &task) {
+  {
+    Queue &own = *m_queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (unsigned i = 1; i < Size(); i++) {
+    Queue &other = *m_queues[(index + i) % Size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned index) {
+  t_pool = this;
+  t_worker = index;
+  for (;;) {
+    Task task;
+    if (TryPop(index, task)) {
+      m_queued--;
+      task(index);
+      if (--m_pending == 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.notify_all();
+      }
+      continue;
+    }
+    // Every deque was empty; park until a task is counted. One counted but
+    // not pushed yet is found on the next pass.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_sleeping++;
+    m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+    m_sleeping--;
+    if (m_stop && m_queued == 0)
+      return;
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker runs
+// its newest task first and, when its deque is empty, steals the oldest
+// task of another worker, so uneven tasks (one 50 MB file among thousands
+// of 2 KB ones) spread out without every thread contending for one queue.
+//
+// Tasks receive the index of the worker running them, so per-thread state
+// can be kept in a vector of Size() entries. Tasks must not throw.
+class ThreadPool {
+public:
+  typedef std::function<void(unsigned worker)> Task;
+
+  // threads == 0 uses one thread per hardware thread.
+  explicit ThreadPool(unsigned threads = 0);
+  // Runs the tasks already submitted, then joins the workers.
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned Size() const { return (unsigned)m_queues.size(); }
+  // From a worker the task goes to that worker's deque, otherwise to the
+  // deques in turn.
+  void Submit(Task task);
+  // Blocks until every submitted task has finished.
+  void Wait();
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void WorkerLoop(unsigned index);
+  bool TryPop(unsigned index, Task &task);
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_workers;
+  // Only for parking: submitting and running tasks use the counters and
+  // the deques' own locks
+  std::mutex m_mutex;
+  std::condition_variable m_wake; // A task was queued, or stopping
+  std::condition_variable m_idle; // m_pending reached 0
+  std::atomic<size_t> m_queued{0};     // Submitted and not yet popped
+  std::atomic<size_t> m_pending{0};    // Submitted and not yet finished
+  std::atomic<unsigned> m_sleeping{0}; // Workers parked on m_wake
+  std::atomic<unsigned> m_next{0};     // Deque for the next outside task
+  bool m_stop = false;                 // Under m_mutex
+};
@@ -0,0 +1,162 @@
+#include "UnityRefs.h"
+#include "OutputSink.h"
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+#include <string_view>
+
+static bool StartsWith(const wchar_t *p, const wchar_t *end,
+                       const wchar_t *prefix) {
+  size_t n = wcslen(prefix);
+  return (size_t)(end - p) >= n && wmemcmp(p, prefix, n) == 0;
+}
+
+static const wchar_t *SkipSpaces(const wchar_t *p, const wchar_t *end) {
+  while (p < end && (*p == L' ' || *p == L'\t'))
+    p++;
+  return p;
+}
+
+// Parses an optionally signed decimal integer; null if there is none.
+static const wchar_t *ParseInt(const wchar_t *p, const wchar_t *end,
+                               int64_t &value) {
+  bool negative = p < end && *p == L'-';
+  if (negative)
+    p++;
+  const wchar_t *digits = p;
+  uint64_t n = 0;
+  for (; p < end && *p >= L'0' && *p <= L'9'; p++)
+    n = n * 10 + (*p - L'0');
+  if (p == digits || p - digits > 19)
+    return nullptr;
+  value = negative ? -(int64_t)n : (int64_t)n;
+  return p;
+}
+
+// "--- !u!<classID> &<fileID>[ stripped]"
+static bool ParseHeader(const wchar_t *p, const wchar_t *end,
+                        UnityObject &object) {
+  p = SkipSpaces(p + 3, end);
+  if (!StartsWith(p, end, L"!u!"))
+    return false;
+  int64_t classID;
+  p = ParseInt(p + 3, end, classID);
+  if (!p)
+    return false;
+  p = SkipSpaces(p, end);
+  if (p == end || *p != L'&' || !(p = ParseInt(p + 1, end, object.fileID)))
+    return false;
+  object.classID = (int)classID;
+  object.stripped = StartsWith(SkipSpaces(p, end), end, L"stripped");
+  return true;
+}
+
+// True if a "guid:" follows in the same flow mapping and is not all zeros
+static bool HasGuid(const wchar_t *p, const wchar_t *end) {
+  const wchar_t *close = std::find(p, end, L'}');
+  std::wstring_view rest(p, close - p);
+  size_t i = rest.find(L"guid:");
+  if (i == std::wstring_view::npos)
+    return false;
+  for (p = SkipSpaces(p + i + 5, close); p < close && iswxdigit(*p); p++)
+    if (*p != L'0')
+      return true;
+  return false;
+}
+
+UnityRefIndex::UnityRefIndex(const wchar_t *text, size_t size) {
+  size_t object = kNone;
+  size_t line = 0;
+  for (size_t start = 0; start <= size; line++) {
+    size_t end = FindLineBreak(text, start, size);
+    const wchar_t *first = text + start, *last = text + end;
+    if (StartsWith(first, last, L"---")) {
+      UnityObject header = {0, 0, false, start, line};
+      object = kNone;
+      if (ParseHeader(first, last, header)) {
+        object = m_objects.size();
+        m_objects.push_back(header);
+      }
+    } else {
+      std::wstring_view view(first, end - start);
+      for (size_t i = view.find(L"fileID:"); i != std::wstring_view::npos;
+           i = view.find(L"fileID:", i + 7)) {
+        if (i > 0 && view[i - 1] != L'{' && view[i - 1] != L' ' &&
+            view[i - 1] != L',' && view[i - 1] != L'\t')
+          continue; // Part of a longer key
+        int64_t fileID;
+        const wchar_t *number = SkipSpaces(first + i + 7, last);
+        const wchar_t *after = ParseInt(number, last, fileID);
+        if (!after || fileID == 0)
+          continue;
+        m_refs.push_back({fileID, start + i, (size_t)(number - text),
+                          (size_t)(after - number), line, start, object,
+                          HasGuid(after, last)});
+      }
+    }
+    if (end == size)
+      break;
+    if (text[end] == L'\r' && end + 1 < size && text[end + 1] == L'\n')
+      end++;
+    start = end + 1;
+  }
+
+  m_byFileID.reserve(m_objects.size());
+  for (size_t i = 0; i < m_objects.size(); i++)
+    if (!m_byFileID.emplace(m_objects[i].fileID, i).second)
+      m_duplicates++;
+
+  for (size_t i = 0; i < m_refs.size(); i++) {
+    if (m_refs[i].external)
+      continue;
+    m_byTarget.push_back(i);
+    if (!m_byFileID.count(m_refs[i].fileID))
+      m_dangling.push_back(i);
+  }
+  std::stable_sort(m_byTarget.begin(), m_byTarget.end(),
+                   [this](size_t a, size_t b) {
+                     return m_refs[a].fileID < m_refs[b].fileID;
+                   });
+  for (size_t i = 0, j; i < m_byTarget.size(); i = j) {
+    int64_t fileID = m_refs[m_byTarget[i]].fileID;
+    for (j = i + 1;
+         j < m_byTarget.size() && m_refs[m_byTarget[j]].fileID == fileID; j++)
+      ;
+    m_targetRange.emplace(fileID, std::make_pair(i, j));
+  }
+}
+
+size_t UnityRefIndex::Definition(int64_t fileID) const {
+  auto it = m_byFileID.find(fileID);
+  return it == m_byFileID.end() ? kNone : it->second;
+}
+
+std::vector<size_t> UnityRefIndex::References(int64_t fileID) const {
+  auto it = m_targetRange.find(fileID);
+  if (it == m_targetRange.end())
+    return {};
+  return std::vector<size_t>(m_byTarget.begin() + it->second.first,
+                             m_byTarget.begin() + it->second.second);
+}
+
+size_t UnityRefIndex::ObjectAt(size_t offset) const {
+  auto it = std::upper_bound(m_objects.begin(), m_objects.end(), offset,
+                             [](size_t pos, const UnityObject &object) {
+                               return pos < object.offset;
+                             });
+  return it == m_objects.begin() ? kNone : it - m_objects.begin() - 1;
+}
+
+size_t UnityRefIndex::RefOnLine(size_t lineStart, size_t lineEnd,
+                                size_t offset) const {
+  auto it = std::lower_bound(
+      m_refs.begin(), m_refs.end(), lineStart,
+      [](const UnityRef &ref, size_t pos) { return ref.key < pos; });
+  size_t found = kNone;
+  for (; it != m_refs.end() && it->key < lineEnd; ++it) {
+    if (found != kNone && it->key > offset)
+      break;
+    found = it - m_refs.begin();
+  }
+  return found;
+}
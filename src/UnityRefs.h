@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One document of a Unity scene, prefab or asset: "--- !u!<classID>
+// &<fileID>". Offsets are in UTF-16 units of the text, as in the edit
+// control, and lines count CRLF, lone CR and lone LF as in FileMatch.
+struct UnityObject {
+  int64_t fileID;
+  int classID;
+  bool stripped; // Placeholder for an object of a prefab instance
+  size_t offset; // Start of the "---" line
+  size_t line;
+};
+
+// A "fileID: N" inside a document; references to fileID 0 (none) are not
+// kept.
+struct UnityRef {
+  int64_t fileID;
+  size_t key;            // Start of "fileID:"
+  size_t offset, length; // The number
+  size_t line, lineStart;
+  size_t object; // Index of the document it is in; kNone before the first
+  bool external; // Has a non-zero guid, so it points into another file
+};
+
+// Cross-reference index of a Unity YAML file, built by one scan over the
+// text without parsing it as YAML: document headers are recognized at line
+// starts and references by their "fileID:" key. Lookups by fileID are
+// hash table hits.
+class UnityRefIndex {
+public:
+  static const size_t kNone = SIZE_MAX;
+
+  UnityRefIndex(const wchar_t *text, size_t size);
+
+  bool Empty() const { return m_objects.empty(); } // Not a Unity file
+  const std::vector<UnityObject> &Objects() const { return m_objects; }
+  const std::vector<UnityRef> &Refs() const { return m_refs; } // Text order
+
+  // Object defined with fileID, or kNone.
+  size_t Definition(int64_t fileID) const;
+  // Local references to fileID, in text order.
+  std::vector<size_t> References(int64_t fileID) const;
+  // Local references to a fileID no document defines, in text order.
+  const std::vector<size_t> &Dangling() const { return m_dangling; }
+  size_t DuplicateCount() const { return m_duplicates; } // Repeated fileIDs
+
+  // Object whose document contains offset, or kNone.
+  size_t ObjectAt(size_t offset) const;
+  // Last reference on the line [lineStart, lineEnd) whose key starts at
+  // or before offset, else the first on that line, or kNone.
+  size_t RefOnLine(size_t lineStart, size_t lineEnd, size_t offset) const;
+
+private:
+  std::vector<UnityObject> m_objects;
+  std::vector<UnityRef> m_refs;
+  std::unordered_map<int64_t, size_t> m_byFileID;
+  // Local references grouped by target (sorted by fileID, then offset) and
+  // the range of each target in it
+  std::vector<size_t> m_byTarget;
+  std::unordered_map<int64_t, std::pair<size_t, size_t>> m_targetRange;
+  std::vector<size_t> m_dangling;
+  size_t m_duplicates = 0;
+};
@@ -0,0 +1,403 @@
+#include "YamlEmitter.h"
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+static bool IsReservedWord(const std::string &s) {
+  // Words that YAML 1.1 readers treat as booleans or null
+  static const char *const kWords[] = {"true", "false", "null", "yes", "no",
+                                       "on",   "off",   "y",    "n",   "~"};
+  if (s.size() > 5)
+    return false;
+  std::string lower;
+  for (char c : s)
+    lower += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+  for (const char *word : kWords) {
+    if (lower == word)
+      return true;
+  }
+  return false;
+}
+
+// True if s must be quoted to read back as the same string.
+static bool NeedsQuotes(const std::string &s, bool flow) {
+  if (s.empty() || IsReservedWord(s))
+    return true;
+  if (!Model::IsPlainString(s))
+    return true;
+  static const std::string kIndicators = "-?:,[]{}#&*!|>'\"%@`";
+  if (kIndicators.find(s[0]) != std::string::npos)
+    return true;
+  if (s.compare(0, 3, "...") == 0)
+    return true;
+  char last = s.back();
+  if (s[0] == ' ' || s[0] == '\t' || last == ' ' || last == '\t' ||
+      last == ':')
+    return true;
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c < 0x20 || c == 0x7F)
+      return true;
+    if (c == ':' && s[i + 1] == ' ')
+      return true;
+    if (c == '#' && s[i - 1] == ' ')
+      return true;
+    if (flow && (c == ',' || c == '[' || c == ']' || c == '{' || c == '}'))
+      return true;
+  }
+  return false;
+}
+
+static void AppendQuoted(std::string &out, const std::string &s) {
+  static const char kHex[] = "0123456789ABCDEF";
+  out += '"';
+  size_t run = 0; // Start of the pending run of unescaped bytes
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7F)
+      continue;
+    out.append(s, run, i - run);
+    run = i + 1;
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case 0:
+      out += "\\0";
+      break;
+    default:
+      out += "\\x";
+      out += kHex[c >> 4];
+      out += kHex[c & 0xF];
+      break;
+    }
+  }
+  out.append(s, run, std::string::npos);
+  out += '"';
+}
+
+static void AppendInteger(std::string &out, int64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static void AppendInteger(std::string &out, uint64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+static void AppendReal(std::string &out, double value) {
+  if (std::isnan(value)) {
+    out += ".nan";
+    return;
+  }
+  if (std::isinf(value)) {
+    out += value < 0 ? "-.inf" : ".inf";
+    return;
+  }
+  char buf[32];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  size_t start = out.size();
+  out.append(buf, res.ptr);
+  // Keep integral reals recognizable as reals
+  if (out.find_first_of(".e", start) == std::string::npos)
+    out += ".0";
+}
+
+static void AppendScalar(std::string &out, const ModelNode &node, bool flow) {
+  switch (node.kind) {
+  case ModelNode::NUL:
+    out += "null";
+    break;
+  case ModelNode::BOOLEAN:
+    out += node.boolean ? "true" : "false";
+    break;
+  case ModelNode::INTEGER:
+    if (node.isUnsigned)
+      AppendInteger(out, node.uinteger);
+    else
+      AppendInteger(out, node.integer);
+    break;
+  case ModelNode::REAL:
+    AppendReal(out, node.real);
+    break;
+  case ModelNode::STRING:
+    YamlEmitter::AppendString(out, node.Text(), flow);
+    break;
+  default:
+    break;
+  }
+}
+
+class YamlWriter {
+public:
+  YamlWriter(const YamlEmitOptions &options, std::string &out)
+      : m_options(options), m_out(out) {}
+
+  void Document(const ModelPtr &root) {
+    m_anchors.clear();
+    m_emitted.clear();
+    std::unordered_set<const ModelNode *> visited;
+    std::unordered_map<std::string, const ModelNode *> owners;
+    CollectAnchors(root, visited, owners);
+
+    m_lineStarted = false;
+    Node(root, 0, ROOT);
+    m_out += m_options.newline;
+  }
+
+private:
+  enum Context { ROOT, MAP_VALUE, SEQ_ITEM };
+
+  // Names every node that an alias refers to. Two targets that share an
+  // anchor name (YAML allows redefinition) get distinct names.
+  void CollectAnchors(const ModelPtr &node,
+                      std::unordered_set<const ModelNode *> &visited,
+                      std::unordered_map<std::string, const ModelNode *> &owners) {
+    if (node->kind == ModelNode::ALIAS) {
+      if (node->items.empty())
+        throw std::runtime_error("Recursive alias *" + node->Text());
+      const ModelNode *target = node->items[0].get();
+      if (m_anchors.count(target))
+        return;
+      std::string name = node->Text();
+      for (int n = 2; owners.count(name) && owners[name] != target; n++)
+        name = node->Text() + "_" + std::to_string(n);
+      owners[name] = target;
+      m_anchors[target] = name;
+      // The target may be nowhere else in the document
+      CollectAnchors(node->items[0], visited, owners);
+      return;
+    }
+    if (node->IsPacked() || !node->IsContainer() ||
+        !visited.insert(node.get()).second)
+      return;
+    for (const ModelPtr &child : node->items)
+      CollectAnchors(child, visited, owners);
+  }
+
+  void NewLine(size_t column) {
+    if (m_lineStarted)
+      m_out += m_options.newline;
+    m_lineStarted = true;
+    m_out.append(column, ' ');
+  }
+
+  // Space before a value that follows "key:" or "-".
+  void Separate(Context context) {
+    if (context != ROOT)
+      m_out += ' ';
+    m_lineStarted = true;
+  }
+
+  // Writes "&name" if node is an alias target not written yet.
+  bool Anchor(const ModelPtr &node, Context context) {
+    auto it = m_anchors.find(node.get());
+    if (it == m_anchors.end() || !m_emitted.insert(node.get()).second)
+      return false;
+    Separate(context);
+    m_out += '&';
+    m_out += it->second;
+    return true;
+  }
+
+  void String(const std::string &s, bool flow) {
+    YamlEmitter::AppendString(m_out, s, flow);
+  }
+
+  void Scalar(const ModelPtr &node, bool flow) {
+    if (node->kind == ModelNode::ALIAS) {
+      m_out += '*';
+      m_out += m_anchors.at(node->items[0].get());
+    } else {
+      AppendScalar(m_out, *node, flow);
+    }
+  }
+
+  void PackedItem(const ModelNode &node, size_t i) {
+    if (node.packedKind == ModelNode::REAL)
+      AppendReal(m_out, node.PackedReals()[i]);
+    else if (node.packedKind == ModelNode::BOOLEAN)
+      m_out += node.PackedInts()[i] ? "true" : "false";
+    else
+      AppendInteger(m_out, node.PackedInts()[i]);
+  }
+
+  bool IsFlow(const ModelPtr &node) const {
+    size_t size = node->Size();
+    if (m_options.flowThreshold == 0 || size > m_options.flowThreshold)
+      return false;
+    if (node->IsPacked())
+      return true;
+    for (const ModelPtr &child : node->items) {
+      if (child->IsContainer() || m_anchors.count(child.get()))
+        return false;
+      if (child->kind == ModelNode::ALIAS &&
+          !m_emitted.count(child->items[0].get()))
+        return false; // Its target is written in block style below
+    }
+    return true;
+  }
+
+  void Flow(const ModelPtr &node) {
+    bool isMap = node->kind == ModelNode::OBJECT;
+    m_out += isMap ? '{' : '[';
+    for (size_t i = 0; i < node->Size(); i++) {
+      if (i > 0)
+        m_out += ", ";
+      if (isMap) {
+        String(node->Keys()[i], true);
+        m_out += ": ";
+      }
+      if (node->IsPacked())
+        PackedItem(*node, i);
+      else
+        Scalar(node->items[i], true);
+    }
+    m_out += isMap ? '}' : ']';
+  }
+
+  // Writes node; the cursor is after "key:", after "-", or at the start of
+  // the document. column is the column of that key or dash.
+  void Node(const ModelPtr &node, size_t column, Context context) {
+    // An alias met before its target writes the target there, with its
+    // anchor: the target may come later in the document or not be in it at
+    // all. Any later occurrence of the target is written as an alias.
+    const ModelNode *target =
+        node->kind == ModelNode::ALIAS ? node->items[0].get() : node.get();
+    if (m_anchors.count(target) && m_emitted.count(target)) {
+      Separate(context);
+      m_out += '*';
+      m_out += m_anchors[target];
+      return;
+    }
+    if (node->kind == ModelNode::ALIAS) {
+      Node(node->items[0], column, context);
+      return;
+    }
+
+    bool anchored = Anchor(node, context);
+    Context valueContext = anchored ? MAP_VALUE : context; // After "&name"
+
+    if (!node->IsContainer()) {
+      Separate(valueContext);
+      Scalar(node, false);
+      return;
+    }
+    if (node->Size() == 0) {
+      Separate(valueContext);
+      m_out += node->kind == ModelNode::OBJECT ? "{}" : "[]";
+      return;
+    }
+    if (IsFlow(node)) {
+      Separate(valueContext);
+      Flow(node);
+      return;
+    }
+
+    // Block layout. The first child of a sequence item shares the dash
+    // line ("- a: 1") unless an anchor is in the way; other children start
+    // on the next line.
+    size_t childColumn = 0;
+    bool inlineFirst = false;
+    if (context == SEQ_ITEM) {
+      childColumn = column + 2;
+      if (!anchored) {
+        m_out += ' ';
+        inlineFirst = true;
+      }
+    } else if (context == MAP_VALUE) {
+      childColumn = column + m_options.indent;
+    }
+
+    for (size_t i = 0; i < node->Size(); i++) {
+      if (!(i == 0 && inlineFirst))
+        NewLine(childColumn);
+      if (node->kind == ModelNode::OBJECT) {
+        String(node->Keys()[i], false);
+        m_out += ':';
+        Node(node->items[i], childColumn, MAP_VALUE);
+      } else {
+        m_out += '-';
+        if (node->IsPacked()) {
+          m_out += ' ';
+          PackedItem(*node, i);
+        } else {
+          Node(node->items[i], childColumn, SEQ_ITEM);
+        }
+      }
+    }
+  }
+
+  const YamlEmitOptions &m_options;
+  std::string &m_out;
+  bool m_lineStarted = false;
+  std::unordered_map<const ModelNode *, std::string> m_anchors;
+  std::unordered_set<const ModelNode *> m_emitted;
+};
+
+void YamlEmitter::AppendString(std::string &out, const std::string &s,
+                               bool flow) {
+  if (NeedsQuotes(s, flow))
+    AppendQuoted(out, s);
+  else
+    out += s;
+}
+
+std::string YamlEmitter::Emit(const std::vector<ModelPtr> &documents,
+                              const YamlEmitOptions &options) {
+  std::string out;
+  YamlWriter writer(options, out);
+  for (size_t i = 0; i < documents.size(); i++) {
+    if (i > 0) {
+      out += "---";
+      out += options.newline;
+    }
+    writer.Document(documents[i]);
+  }
+  return out;
+}
+
+void YamlEmitter::AppendInline(std::string &out, const ModelPtr &node,
+                               bool flow) {
+  ModelPtr target = Model::Resolve(node);
+  if (target->kind == ModelNode::ALIAS)
+    throw std::runtime_error("Recursive alias *" + target->Text());
+  if (target->kind == ModelNode::OBJECT) {
+    out += '{';
+    for (size_t i = 0; i < target->items.size(); i++) {
+      if (i > 0)
+        out += ", ";
+      AppendString(out, target->Keys()[i], true);
+      out += ": ";
+      AppendInline(out, target->items[i], true);
+    }
+    out += '}';
+  } else if (target->kind == ModelNode::ARRAY) {
+    out += '[';
+    for (size_t i = 0; i < target->Size(); i++) {
+      if (i > 0)
+        out += ", ";
+      AppendInline(out, Model::Item(target, i), true);
+    }
+    out += ']';
+  } else {
+    AppendScalar(out, *target, flow);
+  }
+}
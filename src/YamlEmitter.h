@@ -0,0 +1,36 @@
+#pragma once
+#include "Model.h"
+#include <string>
+#include <vector>
+
+struct YamlEmitOptions {
+  int indent = 2;           // Spaces per nesting level
+  size_t flowThreshold = 0; // Write sequences and maps of at most this many
+                            // scalars inline ([a, b] / {k: v}); 0 disables
+  const char *newline = "\r\n";
+};
+
+// Writes models as block-style YAML straight into a string buffer.
+//
+// Scalars are quoted only when a plain scalar would read back differently,
+// numbers are formatted with std::to_chars, and packed arrays are written
+// without boxing their elements. A node referenced by aliases gets its
+// anchor at its first occurrence, whether that is the node itself or an
+// alias to it, and every other occurrence is written as *name, so
+// anchor-heavy documents are not expanded.
+class YamlEmitter {
+public:
+  // Writes each root as one document; documents after the first are
+  // preceded by "---". Throws std::runtime_error on a recursive alias.
+  static std::string Emit(const std::vector<ModelPtr> &documents,
+                          const YamlEmitOptions &options);
+  // Appends s as a string scalar, quoted only if a plain scalar would read
+  // back differently. flow is set inside [...] and {...}.
+  static void AppendString(std::string &out, const std::string &s,
+                           bool flow = false);
+  // Appends node on one line, collections in flow style and aliases
+  // expanded, for replacing a value in place. flow is as for AppendString.
+  // Throws std::runtime_error on a recursive alias.
+  static void AppendInline(std::string &out, const ModelPtr &node,
+                           bool flow = false);
+};
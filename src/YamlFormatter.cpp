@@ -0,0 +1,323 @@
+#include "YamlFormatter.h"
+#include <cstring>
+#include <vector>
+
+class YamlReindenter {
+public:
+  YamlReindenter(int indent, const char *newline, size_t baseColumn,
+                 std::string &out)
+      : m_indent(indent), m_newline(newline), m_base(baseColumn), m_out(out) {}
+
+  void Line(const char *p, size_t len) {
+    size_t end = len;
+    while (end > 0 && (p[end - 1] == ' ' || p[end - 1] == '\t'))
+      end--;
+    size_t col = 0;
+    while (col < end && p[col] == ' ')
+      col++;
+
+    if (m_lines++ > 0)
+      m_out += m_newline;
+
+    if (m_mode == BLOCK_SCALAR && BlockScalarLine(p, col, end, len))
+      return;
+    if (m_mode == CONTINUATION) {
+      if (col < end) {
+        m_out.append(m_continuationColumn, ' ');
+        Content(p + col, end - col);
+      }
+      return;
+    }
+    if (col == end)
+      return; // Blank line
+
+    // Directives and document markers reset the structure
+    if (col == 0 && (p[0] == '%' || IsMarker(p, end, "---") ||
+                     IsMarker(p, end, "..."))) {
+      m_stack.clear();
+      m_out.append(p, end);
+      return;
+    }
+
+    if (p[col] == '#') {
+      m_out.append(CommentColumn(col), ' ');
+      m_out.append(p + col, end - col);
+      return;
+    }
+
+    size_t column = Place(col);
+    m_out.append(column, ' ');
+
+    // Sequence entries: "-   x" becomes "- x". Whatever follows a dash
+    // opens a level at its column so the lines below it stay aligned.
+    size_t i = col;
+    size_t dashOrig = col, dashNew = column;
+    bool afterDash = false;
+    while (i < end && p[i] == '-' && (i + 1 == end || p[i + 1] == ' ')) {
+      dashOrig = i;
+      dashNew = column;
+      afterDash = true;
+      m_out += '-';
+      size_t j = i + 1;
+      while (j < end && p[j] == ' ')
+        j++;
+      if (j == end) {
+        i = j;
+        break;
+      }
+      m_out += ' ';
+      column += 2;
+      m_stack.push_back({j, column});
+      i = j;
+    }
+    if (i == end)
+      return;
+
+    // "- |" belongs to the dash; "key: |" belongs to the key
+    bool blockAtStart = afterDash && (p[i] == '|' || p[i] == '>');
+    m_ownerOrig = blockAtStart ? dashOrig : m_stack.back().orig;
+    m_ownerNew = blockAtStart ? dashNew : m_stack.back().column;
+    m_continuationColumn = column + m_indent;
+    Content(p + i, end - i);
+  }
+
+private:
+  enum Mode { NORMAL, BLOCK_SCALAR, CONTINUATION };
+  struct Level {
+    size_t orig;   // Column in the source
+    size_t column; // Column in the output
+  };
+
+  static bool IsMarker(const char *p, size_t end, const char *marker) {
+    return end >= 3 && memcmp(p, marker, 3) == 0 &&
+           (end == 3 || p[3] == ' ' || p[3] == '\t');
+  }
+
+  // Output column for a content line at source column col.
+  size_t Place(size_t col) {
+    while (!m_stack.empty() && m_stack.back().orig > col)
+      m_stack.pop_back();
+    if (!m_stack.empty() && m_stack.back().orig == col)
+      return m_stack.back().column;
+    size_t column =
+        m_stack.empty() ? m_base : m_stack.back().column + m_indent;
+    m_stack.push_back({col, column});
+    return column;
+  }
+
+  // Comments follow the level they are at without changing the structure.
+  size_t CommentColumn(size_t col) const {
+    for (size_t k = m_stack.size(); k-- > 0;) {
+      if (m_stack[k].orig == col)
+        return m_stack[k].column;
+      if (m_stack[k].orig < col)
+        return m_stack[k].column + m_indent;
+    }
+    return m_base;
+  }
+
+  // Handles a line while inside a block scalar. Returns false once the
+  // scalar has ended and the line must be formatted normally. Whitespace
+  // past the content column is part of the value, so the line is copied
+  // up to len rather than the trimmed end.
+  bool BlockScalarLine(const char *p, size_t col, size_t end, size_t len) {
+    if (col == end) {
+      // Blank lines belong to the scalar
+      if (m_contentOrig != std::string::npos && len > m_contentOrig) {
+        m_out.append(m_contentNew, ' ');
+        m_out.append(p + m_contentOrig, len - m_contentOrig);
+      }
+      return true;
+    }
+    if (m_contentOrig == std::string::npos) {
+      if (col <= m_ownerOrig) {
+        m_mode = NORMAL; // Empty scalar
+        return false;
+      }
+      m_contentOrig = col;
+      m_contentNew = m_ownerNew + m_indent;
+    }
+    if (col < m_contentOrig) {
+      m_mode = NORMAL;
+      return false;
+    }
+    m_out.append(m_contentNew, ' ');
+    m_out.append(p + m_contentOrig, len - m_contentOrig);
+    return true;
+  }
+
+  // Copies the rest of a line, tidying "key:   value" to "key: value",
+  // while tracking quotes and flow brackets that may continue on the next
+  // line and spotting block scalar indicators.
+  void Content(const char *p, size_t n) {
+    size_t lastToken = std::string::npos; // Start of the last plain token
+    bool tokenStart = (m_quote == 0);
+    for (size_t i = 0; i < n; i++) {
+      char c = p[i];
+      if (m_quote == '"') {
+        m_out += c;
+        if (c == '\\' && i + 1 < n)
+          m_out += p[++i];
+        else if (c == '"')
+          m_quote = 0;
+        continue;
+      }
+      if (m_quote == '\'') {
+        m_out += c;
+        if (c == '\'') {
+          if (i + 1 < n && p[i + 1] == '\'')
+            m_out += p[++i];
+          else
+            m_quote = 0;
+        }
+        continue;
+      }
+
+      if (c == '#' && (i == 0 || p[i - 1] == ' ')) {
+        m_out.append(p + i, n - i); // Comment
+        break;
+      }
+      if (c == ' ') {
+        m_out += c;
+        tokenStart = true;
+        continue;
+      }
+      if (tokenStart && (c == '"' || c == '\'')) {
+        m_quote = c;
+        m_out += c;
+        tokenStart = false;
+        continue;
+      }
+      if (c == ':' && (i + 1 == n || p[i + 1] == ' ')) {
+        m_out += ':';
+        size_t j = i + 1;
+        while (j < n && p[j] == ' ')
+          j++;
+        if (j < n)
+          m_out += ' ';
+        i = j - 1;
+        tokenStart = true;
+        continue;
+      }
+      if (c == '[' || c == '{') {
+        m_flowDepth++;
+        tokenStart = true;
+      } else if ((c == ']' || c == '}') && m_flowDepth > 0) {
+        m_flowDepth--;
+        tokenStart = false;
+      } else if (c == ',' && m_flowDepth > 0) {
+        tokenStart = true;
+      } else {
+        if (tokenStart)
+          lastToken = i;
+        tokenStart = false;
+      }
+      m_out += c;
+    }
+
+    if (m_quote != 0 || m_flowDepth > 0) {
+      m_mode = CONTINUATION;
+      return;
+    }
+    m_mode = NORMAL;
+
+    // Block scalar header: "|" or ">" with optional chomping and indent
+    // indicators as the last token of the line
+    if (lastToken == std::string::npos ||
+        (p[lastToken] != '|' && p[lastToken] != '>'))
+      return;
+    size_t explicitIndent = 0;
+    size_t k = lastToken + 1;
+    for (; k < n && p[k] != ' '; k++) {
+      if (p[k] >= '1' && p[k] <= '9')
+        explicitIndent = p[k] - '0';
+      else if (p[k] != '+' && p[k] != '-')
+        return;
+    }
+    while (k < n && p[k] == ' ')
+      k++;
+    if (k < n && p[k] != '#')
+      return;
+    m_mode = BLOCK_SCALAR;
+    m_contentOrig = std::string::npos;
+    if (explicitIndent) {
+      // The indicator puts the content at a fixed offset from the owner,
+      // whatever the first line's indentation. Keeping that offset keeps
+      // the indicator right, and deeper lines keep their extra spaces.
+      m_contentOrig = m_ownerOrig + explicitIndent;
+      m_contentNew = m_ownerNew + explicitIndent;
+    }
+  }
+
+  int m_indent;
+  const char *m_newline;
+  size_t m_base;
+  std::string &m_out;
+  size_t m_lines = 0;
+  std::vector<Level> m_stack;
+
+  Mode m_mode = NORMAL;
+  char m_quote = 0;     // Open quote carried over from earlier lines
+  int m_flowDepth = 0;  // Open flow brackets carried over
+  size_t m_continuationColumn = 0;
+  size_t m_ownerOrig = 0, m_ownerNew = 0; // Node owning a block scalar
+  size_t m_contentOrig = std::string::npos, m_contentNew = 0;
+};
+
+std::string YamlFormatter::Format(const char *data, size_t size, int indent,
+                                  const char *newline, size_t baseColumn) {
+  std::string out;
+  out.reserve(size + size / 8);
+  YamlReindenter reindenter(indent < 1 ? 2 : indent, newline, baseColumn,
+                            out);
+
+  size_t start = 0;
+  while (start < size) {
+    const char *eol = (const char *)memchr(data + start, '\n', size - start);
+    size_t end = eol ? (size_t)(eol - data) : size;
+    size_t lineEnd = end;
+    if (lineEnd > start && data[lineEnd - 1] == '\r')
+      lineEnd--;
+    reindenter.Line(data + start, lineEnd - start);
+    start = end + 1;
+  }
+  if (size > 0 && (data[size - 1] == '\n' || data[size - 1] == '\r'))
+    out += newline;
+  return out;
+}
+
+void YamlFormatter::FindEnclosing(const char *data, size_t size, size_t offset,
+                                  size_t &begin, size_t &end, size_t &column) {
+  if (offset > size)
+    offset = size;
+  begin = offset;
+  while (begin > 0 && data[begin - 1] != '\n')
+    begin--;
+  column = 0;
+  while (begin + column < size && data[begin + column] == ' ')
+    column++;
+
+  // Extend over deeper lines, remembering the last non-blank one
+  size_t line = begin;
+  end = begin;
+  bool first = true;
+  while (line < size) {
+    const char *eol = (const char *)memchr(data + line, '\n', size - line);
+    size_t lineEnd = eol ? (size_t)(eol - data) : size;
+    size_t contentEnd = lineEnd;
+    while (contentEnd > line &&
+           (data[contentEnd - 1] == '\r' || data[contentEnd - 1] == ' ' ||
+            data[contentEnd - 1] == '\t'))
+      contentEnd--;
+    size_t col = 0;
+    while (line + col < contentEnd && data[line + col] == ' ')
+      col++;
+    bool blank = line + col == contentEnd;
+    if (!first && !blank && col <= column)
+      break;
+    if (!blank || first)
+      end = contentEnd;
+    first = false;
+    line = lineEnd + 1;
+  }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Line-level YAML re-indenter.
+//
+// Works on the text itself rather than on a parsed YAML::Node, so comments,
+// tags (e.g. Unity's !u!), anchors, directives and every document of a
+// multi-document stream survive unchanged. Block indentation is normalized
+// to indent spaces per level, "- " and "key: " spacing is tidied and
+// trailing whitespace is removed. Block scalars keep their relative
+// indentation and their trailing whitespace, and flow collections or quoted scalars that span lines are
+// re-indented as continuation lines. The only state kept is the stack of
+// open indentation levels.
+class YamlFormatter {
+public:
+  // baseColumn is the indentation of the outermost level, for
+  // reformatting a node nested inside a larger document.
+  static std::string Format(const char *data, size_t size, int indent,
+                            const char *newline = "\r\n",
+                            size_t baseColumn = 0);
+
+  // Span [begin, end) of the block node on the line containing offset: that
+  // line plus every following line indented deeper (trailing blank lines
+  // and the final line break excluded). column receives its indentation.
+  static void FindEnclosing(const char *data, size_t size, size_t offset,
+                            size_t &begin, size_t &end, size_t &column);
+};
@@ -0,0 +1,302 @@
+#include "YamlLint.h"
+#include "Model.h"
+#include <unordered_map>
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/yaml.h>
+
+namespace {
+
+// Value types the type drift check tells apart.
+enum ValueType : uint8_t {
+  UNKNOWN, // An alias to an anchor not seen
+  NUL,
+  BOOLEAN,
+  NUMBER,
+  STRING,
+  SEQUENCE,
+  MAPPING
+};
+
+const char *const kTypeNames[] = {"unknown",  "null",       "a boolean",
+                                  "a number", "a string",   "a sequence",
+                                  "a mapping"};
+
+// Thrown from the handler to stop the parser once cancelled or full.
+struct Stop {};
+
+class LintHandler : public YAML::EventHandler {
+public:
+  LintHandler(const LintRules &rules, const std::atomic<bool> *cancel,
+              size_t limit)
+      : m_rules(rules), m_cancel(cancel), m_limit(limit) {}
+
+  std::vector<LintDiagnostic> diagnostics;
+  size_t document = 0;
+
+  void OnDocumentStart(const YAML::Mark &) override {
+    m_stack.clear();
+    m_anchors.clear();
+  }
+
+  void OnDocumentEnd() override { document++; }
+
+  void OnNull(const YAML::Mark &mark, YAML::anchor_t anchor) override {
+    Tick();
+    if (KeySlot())
+      Key(mark, "null");
+    else
+      Value(mark, NUL);
+    Remember(anchor, NUL, "null");
+  }
+
+  void OnAlias(const YAML::Mark &mark, YAML::anchor_t anchor) override {
+    Tick();
+    const Anchor *target =
+        anchor < m_anchors.size() ? &m_anchors[anchor] : nullptr;
+    if (!KeySlot())
+      Value(mark, target ? target->type : UNKNOWN);
+    else if (target && target->type != SEQUENCE && target->type != MAPPING)
+      Key(mark, target->text);
+    else
+      EndComplexKey();
+  }
+
+  void OnScalar(const YAML::Mark &mark, const std::string &tag,
+                YAML::anchor_t anchor, const std::string &value) override {
+    Tick();
+    bool key = KeySlot();
+    ValueType type = STRING;
+    if ((anchor != 0 || (!key && Tracked())) && tag != "!" &&
+        tag != "tag:yaml.org,2002:str") {
+      // Typed the way the model and the JSON conversion type it
+      ModelNode scalar;
+      Model::ParseScalar(value, scalar);
+      type = scalar.kind == ModelNode::NUL       ? NUL
+             : scalar.kind == ModelNode::BOOLEAN ? BOOLEAN
+             : scalar.kind == ModelNode::INTEGER ||
+                     scalar.kind == ModelNode::REAL
+                 ? NUMBER
+                 : STRING;
+    }
+    if (key)
+      Key(mark, value);
+    else
+      Value(mark, type);
+    if (m_rules.maxScalarBytes && value.size() > m_rules.maxScalarBytes)
+      Report(LintDiagnostic::SCALAR_SIZE, mark, Path(m_stack.size()),
+             std::string(key ? "key" : "value") + " of " +
+                 std::to_string(value.size()) + " bytes, over the limit of " +
+                 std::to_string(m_rules.maxScalarBytes));
+    Remember(anchor, type, value);
+  }
+
+  void OnSequenceStart(const YAML::Mark &mark, const std::string &,
+                       YAML::anchor_t anchor,
+                       YAML::EmitterStyle::value) override {
+    Push(mark, anchor, false);
+  }
+
+  void OnSequenceEnd() override { Pop(); }
+
+  void OnMapStart(const YAML::Mark &mark, const std::string &,
+                  YAML::anchor_t anchor, YAML::EmitterStyle::value) override {
+    Push(mark, anchor, true);
+  }
+
+  void OnMapEnd() override { Pop(); }
+
+private:
+  // Type first seen at a key path under the elements of a sequence
+  struct Seen {
+    ValueType type;
+    int line;
+    size_t element;
+    bool reported; // Drift is reported once per key path
+  };
+
+  struct Frame {
+    bool isMap = false;
+    bool isKey = false;      // The collection is, or is in, a mapping key
+    bool keySlot = false;    // The collection is a mapping key itself
+    size_t count = 0;        // Elements, or keys, so far
+    bool haveKey = false;    // Mapping: the next node is key's value
+    bool complexKey = false; // Mapping: key is a collection
+    std::string key;
+    // Mapping: the sequence whose elements it is under (-1 if none) and
+    // its key path from the element; a sequence keeps the types seen
+    int sequence = -1;
+    std::string keyPath;
+    std::unordered_map<std::string, int> keys; // Key -> line, for duplicates
+    std::unordered_map<std::string, Seen> types;
+  };
+
+  struct Anchor {
+    ValueType type = UNKNOWN;
+    std::string text; // Of a scalar, for an alias used as a key
+  };
+
+  void Tick() {
+    if (m_cancel && (++m_events & 4095) == 0 && *m_cancel)
+      throw Stop();
+  }
+
+  bool KeySlot() const {
+    return !m_stack.empty() && m_stack.back().isMap && !m_stack.back().haveKey;
+  }
+
+  // The next value's type is compared across sequence elements.
+  bool Tracked() const {
+    if (!m_rules.typeDrift || m_stack.empty())
+      return false;
+    const Frame &parent = m_stack.back();
+    return parent.isMap && parent.sequence >= 0 && !parent.complexKey;
+  }
+
+  // Pointer to the current child of the first depth open collections.
+  std::string Path(size_t depth) const {
+    std::string path;
+    for (size_t i = 0; i < depth; i++) {
+      const Frame &frame = m_stack[i];
+      path += '/';
+      path += frame.isMap ? Model::EscapePointerToken(frame.key)
+                          : std::to_string(frame.count - 1);
+    }
+    return path;
+  }
+
+  void Report(LintDiagnostic::Rule rule, const YAML::Mark &mark,
+              std::string path, std::string message) {
+    if (diagnostics.size() >= m_limit)
+      throw Stop();
+    diagnostics.push_back({rule, document, mark.line, mark.column,
+                           std::move(path), std::move(message)});
+  }
+
+  void Remember(YAML::anchor_t anchor, ValueType type,
+                const std::string &text) {
+    if (anchor == 0)
+      return;
+    if (anchor >= m_anchors.size())
+      m_anchors.resize(anchor + 1);
+    m_anchors[anchor].type = type;
+    m_anchors[anchor].text = text;
+  }
+
+  void Key(const YAML::Mark &mark, const std::string &text) {
+    Frame &map = m_stack.back();
+    map.haveKey = true;
+    map.complexKey = false;
+    map.key = text;
+    map.count++;
+    if (!m_rules.duplicateKeys)
+      return;
+    auto first = map.keys.emplace(text, mark.line);
+    if (!first.second)
+      Report(LintDiagnostic::DUPLICATE_KEY, mark, Path(m_stack.size()),
+             "duplicate key \"" + text + "\", first on Ln " +
+                 std::to_string(first.first->second) +
+                 "; only the last value is kept");
+  }
+
+  void EndComplexKey() {
+    Frame &map = m_stack.back();
+    map.haveKey = true;
+    map.complexKey = true;
+    map.key = "?";
+    map.count++;
+  }
+
+  // Any node that is not a mapping key, before it is handled.
+  void Value(const YAML::Mark &mark, ValueType type) {
+    if (m_stack.empty())
+      return;
+    Frame &parent = m_stack.back();
+    if (!parent.isMap) {
+      parent.count++;
+      return;
+    }
+    parent.haveKey = false;
+    if (!Tracked() || type == NUL || type == UNKNOWN)
+      return;
+    Frame &sequence = m_stack[parent.sequence];
+    auto seen = sequence.types.emplace(
+        parent.keyPath + "/" + Model::EscapePointerToken(parent.key),
+        Seen{type, mark.line, sequence.count - 1, false});
+    Seen &first = seen.first->second;
+    if (seen.second || first.type == type || first.reported)
+      return;
+    first.reported = true;
+    Report(LintDiagnostic::TYPE_DRIFT, mark, Path(m_stack.size()),
+           "\"" + parent.key + "\" is " + kTypeNames[type] + " here but " +
+               kTypeNames[first.type] + " in item " +
+               std::to_string(first.element) + " (Ln " +
+               std::to_string(first.line) + ")");
+  }
+
+  void Push(const YAML::Mark &mark, YAML::anchor_t anchor, bool isMap) {
+    Tick();
+    Frame frame;
+    frame.isMap = isMap;
+    if (!m_stack.empty()) {
+      Frame &parent = m_stack.back();
+      frame.keySlot = KeySlot();
+      frame.isKey = parent.isKey || frame.keySlot;
+      if (!frame.keySlot)
+        Value(mark, isMap ? MAPPING : SEQUENCE);
+      if (!frame.isKey && isMap && !parent.isMap) {
+        frame.sequence = (int)m_stack.size() - 1;
+      } else if (!frame.isKey && isMap && parent.sequence >= 0 &&
+                 !parent.complexKey) {
+        frame.sequence = parent.sequence;
+        frame.keyPath =
+            parent.keyPath + "/" + Model::EscapePointerToken(parent.key);
+      }
+    }
+    Remember(anchor, isMap ? MAPPING : SEQUENCE, std::string());
+    m_stack.push_back(std::move(frame));
+    if (m_rules.maxDepth && m_stack.size() == m_rules.maxDepth + 1)
+      Report(LintDiagnostic::DEPTH, mark, Path(m_stack.size() - 1),
+             "nested deeper than " + std::to_string(m_rules.maxDepth) +
+                 " levels");
+  }
+
+  void Pop() {
+    bool keySlot = m_stack.back().keySlot;
+    m_stack.pop_back();
+    if (keySlot)
+      EndComplexKey();
+  }
+
+  const LintRules &m_rules;
+  const std::atomic<bool> *m_cancel;
+  size_t m_limit;
+  size_t m_events = 0;
+  std::vector<Frame> m_stack;
+  std::vector<Anchor> m_anchors; // By anchor id, reset per document
+};
+
+} // namespace
+
+std::vector<LintDiagnostic> YamlLint::Run(std::istream &in,
+                                          const LintRules &rules,
+                                          const std::atomic<bool> *cancel,
+                                          size_t limit, bool *complete) {
+  LintHandler handler(rules, cancel, limit);
+  bool stopped = false;
+  try {
+    YAML::Parser parser(in);
+    while (parser.HandleNextDocument(handler)) {
+    }
+  } catch (const Stop &) {
+    stopped = true;
+  } catch (const YAML::Exception &e) {
+    if (handler.diagnostics.size() < limit)
+      handler.diagnostics.push_back({LintDiagnostic::SYNTAX, handler.document,
+                                     e.mark.line, e.mark.column, "", e.msg});
+    else
+      stopped = true;
+  }
+  if (complete)
+    *complete = !stopped;
+  return std::move(handler.diagnostics);
+}
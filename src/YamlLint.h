@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Which checks run; a limit of 0 turns its check off.
+struct LintRules {
+  bool duplicateKeys = true;
+  // The same key path under the elements of one sequence holds values of
+  // different types (nulls are taken as missing values and never differ)
+  bool typeDrift = true;
+  size_t maxDepth = 64;                // Nested collections
+  size_t maxScalarBytes = 1024 * 1024; // One key or value
+};
+
+struct LintDiagnostic {
+  enum Rule { DUPLICATE_KEY, TYPE_DRIFT, DEPTH, SCALAR_SIZE, SYNTAX };
+  Rule rule;
+  size_t document; // Index of the YAML document
+  int line, column; // 0-based, as the parser reports them
+  std::string path; // JSON Pointer within the document
+  std::string message;
+};
+
+// Lint over YAML (or JSON) parser events.
+//
+// Nothing is built: the handler keeps one frame per open collection, with
+// the keys of a mapping for duplicate detection and, for a sequence, the
+// type first seen at each key path under its elements. Duplicate keys are
+// what a map-based conversion silently collapses, the later value
+// overwriting the earlier one, so they are worth reporting before that
+// happens.
+class YamlLint {
+public:
+  // Diagnostics in document order, at most limit. Stops at a syntax error,
+  // which is the last diagnostic. *complete, if given, receives false when
+  // the limit or cancel cut the run short.
+  static std::vector<LintDiagnostic>
+  Run(std::istream &in, const LintRules &rules,
+      const std::atomic<bool> *cancel = nullptr, size_t limit = SIZE_MAX,
+      bool *complete = nullptr);
+};
@@ -11,6 +11,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
     MSG msg = {};
     while (GetMessage(&msg, NULL, 0, 0)) {
+        if (window.PreTranslateMessage(&msg))
+            continue;
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }